@@ -0,0 +1,107 @@
+#ifndef RIRC_BENCH_H
+#define RIRC_BENCH_H
+
+/* bench.h -- benchmark helpers for rirc, results reported as TAP comments
+ *
+ * Benchmarks are testcases run with run_tests(), and should be included
+ * after test/test.h and before any rirc sources, such that:
+ *
+ *  - write() is a counting sink, output is discarded and the number of
+ *    calls and bytes written are counted
+ *  - malloc(), calloc() and realloc() count allocations
+ *
+ * Defines the following:
+ *
+ *   - bench_count    - running counts of writes, bytes and allocations
+ *   - bench_ns()     - monotonic timestamp, in nanoseconds
+ *   - bench_result() - report a benchmark result
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef RIRC_TEST_H
+#error "bench.h" should be included after "test.h"
+#endif
+
+struct bench_count
+{
+	uint64_t allocs;
+	uint64_t bytes;
+	uint64_t writes;
+};
+
+static struct bench_count bench_count;
+
+static inline ssize_t
+bench_write(int fd, const void *buf, size_t n)
+{
+	(void)fd;
+	(void)buf;
+
+	bench_count.bytes += n;
+	bench_count.writes++;
+
+	return (ssize_t)n;
+}
+
+static inline void*
+bench_malloc(size_t n)
+{
+	bench_count.allocs++;
+
+	return malloc(n);
+}
+
+static inline void*
+bench_calloc(size_t n, size_t size)
+{
+	bench_count.allocs++;
+
+	return calloc(n, size);
+}
+
+static inline void*
+bench_realloc(void *p, size_t n)
+{
+	bench_count.allocs++;
+
+	return realloc(p, n);
+}
+
+static inline uint64_t
+bench_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static inline void
+bench_result(const char *name, uint64_t n, uint64_t ns, const struct bench_count *c0)
+{
+	/* Report per iteration time, bytes written and allocations since `c0` */
+
+	if (!n)
+		n = 1;
+
+	printf("# %-40s %10" PRIu64 " ns %10.1f bytes %8.2f writes %8.2f allocs\n",
+		name,
+		ns / n,
+		(double)(bench_count.bytes - c0->bytes) / n,
+		(double)(bench_count.writes - c0->writes) / n,
+		(double)(bench_count.allocs - c0->allocs) / n);
+}
+
+#define write   bench_write
+#define malloc  bench_malloc
+#define calloc  bench_calloc
+#define realloc bench_realloc
+
+#endif
@@ -0,0 +1,201 @@
+/* Compare write() syscalls and CPU time of draw() across source revisions
+ *
+ * Built by scripts/bench_cmp.sh as the last part of a single translation
+ * unit with a revision's sources and test mocks, using only the draw and
+ * state interfaces common to every revision.
+ *
+ * Frames are written to a pipe drained by a thread. Write syscalls are
+ * read from /proc/self/io, and CPU time is the drawing thread's */
+
+#include <pthread.h>
+#include <unistd.h>
+
+#ifndef BENCH_CMP_REV
+#define BENCH_CMP_REV "?"
+#endif
+
+#define BENCH_CMP_COLS   160
+#define BENCH_CMP_ROWS   50
+#define BENCH_CMP_LINES  1000
+#define BENCH_CMP_FRAMES 2000
+
+static const char *bench_cmp_words[] = {
+	"the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog",
+	"\x02" "irc" "\x02", "\x03" "04,02" "channel" "\x0f", "message", "server",
+	"terminal", "\x1f" "buffer" "\x1f", "caf\xc3\xa9", "\xe4\xb8\xad\xe6\x96\x87",
+};
+
+static uint32_t bench_cmp_seed = 1;
+
+static void* bench_cmp_drain(void*);
+static uint64_t bench_cmp_cpu_ns(void);
+static uint64_t bench_cmp_syscw(void);
+static void bench_cmp_newline(void);
+static void bench_cmp_run(const char*, void (*)(unsigned), int);
+static void bench_cmp_frame_append(unsigned);
+static void bench_cmp_frame_type(unsigned);
+
+static void*
+bench_cmp_drain(void *arg)
+{
+	char buf[1 << 16];
+	int fd = *(int *)arg;
+
+	while (read(fd, buf, sizeof(buf)) > 0)
+		continue;
+
+	return NULL;
+}
+
+static uint64_t
+bench_cmp_cpu_ns(void)
+{
+	struct timespec ts;
+
+	(void) clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t
+bench_cmp_syscw(void)
+{
+	/* Write syscalls made by the process, or 0 if unknown */
+
+	char line[64];
+	unsigned long long n = 0;
+	FILE *f;
+
+	if ((f = fopen("/proc/self/io", "r")) == NULL)
+		return 0;
+
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "syscw: %llu", &n) == 1)
+			break;
+	}
+
+	fclose(f);
+
+	return n;
+}
+
+static void
+bench_cmp_newline(void)
+{
+	/* Add a line of 2 to 24 words to the current channel */
+
+	char text[TEXT_LENGTH_MAX];
+	size_t len = 0;
+	unsigned words;
+
+	bench_cmp_seed = bench_cmp_seed * 1103515245 + 12345;
+	words = 2 + ((bench_cmp_seed >> 16) % 23);
+
+	for (unsigned i = 0; i < words; i++) {
+		bench_cmp_seed = bench_cmp_seed * 1103515245 + 12345;
+		len += (size_t) snprintf(text + len, sizeof(text) - len, "%s ",
+			bench_cmp_words[(bench_cmp_seed >> 16) % (sizeof(bench_cmp_words) / sizeof(bench_cmp_words[0]))]);
+	}
+
+	newlinef(current_channel(), BUFFER_LINE_OTHER, "nick", "%s", text);
+}
+
+static void
+bench_cmp_frame_append(unsigned i)
+{
+	(void)i;
+
+	bench_cmp_newline();
+	draw(DRAW_BUFFER);
+}
+
+static void
+bench_cmp_frame_type(unsigned i)
+{
+	if (i % 64 == 63)
+		input_reset(&(current_channel()->input));
+	else
+		input_insert(&(current_channel()->input), "a", 1);
+
+	draw(DRAW_INPUT);
+}
+
+static void
+bench_cmp_run(const char *name, void (*frame_fn)(unsigned), int out)
+{
+	uint64_t cpu;
+	uint64_t syscw;
+	int fd;
+
+	fflush(stdout);
+
+	if ((fd = dup(STDOUT_FILENO)) < 0 || dup2(out, STDOUT_FILENO) < 0) {
+		perror("dup");
+		exit(EXIT_FAILURE);
+	}
+
+	bench_cmp_seed = 1;
+
+	io_cb_sigwinch(BENCH_CMP_COLS, BENCH_CMP_ROWS);
+
+	state_init();
+
+	for (unsigned i = 0; i < BENCH_CMP_LINES; i++)
+		bench_cmp_newline();
+
+	draw_init();
+	draw(DRAW_ALL);
+	draw(DRAW_FLUSH);
+	fflush(stdout);
+
+	syscw = bench_cmp_syscw();
+	cpu = bench_cmp_cpu_ns();
+
+	for (unsigned i = 0; i < BENCH_CMP_FRAMES; i++) {
+		(*frame_fn)(i);
+		draw(DRAW_FLUSH);
+	}
+
+	fflush(stdout);
+
+	cpu = bench_cmp_cpu_ns() - cpu;
+	syscw = bench_cmp_syscw() - syscw;
+
+	draw_term();
+	state_term();
+
+	fflush(stdout);
+
+	if (dup2(fd, STDOUT_FILENO) < 0 || close(fd) < 0) {
+		perror("dup2");
+		exit(EXIT_FAILURE);
+	}
+
+	printf("%-16s %-8s %8.2f write()/frame %8.1f us/frame\n",
+		BENCH_CMP_REV,
+		name,
+		(double)syscw / BENCH_CMP_FRAMES,
+		(double)cpu / BENCH_CMP_FRAMES / 1000);
+}
+
+int
+main(void)
+{
+	pthread_t drain;
+	int fds[2];
+
+	if (pipe(fds) < 0) {
+		perror("pipe");
+		return EXIT_FAILURE;
+	}
+
+	if ((errno = pthread_create(&drain, NULL, bench_cmp_drain, &fds[0]))) {
+		perror("pthread_create");
+		return EXIT_FAILURE;
+	}
+
+	bench_cmp_run("append", bench_cmp_frame_append, fds[1]);
+	bench_cmp_run("type", bench_cmp_frame_type, fds[1]);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,308 @@
+#include "test/test.h"
+#include "bench/bench.h"
+
+#include "src/components/user.c"
+#include "src/utils/intern.c"
+#include "src/utils/utils.c"
+
+#include "src/utils/tree.h"
+
+/* User list operations, compared with the AVL tree previously indexing
+ * users, with users laid out as they were. Both intern nicks and compare
+ * them by casemapping, such that only the index differs. Times are per
+ * user, lookups and iteration are repeated for at least BENCH_REPEAT_MIN
+ * users */
+
+#define BENCH_REPEAT_MIN 1000000
+
+static const unsigned bench_users[] = { 100, 10000, 100000 };
+
+struct bench_avl_user
+{
+	TREE_NODE(bench_avl_user) node;
+	const char *nick;
+	size_t nick_len;
+	struct mode prfxmodes;
+};
+
+struct bench_avl
+{
+	TREE_HEAD(bench_avl_user);
+};
+
+static inline int
+bench_avl_cmp(struct bench_avl_user *u1, struct bench_avl_user *u2, void *arg)
+{
+	return irc_strcmp(*(enum casemapping*)arg, u1->nick, u2->nick);
+}
+
+static inline int
+bench_avl_ncmp(struct bench_avl_user *u1, struct bench_avl_user *u2, void *arg, size_t n)
+{
+	return irc_strncmp(*(enum casemapping*)arg, u1->nick, u2->nick, n);
+}
+
+AVL_GENERATE(bench_avl, bench_avl_user, node, bench_avl_cmp, bench_avl_ncmp)
+
+static char (*bench_nicks)[16];
+static struct intern bench_strings;
+static uint32_t bench_seed;
+static unsigned bench_iterated;
+
+static uint32_t
+bench_rand(void)
+{
+	bench_seed = bench_seed * 1103515245 + 12345;
+
+	return (bench_seed >> 16) & 0x7FFF;
+}
+
+static void
+bench_setup(unsigned n)
+{
+	/* Unique nicks in random order, sharing random three letter prefixes */
+
+	bench_seed = 1;
+
+	if ((bench_nicks = malloc(sizeof(*bench_nicks) * n)) == NULL)
+		test_abort("malloc");
+
+	for (unsigned i = 0; i < n; i++) {
+		snprintf(bench_nicks[i], sizeof(bench_nicks[i]), "%c%c%c%u",
+			'a' + bench_rand() % 26,
+			'a' + bench_rand() % 26,
+			'a' + bench_rand() % 26,
+			i);
+	}
+
+	for (unsigned i = n - 1; i > 0; i--) {
+
+		char tmp[16];
+		unsigned j = ((bench_rand() << 15) | bench_rand()) % (i + 1);
+
+		memcpy(tmp, bench_nicks[i], sizeof(tmp));
+		memcpy(bench_nicks[i], bench_nicks[j], sizeof(tmp));
+		memcpy(bench_nicks[j], tmp, sizeof(tmp));
+	}
+}
+
+static void
+bench_teardown(void)
+{
+	free(bench_nicks);
+}
+
+static void
+bench_report(const char *index, const char *op, unsigned n, uint64_t ns, const struct bench_count *c0)
+{
+	char name[64];
+
+	snprintf(name, sizeof(name), "%s %s %u users", index, op, n);
+
+	bench_result(name, n, ns, c0);
+}
+
+static void
+bench_avl_iterate(struct bench_avl_user *u)
+{
+	(void)u;
+
+	bench_iterated++;
+}
+
+static void
+bench_user_list(void)
+{
+	for (size_t s = 0; s < sizeof(bench_users) / sizeof(bench_users[0]); s++) {
+
+		enum casemapping cm = CASEMAPPING_RFC1459;
+		struct bench_count c0;
+		struct user *u;
+		struct user_iter it;
+		struct user_list ul = {0};
+		uint64_t ns;
+		unsigned found = 0;
+		unsigned n = bench_users[s];
+		unsigned rounds = (BENCH_REPEAT_MIN + n - 1) / n;
+
+		bench_setup(n);
+
+		c0 = bench_count;
+		ns = bench_ns();
+
+		for (unsigned i = 0; i < n; i++)
+			user_list_add(&ul, &bench_strings, cm, bench_nicks[i], (struct mode){0});
+
+		bench_report("user_list", "add", n, bench_ns() - ns, &c0);
+
+		c0 = bench_count;
+		ns = bench_ns();
+
+		for (unsigned r = 0; r < rounds; r++) {
+			for (unsigned i = 0; i < n; i++)
+				found += (user_list_get(&ul, cm, bench_nicks[n - i - 1], 0) != NULL);
+		}
+
+		bench_report("user_list", "get", n * rounds, bench_ns() - ns, &c0);
+
+		c0 = bench_count;
+		ns = bench_ns();
+
+		for (unsigned r = 0; r < rounds; r++) {
+			for (unsigned i = 0; i < n; i++)
+				found += (user_list_get(&ul, cm, bench_nicks[i], 3) != NULL);
+		}
+
+		bench_report("user_list", "prefix", n * rounds, bench_ns() - ns, &c0);
+
+		c0 = bench_count;
+		ns = bench_ns();
+
+		for (unsigned r = 0; r < rounds; r++) {
+			user_list_iter(&ul, &it, cm, NULL, 0);
+			while ((u = user_list_next(&ul, &it)))
+				found++;
+		}
+
+		bench_report("user_list", "iterate", n * rounds, bench_ns() - ns, &c0);
+
+		printf("# %-40s %10zu bytes\n", "user_list memory", user_list_memory(&ul));
+
+		c0 = bench_count;
+		ns = bench_ns();
+
+		for (unsigned i = 0; i < n; i++)
+			user_list_del(&ul, cm, bench_nicks[i]);
+
+		bench_report("user_list", "del", n, bench_ns() - ns, &c0);
+
+		assert_eq(found, n * rounds * 3);
+		assert_eq(ul.count, 0);
+
+		user_list_free(&ul);
+
+		bench_teardown();
+	}
+}
+
+static void
+bench_user_avl(void)
+{
+	for (size_t s = 0; s < sizeof(bench_users) / sizeof(bench_users[0]); s++) {
+
+		enum casemapping cm = CASEMAPPING_RFC1459;
+		struct bench_avl avl = {0};
+		struct bench_avl_user *users;
+		struct bench_avl_user key;
+		struct bench_avl_user **array;
+		struct bench_count c0;
+		uint64_t ns;
+		unsigned found = 0;
+		unsigned n = bench_users[s];
+		unsigned rounds = (BENCH_REPEAT_MIN + n - 1) / n;
+
+		bench_setup(n);
+
+		if ((users = malloc(sizeof(*users) * n)) == NULL)
+			test_abort("malloc");
+
+		if ((array = malloc(sizeof(*array) * n)) == NULL)
+			test_abort("malloc");
+
+		c0 = bench_count;
+		ns = bench_ns();
+
+		for (unsigned i = 0; i < n; i++) {
+			key.nick = bench_nicks[i];
+			if (!AVL_GET(bench_avl, &avl, &key, &cm, 0)) {
+				users[i].nick_len = strlen(bench_nicks[i]);
+				users[i].nick = intern(&bench_strings, bench_nicks[i], users[i].nick_len);
+				users[i].prfxmodes = (struct mode){0};
+				AVL_ADD(bench_avl, &avl, &users[i], &cm);
+			}
+		}
+
+		bench_report("avl", "add", n, bench_ns() - ns, &c0);
+
+		c0 = bench_count;
+		ns = bench_ns();
+
+		for (unsigned r = 0; r < rounds; r++) {
+			for (unsigned i = 0; i < n; i++) {
+				key.nick = bench_nicks[n - i - 1];
+				found += (AVL_GET(bench_avl, &avl, &key, &cm, 0) != NULL);
+			}
+		}
+
+		bench_report("avl", "get", n * rounds, bench_ns() - ns, &c0);
+
+		c0 = bench_count;
+		ns = bench_ns();
+
+		for (unsigned r = 0; r < rounds; r++) {
+			for (unsigned i = 0; i < n; i++) {
+				key.nick = bench_nicks[i];
+				found += (AVL_GET(bench_avl, &avl, &key, &cm, 3) != NULL);
+			}
+		}
+
+		bench_report("avl", "prefix", n * rounds, bench_ns() - ns, &c0);
+
+		c0 = bench_count;
+		ns = bench_ns();
+		bench_iterated = 0;
+
+		for (unsigned r = 0; r < rounds; r++)
+			AVL_FOREACH(bench_avl, &avl, bench_avl_iterate);
+
+		found += bench_iterated;
+
+		bench_report("avl", "iterate", n * rounds, bench_ns() - ns, &c0);
+
+		c0 = bench_count;
+		ns = bench_ns();
+
+		for (unsigned r = 0; r < rounds; r++)
+			found += (AVL_ARRAY(bench_avl, &avl, array) == n);
+
+		bench_report("avl", "iterate in order", n * rounds, bench_ns() - ns, &c0);
+
+		printf("# %-40s %10zu bytes\n", "avl memory", sizeof(*users) * n);
+
+		/* Rebuild balanced from the sorted users, as after a bulk merge */
+		AVL_BUILD(bench_avl, &avl, array, n);
+
+		c0 = bench_count;
+		ns = bench_ns();
+
+		for (unsigned i = 0; i < n; i++) {
+			struct bench_avl_user *u;
+			key.nick = bench_nicks[i];
+			if ((u = AVL_GET(bench_avl, &avl, &key, &cm, 0))) {
+				AVL_DEL(bench_avl, &avl, u, &cm);
+				intern_unref(u->nick);
+			}
+		}
+
+		bench_report("avl", "del", n, bench_ns() - ns, &c0);
+
+		assert_eq(found, n * rounds * 3 + rounds);
+		assert_ptr_null(TREE_ROOT(&avl));
+
+		free(array);
+		free(users);
+
+		bench_teardown();
+	}
+}
+
+int
+main(void)
+{
+	struct testcase tests[] = {
+		TESTCASE(bench_user_list),
+		TESTCASE(bench_user_avl),
+	};
+
+	return run_tests(NULL, NULL, tests);
+}
@@ -0,0 +1,248 @@
+#include "test/test.h"
+#include "bench/bench.h"
+
+#include "src/components/buffer.c"
+#include "src/components/channel.c"
+#include "src/components/chanlist.c"
+#include "src/components/input.c"
+#include "src/components/ircv3.c"
+#include "src/components/isupport.c"
+#include "src/components/mode.c"
+#include "src/components/netsplit.c"
+#include "src/components/server.c"
+#include "src/components/user.c"
+#include "src/draw.c"
+#include "src/state.c"
+#include "src/utils/highlight.c"
+#include "src/utils/intern.c"
+#include "src/utils/utils.c"
+
+#include "test/handlers/irc_recv.mock.c"
+#include "test/handlers/irc_send.mock.c"
+#include "test/io.mock.c"
+#include "test/rirc.mock.c"
+
+#define BENCH_FRAMES 500
+
+enum bench_format
+{
+	BENCH_FORMAT_PLAIN, /* No formatting */
+	BENCH_FORMAT_LIGHT, /* Occasional bold and colour spans */
+	BENCH_FORMAT_HEAVY, /* Formatting on every word */
+};
+
+static const char *bench_format_names[] = { "plain", "light", "heavy" };
+
+static const char *bench_words[] = {
+	"the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog",
+	"irc", "channel", "message", "server", "terminal", "buffer", "x",
+	"internationalization", "a", "of", "caf\xc3\xa9", "\xe4\xb8\xad\xe6\x96\x87",
+};
+
+/* Lines added to the buffer, beyond BUFFER_LINES_MAX the oldest are dropped */
+static const unsigned bench_lines[] = { 100, 1000, 10000 };
+
+static const struct {
+	unsigned cols;
+	unsigned rows;
+} bench_screens[] = {
+	{  80, 24 },
+	{ 200, 60 },
+};
+
+static uint32_t bench_seed;
+
+static uint32_t
+bench_rand(void)
+{
+	bench_seed = bench_seed * 1103515245 + 12345;
+
+	return (bench_seed >> 16) & 0x7FFF;
+}
+
+static void
+bench_newline(enum bench_format format)
+{
+	/* Add a line of 2 to 40 words to the current channel */
+
+	char text[TEXT_LENGTH_MAX];
+	size_t len = 0;
+	unsigned words = 2 + (bench_rand() % 39);
+
+	for (unsigned i = 0; i < words && len < sizeof(text) - 64; i++) {
+
+		const char *word = bench_words[bench_rand() % (sizeof(bench_words) / sizeof(bench_words[0]))];
+		const char *fmt = "%s ";
+
+		if (format == BENCH_FORMAT_HEAVY) {
+			switch (i % 4) {
+				case 0: fmt = "\x03" "04,02%s\x0f "; break;
+				case 1: fmt = "\x02%s\x02 "; break;
+				case 2: fmt = "\x1f\x1d%s\x0f "; break;
+				case 3: fmt = "\x03" "12%s\x03 "; break;
+			}
+		} else if (format == BENCH_FORMAT_LIGHT && i % 8 == 1) {
+			fmt = (i % 16 == 1) ? "\x02%s\x02 " : "\x03" "03%s\x03 ";
+		}
+
+		len += (size_t) snprintf(text + len, sizeof(text) - len, fmt, word);
+	}
+
+	newlinef(current_channel(), BUFFER_LINE_OTHER, "nick", "%s", text);
+}
+
+static void
+bench_setup(unsigned cols, unsigned rows, unsigned lines, enum bench_format format)
+{
+	bench_seed = 1;
+
+	state_tty_cols = cols;
+	state_tty_rows = rows;
+
+	state_init();
+
+	for (unsigned i = 0; i < lines; i++)
+		bench_newline(format);
+
+	draw_init();
+	draw(DRAW_ALL);
+	draw(DRAW_FLUSH);
+}
+
+static void
+bench_teardown(void)
+{
+	draw_term();
+	state_term();
+}
+
+static void
+bench_run(const char *mode, void (*frame_fn)(enum bench_format))
+{
+	for (size_t s = 0; s < sizeof(bench_screens) / sizeof(bench_screens[0]); s++) {
+		for (size_t l = 0; l < sizeof(bench_lines) / sizeof(bench_lines[0]); l++) {
+			for (unsigned f = BENCH_FORMAT_PLAIN; f <= BENCH_FORMAT_HEAVY; f++) {
+
+				char name[64];
+				struct bench_count c0;
+				uint64_t ns;
+
+				bench_setup(bench_screens[s].cols, bench_screens[s].rows, bench_lines[l], f);
+
+				c0 = bench_count;
+				ns = bench_ns();
+
+				for (unsigned i = 0; i < BENCH_FRAMES; i++) {
+					(*frame_fn)(f);
+					draw(DRAW_FLUSH);
+				}
+
+				ns = bench_ns() - ns;
+
+				snprintf(name, sizeof(name), "%s %ux%u %u lines %s",
+					mode,
+					bench_screens[s].cols,
+					bench_screens[s].rows,
+					bench_lines[l],
+					bench_format_names[f]);
+
+				bench_result(name, BENCH_FRAMES, ns, &c0);
+
+				/* Every frame is written with a single write */
+				assert_true(bench_count.writes - c0.writes == BENCH_FRAMES);
+
+				bench_teardown();
+			}
+		}
+	}
+}
+
+static void
+bench_frame_append(enum bench_format format)
+{
+	bench_newline(format);
+	draw(DRAW_BUFFER);
+}
+
+static void
+bench_frame_redraw(enum bench_format format)
+{
+	(void)format;
+
+	screen.valid = 0;
+	draw(DRAW_ALL);
+}
+
+static void
+bench_frame_scroll(enum bench_format format)
+{
+	static unsigned n;
+
+	(void)format;
+
+	draw((n++ % 8) < 4 ? DRAW_BUFFER_BACK : DRAW_BUFFER_FORW);
+	draw(DRAW_BUFFER);
+	draw(DRAW_STATUS);
+}
+
+static void
+bench_frame_type(enum bench_format format)
+{
+	static unsigned n;
+
+	(void)format;
+
+	if (n++ % 64 == 63)
+		input_reset(&(current_channel()->input));
+	else
+		input_insert(&(current_channel()->input), "a", 1);
+
+	draw(DRAW_INPUT);
+}
+
+static void
+bench_draw_append(void)
+{
+	/* New line at the head of the buffer */
+
+	bench_run("append", bench_frame_append);
+}
+
+static void
+bench_draw_redraw(void)
+{
+	/* Full repaint, as after resizing */
+
+	bench_run("redraw", bench_frame_redraw);
+}
+
+static void
+bench_draw_scroll(void)
+{
+	/* Paging the buffer back and forward */
+
+	bench_run("scroll", bench_frame_scroll);
+}
+
+static void
+bench_draw_type(void)
+{
+	/* Typing in the input line */
+
+	bench_run("type", bench_frame_type);
+}
+
+int
+main(void)
+{
+	struct testcase tests[] = {
+		TESTCASE(bench_draw_append),
+		TESTCASE(bench_draw_redraw),
+		TESTCASE(bench_draw_scroll),
+		TESTCASE(bench_draw_type),
+	};
+
+	printf("# %-40s %13s %16s %15s %15s\n", "draw", "time/frame", "bytes/frame", "writes/frame", "allocs/frame");
+
+	return run_tests(NULL, NULL, tests);
+}
@@ -0,0 +1,423 @@
+#include "test/test.h"
+#include "bench/bench.h"
+
+#include <sys/resource.h>
+
+#include "src/components/buffer.c"
+#include "src/components/channel.c"
+#include "src/components/chanlist.c"
+#include "src/components/input.c"
+#include "src/components/ircv3.c"
+#include "src/components/isupport.c"
+#include "src/components/mode.c"
+#include "src/components/netsplit.c"
+#include "src/components/server.c"
+#include "src/components/user.c"
+#include "src/handlers/irc_ctcp.c"
+#include "src/handlers/irc_recv.c"
+#include "src/handlers/irc_send.c"
+#include "src/handlers/ircv3.c"
+#include "src/state.c"
+#include "src/utils/highlight.c"
+#include "src/utils/intern.c"
+#include "src/utils/utils.c"
+
+#include "bench/io.mock.c"
+#include "test/draw.mock.c"
+#include "test/rirc.mock.c"
+
+/* Size of chunks read from the socket */
+#define BENCH_READ_LEN 4096
+
+/* Maximum distinct commands reported per benchmark */
+#define BENCH_COMMANDS_MAX 16
+
+struct bench_traffic
+{
+	char *buf;
+	size_t len;
+	size_t size;
+	unsigned n;
+};
+
+static struct bench_traffic pre; /* Traffic preceding the benchmark, not measured */
+static struct bench_traffic run; /* Traffic measured */
+
+static struct server *s;
+
+static uint32_t bench_seed;
+
+static uint32_t
+bench_rand(void)
+{
+	bench_seed = bench_seed * 1103515245 + 12345;
+
+	return (bench_seed >> 16) & 0x7FFF;
+}
+
+static void
+bench_traffic(struct bench_traffic *t, const char *fmt, ...)
+{
+	/* Append a CRLF terminated message */
+
+	char buf[IRC_MESSAGE_LEN + 1];
+	int len;
+	va_list ap;
+
+	va_start(ap, fmt);
+	len = vsnprintf(buf, sizeof(buf) - 2, fmt, ap);
+	va_end(ap);
+
+	if (len < 0 || (size_t) len >= sizeof(buf) - 2)
+		test_abortf("message too long: %s", fmt);
+
+	buf[len++] = '\r';
+	buf[len++] = '\n';
+
+	if (t->len + len > t->size) {
+
+		t->size = (t->size ? t->size * 2 : 1 << 16);
+
+		if ((t->buf = realloc(t->buf, t->size)) == NULL)
+			test_abort("realloc");
+	}
+
+	memcpy(t->buf + t->len, buf, len);
+
+	t->len += len;
+	t->n++;
+}
+
+static void
+bench_traffic_names(struct bench_traffic *t, const char *chan, unsigned users)
+{
+	/* Join `chan` and list `users` names, as nN */
+
+	char buf[400];
+	size_t len = 0;
+
+	bench_traffic(t, ":me!user@host JOIN %s", chan);
+
+	for (unsigned i = 0; i < users; i++) {
+
+		const char *prefix = (i % 50 == 0) ? "@" : (i % 10 == 0) ? "+" : "";
+
+		len += (size_t) snprintf(buf + len, sizeof(buf) - len, "%s%sn%u", (len ? " " : ""), prefix, i);
+
+		if (len > sizeof(buf) - 32 || i + 1 == users) {
+			bench_traffic(t, ":irc.server.net 353 me = %s :%s", chan, buf);
+			len = 0;
+		}
+	}
+
+	bench_traffic(t, ":irc.server.net 366 me %s :End of /NAMES list.", chan);
+}
+
+static void
+bench_traffic_reset(void)
+{
+	pre.len = 0;
+	pre.n = 0;
+	run.len = 0;
+	run.n = 0;
+
+	bench_seed = 1;
+
+	/* Registration */
+	bench_traffic(&pre, "CAP * LS :multi-prefix away-notify account-notify chghost extended-join");
+	bench_traffic(&pre, "CAP me ACK :multi-prefix away-notify account-notify chghost");
+	bench_traffic(&pre, ":irc.server.net 001 me :Welcome to the network");
+	bench_traffic(&pre, ":irc.server.net 005 me PREFIX=(ov)@+ CHANMODES=b,k,l,imnt CHANTYPES=# MODES=4 :are supported");
+}
+
+static void
+bench_read(const struct bench_traffic *t)
+{
+	for (size_t i = 0; i < t->len; i += BENCH_READ_LEN)
+		io_cb_read_soc(t->buf + i, MIN(BENCH_READ_LEN, t->len - i), s);
+}
+
+static void
+bench_setup(void)
+{
+	state_init();
+
+	s = server("irc.server.net", "6667", NULL, "user", "real", NULL);
+
+	server_list_add(state_server_list(), s);
+
+	if (server_set_nicks(s, "me"))
+		test_abort("server_set_nicks");
+
+	io_cb_cxed(s);
+
+	bench_read(&pre);
+}
+
+static void
+bench_teardown(void)
+{
+	state_term();
+
+	s = NULL;
+}
+
+static void
+bench_command(const char *msg, char *command, size_t n)
+{
+	/* Copy the command of a message, skipping its prefix */
+
+	size_t i = 0;
+
+	if (*msg == ':')
+		msg = strchr(msg, ' ') + 1;
+
+	while (i + 1 < n && msg[i] != ' ' && msg[i] != '\r')
+		command[i] = msg[i], i++;
+
+	command[i] = 0;
+}
+
+static unsigned
+bench_users(const char *chan)
+{
+	struct channel *c;
+
+	if ((c = channel_list_get(&(s->clist), chan, s->casemapping)) == NULL)
+		return 0;
+
+	return c->users.count;
+}
+
+static void
+bench_report(const char *name, void (*check)(void))
+{
+	/* Measure throughput reading `run` in chunks, then time each message
+	 * individually by command */
+
+	struct {
+		char command[16];
+		uint64_t n;
+		uint64_t ns;
+	} commands[BENCH_COMMANDS_MAX] = {0};
+
+	struct bench_count c0;
+	struct rusage ru;
+	uint64_t ns;
+	size_t n_commands = 0;
+
+	bench_setup();
+
+	c0 = bench_count;
+	ns = bench_ns();
+
+	bench_read(&run);
+
+	ns = bench_ns() - ns;
+
+	getrusage(RUSAGE_SELF, &ru);
+
+	printf("# %-12s %8u msgs %10.0f msgs/sec %8.1f allocs/msg %8ld KB peak RSS\n",
+		name,
+		run.n,
+		(double) run.n / ((double) ns / 1e9),
+		(double) (bench_count.allocs - c0.allocs) / run.n,
+		(long) ru.ru_maxrss);
+
+	(*check)();
+
+	bench_teardown();
+
+	bench_setup();
+
+	for (size_t i = 0; i < run.len; ) {
+
+		char command[sizeof(commands[0].command)];
+		size_t j;
+		size_t len = (size_t)(strchr(run.buf + i, '\n') - (run.buf + i)) + 1;
+
+		bench_command(run.buf + i, command, sizeof(command));
+
+		for (j = 0; j < n_commands && strcmp(commands[j].command, command); j++)
+			;
+
+		if (j == n_commands) {
+
+			if (n_commands == BENCH_COMMANDS_MAX)
+				test_abort("too many commands");
+
+			strcpy(commands[n_commands++].command, command);
+		}
+
+		ns = bench_ns();
+
+		io_cb_read_soc(run.buf + i, len, s);
+
+		commands[j].ns += bench_ns() - ns;
+		commands[j].n++;
+
+		i += len;
+	}
+
+	for (size_t j = 0; j < n_commands; j++) {
+		printf("#   %-10s %8" PRIu64 " msgs %10" PRIu64 " ns/msg\n",
+			commands[j].command,
+			commands[j].n,
+			commands[j].ns / commands[j].n);
+	}
+
+	bench_teardown();
+}
+
+static void
+bench_check_privmsg(void)
+{
+	assert_eq(bench_users("#chan"), 500);
+	assert_ptr_not_null(channel_list_get(&(s->clist), "n9", s->casemapping));
+}
+
+static void
+bench_check_names(void)
+{
+	assert_eq(bench_users("#big0"), 10000);
+	assert_eq(bench_users("#big4"), 10000);
+}
+
+static void
+bench_check_netsplit(void)
+{
+	assert_eq(bench_users("#big"), 10000);
+}
+
+static void
+bench_check_modes(void)
+{
+	assert_eq(bench_users("#chan"), 1000);
+}
+
+static void
+bench_check_cap(void)
+{
+	assert_true(s->ircv3_caps.away_notify.set);
+}
+
+static void
+bench_irc_recv_privmsg(void)
+{
+	/* PRIVMSG flood in a channel of 500 users, with occasional
+	 * highlights and private messages */
+
+	bench_traffic_reset();
+	bench_traffic_names(&pre, "#chan", 500);
+
+	for (unsigned i = 0; i < 100000; i++) {
+
+		unsigned nick = bench_rand() % 500;
+
+		if (i % 100 == 0)
+			bench_traffic(&run, ":n%u!user@host PRIVMSG me :private message %u", nick % 10, i);
+		else if (i % 50 == 0)
+			bench_traffic(&run, ":n%u!user@host PRIVMSG #chan :me: a highlight %u", nick, i);
+		else
+			bench_traffic(&run, ":n%u!user@host PRIVMSG #chan :message %u with some more text to parse", nick, i);
+	}
+
+	bench_report("privmsg", bench_check_privmsg);
+}
+
+static void
+bench_irc_recv_names(void)
+{
+	/* NAMES of 10000 users, joining 5 channels */
+
+	char chan[16];
+
+	bench_traffic_reset();
+
+	for (unsigned i = 0; i < 5; i++) {
+		snprintf(chan, sizeof(chan), "#big%u", i);
+		bench_traffic_names(&run, chan, 10000);
+	}
+
+	bench_report("names", bench_check_names);
+}
+
+static void
+bench_irc_recv_netsplit(void)
+{
+	/* Netsplit of half the users in a channel of 10000 users, then the
+	 * netjoin and server restoring their modes */
+
+	bench_traffic_reset();
+	bench_traffic_names(&pre, "#big", 10000);
+
+	for (unsigned i = 0; i < 10000; i += 2)
+		bench_traffic(&run, ":n%u!user@host QUIT :irc.hub.net irc.leaf.net", i);
+
+	for (unsigned i = 0; i < 10000; i += 2)
+		bench_traffic(&run, ":n%u!user@host JOIN #big", i);
+
+	for (unsigned i = 0; i < 10000; i += 100)
+		bench_traffic(&run, ":irc.leaf.net MODE #big +oo n%u n%u", i, i + 50);
+
+	bench_report("netsplit", bench_check_netsplit);
+}
+
+static void
+bench_irc_recv_modes(void)
+{
+	/* Channel and prefix mode changes in a channel of 1000 users */
+
+	bench_traffic_reset();
+	bench_traffic_names(&pre, "#chan", 1000);
+
+	for (unsigned i = 0; i < 20000; i++) {
+
+		unsigned nick = bench_rand() % 1000;
+
+		switch (i % 5) {
+			case 0: bench_traffic(&run, ":n0!user@host MODE #chan +ov-v n%u n%u n%u", nick, (nick + 1) % 1000, (nick + 2) % 1000); break;
+			case 1: bench_traffic(&run, ":n0!user@host MODE #chan -o+v n%u n%u", nick, (nick + 1) % 1000); break;
+			case 2: bench_traffic(&run, ":n0!user@host MODE #chan +b-b *!*@host%u *!*@host%u", nick, nick); break;
+			case 3: bench_traffic(&run, ":n0!user@host MODE #chan +l-k %u key", nick); break;
+			case 4: bench_traffic(&run, ":n0!user@host MODE #chan %cimnt", (i % 2) ? '+' : '-'); break;
+		}
+	}
+
+	bench_report("modes", bench_check_modes);
+}
+
+static void
+bench_irc_recv_cap(void)
+{
+	/* Capabilities deleted, advertised and acknowledged */
+
+	bench_traffic_reset();
+
+	for (unsigned i = 0; i < 10000; i++) {
+		bench_traffic(&run, "CAP me DEL :away-notify chghost multi-prefix");
+		bench_traffic(&run, "CAP me NEW :away-notify chghost multi-prefix");
+		bench_traffic(&run, "CAP me ACK :away-notify chghost multi-prefix");
+	}
+
+	bench_report("cap", bench_check_cap);
+}
+
+int
+main(void)
+{
+	struct testcase tests[] = {
+		TESTCASE(bench_irc_recv_privmsg),
+		TESTCASE(bench_irc_recv_names),
+		TESTCASE(bench_irc_recv_netsplit),
+		TESTCASE(bench_irc_recv_modes),
+		TESTCASE(bench_irc_recv_cap),
+	};
+
+	int ret = run_tests(NULL, NULL, tests);
+
+	free(pre.buf);
+	free(run.buf);
+
+	return ret;
+}
@@ -0,0 +1,78 @@
+#include <stdarg.h>
+
+/* Connection mock for benchmarks, formatting sent messages without
+ * reporting testcase results */
+
+static char mock_send[IRC_MESSAGE_LEN + 1];
+static unsigned mock_send_n;
+
+int
+io_sendf(struct connection *c, const char *fmt, ...)
+{
+	va_list ap;
+
+	UNUSED(c);
+
+	va_start(ap, fmt);
+	(void) vsnprintf(mock_send, sizeof(mock_send), fmt, ap);
+	va_end(ap);
+
+	mock_send_n++;
+
+	return 0;
+}
+
+struct connection*
+connection(
+	const void *o,
+	const char *h,
+	const char *p,
+	const char *caf,
+	const char *cap,
+	const char *cl,
+	uint32_t f)
+{
+	UNUSED(o);
+	UNUSED(h);
+	UNUSED(p);
+	UNUSED(caf);
+	UNUSED(cap);
+	UNUSED(cl);
+	UNUSED(f);
+	return NULL;
+}
+
+int
+io_cx(struct connection *c)
+{
+	UNUSED(c);
+	return 0;
+}
+
+int
+io_dx(struct connection *c, int destroy)
+{
+	UNUSED(c);
+	UNUSED(destroy);
+	return 0;
+}
+
+const char*
+io_err(int err)
+{
+	UNUSED(err);
+	return "err";
+}
+
+void
+io_stats(struct connection *c, struct io_stats *out)
+{
+	UNUSED(c);
+	memset(out, 0, sizeof(*out));
+}
+
+unsigned io_tty_cols(void) { return 0; }
+unsigned io_tty_rows(void) { return 0; }
+void io_init(void) { ; }
+void io_start(void) { ; }
+void io_stop(void) { ; }
@@ -0,0 +1,971 @@
+/* ircd.c -- scriptable IRC server fixture, for end-to-end load testing
+ *
+ * Listens on loopback, optionally with TLS, and serves each client:
+ *
+ *  - registration, with no capabilities
+ *  - a burst of channels joined, each with a NAMES list of users
+ *  - the script, or by default a PRIVMSG flood across the channels
+ *
+ * Clients are sent a timestamped PING at each interval, and the latency
+ * of their PONG is reported when they disconnect. rirc replies only after
+ * handling all messages preceding the PING, such that the latency includes
+ * any backlog between the socket and the handlers.
+ *
+ * Usage:
+ *
+ *   ircd [-v] [-p port] [-c chans] [-u users] [-r rate] [-n count]
+ *        [-i interval] [-f script] [-t [-C cert] [-K key]]
+ *
+ *   -c  channels joined, default 1
+ *   -u  users per channel, default 100
+ *   -r  flood rate, in messages per second, 0 unlimited, default 1000
+ *   -n  flood count, 0 indefinitely, default 0
+ *   -i  PING interval, in milliseconds, default 1000
+ *   -f  script file
+ *   -t  enable TLS, with the certificate and key files given by -C and -K
+ *   -v  report each PONG latency
+ *
+ * Script lines are sent as written, with `$nick` replaced by the client's
+ * nick, except for the directives:
+ *
+ *   .sleep <ms>  - pause the script
+ *   .flood <n>   - send n PRIVMSG at the flood rate, 0 indefinitely
+ *   .quit        - close the connection
+ *
+ * The test certificate is generated by `make -f Makefile.dev ircd`, e.g.:
+ *
+ *   ./build/ircd -t -c 10 -u 1000 -r 5000
+ *   ./rirc.debug -s localhost -p 6697 --tls-ca-file=build/ircd.crt
+ */
+
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/error.h"
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/pk.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/x509_crt.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define IRCD_CLIENTS_MAX 256
+#define IRCD_NICK_LEN    32
+#define IRCD_READ_LEN    4096
+#define IRCD_SCRIPT_MAX  4096
+#define IRCD_SERVER      "irc.ircd.test"
+
+/* Floods and scripts pause while this much output is pending */
+#define IRCD_WRITE_HIGH (1 << 16)
+
+/* Largest TLS write */
+#define IRCD_WRITE_TLS (1 << 14)
+
+struct ircd_client
+{
+	mbedtls_net_context net;
+	mbedtls_ssl_context ssl;
+	char nick[IRCD_NICK_LEN];
+	char rbuf[IRCD_READ_LEN];
+	char *wbuf;
+	size_t rlen;
+	size_t wlen;
+	size_t wsize;
+	size_t wtls;        /* Length of a TLS write to be retried */
+	size_t script;      /* Index of the next script line */
+	uint64_t flood_n;   /* Messages in the current flood, 0 indefinitely */
+	uint64_t flood_ns;
+	uint64_t flood_sent;
+	uint64_t latency_max;
+	uint64_t latency_min;
+	uint64_t latency_n;
+	uint64_t latency_sum;
+	uint64_t msgs;
+	uint64_t ping_ns;
+	uint64_t sleep_ns;
+	uint64_t start_ns;
+	unsigned id;
+	int closing;
+	int flooding;
+	int handshake;
+	int nick_set;
+	int registered;
+	int user_set;
+	int want_write;
+};
+
+static int ircd_accept(int);
+static int ircd_listen(const char*);
+static int ircd_read(struct ircd_client*);
+static int ircd_write(struct ircd_client*);
+static uint64_t ircd_ns(void);
+static uint32_t ircd_rand(void);
+static void ircd_client_close(struct ircd_client*);
+static void ircd_client_recv(struct ircd_client*, char*);
+static void ircd_client_report(struct ircd_client*);
+static void ircd_client_run(struct ircd_client*, uint64_t);
+static void ircd_client_welcome(struct ircd_client*);
+static void ircd_script_load(const char*);
+static void ircd_send(struct ircd_client*, const char*, ...);
+static void ircd_send_script(struct ircd_client*, const char*);
+static void ircd_sigint(int);
+static void ircd_tls_init(const char*, const char*);
+static void ircd_tls_fatal(const char*, int);
+static const char* ircd_tls_strerror(int);
+static void ircd_usage(void);
+
+static struct ircd_client *clients[IRCD_CLIENTS_MAX];
+static char *script[IRCD_SCRIPT_MAX];
+static size_t script_n;
+static unsigned client_id;
+static volatile sig_atomic_t quit;
+static uint32_t seed = 1;
+
+static struct {
+	unsigned chans;
+	unsigned users;
+	uint64_t count;
+	uint64_t interval_ns;
+	uint64_t rate;
+	int tls;
+	int verbose;
+} opt = {
+	.chans       = 1,
+	.users       = 100,
+	.count       = 0,
+	.interval_ns = 1000000000,
+	.rate        = 1000,
+};
+
+static struct {
+	mbedtls_ctr_drbg_context ctr_drbg;
+	mbedtls_entropy_context entropy;
+	mbedtls_pk_context key;
+	mbedtls_ssl_config config;
+	mbedtls_x509_crt cert;
+} tls;
+
+int
+main(int argc, char **argv)
+{
+	const char *cert = "build/ircd.crt";
+	const char *key = "build/ircd.key";
+	const char *port = NULL;
+	const char *script_path = NULL;
+	int c;
+	int soc;
+
+	while ((c = getopt(argc, argv, "c:f:i:n:p:r:u:tvC:K:h")) != -1) {
+		switch (c) {
+			case 'c':
+				opt.chans = (unsigned) strtoul(optarg, NULL, 10);
+				break;
+			case 'f':
+				script_path = optarg;
+				break;
+			case 'i':
+				opt.interval_ns = strtoull(optarg, NULL, 10) * 1000000;
+				break;
+			case 'n':
+				opt.count = strtoull(optarg, NULL, 10);
+				break;
+			case 'p':
+				port = optarg;
+				break;
+			case 'r':
+				opt.rate = strtoull(optarg, NULL, 10);
+				break;
+			case 'u':
+				opt.users = (unsigned) strtoul(optarg, NULL, 10);
+				break;
+			case 't':
+				opt.tls = 1;
+				break;
+			case 'v':
+				opt.verbose = 1;
+				break;
+			case 'C':
+				cert = optarg;
+				break;
+			case 'K':
+				key = optarg;
+				break;
+			default:
+				ircd_usage();
+		}
+	}
+
+	if (optind != argc || !opt.interval_ns)
+		ircd_usage();
+
+	if (script_path) {
+		ircd_script_load(script_path);
+	} else {
+		char flood[32];
+		snprintf(flood, sizeof(flood), ".flood %" PRIu64, opt.count);
+		script[script_n++] = strdup(flood);
+	}
+
+	if (opt.tls)
+		ircd_tls_init(cert, key);
+
+	if ((soc = ircd_listen(port ? port : (opt.tls ? "6697" : "6667"))) < 0)
+		return EXIT_FAILURE;
+
+	signal(SIGINT, ircd_sigint);
+	signal(SIGPIPE, SIG_IGN);
+
+	setvbuf(stdout, NULL, _IOLBF, 0);
+
+	while (!quit) {
+
+		struct pollfd fds[IRCD_CLIENTS_MAX + 1];
+		struct ircd_client *polled[IRCD_CLIENTS_MAX];
+		uint64_t now = ircd_ns();
+		uint64_t next = now + opt.interval_ns;
+		nfds_t n = 1;
+		int timeout;
+
+		fds[0].fd = soc;
+		fds[0].events = POLLIN;
+
+		for (size_t i = 0; i < IRCD_CLIENTS_MAX; i++) {
+
+			struct ircd_client *cl;
+
+			if ((cl = clients[i]) == NULL)
+				continue;
+
+			/* Next deadline of the client's pings, script and flood */
+			if (cl->registered) {
+
+				if (next > cl->ping_ns)
+					next = cl->ping_ns;
+
+				if (cl->wlen < IRCD_WRITE_HIGH) {
+					if (cl->flooding) {
+						uint64_t due = opt.rate
+							? cl->flood_ns + (cl->flood_sent + 1) * 1000000000 / opt.rate
+							: now;
+						if (next > due)
+							next = due;
+					} else if (cl->script < script_n) {
+						if (next > cl->sleep_ns)
+							next = cl->sleep_ns;
+					}
+				}
+			}
+
+			fds[n].fd = cl->net.fd;
+			fds[n].events = POLLIN;
+
+			if (cl->wlen || cl->want_write)
+				fds[n].events |= POLLOUT;
+
+			polled[n - 1] = cl;
+			n++;
+		}
+
+		timeout = (next > now) ? (int)((next - now + 999999) / 1000000) : 0;
+
+		if (poll(fds, n, timeout) < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("poll");
+			break;
+		}
+
+		if (fds[0].revents & POLLIN)
+			while (ircd_accept(soc) == 0)
+				;
+
+		now = ircd_ns();
+
+		for (nfds_t i = 1; i < n; i++) {
+
+			struct ircd_client *cl = polled[i - 1];
+
+			if ((fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+			 || (fds[i].revents & POLLOUT && cl->handshake)) {
+				if (ircd_read(cl)) {
+					ircd_client_close(cl);
+					continue;
+				}
+			}
+
+			if (!cl->handshake)
+				ircd_client_run(cl, now);
+
+			if ((cl->wlen || cl->want_write) && ircd_write(cl)) {
+				ircd_client_close(cl);
+				continue;
+			}
+
+			if (cl->closing && !cl->wlen)
+				ircd_client_close(cl);
+		}
+	}
+
+	for (size_t i = 0; i < IRCD_CLIENTS_MAX; i++) {
+		if (clients[i])
+			ircd_client_close(clients[i]);
+	}
+
+	for (size_t i = 0; i < script_n; i++)
+		free(script[i]);
+
+	if (opt.tls) {
+		mbedtls_ctr_drbg_free(&tls.ctr_drbg);
+		mbedtls_entropy_free(&tls.entropy);
+		mbedtls_pk_free(&tls.key);
+		mbedtls_ssl_config_free(&tls.config);
+		mbedtls_x509_crt_free(&tls.cert);
+	}
+
+	close(soc);
+
+	return EXIT_SUCCESS;
+}
+
+static int
+ircd_listen(const char *port)
+{
+	struct sockaddr_in addr = {0};
+	int soc;
+	int on = 1;
+
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons((uint16_t) strtoul(port, NULL, 10));
+
+	if ((soc = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+		perror("socket");
+		return -1;
+	}
+
+	if (setsockopt(soc, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) < 0
+	 || bind(soc, (struct sockaddr *) &addr, sizeof(addr)) < 0
+	 || listen(soc, 64) < 0
+	 || fcntl(soc, F_SETFL, O_NONBLOCK) < 0) {
+		perror("listen");
+		close(soc);
+		return -1;
+	}
+
+	printf("ircd: listening on 127.0.0.1:%s%s\n", port, (opt.tls ? " (TLS)" : ""));
+
+	return soc;
+}
+
+static int
+ircd_accept(int soc)
+{
+	/* Accept a pending connection, returning non-zero when none remain */
+
+	struct ircd_client *cl;
+	size_t i;
+	int fd;
+	int ret;
+
+	if ((fd = accept(soc, NULL, NULL)) < 0)
+		return -1;
+
+	for (i = 0; i < IRCD_CLIENTS_MAX && clients[i]; i++)
+		;
+
+	if (i == IRCD_CLIENTS_MAX || fcntl(fd, F_SETFL, O_NONBLOCK) < 0) {
+		fprintf(stderr, "ircd: connection refused\n");
+		close(fd);
+		return 0;
+	}
+
+	if ((cl = calloc(1, sizeof(*cl))) == NULL) {
+		perror("calloc");
+		exit(EXIT_FAILURE);
+	}
+
+	cl->id = client_id++;
+	cl->net.fd = fd;
+	cl->start_ns = ircd_ns();
+
+	mbedtls_ssl_init(&(cl->ssl));
+
+	if (opt.tls) {
+
+		if ((ret = mbedtls_ssl_setup(&(cl->ssl), &(tls.config))))
+			ircd_tls_fatal("mbedtls_ssl_setup", ret);
+
+		mbedtls_ssl_set_bio(&(cl->ssl), &(cl->net), mbedtls_net_send, mbedtls_net_recv, NULL);
+
+		cl->handshake = 1;
+	}
+
+	clients[i] = cl;
+
+	printf("ircd: client %u connected\n", cl->id);
+
+	return 0;
+}
+
+static void
+ircd_client_close(struct ircd_client *cl)
+{
+	ircd_client_report(cl);
+
+	for (size_t i = 0; i < IRCD_CLIENTS_MAX; i++) {
+		if (clients[i] == cl)
+			clients[i] = NULL;
+	}
+
+	if (opt.tls && !cl->handshake)
+		(void) mbedtls_ssl_close_notify(&(cl->ssl));
+
+	mbedtls_ssl_free(&(cl->ssl));
+	mbedtls_net_free(&(cl->net));
+
+	free(cl->wbuf);
+	free(cl);
+}
+
+static void
+ircd_client_report(struct ircd_client *cl)
+{
+	double s = (double)(ircd_ns() - cl->start_ns) / 1e9;
+
+	printf("ircd: client %u (%s) disconnected: %" PRIu64 " msgs in %.1fs, %.0f msgs/sec",
+		cl->id,
+		(*cl->nick ? cl->nick : "*"),
+		cl->msgs,
+		s,
+		(s > 0 ? (double) cl->msgs / s : 0));
+
+	if (cl->latency_n) {
+		printf(", latency min/avg/max %.3f/%.3f/%.3f ms over %" PRIu64 " pings",
+			(double) cl->latency_min / 1e6,
+			(double) cl->latency_sum / (double) cl->latency_n / 1e6,
+			(double) cl->latency_max / 1e6,
+			cl->latency_n);
+	}
+
+	printf("\n");
+}
+
+static int
+ircd_read(struct ircd_client *cl)
+{
+	/* Read and handle all available lines, returning non-zero when the
+	 * connection is closed */
+
+	for (;;) {
+
+		char *p;
+		char *end;
+		int ret;
+
+		if (cl->handshake) {
+
+			if ((ret = mbedtls_ssl_handshake(&(cl->ssl))) == 0) {
+				cl->handshake = 0;
+				cl->want_write = 0;
+				continue;
+			}
+
+			cl->want_write = (ret == MBEDTLS_ERR_SSL_WANT_WRITE);
+
+			if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE)
+				return 0;
+
+			fprintf(stderr, "ircd: client %u: %s\n", cl->id, ircd_tls_strerror(ret));
+			return -1;
+		}
+
+		if (cl->rlen == sizeof(cl->rbuf)) {
+			fprintf(stderr, "ircd: client %u: line too long\n", cl->id);
+			return -1;
+		}
+
+		if (opt.tls) {
+
+			ret = mbedtls_ssl_read(&(cl->ssl), (unsigned char *) cl->rbuf + cl->rlen, sizeof(cl->rbuf) - cl->rlen);
+
+			if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE)
+				return 0;
+
+			if (ret <= 0)
+				return -1;
+
+		} else {
+
+			ret = (int) read(cl->net.fd, cl->rbuf + cl->rlen, sizeof(cl->rbuf) - cl->rlen);
+
+			if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+				return 0;
+
+			if (ret <= 0)
+				return -1;
+		}
+
+		cl->rlen += (size_t) ret;
+
+		p = cl->rbuf;
+
+		while ((end = memchr(p, '\n', cl->rlen - (size_t)(p - cl->rbuf)))) {
+
+			*end = 0;
+
+			if (end > p && *(end - 1) == '\r')
+				*(end - 1) = 0;
+
+			ircd_client_recv(cl, p);
+
+			p = end + 1;
+		}
+
+		cl->rlen -= (size_t)(p - cl->rbuf);
+
+		memmove(cl->rbuf, p, cl->rlen);
+	}
+}
+
+static int
+ircd_write(struct ircd_client *cl)
+{
+	/* Write pending output, returning non-zero when the connection is closed */
+
+	while (cl->wlen) {
+
+		int ret;
+
+		if (opt.tls) {
+
+			if (!cl->wtls)
+				cl->wtls = (cl->wlen < IRCD_WRITE_TLS ? cl->wlen : IRCD_WRITE_TLS);
+
+			ret = mbedtls_ssl_write(&(cl->ssl), (unsigned char *) cl->wbuf, cl->wtls);
+
+			cl->want_write = (ret == MBEDTLS_ERR_SSL_WANT_WRITE);
+
+			if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE)
+				return 0;
+
+			if (ret <= 0)
+				return -1;
+
+			cl->wtls = 0;
+
+		} else {
+
+			ret = (int) write(cl->net.fd, cl->wbuf, cl->wlen);
+
+			if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+				return 0;
+
+			if (ret <= 0)
+				return -1;
+		}
+
+		cl->wlen -= (size_t) ret;
+
+		memmove(cl->wbuf, cl->wbuf + ret, cl->wlen);
+	}
+
+	return 0;
+}
+
+static void
+ircd_client_recv(struct ircd_client *cl, char *line)
+{
+	/* Handle a line received from the client */
+
+	char *command;
+	char *params;
+	char *trailing;
+
+	if (*line == ':' && (line = strchr(line, ' ')) == NULL)
+		return;
+
+	while (*line == ' ')
+		line++;
+
+	command = line;
+
+	if ((params = strchr(line, ' '))) {
+		*params++ = 0;
+		while (*params == ' ')
+			params++;
+	} else {
+		params = "";
+	}
+
+	/* Last parameter, trailing or otherwise */
+	if ((trailing = strstr(params, " :")))
+		trailing += 2;
+	else if (*params == ':')
+		trailing = params + 1;
+	else if ((trailing = strrchr(params, ' ')))
+		trailing += 1;
+	else
+		trailing = params;
+
+	if (!strcmp(command, "CAP")) {
+
+		if (!strncmp(params, "LS", 2))
+			ircd_send(cl, ":" IRCD_SERVER " CAP * LS :");
+
+		if (!strncmp(params, "REQ", 3))
+			ircd_send(cl, ":" IRCD_SERVER " CAP * NAK :%s", trailing);
+
+	} else if (!strcmp(command, "NICK")) {
+
+		if (cl->registered)
+			ircd_send(cl, ":%s!user@ircd.test NICK :%s", cl->nick, trailing);
+
+		snprintf(cl->nick, sizeof(cl->nick), "%s", trailing);
+
+		cl->nick_set = 1;
+
+	} else if (!strcmp(command, "USER")) {
+
+		cl->user_set = 1;
+
+	} else if (!strcmp(command, "PING")) {
+
+		ircd_send(cl, ":" IRCD_SERVER " PONG " IRCD_SERVER " :%s", trailing);
+
+	} else if (!strcmp(command, "PONG")) {
+
+		uint64_t ns = ircd_ns() - strtoull(trailing, NULL, 10);
+
+		if (!cl->latency_n || cl->latency_min > ns)
+			cl->latency_min = ns;
+
+		if (!cl->latency_n || cl->latency_max < ns)
+			cl->latency_max = ns;
+
+		cl->latency_sum += ns;
+		cl->latency_n++;
+
+		if (opt.verbose)
+			printf("ircd: client %u (%s): latency %.3f ms\n", cl->id, cl->nick, (double) ns / 1e6);
+
+	} else if (!strcmp(command, "JOIN") && cl->registered) {
+
+		char *chan;
+		char *saveptr;
+
+		/* JOIN <chans> [<keys>] */
+		params[strcspn(params, " ")] = 0;
+
+		for (chan = strtok_r(params, ",", &saveptr); chan; chan = strtok_r(NULL, ",", &saveptr)) {
+			ircd_send(cl, ":%s!user@ircd.test JOIN %s", cl->nick, chan);
+			ircd_send(cl, ":" IRCD_SERVER " 366 %s %s :End of /NAMES list", cl->nick, chan);
+		}
+
+	} else if (!strcmp(command, "PART") && cl->registered) {
+
+		params[strcspn(params, " ")] = 0;
+
+		ircd_send(cl, ":%s!user@ircd.test PART %s", cl->nick, params);
+
+	} else if (!strcmp(command, "QUIT")) {
+
+		ircd_send(cl, "ERROR :Closing link");
+
+		cl->closing = 1;
+	}
+
+	if (!cl->registered && cl->nick_set && cl->user_set)
+		ircd_client_welcome(cl);
+}
+
+static void
+ircd_client_welcome(struct ircd_client *cl)
+{
+	/* Complete registration, and join the client to each channel */
+
+	char names[400];
+
+	ircd_send(cl, ":" IRCD_SERVER " 001 %s :Welcome to the ircd fixture %s", cl->nick, cl->nick);
+	ircd_send(cl, ":" IRCD_SERVER " 005 %s PREFIX=(ov)@+ CHANTYPES=# CHANMODES=b,k,l,imnt MODES=4 NETWORK=ircd :are supported", cl->nick);
+
+	for (unsigned i = 0; i < opt.chans; i++) {
+
+		size_t len = 0;
+
+		ircd_send(cl, ":%s!user@ircd.test JOIN #c%u", cl->nick, i);
+
+		for (unsigned j = 0; j < opt.users; j++) {
+
+			const char *prefix = (j % 50 == 0) ? "@" : (j % 10 == 0) ? "+" : "";
+
+			len += (size_t) snprintf(names + len, sizeof(names) - len, "%s%su%u", (len ? " " : ""), prefix, j);
+
+			if (len > sizeof(names) - 32 || j + 1 == opt.users) {
+				ircd_send(cl, ":" IRCD_SERVER " 353 %s = #c%u :%s", cl->nick, i, names);
+				len = 0;
+			}
+		}
+
+		ircd_send(cl, ":" IRCD_SERVER " 366 %s #c%u :End of /NAMES list", cl->nick, i);
+	}
+
+	cl->registered = 1;
+	cl->ping_ns = ircd_ns() + opt.interval_ns;
+}
+
+static void
+ircd_client_run(struct ircd_client *cl, uint64_t now)
+{
+	/* Send any pings, flood messages and script lines due */
+
+	if (!cl->registered || cl->closing)
+		return;
+
+	if (now >= cl->ping_ns) {
+		ircd_send(cl, "PING :%" PRIu64, now);
+		cl->ping_ns = now + opt.interval_ns;
+	}
+
+	while (cl->wlen < IRCD_WRITE_HIGH && !cl->closing) {
+
+		const char *line;
+
+		if (cl->flooding) {
+
+			uint64_t due = opt.rate
+				? (uint64_t)((double)(now - cl->flood_ns) * (double) opt.rate / 1e9)
+				: cl->flood_sent + 1;
+
+			if (cl->flood_n && cl->flood_sent == cl->flood_n) {
+				cl->flooding = 0;
+				continue;
+			}
+
+			if (cl->flood_sent >= due)
+				break;
+
+			if (opt.chans) {
+				ircd_send(cl, ":u%u!user@ircd.test PRIVMSG #c%u :message %" PRIu64 " from the ircd fixture flood",
+					ircd_rand() % (opt.users ? opt.users : 1),
+					ircd_rand() % opt.chans,
+					cl->flood_sent);
+			} else {
+				ircd_send(cl, ":u%u!user@ircd.test PRIVMSG %s :message %" PRIu64 " from the ircd fixture flood",
+					ircd_rand() % (opt.users ? opt.users : 1),
+					cl->nick,
+					cl->flood_sent);
+			}
+
+			cl->flood_sent++;
+			continue;
+		}
+
+		if (cl->script == script_n || cl->sleep_ns > now)
+			break;
+
+		line = script[cl->script++];
+
+		if (!strncmp(line, ".sleep ", 7)) {
+			cl->sleep_ns = now + strtoull(line + 7, NULL, 10) * 1000000;
+		} else if (!strncmp(line, ".flood ", 7)) {
+			cl->flooding = 1;
+			cl->flood_n = strtoull(line + 7, NULL, 10);
+			cl->flood_ns = now;
+			cl->flood_sent = 0;
+		} else if (!strcmp(line, ".quit")) {
+			ircd_send(cl, "ERROR :Closing link");
+			cl->closing = 1;
+		} else {
+			ircd_send_script(cl, line);
+		}
+	}
+}
+
+static void
+ircd_send(struct ircd_client *cl, const char *fmt, ...)
+{
+	/* Append a CRLF terminated message to the client's output */
+
+	char buf[IRCD_READ_LEN];
+	int len;
+	va_list ap;
+
+	va_start(ap, fmt);
+	len = vsnprintf(buf, sizeof(buf) - 2, fmt, ap);
+	va_end(ap);
+
+	if (len < 0 || (size_t) len >= sizeof(buf) - 2)
+		return;
+
+	buf[len++] = '\r';
+	buf[len++] = '\n';
+
+	if (cl->wlen + (size_t) len > cl->wsize) {
+
+		while (cl->wlen + (size_t) len > cl->wsize)
+			cl->wsize = (cl->wsize ? cl->wsize * 2 : IRCD_WRITE_HIGH);
+
+		if ((cl->wbuf = realloc(cl->wbuf, cl->wsize)) == NULL) {
+			perror("realloc");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	memcpy(cl->wbuf + cl->wlen, buf, (size_t) len);
+
+	cl->wlen += (size_t) len;
+	cl->msgs++;
+}
+
+static void
+ircd_send_script(struct ircd_client *cl, const char *line)
+{
+	/* Send a script line, replacing `$nick` with the client's nick */
+
+	char buf[IRCD_READ_LEN];
+	const char *p;
+	size_t len = 0;
+
+	while ((p = strstr(line, "$nick")) && len + (size_t)(p - line) + sizeof(cl->nick) < sizeof(buf)) {
+		memcpy(buf + len, line, (size_t)(p - line));
+		len += (size_t)(p - line);
+		len += (size_t) snprintf(buf + len, sizeof(buf) - len, "%s", cl->nick);
+		line = p + 5;
+	}
+
+	snprintf(buf + len, sizeof(buf) - len, "%s", line);
+
+	ircd_send(cl, "%s", buf);
+}
+
+static void
+ircd_script_load(const char *path)
+{
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t len;
+	FILE *f;
+
+	if ((f = fopen(path, "r")) == NULL) {
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+
+	while ((len = getline(&line, &size, f)) >= 0) {
+
+		while (len && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+			line[--len] = 0;
+
+		if (!len || *line == '#')
+			continue;
+
+		if (script_n == IRCD_SCRIPT_MAX) {
+			fprintf(stderr, "ircd: %s: too many lines\n", path);
+			exit(EXIT_FAILURE);
+		}
+
+		if ((script[script_n++] = strdup(line)) == NULL) {
+			perror("strdup");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	free(line);
+	fclose(f);
+}
+
+static void
+ircd_tls_init(const char *cert, const char *key)
+{
+	int ret;
+
+	mbedtls_ctr_drbg_init(&tls.ctr_drbg);
+	mbedtls_entropy_init(&tls.entropy);
+	mbedtls_pk_init(&tls.key);
+	mbedtls_ssl_config_init(&tls.config);
+	mbedtls_x509_crt_init(&tls.cert);
+
+	if ((ret = mbedtls_ctr_drbg_seed(&tls.ctr_drbg, mbedtls_entropy_func, &tls.entropy, (const unsigned char *) "ircd", 4)))
+		ircd_tls_fatal("mbedtls_ctr_drbg_seed", ret);
+
+	if ((ret = mbedtls_x509_crt_parse_file(&tls.cert, cert)))
+		ircd_tls_fatal(cert, ret);
+
+	if ((ret = mbedtls_pk_parse_keyfile(&tls.key, key, NULL, mbedtls_ctr_drbg_random, &tls.ctr_drbg)))
+		ircd_tls_fatal(key, ret);
+
+	if ((ret = mbedtls_ssl_config_defaults(&tls.config, MBEDTLS_SSL_IS_SERVER, MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT)))
+		ircd_tls_fatal("mbedtls_ssl_config_defaults", ret);
+
+	mbedtls_ssl_conf_rng(&tls.config, mbedtls_ctr_drbg_random, &tls.ctr_drbg);
+
+	if ((ret = mbedtls_ssl_conf_own_cert(&tls.config, &tls.cert, &tls.key)))
+		ircd_tls_fatal("mbedtls_ssl_conf_own_cert", ret);
+}
+
+static void
+ircd_tls_fatal(const char *str, int ret)
+{
+	fprintf(stderr, "ircd: %s: %s\n", str, ircd_tls_strerror(ret));
+
+	exit(EXIT_FAILURE);
+}
+
+static const char*
+ircd_tls_strerror(int ret)
+{
+	static char buf[256];
+
+	mbedtls_strerror(ret, buf, sizeof(buf));
+
+	return buf;
+}
+
+static uint64_t
+ircd_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+static uint32_t
+ircd_rand(void)
+{
+	seed = seed * 1103515245 + 12345;
+
+	return (seed >> 16) & 0x7FFF;
+}
+
+static void
+ircd_sigint(int sig)
+{
+	(void) sig;
+
+	quit = 1;
+}
+
+static void
+ircd_usage(void)
+{
+	fprintf(stderr,
+		"usage: ircd [-v] [-p port] [-c chans] [-u users] [-r rate] [-n count]\n"
+		"            [-i interval] [-f script] [-t [-C cert] [-K key]]\n");
+
+	exit(EXIT_FAILURE);
+}
@@ -0,0 +1,6 @@
+/* mbedtls config for the test server fixture, the client config with
+ * TLS 1.2 server support. rirc itself is built without it */
+
+#include "../../lib/mbedtls.h"
+
+#define MBEDTLS_SSL_SRV_C
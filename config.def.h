@@ -16,6 +16,13 @@
 #define DEFAULT_USERNAME ""
 #define DEFAULT_REALNAME ""
 
+/* Comma separated set of default keywords highlighted in messages, in
+ * addition to the current nick
+ *   String
+ *   ("": highlight nick only)
+ */
+#define DEFAULT_HIGHLIGHTS ""
+
 /* User count in channel before filtering message types
  *   Integer
  *   (0: never filter, -1: always filter) */
@@ -27,6 +34,17 @@
 #define FILTER_THRESHOLD_AWAY    0
 #define FILTER_THRESHOLD_CHGHOST 0
 
+/* Seconds between QUITs of a netsplit, or JOINs of its netjoin, collected
+ * into a single line per channel
+ *   Integer
+ *   (0: never collect) */
+#define NETSPLIT_WINDOW 5
+
+/* Seconds after a netsplit that its users are kept, to collect their
+ * JOINs into a netjoin line once the servers relink
+ *   Integer */
+#define NETSPLIT_REJOIN_MAX 3600
+
 /* Message sent for PART and QUIT by default */
 #define DEFAULT_QUIT_MESG "rirc v" STR(VERSION)
 #define DEFAULT_PART_MESG "rirc v" STR(VERSION)
@@ -47,6 +65,27 @@
 /* Number of buffer lines to keep in history, must be power of 2 */
 #define BUFFER_LINES_MAX (1 << 10)
 
+/* Number of most recent buffer lines kept uncompressed, older lines are
+ * compressed in blocks and decompressed on demand when scrolled back to
+ *   Integer
+ *   (>= BUFFER_LINES_MAX: never compress) */
+#define BUFFER_LINES_HOT (1 << 8)
+
+/* Seconds a channel must be idle and out of view before its buffer and
+ * input storage is compacted
+ *   Integer
+ *   (0: never compact) */
+#define CHANNEL_IDLE_COMPACT 600
+
+/* File runtime statistics are appended to periodically, as shown by :stats
+ *   String
+ *   ("": never written) */
+#define STATS_FILE ""
+
+/* Seconds between appending runtime statistics to STATS_FILE
+ *   Integer */
+#define STATS_INTERVAL 60
+
 /* Colours used for nicks */
 #define NICK_COLOURS {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14};
 
@@ -127,7 +166,8 @@
  *   (0: no ping handling) */
 #define IO_PING_MIN 150
 
-/* Seconds between refreshing ping display
+/* Seconds between refreshing ping display, and between periodic work
+ * while connected and no data is received
  *   Integer, [0, 5, 86400]
  *   (0: no ping handling) */
 #define IO_PING_REFRESH 5
@@ -0,0 +1,73 @@
+#!/bin/bash
+
+# Compare draw() write syscalls and CPU time across source revisions,
+# e.g. before and after a change to the draw path:
+#
+#   ./scripts/bench_cmp.sh <rev> [<rev> ...]
+#
+# A revision of '.' is the working tree. Each revision is copied to
+# build/cmp and built as a single translation unit of its sources, its
+# test mocks and bench/cmp/draw.c from the working tree. The network,
+# handlers and main loop aren't built, so mbedtls isn't needed
+
+set -e
+set -u
+
+BDIR="build/cmp"
+BENCH="$(pwd)/bench/cmp/draw.c"
+
+CC="${CC:-gcc}"
+CFLAGS="${CFLAGS:--pipe -O2 -g}"
+
+if [ $# -eq 0 ]; then
+	echo "usage: $0 <rev> [<rev> ...]" >&2
+	exit 1
+fi
+
+mkdir -p "$BDIR"
+
+for REV in "$@"; do
+
+	if [ "$REV" = "." ]; then
+		HASH="worktree"
+	else
+		HASH=$(git rev-parse --short "$REV^{commit}")
+	fi
+
+	TREE="$BDIR/$HASH"
+	UNIT="$TREE/bench.c"
+
+	rm -rf "$TREE" && mkdir -p "$TREE"
+
+	if [ "$REV" = "." ]; then
+		cp -r src test config.def.h "$TREE"
+	else
+		# Checked out through a separate index, the tests are export-ignored
+		export GIT_INDEX_FILE="$TREE.index"
+		git read-tree "$HASH"
+		git ls-files -- src test config.def.h | git checkout-index --prefix="$TREE/" --stdin
+		rm -f "$GIT_INDEX_FILE"
+		unset GIT_INDEX_FILE
+	fi
+
+	cp "$TREE/config.def.h" "$TREE/config.h"
+
+	{
+		echo '#include "test/test.h"'
+
+		find "$TREE/src" -name '*.c' ! -name 'rirc.c' ! -name 'io.c' ! -path '*/handlers/*' | sort | \
+			while read -r SRC; do echo "#include \"${SRC#$TREE/}\""; done
+
+		echo '#include "test/handlers/irc_recv.mock.c"'
+		echo '#include "test/handlers/irc_send.mock.c"'
+		echo '#include "test/io.mock.c"'
+		echo '#include "test/rirc.mock.c"'
+		echo "#include \"$BENCH\""
+	} > "$UNIT"
+
+	$CC -std=c11 $CFLAGS -w -I"$TREE" -D_POSIX_C_SOURCE=200809L \
+		-DVERSION="$HASH" -DGITHASH="$HASH" -DBENCH_CMP_REV="\"$REV\"" \
+		-pthread -o "$TREE/bench" "$UNIT"
+
+	"./$TREE/bench"
+done
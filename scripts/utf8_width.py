@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+#
+# Generate the two-stage display width table for src/utils/utils.c:
+#   ./scripts/utf8_width.py > src/utils/utf8_width.h
+#
+# Code points are grouped in blocks of 256, stage 1 maps each block to a
+# unique stage 2 block of widths packed 2 bits per code point:
+#
+#   0 -- zero width, combined with the preceding code point
+#   1 -- narrow
+#   2 -- wide
+
+import sys
+import unicodedata
+
+CP_MAX = 0x110000
+BLOCK = 256
+
+WIDE_UNASSIGNED = (
+    (0x3400, 0x4DBF),
+    (0x4E00, 0x9FFF),
+    (0xF900, 0xFAFF),
+    (0x1F000, 0x1FAFF),
+    (0x20000, 0x2FFFD),
+    (0x30000, 0x3FFFD),
+)
+
+
+def width(cp):
+    c = chr(cp)
+    cat = unicodedata.category(c)
+
+    # Combining marks, format characters and Hangul medial vowels and
+    # final consonants; soft hyphen is drawn
+    if cat in ('Mn', 'Me') or (cat == 'Cf' and cp != 0x00AD) or 0x1160 <= cp <= 0x11FF:
+        return 0
+
+    # Unassigned code points default to wide only within the CJK ideograph
+    # and pictograph ranges
+    if cat == 'Cn':
+        for lo, hi in WIDE_UNASSIGNED:
+            if lo <= cp <= hi:
+                return 2
+        return 1
+
+    if unicodedata.east_asian_width(c) in ('W', 'F'):
+        return 2
+
+    return 1
+
+
+def main():
+    blocks = []
+    index = {}
+    stage1 = []
+
+    for b in range(CP_MAX // BLOCK):
+        packed = bytearray(BLOCK // 4)
+        for i in range(BLOCK):
+            packed[i // 4] |= width(b * BLOCK + i) << ((i % 4) * 2)
+        packed = bytes(packed)
+        if packed not in index:
+            index[packed] = len(blocks)
+            blocks.append(packed)
+        stage1.append(index[packed])
+
+    if len(blocks) > 256:
+        sys.exit("too many unique blocks: %d" % len(blocks))
+
+    out = sys.stdout
+
+    out.write("/* Generated by scripts/utf8_width.py, Unicode %s */\n\n" % unicodedata.unidata_version)
+    out.write("#define UTF8_WIDTH_BLOCK %d\n\n" % BLOCK)
+
+    out.write("static const unsigned char utf8_width_stage1[] = {\n")
+    for i in range(0, len(stage1), 16):
+        out.write("\t" + ", ".join("%3d" % x for x in stage1[i:i + 16]) + ",\n")
+    out.write("};\n\n")
+
+    out.write("static const unsigned char utf8_width_stage2[][UTF8_WIDTH_BLOCK / 4] = {\n")
+    for block in blocks:
+        out.write("\t{\n")
+        for i in range(0, len(block), 16):
+            out.write("\t\t" + ", ".join("0x%02x" % x for x in block[i:i + 16]) + ",\n")
+        out.write("\t},\n")
+    out.write("};\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -2,6 +2,9 @@
 
 #include "src/utils/utils.h"
 
+#include <ctype.h>
+#include <errno.h>
+#include <stdint.h>
 #include <string.h>
 
 #define BUFFER_MASK(X) ((X) & (BUFFER_LINES_MAX - 1))
@@ -10,14 +13,69 @@
 #error BUFFER_LINES_MAX must be a power of 2
 #endif
 
+/* IRC formatting codes, see: https://modern.ircdocs.horse/formatting.html */
+#define ATTR_CODE_BOLD      0x02
+#define ATTR_CODE_COLOUR    0x03
+#define ATTR_CODE_ITALIC    0x1D
+#define ATTR_CODE_MONOSPACE 0x11
+#define ATTR_CODE_RESET     0x0F
+#define ATTR_CODE_REVERSE   0x16
+#define ATTR_CODE_STRIKE    0x1E
+#define ATTR_CODE_UNDERLINE 0x1F
+
+/* Line storage grows by powers of 2, masked by the allocated count */
+#define BUFFER_SLOT(B, X) (&(B)->buffer_lines[(X) & ((B)->buffer_lines_max - 1)])
+
+/* Cold blocks are aligned runs of lines compressed together */
+#define BUFFER_BLOCK_LINES 32
+
+#if (BUFFER_LINES_MAX % BUFFER_BLOCK_LINES)
+#error BUFFER_LINES_MAX must be a multiple of BUFFER_BLOCK_LINES
+#endif
+
+/* LZ coder parameters, see buffer_lz_pack */
+#define BUFFER_LZ_HASH_BITS 12
+#define BUFFER_LZ_MATCH_MIN 4
+#define BUFFER_LZ_MATCH_MAX (0x7f + BUFFER_LZ_MATCH_MIN)
+#define BUFFER_LZ_LITERAL_MAX 0x80
+#define BUFFER_LZ_BOUND(N) ((N) + ((N) / BUFFER_LZ_LITERAL_MAX) + 1)
+
+struct buffer_block
+{
+	char *text;          /* Decompressed text, NULL when frozen */
+	unsigned char *data; /* Compressed text */
+	size_t data_len;
+	size_t text_len;
+	unsigned first;      /* Index of the block's first line */
+	unsigned refs;       /* Lines remaining in the buffer */
+	uint16_t offsets[BUFFER_BLOCK_LINES];
+};
+
 static struct buffer_line* buffer_push(struct buffer*);
+static void buffer_grow(struct buffer*);
+static struct buffer_line* buffer_line_thaw(struct buffer*, struct buffer_line*);
+static void buffer_block_freeze(struct buffer*, struct buffer_block*);
+static void buffer_block_pack(struct buffer*, unsigned);
+static void buffer_block_thaw(struct buffer*, struct buffer_block*);
+static void buffer_line_format(struct buffer_line*, const char*, size_t);
+static void buffer_line_free(struct buffer*, struct buffer_line*);
+static unsigned buffer_rows_prefix(struct buffer*, unsigned);
+static size_t buffer_parse_irc_colour(const char*, size_t, int*, int*);
+static size_t buffer_lz_pack(const unsigned char*, size_t, unsigned char*);
+static size_t buffer_lz_unpack(const unsigned char*, size_t, unsigned char*, size_t);
+
+static struct buffer_stats stats;
+static struct intern buffer_intern; /* `from` of lines in buffers without a server */
 
 struct buffer_line*
 buffer_head(struct buffer *b)
 {
 	/* Return the first printable line in a buffer */
 
-	return buffer_size(b) == 0 ? NULL : &b->buffer_lines[BUFFER_MASK(b->head - 1)];
+	if (buffer_size(b) == 0)
+		return NULL;
+
+	return buffer_line_thaw(b, BUFFER_SLOT(b, b->head - 1));
 }
 
 struct buffer_line*
@@ -25,7 +83,10 @@ buffer_tail(struct buffer *b)
 {
 	/* Return the last printable line in a buffer */
 
-	return buffer_size(b) == 0 ? NULL : &b->buffer_lines[BUFFER_MASK(b->tail)];
+	if (buffer_size(b) == 0)
+		return NULL;
+
+	return buffer_line_thaw(b, BUFFER_SLOT(b, b->tail));
 }
 
 struct buffer_line*
@@ -57,19 +118,150 @@ buffer_line(struct buffer *b, unsigned i)
 	    ((b->tail > b->head) && (i < b->tail && i >= b->head)))
 		fatal("invalid index: %d", i);
 
-	return &b->buffer_lines[BUFFER_MASK(i)];
+	return buffer_line_thaw(b, BUFFER_SLOT(b, i));
+}
+
+struct buffer_line*
+buffer_line_peek(struct buffer *b, unsigned i)
+{
+	/* Return the buffer line indexed by i without decompressing its cold
+	 * block. Its text is NULL while the block is frozen */
+
+	if (buffer_size(b) == 0)
+		return NULL;
+
+	if (((b->head > b->tail) && (i < b->tail || i >= b->head)) ||
+	    ((b->tail > b->head) && (i < b->tail && i >= b->head)))
+		fatal("invalid index: %d", i);
+
+	return BUFFER_SLOT(b, i);
+}
+
+unsigned
+buffer_line_width(struct buffer_line *line)
+{
+	/* Return the display width of a line's text, cached on first use.
+	 * Widths are cached before lines are packed, and known while frozen */
+
+	if (!line->cached.width && line->text) {
+
+		const char *p = line->text;
+		const char *end = line->text + line->text_len;
+		uint32_t cp;
+		unsigned width;
+
+		while (p < end) {
+			p += utf8_decode(p, end - p, &cp, &width);
+			line->cached.width += width;
+		}
+	}
+
+	return line->cached.width;
+}
+
+unsigned
+buffer_rows(struct buffer *b, unsigned i, unsigned j)
+{
+	/* Return the summed rows of lines [i, j) */
+
+	if (!b->rows.tree || i == j)
+		return 0;
+
+	unsigned n = b->buffer_lines_max;
+	unsigned slot_i = i & (n - 1);
+	unsigned slot_j = slot_i + (j - i);
+
+	if (slot_j <= n)
+		return buffer_rows_prefix(b, slot_j) - buffer_rows_prefix(b, slot_i);
+
+	return buffer_rows_prefix(b, n) - buffer_rows_prefix(b, slot_i) + buffer_rows_prefix(b, slot_j - n);
+}
+
+unsigned
+buffer_rows_find(struct buffer *b, unsigned rows)
+{
+	/* Return the index of the line containing the row `rows` counted from
+	 * the top of the tail line, or the head line if out of range
+	 *
+	 * Lines are summed by slot; rows in slots [tail, n) precede the rows of
+	 * lines wrapped around to slots [0, tail) */
+
+	unsigned n = b->buffer_lines_max;
+	unsigned slot_tail = b->tail & (n - 1);
+	unsigned base;
+	unsigned step;
+	unsigned slot = 0;
+	unsigned i;
+
+	if (!b->rows.tree || rows >= buffer_rows(b, b->tail, b->head))
+		return b->head - 1;
+
+	base = buffer_rows_prefix(b, slot_tail);
+
+	if (rows < buffer_rows_prefix(b, n) - base)
+		rows += base;
+	else
+		rows -= buffer_rows_prefix(b, n) - base;
+
+	for (step = n; step; step >>= 1) {
+		if (slot + step <= n && b->rows.tree[slot + step - 1] <= rows) {
+			slot += step;
+			rows -= b->rows.tree[slot - 1];
+		}
+	}
+
+	i = b->tail + ((slot - slot_tail) & (n - 1));
+
+	return ((i - b->tail) < buffer_size(b) ? i : b->head - 1);
+}
+
+void
+buffer_rows_reset(struct buffer *b, unsigned cols)
+{
+	/* Clear the summed rows, e.g. when lines are measured on a new width */
+
+	if (!b->buffer_lines_max)
+		return;
+
+	free(b->rows.tree);
+
+	if ((b->rows.tree = calloc(b->buffer_lines_max, sizeof(*b->rows.tree))) == NULL)
+		fatal("calloc: %s", strerror(errno));
+
+	b->rows.cols = cols;
+	b->rows.pad = b->pad;
+	b->rows.synced = b->tail;
+}
+
+void
+buffer_rows_set(struct buffer *b, unsigned i, unsigned rows)
+{
+	/* Set the rows occupied by line `i` */
+
+	if (!b->rows.tree)
+		return;
+
+	unsigned n = b->buffer_lines_max;
+	unsigned slot = i & (n - 1);
+	unsigned delta = rows - buffer_rows(b, i, i + 1);
+
+	for (slot++; slot <= n; slot += (slot & -slot))
+		b->rows.tree[slot - 1] += delta;
 }
 
 void
 buffer_newline(
 		struct buffer *b,
+		struct intern *t,
 		enum buffer_line_type type,
+		time_t line_time,
 		const char *from_str,
 		const char *text_str,
 		size_t from_len,
 		size_t text_len,
 		char prefix)
 {
+	char from[FROM_LENGTH_MAX + 1];
 	struct buffer_line *line;
 
 	if (from_str == NULL)
@@ -84,19 +276,28 @@ buffer_newline(
 	line->text_len = MIN(text_len,              TEXT_LENGTH_MAX);
 
 	if (prefix)
-		*line->from = prefix;
+		*from = prefix;
+
+	memcpy(from + (!!prefix), from_str, line->from_len - (!!prefix));
 
-	memcpy(line->from + (!!prefix), from_str, line->from_len);
-	memcpy(line->text,              text_str, line->text_len);
+	line->from = intern((t ? t : &buffer_intern), from, line->from_len);
 
-	*(line->from + line->from_len) = '\0';
-	*(line->text + line->text_len) = '\0';
+	buffer_line_format(line, text_str, line->text_len);
 
-	line->time = time(NULL);
+	line->time = line_time;
 	line->type = type;
 
 	if (line->from_len > b->pad)
 		b->pad = line->from_len;
+
+	/* Pack the block of lines falling out of the hot region */
+	if (BUFFER_LINES_HOT < BUFFER_LINES_MAX
+	 && buffer_size(b) >= BUFFER_LINES_HOT + BUFFER_BLOCK_LINES
+	 && ((b->head - BUFFER_LINES_HOT) % BUFFER_BLOCK_LINES) == 0)
+		buffer_block_pack(b, b->head - BUFFER_LINES_HOT - BUFFER_BLOCK_LINES);
+
+	if (b->thawed && b->scrollback == b->head - 1)
+		buffer_cold_freeze(b);
 }
 
 void
@@ -107,6 +308,65 @@ buffer(struct buffer *b)
 	memset(b, 0, sizeof(*b));
 }
 
+void
+buffer_compact(struct buffer *b)
+{
+	/* Pack all full blocks of lines, including the hot region, and
+	 * freeze any thawed blocks, e.g. for buffers idle and not in view.
+	 * Cached row breaks of packed lines and the summed rows are released,
+	 * both are measured again when drawn */
+
+	unsigned i;
+
+	free(b->rows.tree);
+	b->rows.tree = NULL;
+
+	if (buffer_size(b) < BUFFER_BLOCK_LINES)
+		return;
+
+	i = b->tail + (-b->tail % BUFFER_BLOCK_LINES);
+
+	while ((b->head - i) >= BUFFER_BLOCK_LINES && (i - b->tail) < buffer_size(b)) {
+
+		struct buffer_line *line = BUFFER_SLOT(b, i);
+
+		if (line->block == NULL)
+			buffer_block_pack(b, i);
+		else if (line->block->text)
+			buffer_block_freeze(b, line->block);
+
+		i += BUFFER_BLOCK_LINES;
+	}
+
+	for (i = b->tail; i != b->head; i++) {
+
+		struct buffer_line *line = BUFFER_SLOT(b, i);
+
+		if (line->block) {
+			free(line->cached.breaks);
+			line->cached.breaks = NULL;
+		}
+	}
+}
+
+void
+buffer_free(struct buffer *b)
+{
+	/* Free all line text, cold blocks and line storage held by a buffer */
+
+	unsigned i;
+
+	for (i = 0; i < b->buffer_lines_max; i++)
+		buffer_line_free(b, &b->buffer_lines[i]);
+
+	free(b->buffer_lines);
+	free(b->rows.tree);
+
+	b->buffer_lines = NULL;
+	b->buffer_lines_max = 0;
+	b->rows.tree = NULL;
+}
+
 unsigned
 buffer_size(struct buffer *b)
 {
@@ -115,13 +375,56 @@ buffer_size(struct buffer *b)
 	return b->head - b->tail;
 }
 
+size_t
+buffer_memory(struct buffer *b)
+{
+	/* Return the heap memory used by a buffer's lines, cold blocks are
+	 * counted once with the first of their lines in the buffer */
+
+	struct buffer_line *line;
+	size_t size = 0;
+
+	if (b->buffer_lines)
+		size += sizeof(*b->buffer_lines) * b->buffer_lines_max;
+
+	if (b->rows.tree)
+		size += sizeof(*b->rows.tree) * b->buffer_lines_max;
+
+	for (unsigned i = b->tail; i != b->head; i++) {
+
+		line = BUFFER_SLOT(b, i);
+
+		size += sizeof(*line->runs) * line->runs_len;
+
+		if (line->cached.breaks)
+			size += sizeof(*line->cached.breaks) * line->cached.rows;
+
+		if (!line->block && line->text)
+			size += line->text_len + 1;
+
+		if (line->block && (i == b->tail || BUFFER_SLOT(b, i - 1)->block != line->block)) {
+			size += sizeof(*line->block) + line->block->data_len;
+			if (line->block->text)
+				size += line->block->text_len;
+		}
+	}
+
+	return size;
+}
+
+const struct buffer_stats*
+buffer_stats(void)
+{
+	return &stats;
+}
+
 static struct buffer_line*
 buffer_push(struct buffer *b)
 {
 	/* Return a new `struct buffer_line *` pushed to a buffer */
 
 	/* lock scrollback to head */
-	if (buffer_line(b, b->scrollback) == buffer_head(b))
+	if (buffer_size(b) == 0 || b->scrollback == b->head - 1)
 		b->scrollback = b->head;
 
 	/* lock scrollback to tail */
@@ -130,8 +433,513 @@ buffer_push(struct buffer *b)
 		if (b->scrollback == b->tail)
 			b->scrollback++;
 
-		b->tail++;
+		buffer_line_free(b, BUFFER_SLOT(b, b->tail++));
+
+	} else if (buffer_size(b) >= b->buffer_lines_max) {
+		buffer_grow(b);
+	}
+
+	return BUFFER_SLOT(b, b->head++);
+}
+
+static void
+buffer_grow(struct buffer *b)
+{
+	/* Double the line storage, re-masking lines [tail, head) */
+
+	struct buffer_line *lines;
+	unsigned lines_max = b->buffer_lines_max ? b->buffer_lines_max : BUFFER_BLOCK_LINES;
+	unsigned i;
+
+	while (lines_max <= buffer_size(b))
+		lines_max *= 2;
+
+	if ((lines = calloc(lines_max, sizeof(*lines))) == NULL)
+		fatal("calloc: %s", strerror(errno));
+
+	if (b->buffer_lines) {
+		for (i = b->tail; i != b->head; i++)
+			lines[i & (lines_max - 1)] = *BUFFER_SLOT(b, i);
+	}
+
+	free(b->buffer_lines);
+	free(b->rows.tree);
+
+	b->buffer_lines = lines;
+	b->buffer_lines_max = lines_max;
+	b->rows.tree = NULL;
+}
+
+static unsigned
+buffer_rows_prefix(struct buffer *b, unsigned slot)
+{
+	/* Return the summed rows of slots [0, slot) */
+
+	unsigned rows = 0;
+
+	for (; slot; slot -= (slot & -slot))
+		rows += b->rows.tree[slot - 1];
+
+	return rows;
+}
+
+static struct buffer_line*
+buffer_line_thaw(struct buffer *b, struct buffer_line *line)
+{
+	/* Decompress a line's cold block on demand */
+
+	if (line->block && line->text == NULL)
+		buffer_block_thaw(b, line->block);
+
+	return line;
+}
+
+static void
+buffer_line_format(struct buffer_line *line, const char *str, size_t len)
+{
+	/* Copy text to a line stripped of formatting codes, parsing the codes
+	 * once into runs of uniformly formatted text. Runs span the full text,
+	 * adjacent runs with equal formatting are merged */
+
+	struct buffer_run runs[TEXT_LENGTH_MAX];
+	struct buffer_run run = { .bg = -1, .fg = -1 };
+	size_t i = 0;
+	size_t n = 0;
+	size_t formatted = 0;
+	char *text;
+
+	if ((text = malloc(len + 1)) == NULL)
+		fatal("malloc: %s", strerror(errno));
+
+	line->text = text;
+	line->text_len = 0;
+
+	while (i < len) {
+
+		int bg = -2;
+		int fg = -2;
+		uint8_t flag = 0;
+		size_t attr_len = 1;
+
+		switch (str[i]) {
+			case ATTR_CODE_BOLD:
+				flag = BUFFER_RUN_BOLD;
+				break;
+			case ATTR_CODE_COLOUR:
+				attr_len = buffer_parse_irc_colour(str + i, len - i, &fg, &bg);
+				break;
+			case ATTR_CODE_ITALIC:
+				flag = BUFFER_RUN_ITALIC;
+				break;
+			case ATTR_CODE_MONOSPACE:
+			case ATTR_CODE_RESET:
+				break;
+			case ATTR_CODE_REVERSE:
+				flag = BUFFER_RUN_REVERSE;
+				break;
+			case ATTR_CODE_STRIKE:
+				flag = BUFFER_RUN_STRIKE;
+				break;
+			case ATTR_CODE_UNDERLINE:
+				flag = BUFFER_RUN_UNDERLINE;
+				break;
+			default:
+				text[line->text_len++] = str[i++];
+				run.len++;
+				continue;
+		}
+
+		if (run.len) {
+			if (n && runs[n - 1].bg == run.bg && runs[n - 1].fg == run.fg && runs[n - 1].flags == run.flags)
+				runs[n - 1].len += run.len;
+			else
+				runs[n++] = run;
+		}
+
+		run.offset = line->text_len;
+		run.len = 0;
+
+		/* Colour 99 is the default colour */
+		if (bg == 99 || (bg == -1 && fg == -1))
+			run.bg = -1;
+		else if (bg >= 0)
+			run.bg = bg;
+
+		if (fg == 99 || (bg == -1 && fg == -1))
+			run.fg = -1;
+		else if (fg >= 0)
+			run.fg = fg;
+
+		if (str[i] == ATTR_CODE_RESET) {
+			run.bg = -1;
+			run.fg = -1;
+			run.flags = 0;
+		}
+
+		run.flags ^= flag;
+		formatted = 1;
+		i += attr_len;
+	}
+
+	text[line->text_len] = 0;
+
+	if (!formatted)
+		return;
+
+	if (run.len) {
+		if (n && runs[n - 1].bg == run.bg && runs[n - 1].fg == run.fg && runs[n - 1].flags == run.flags)
+			runs[n - 1].len += run.len;
+		else
+			runs[n++] = run;
+	}
+
+	/* All text unformatted */
+	if (n == 0 || (n == 1 && runs[0].bg == -1 && runs[0].fg == -1 && !runs[0].flags))
+		return;
+
+	if ((line->runs = malloc(sizeof(*runs) * n)) == NULL)
+		fatal("malloc: %s", strerror(errno));
+
+	memcpy(line->runs, runs, sizeof(*runs) * n);
+
+	line->runs_len = n;
+}
+
+static void
+buffer_line_free(struct buffer *b, struct buffer_line *line)
+{
+	struct buffer_block *block;
+
+	intern_unref(line->from);
+	line->from = NULL;
+
+	free(line->cached.breaks);
+	line->cached.breaks = NULL;
+	line->cached.cols = 0;
+	line->cached.width = 0;
+
+	free(line->runs);
+	line->runs = NULL;
+	line->runs_len = 0;
+
+	if ((block = line->block) == NULL) {
+		free(line->text);
+	} else if (--block->refs == 0) {
+		if (block->text)
+			b->thawed--;
+		free(block->data);
+		free(block->text);
+		free(block);
+	}
+
+	line->block = NULL;
+	line->text = NULL;
+}
+
+static void
+buffer_block_pack(struct buffer *b, unsigned first)
+{
+	/* Compress the text of lines [first, first + BUFFER_BLOCK_LINES) into
+	 * a single cold block, freeing each line's individual text */
+
+	char raw[BUFFER_BLOCK_LINES * (TEXT_LENGTH_MAX + 1)];
+	struct buffer_block *block;
+	struct buffer_line *line;
+	size_t len = 0;
+	unsigned i;
+
+	for (i = 0; i < BUFFER_BLOCK_LINES; i++) {
+		if (BUFFER_SLOT(b, first + i)->block)
+			return;
+	}
+
+	if ((block = calloc(1, sizeof(*block))) == NULL)
+		fatal("calloc: %s", strerror(errno));
+
+	for (i = 0; i < BUFFER_BLOCK_LINES; i++) {
+
+		line = BUFFER_SLOT(b, first + i);
+
+		block->offsets[i] = len;
+
+		if (line->text) {
+			memcpy(raw + len, line->text, line->text_len);
+			buffer_line_width(line);
+		}
+
+		len += line->text_len;
+		raw[len++] = 0;
+
+		free(line->text);
+		line->text = NULL;
+		line->block = block;
+	}
+
+	if ((block->data = malloc(BUFFER_LZ_BOUND(len))) == NULL)
+		fatal("malloc: %s", strerror(errno));
+
+	block->data_len = buffer_lz_pack((unsigned char *)raw, len, block->data);
+	block->text_len = len;
+	block->first = first;
+	block->refs = BUFFER_BLOCK_LINES;
+
+	if ((block->data = realloc(block->data, block->data_len)) == NULL)
+		fatal("realloc: %s", strerror(errno));
+
+	stats.cold_bytes_raw += len;
+	stats.cold_bytes_packed += block->data_len;
+}
+
+static void
+buffer_block_thaw(struct buffer *b, struct buffer_block *block)
+{
+	/* Decompress a cold block, pointing its remaining lines at the text */
+
+	struct buffer_line *line;
+	struct timespec t1;
+	struct timespec t2;
+	unsigned i;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	if ((block->text = malloc(block->text_len)) == NULL)
+		fatal("malloc: %s", strerror(errno));
+
+	if (buffer_lz_unpack(block->data, block->data_len, (unsigned char *)block->text, block->text_len) != block->text_len)
+		fatal("corrupt buffer block");
+
+	for (i = 0; i < BUFFER_BLOCK_LINES; i++) {
+
+		line = BUFFER_SLOT(b, block->first + i);
+
+		if (line->block == block)
+			line->text = block->text + block->offsets[i];
+	}
+
+	b->thawed++;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &t2);
+
+	stats.thaw_count++;
+	stats.thaw_ns += (t2.tv_sec - t1.tv_sec) * 1000000000ULL + t2.tv_nsec - t1.tv_nsec;
+}
+
+static void
+buffer_block_freeze(struct buffer *b, struct buffer_block *block)
+{
+	/* Discard the decompressed text of a thawed cold block */
+
+	struct buffer_line *line;
+	unsigned i;
+
+	for (i = 0; i < BUFFER_BLOCK_LINES; i++) {
+
+		line = BUFFER_SLOT(b, block->first + i);
+
+		if (line->block == block)
+			line->text = NULL;
+	}
+
+	free(block->text);
+	block->text = NULL;
+
+	b->thawed--;
+}
+
+void
+buffer_cold_freeze(struct buffer *b)
+{
+	/* Freeze all blocks thawed while scrolled back, blocks overlapping
+	 * the hot region are left thawed */
+
+	struct buffer_line *line;
+	unsigned i;
+
+	if (buffer_size(b) <= BUFFER_LINES_HOT)
+		return;
+
+	for (i = b->tail; (b->head - i) > BUFFER_LINES_HOT; i = (i | (BUFFER_BLOCK_LINES - 1)) + 1) {
+
+		line = BUFFER_SLOT(b, i);
+
+		if (line->block && line->block->text && (b->head - line->block->first) > BUFFER_LINES_HOT + BUFFER_BLOCK_LINES - 1)
+			buffer_block_freeze(b, line->block);
+	}
+}
+
+static size_t
+buffer_parse_irc_colour(const char *code, size_t len, int *fg, int *bg)
+{
+	/* Parse an IRC colour code of up to `len` bytes, returning its length
+	 *
+	 *   \x03[fg][,bg]
+	 *
+	 * fg and bg are set to the parsed IRC colour [0, 99] and are unchanged
+	 * if absent. If neither are present both are set to -1, resetting the
+	 * colour */
+
+	char c;
+	size_t i = 1;
+	int comma = 0;
+	int digits_bg = 0;
+	int digits_fg = 0;
+	int parsed_fg = 0;
+	int parsed_bg = 0;
+
+	if (!len || *code != ATTR_CODE_COLOUR)
+		return 0;
+
+	while (i < len && (c = code[i++])) {
+
+		if (isdigit(c)) {
+			if (comma) {
+				if (digits_bg >= 2)
+					break;
+				digits_bg++;
+				parsed_bg *= 10;
+				parsed_bg += (c - '0');
+			} else {
+				if (digits_fg >= 2)
+					break;
+				digits_fg++;
+				parsed_fg *= 10;
+				parsed_fg += (c - '0');
+			}
+		} else if (c == ',') {
+			if (comma++)
+				break;
+		} else {
+			break;
+		}
+	}
+
+	if (fg && !digits_fg && !digits_bg)
+		*fg = -1;
+
+	if (bg && !digits_fg && !digits_bg)
+		*bg = -1;
+
+	if (fg && digits_fg)
+		*fg = parsed_fg;
+
+	if (bg && digits_bg)
+		*bg = parsed_bg;
+
+	return (1 + digits_fg + digits_bg + (comma && digits_bg));
+}
+
+static size_t
+buffer_lz_pack(const unsigned char *src, size_t len, unsigned char *dst)
+{
+	/* Compress `len` bytes of `src` to `dst`, returning the compressed length
+	 *
+	 * LZ77 with a single-probe hash table of previous positions, output
+	 * is a sequence of literal runs and back references:
+	 *
+	 *   0LLLLLLL [L + 1 bytes]     : literal run of 1 to 128 bytes
+	 *   1MMMMMMM [offset, 2 bytes] : copy M + 4 bytes from `offset` bytes back
+	 *
+	 * `dst` must fit at least BUFFER_LZ_BOUND(len) bytes */
+
+	uint16_t table[1 << BUFFER_LZ_HASH_BITS] = {0};
+	size_t i = 0;
+	size_t lit = 0;
+	size_t out = 0;
+
+	if (len > UINT16_MAX)
+		fatal("invalid length: %zu", len);
+
+	#define BUFFER_LZ_LITERALS(END) \
+	while (lit < (END)) { \
+		size_t n = MIN((END) - lit, BUFFER_LZ_LITERAL_MAX); \
+		dst[out++] = n - 1; \
+		memcpy(dst + out, src + lit, n); \
+		out += n; \
+		lit += n; \
+	}
+
+	while (i + BUFFER_LZ_MATCH_MIN <= len) {
+
+		uint32_t h = ((uint32_t)src[i] | src[i + 1] << 8 | src[i + 2] << 16 | (uint32_t)src[i + 3] << 24);
+		size_t j = table[(h * 2654435761U) >> (32 - BUFFER_LZ_HASH_BITS)];
+		size_t m = 0;
+
+		table[(h * 2654435761U) >> (32 - BUFFER_LZ_HASH_BITS)] = i;
+
+		if (j < i && !memcmp(src + i, src + j, BUFFER_LZ_MATCH_MIN)) {
+			m = BUFFER_LZ_MATCH_MIN;
+			while (i + m < len && m < BUFFER_LZ_MATCH_MAX && src[i + m] == src[j + m])
+				m++;
+		}
+
+		if (!m) {
+			i++;
+			continue;
+		}
+
+		BUFFER_LZ_LITERALS(i);
+
+		dst[out++] = 0x80 | (m - BUFFER_LZ_MATCH_MIN);
+		dst[out++] = (i - j) >> 8;
+		dst[out++] = (i - j) & 0xff;
+
+		i += m;
+		lit = i;
+	}
+
+	BUFFER_LZ_LITERALS(len);
+
+	#undef BUFFER_LZ_LITERALS
+
+	return out;
+}
+
+static size_t
+buffer_lz_unpack(const unsigned char *src, size_t len, unsigned char *dst, size_t max)
+{
+	/* Decompress `len` bytes of `src` to `dst`, returning the decompressed
+	 * length, or 0 if the input is malformed or exceeds `max` bytes */
+
+	size_t i = 0;
+	size_t out = 0;
+
+	while (i < len) {
+
+		size_t n;
+
+		if (src[i] & 0x80) {
+
+			size_t offset;
+
+			if (i + 3 > len)
+				return 0;
+
+			n = (src[i] & 0x7f) + BUFFER_LZ_MATCH_MIN;
+			offset = (src[i + 1] << 8) | src[i + 2];
+
+			if (offset == 0 || offset > out || n > max - out)
+				return 0;
+
+			/* Byte-wise copy, matches may overlap their output */
+			while (n--) {
+				dst[out] = dst[out - offset];
+				out++;
+			}
+
+			i += 3;
+		} else {
+
+			n = src[i] + 1;
+
+			if (n > len - i - 1 || n > max - out)
+				return 0;
+
+			memcpy(dst + out, src + i + 1, n);
+
+			out += n;
+			i += n + 1;
+		}
 	}
 
-	return &(b->buffer_lines[BUFFER_MASK(b->head++)]);
+	return out;
 }
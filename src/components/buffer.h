@@ -2,9 +2,13 @@
 #define RIRC_COMPONENTS_BUFFER_H
 
 #include "config.h"
+#include "src/utils/intern.h"
 
+#include <stdint.h>
 #include <time.h>
 
+struct buffer_block;
+
 #define TEXT_LENGTH_MAX 510 /* FIXME: remove max lengths in favour of growable buffer */
 #define FROM_LENGTH_MAX 100
 
@@ -12,6 +16,10 @@
 #define BUFFER_LINES_MAX (1 << 10)
 #endif
 
+#ifndef BUFFER_LINES_HOT
+#define BUFFER_LINES_HOT (1 << 8)
+#endif
+
 /* Buffer line types, in order of precedence */
 enum buffer_line_type
 {
@@ -28,19 +36,41 @@ enum buffer_line_type
 	BUFFER_LINE_T_SIZE
 };
 
+/* Formatting run attributes */
+#define BUFFER_RUN_BOLD      (1 << 0)
+#define BUFFER_RUN_ITALIC    (1 << 1)
+#define BUFFER_RUN_REVERSE   (1 << 2)
+#define BUFFER_RUN_STRIKE    (1 << 3)
+#define BUFFER_RUN_UNDERLINE (1 << 4)
+
+/* Uniformly formatted span of buffer line text */
+struct buffer_run
+{
+	uint16_t offset; /* Offset in line text */
+	uint16_t len;
+	int8_t bg;       /* IRC colour [0, 98], -1: line default */
+	int8_t fg;       /* IRC colour [0, 98], -1: line default */
+	uint8_t flags;   /* BUFFER_RUN_* attributes */
+};
+
 struct buffer_line
 {
 	enum buffer_line_type type;
 	char prefix; /* TODO as part of `from` */
-	char from[FROM_LENGTH_MAX + 1]; /* TODO: from/text as struct string */
-	char text[TEXT_LENGTH_MAX + 1];
+	const char *from; /* Interned, including prefix */
+	char *text; /* Text stripped of formatting codes, NULL while packed in a cold block */
+	struct buffer_run *runs; /* Formatting runs spanning `text`, NULL when unformatted */
 	size_t from_len;
 	size_t text_len;
+	size_t runs_len;
 	time_t time;
+	struct buffer_block *block; /* Cold block containing `text` */
 	struct {
 		unsigned colour; /* Cached colour of `from` text */
 		unsigned cols;   /* Cached columns */
 		unsigned rows;   /* Cached rows when wrapping on `cols` columns */
+		unsigned width;  /* Cached display width of `text`, 0 until computed */
+		uint16_t *breaks; /* Cached end offset in `text` of each row, NULL when `rows` <= 1 */
 		unsigned initialized : 1;
 	} cached;
 };
@@ -51,23 +81,58 @@ struct buffer
 	unsigned tail;
 	unsigned scrollback; /* Index of the current line between [tail, head) for scrollback */
 	size_t pad;              /* Pad 'from' when printing to be at least this wide */
-	struct buffer_line buffer_lines[BUFFER_LINES_MAX];
+	struct buffer_line *buffer_lines; /* Allocated on first write, grows to BUFFER_LINES_MAX */
+	unsigned buffer_lines_max;        /* Allocated count of buffer_lines */
 	unsigned buffer_i_bot; /* index of last drawn bottom buffer line */
 	unsigned buffer_i_top; /* index of last drawn top buffer line */
+	unsigned thawed;       /* Count of cold blocks decompressed for drawing */
 	time_t time_last;
+	struct {
+		unsigned *tree;  /* Fenwick tree of wrapped line rows, indexed by slot */
+		unsigned cols;   /* Columns the rows were measured on */
+		unsigned synced; /* Lines [tail, synced) have their rows summed */
+		size_t pad;      /* Padding the rows were measured with */
+	} rows;
+};
+
+struct buffer_stats
+{
+	unsigned long long cold_bytes_raw;    /* Text bytes packed into cold blocks */
+	unsigned long long cold_bytes_packed; /* Compressed size of cold blocks */
+	unsigned long long thaw_count;        /* Cold blocks decompressed on demand */
+	unsigned long long thaw_ns;           /* Time spent decompressing cold blocks */
 };
 
 unsigned buffer_size(struct buffer*);
 
+size_t buffer_memory(struct buffer*);
+
 void buffer(struct buffer*);
+void buffer_compact(struct buffer*);
+void buffer_free(struct buffer*);
+
+const struct buffer_stats* buffer_stats(void);
 
 struct buffer_line* buffer_head(struct buffer*);
 struct buffer_line* buffer_tail(struct buffer*);
 struct buffer_line* buffer_line(struct buffer*, unsigned);
+struct buffer_line* buffer_line_peek(struct buffer*, unsigned);
+
+unsigned buffer_line_width(struct buffer_line*);
+
+/* Freeze cold blocks thawed outside the hot region */
+void buffer_cold_freeze(struct buffer*);
+
+unsigned buffer_rows(struct buffer*, unsigned, unsigned);
+unsigned buffer_rows_find(struct buffer*, unsigned);
+void buffer_rows_reset(struct buffer*, unsigned);
+void buffer_rows_set(struct buffer*, unsigned, unsigned);
 
 void buffer_newline(
 	struct buffer*,
+	struct intern*,
 	enum buffer_line_type,
+	time_t,
 	const char*,
 	const char*,
 	size_t,
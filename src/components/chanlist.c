@@ -0,0 +1,189 @@
+#include "src/components/chanlist.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int chanlist_cmp(const void*, const void*);
+static int chanlist_match(enum casemapping, const char*, const char*);
+static uint32_t chanlist_str(struct chanlist*, const char*);
+
+/* Sorted list and casemapping, for qsort */
+static struct chanlist *chanlist_sorting;
+static enum casemapping chanlist_sorting_cm;
+
+void
+chanlist_add(struct chanlist *cl, const char *name, unsigned users, const char *topic)
+{
+	struct chanlist_entry *e;
+
+	if (cl->entries_len == cl->entries_size) {
+
+		cl->entries_size = (cl->entries_size ? cl->entries_size * 2 : 256);
+
+		if ((cl->entries = realloc(cl->entries, sizeof(*cl->entries) * cl->entries_size)) == NULL)
+			fatal("realloc: %s", strerror(errno));
+	}
+
+	e = &(cl->entries[cl->entries_len++]);
+	e->name = chanlist_str(cl, name);
+	e->topic = chanlist_str(cl, topic);
+	e->users = users;
+
+	cl->stale = 1;
+}
+
+void
+chanlist_reset(struct chanlist *cl)
+{
+	/* Discard entries, keeping allocations and the filter for the next list */
+
+	cl->strs_len = 0;
+	cl->entries_len = 0;
+	cl->view_len = 0;
+	cl->page = 0;
+	cl->listing = 0;
+	cl->stale = 1;
+}
+
+void
+chanlist_free(struct chanlist *cl)
+{
+	free(cl->strs);
+	free(cl->entries);
+	free(cl->view);
+
+	memset(cl, 0, sizeof(*cl));
+}
+
+void
+chanlist_view(struct chanlist *cl, enum casemapping cm)
+{
+	struct chanlist_filter *f = &(cl->filter);
+
+	free(cl->view);
+
+	cl->view = NULL;
+	cl->view_len = 0;
+	cl->page = 0;
+	cl->stale = 0;
+
+	if (!cl->entries_len)
+		return;
+
+	if ((cl->view = malloc(sizeof(*cl->view) * cl->entries_len)) == NULL)
+		fatal("malloc: %s", strerror(errno));
+
+	for (size_t i = 0; i < cl->entries_len; i++) {
+
+		const struct chanlist_entry *e = &(cl->entries[i]);
+
+		if (f->users_min && e->users <= f->users_min)
+			continue;
+
+		if (f->users_max && e->users >= f->users_max)
+			continue;
+
+		if (*f->match && !chanlist_match(cm, cl->strs + e->name, f->match))
+			continue;
+
+		cl->view[cl->view_len++] = (uint32_t) i;
+	}
+
+	chanlist_sorting = cl;
+	chanlist_sorting_cm = cm;
+
+	qsort(cl->view, cl->view_len, sizeof(*cl->view), chanlist_cmp);
+
+	chanlist_sorting = NULL;
+}
+
+const struct chanlist_entry*
+chanlist_view_entry(struct chanlist *cl, size_t i)
+{
+	if (i >= cl->view_len)
+		return NULL;
+
+	return &(cl->entries[cl->view[i]]);
+}
+
+const char*
+chanlist_name(struct chanlist *cl, const struct chanlist_entry *e)
+{
+	return cl->strs + e->name;
+}
+
+const char*
+chanlist_topic(struct chanlist *cl, const struct chanlist_entry *e)
+{
+	return cl->strs + e->topic;
+}
+
+size_t
+chanlist_memory(struct chanlist *cl)
+{
+	return cl->strs_size
+		+ sizeof(*cl->entries) * cl->entries_size
+		+ sizeof(*cl->view) * (cl->view ? cl->entries_len : 0);
+}
+
+static int
+chanlist_cmp(const void *p1, const void *p2)
+{
+	const struct chanlist_entry *e1 = &(chanlist_sorting->entries[*(const uint32_t *)p1]);
+	const struct chanlist_entry *e2 = &(chanlist_sorting->entries[*(const uint32_t *)p2]);
+
+	if (chanlist_sorting->filter.sort == CHANLIST_SORT_USERS && e1->users != e2->users)
+		return (e1->users < e2->users) ? 1 : -1;
+
+	/* irc_strcmp orders reverse lexically */
+	return -irc_strcmp(chanlist_sorting_cm,
+		chanlist_sorting->strs + e1->name,
+		chanlist_sorting->strs + e2->name);
+}
+
+static int
+chanlist_match(enum casemapping cm, const char *str, const char *match)
+{
+	/* Return non-zero if match is a substring of str, under casemapping */
+
+	size_t len = strlen(match);
+
+	for (; *str; str++) {
+		if (!irc_strncmp(cm, str, match, len))
+			return 1;
+	}
+
+	return 0;
+}
+
+static uint32_t
+chanlist_str(struct chanlist *cl, const char *str)
+{
+	/* Append a string to the string table, returning its offset */
+
+	size_t len = strlen(str) + 1;
+	size_t offset = cl->strs_len;
+
+	if (cl->strs_len + len > cl->strs_size) {
+
+		size_t size = (cl->strs_size ? cl->strs_size : 4096);
+
+		while (cl->strs_len + len > size)
+			size *= 2;
+
+		if (size > UINT32_MAX)
+			fatal("chanlist: string table too large");
+
+		if ((cl->strs = realloc(cl->strs, size)) == NULL)
+			fatal("realloc: %s", strerror(errno));
+
+		cl->strs_size = size;
+	}
+
+	memcpy(cl->strs + offset, str, len);
+
+	cl->strs_len += len;
+
+	return (uint32_t) offset;
+}
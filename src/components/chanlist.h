@@ -0,0 +1,73 @@
+#ifndef RIRC_COMPONENTS_CHANLIST_H
+#define RIRC_COMPONENTS_CHANLIST_H
+
+/* Channel list
+ *
+ * Channels received from a server's LIST reply, stored compactly apart
+ * from buffer lines: names and topics are packed in a single string
+ * table, referenced by offset from fixed size entries.
+ *
+ * A view of the entries is filtered and sorted locally, and read a page
+ * at a time. The filter's user counts are exclusive, as with the ELIST
+ * 'U' extension, such that it can also be sent to the server */
+
+#include "src/utils/utils.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CHANLIST_MATCH_MAX 64
+
+enum chanlist_sort
+{
+	CHANLIST_SORT_USERS, /* Descending user count, then name */
+	CHANLIST_SORT_NAME,  /* Ascending name */
+};
+
+struct chanlist_entry
+{
+	uint32_t name;  /* Offset in string table */
+	uint32_t topic; /* Offset in string table */
+	uint32_t users;
+};
+
+struct chanlist_filter
+{
+	enum chanlist_sort sort;
+	unsigned users_min; /* Users more than, 0 for none */
+	unsigned users_max; /* Users less than, 0 for none */
+	char match[CHANLIST_MATCH_MAX]; /* Substring of name, "" for none */
+};
+
+struct chanlist
+{
+	char *strs;
+	size_t strs_len;
+	size_t strs_size;
+	struct chanlist_entry *entries;
+	size_t entries_len;
+	size_t entries_size;
+	uint32_t *view; /* Filtered and sorted entries, by index */
+	size_t view_len;
+	size_t page;    /* Next page of the view */
+	struct chanlist_filter filter;
+	unsigned listing : 1; /* Receiving entries */
+	unsigned stale   : 1; /* Entries changed since the view */
+};
+
+void chanlist_add(struct chanlist*, const char*, unsigned, const char*);
+void chanlist_reset(struct chanlist*);
+void chanlist_free(struct chanlist*);
+
+/* Filter and sort entries into the view */
+void chanlist_view(struct chanlist*, enum casemapping);
+
+/* Return the view's i'th entry, or NULL */
+const struct chanlist_entry* chanlist_view_entry(struct chanlist*, size_t);
+
+const char* chanlist_name(struct chanlist*, const struct chanlist_entry*);
+const char* chanlist_topic(struct chanlist*, const struct chanlist_entry*);
+
+size_t chanlist_memory(struct chanlist*);
+
+#endif
@@ -29,6 +29,7 @@ channel(const char *name, enum channel_type type)
 void
 channel_free(struct channel *c)
 {
+	buffer_free(&c->buffer);
 	input_free(&c->input);
 	user_list_free(&(c->users));
 	free((void *)c->key);
@@ -123,6 +124,15 @@ channel_list_get(struct channel_list *cl, const char *name, enum casemapping cm)
 	return NULL;
 }
 
+void
+channel_compact(struct channel *c)
+{
+	/* Release storage of a channel not in view */
+
+	buffer_compact(&(c->buffer));
+	input_release(&(c->input));
+}
+
 void
 channel_part(struct channel *c)
 {
@@ -136,6 +146,8 @@ channel_reset(struct channel *c)
 	memset(&(c->chanmodes), 0, sizeof(c->chanmodes));
 	memset(&(c->chanmodes_str), 0, sizeof(c->chanmodes_str));
 	user_list_free(&(c->users));
+	c->history.batch[0] = 0;
+	c->netsplit = 0;
 	c->joined = 0;
 	c->_366   = 0;
 }
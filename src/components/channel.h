@@ -6,6 +6,8 @@
 #include "src/components/mode.h"
 #include "src/components/user.h"
 
+#define CHANNEL_HISTORY_LEN 64
+
 /* Channel activity types, in order of precedence */
 enum activity
 {
@@ -41,6 +43,13 @@ struct channel
 	struct mode_str chanmodes_str;
 	struct server *server;
 	struct user_list users;
+	struct {
+		char batch[CHANNEL_HISTORY_LEN]; /* Open chathistory batch reference */
+		char msgid[CHANNEL_HISTORY_LEN]; /* Last message id received */
+		char time[CHANNEL_HISTORY_LEN];  /* Last server-time received */
+	} history;
+	time_t time_viewed; /* Last time set as the current channel */
+	unsigned netsplit;  /* Users quit or joined in the collected netsplit */
 	unsigned parted : 1;
 	unsigned joined : 1;
 	unsigned _366   : 1;
@@ -62,6 +71,7 @@ void channel_key_del(struct channel*);
 void channel_list_add(struct channel_list*, struct channel*);
 void channel_list_del(struct channel_list*, struct channel*);
 void channel_list_free(struct channel_list*);
+void channel_compact(struct channel*);
 void channel_part(struct channel*);
 void channel_reset(struct channel*);
 
@@ -15,6 +15,7 @@
 #define INPUT_HIST_LINE(I, X) ((I)->hist.ptrs[INPUT_MASK((X))])
 
 static char *input_text_copy(struct input*);
+static void input_text_alloc(struct input*);
 static int input_text_isfull(struct input*);
 static int input_text_iszero(struct input*);
 static uint16_t input_hist_size(struct input*);
@@ -33,6 +34,21 @@ input_free(struct input *inp)
 {
 	while (inp->hist.tail != inp->hist.head)
 		free(INPUT_HIST_LINE(inp, inp->hist.tail++));
+
+	free(inp->buf);
+}
+
+void
+input_release(struct input *inp)
+{
+	/* Free the working edit area when empty */
+
+	if (!input_text_iszero(inp))
+		return;
+
+	free(inp->buf);
+	inp->buf = NULL;
+	inp->window = 0;
 }
 
 int
@@ -85,6 +101,8 @@ input_insert(struct input *inp, const char *c, size_t count)
 	if (input_text_isfull(inp))
 		return 0;
 
+	input_text_alloc(inp);
+
 	while (!input_text_isfull(inp) && count--) {
 
 		if (iscntrl(*c))
@@ -162,6 +180,8 @@ input_hist_back(struct input *inp)
 
 	inp->hist.current--;
 
+	input_text_alloc(inp);
+
 	len = strlen(INPUT_HIST_LINE(inp, inp->hist.current));
 	memcpy(inp->buf, INPUT_HIST_LINE(inp, inp->hist.current), len);
 
@@ -184,6 +204,7 @@ input_hist_forw(struct input *inp)
 	if (inp->hist.current == inp->hist.head) {
 		len = 0;
 	} else {
+		input_text_alloc(inp);
 		len = strlen(INPUT_HIST_LINE(inp, inp->hist.current));
 		memcpy(inp->buf, INPUT_HIST_LINE(inp, inp->hist.current), len);
 	}
@@ -281,6 +302,13 @@ input_text_copy(struct input *inp)
 	return str;
 }
 
+static void
+input_text_alloc(struct input *inp)
+{
+	if (inp->buf == NULL && (inp->buf = malloc(INPUT_LEN_MAX)) == NULL)
+		fatal("malloc: %s", strerror(errno));
+}
+
 static int
 input_text_isfull(struct input *inp)
 {
@@ -43,7 +43,7 @@ typedef uint16_t (*f_completion_cb)(
 
 struct input
 {
-	char buf[INPUT_LEN_MAX];
+	char *buf; /* Allocated on first edit, see input_release */
 	struct {
 		char *ptrs[INPUT_HIST_MAX];
 		uint16_t current; /* Ring buffer current entry */
@@ -57,6 +57,7 @@ struct input
 
 void input_init(struct input*);
 void input_free(struct input*);
+void input_release(struct input*);
 
 /* Input manipulation */
 int input_cursor_back(struct input*);
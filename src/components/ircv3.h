@@ -8,13 +8,17 @@
 #define IRCV3_CAP_VERSION "302"
 
 #define IRCV3_CAPS_DEF \
-	X("account-notify", account_notify, IRCV3_CAP_AUTO) \
-	X("away-notify",    away_notify,    IRCV3_CAP_AUTO) \
-	X("chghost",        chghost,        IRCV3_CAP_AUTO) \
-	X("extended-join",  extended_join,  IRCV3_CAP_AUTO) \
-	X("invite-notify",  invite_notify,  IRCV3_CAP_AUTO) \
-	X("multi-prefix",   multi_prefix,   IRCV3_CAP_AUTO) \
-	X("sasl",           sasl,           IRCV3_CAP_AUTO)
+	X("account-notify",    account_notify,    IRCV3_CAP_AUTO) \
+	X("away-notify",       away_notify,       IRCV3_CAP_AUTO) \
+	X("batch",             batch,             IRCV3_CAP_AUTO) \
+	X("chghost",           chghost,           IRCV3_CAP_AUTO) \
+	X("draft/chathistory", draft_chathistory, IRCV3_CAP_AUTO) \
+	X("extended-join",     extended_join,     IRCV3_CAP_AUTO) \
+	X("invite-notify",     invite_notify,     IRCV3_CAP_AUTO) \
+	X("message-tags",      message_tags,      IRCV3_CAP_AUTO) \
+	X("multi-prefix",      multi_prefix,      IRCV3_CAP_AUTO) \
+	X("sasl",              sasl,              IRCV3_CAP_AUTO) \
+	X("server-time",       server_time,       IRCV3_CAP_AUTO)
 
 /* Extended by testcases */
 #ifndef IRCV3_CAPS_TEST
@@ -0,0 +1,332 @@
+#include "src/components/isupport.h"
+
+#include "src/utils/utils.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/* At least a few times the number of known tokens */
+#define ISUPPORT_SLOTS_BITS 7
+#define ISUPPORT_SLOTS      (1 << ISUPPORT_SLOTS_BITS)
+#define ISUPPORT_SEEDS_MAX  (1 << 16)
+
+static const char* isupport_unescape(const char*);
+static int isupport_limit(const char**, const char**, size_t*, unsigned*);
+static unsigned isupport_hash(uint32_t, const char*);
+static void isupport_slots_init(void);
+
+static const char *const isupport_tokens[] = {
+	#define X(TOKEN) #TOKEN,
+	ISUPPORT_TOKENS
+	#undef X
+};
+
+static unsigned char isupport_slots[ISUPPORT_SLOTS]; /* Token index + 1, 0 if empty */
+static uint32_t isupport_seed;
+
+int
+isupport_set(struct isupport *is, const char *token, const char *val)
+{
+	int del = (*token == '-');
+	int t;
+	size_t i;
+
+	if (is->stale)
+		isupport_free(is);
+
+	if (del)
+		token++;
+
+	if (!*token || (del && val))
+		return -1;
+
+	if ((t = isupport_token(token)) >= 0) {
+		free((void *)is->vals[t]);
+		is->vals[t] = (del ? NULL : isupport_unescape(val));
+		return 0;
+	}
+
+	for (i = 0; i < is->other_n && strcmp(is->other[i].token, token); i++)
+		;
+
+	if (i < is->other_n) {
+
+		free((void *)is->other[i].val);
+
+		if (!del) {
+			is->other[i].val = isupport_unescape(val);
+		} else {
+			free((void *)is->other[i].token);
+			is->other[i] = is->other[--is->other_n];
+		}
+
+		return 0;
+	}
+
+	if (del)
+		return 0;
+
+	if ((is->other = realloc(is->other, sizeof(*is->other) * (is->other_n + 1))) == NULL)
+		fatal("realloc: %s", strerror(errno));
+
+	is->other[is->other_n].token = irc_strdup(token);
+	is->other[is->other_n].val = isupport_unescape(val);
+	is->other_n++;
+
+	return 0;
+}
+
+const char*
+isupport_get(struct isupport *is, const char *token)
+{
+	int t;
+
+	if ((t = isupport_token(token)) >= 0)
+		return is->vals[t];
+
+	for (size_t i = 0; i < is->other_n; i++) {
+		if (!strcmp(is->other[i].token, token))
+			return is->other[i].val;
+	}
+
+	return NULL;
+}
+
+int
+isupport_token(const char *token)
+{
+	unsigned slot;
+
+	if (!isupport_seed)
+		isupport_slots_init();
+
+	slot = isupport_slots[isupport_hash(isupport_seed, token)];
+
+	if (slot && !strcmp(isupport_tokens[slot - 1], token))
+		return (int) slot - 1;
+
+	return -1;
+}
+
+const char*
+isupport_str(struct isupport *is, enum isupport_token t)
+{
+	return is->vals[t];
+}
+
+unsigned
+isupport_num(struct isupport *is, enum isupport_token t, unsigned def)
+{
+	const char *val = is->vals[t];
+	char *end;
+	unsigned long n;
+
+	if (!val || !isdigit((unsigned char) *val))
+		return def;
+
+	errno = 0;
+	n = strtoul(val, &end, 10);
+
+	if (*end || errno || n > UINT_MAX)
+		return def;
+
+	return (unsigned) n;
+}
+
+unsigned
+isupport_chanlimit(struct isupport *is, char type, unsigned *group)
+{
+	/* CHANLIMIT=<types>:[limit]{,<types>:[limit]}
+	 *
+	 * Falls back to MAXCHANNELS, limiting all types as a single group */
+
+	const char *str = is->vals[ISUPPORT_CHANLIMIT];
+	const char *types;
+	size_t len;
+	unsigned limit;
+
+	*group = 0;
+
+	if (!str)
+		return isupport_num(is, ISUPPORT_MAXCHANNELS, 0);
+
+	while (isupport_limit(&str, &types, &len, &limit) > 0) {
+
+		if (memchr(types, type, len))
+			return limit;
+
+		(*group)++;
+	}
+
+	return 0;
+}
+
+unsigned
+isupport_targmax(struct isupport *is, const char *cmd)
+{
+	/* TARGMAX=<command>:[limit]{,<command>:[limit]}
+	 *
+	 * Falls back to MAXTARGETS, limiting PRIVMSG and NOTICE */
+
+	const char *str = is->vals[ISUPPORT_TARGMAX];
+	const char *key;
+	size_t len;
+	unsigned limit;
+
+	if (!str) {
+		if (!strcasecmp(cmd, "PRIVMSG") || !strcasecmp(cmd, "NOTICE"))
+			return isupport_num(is, ISUPPORT_MAXTARGETS, 0);
+		return 0;
+	}
+
+	while (isupport_limit(&str, &key, &len, &limit) > 0) {
+		if (len == strlen(cmd) && !strncasecmp(key, cmd, len))
+			return limit;
+	}
+
+	return 0;
+}
+
+void
+isupport_reset(struct isupport *is)
+{
+	is->stale = 1;
+}
+
+void
+isupport_free(struct isupport *is)
+{
+	for (size_t i = 0; i < ARR_LEN(is->vals); i++)
+		free((void *)is->vals[i]);
+
+	for (size_t i = 0; i < is->other_n; i++) {
+		free((void *)is->other[i].token);
+		free((void *)is->other[i].val);
+	}
+
+	free(is->other);
+
+	memset(is, 0, sizeof(*is));
+}
+
+static const char*
+isupport_unescape(const char *val)
+{
+	/* Copy a value, replacing \xHH escapes with their byte */
+
+	char *p;
+	char *ret;
+
+	if (val == NULL)
+		return irc_strdup("");
+
+	p = ret = irc_strdup(val);
+
+	while (*val) {
+		if (val[0] == '\\' && val[1] == 'x'
+		 && isxdigit((unsigned char) val[2])
+		 && isxdigit((unsigned char) val[3])) {
+			char hex[] = { val[2], val[3], 0 };
+			*p++ = (char) strtoul(hex, NULL, 16);
+			val += 4;
+		} else {
+			*p++ = *val++;
+		}
+	}
+
+	*p = 0;
+
+	return ret;
+}
+
+static int
+isupport_limit(const char **str, const char **key, size_t *len, unsigned *limit)
+{
+	/* Parse a single <key>:[limit] from a comma separated list, where an
+	 * empty limit is unlimited
+	 *
+	 * Returns 1 if parsed, 0 at the end of the list, -1 if invalid */
+
+	const char *p = *str;
+	char *end;
+	unsigned long n = 0;
+
+	if (*p == 0)
+		return 0;
+
+	*key = p;
+	*len = strcspn(p, ":,");
+
+	p += *len;
+
+	if (*p++ != ':' || *len == 0)
+		return -1;
+
+	if (isdigit((unsigned char) *p)) {
+		errno = 0;
+		n = strtoul(p, &end, 10);
+		if (errno || n > UINT_MAX)
+			return -1;
+		p = end;
+	}
+
+	if (*p == ',')
+		p++;
+	else if (*p)
+		return -1;
+
+	*str = p;
+	*limit = (unsigned) n;
+
+	return 1;
+}
+
+static unsigned
+isupport_hash(uint32_t seed, const char *str)
+{
+	/* FNV-1a, with the offset basis varied by seed, returning a slot from
+	 * the hash's high bits, as its low bits depend only on the low bits
+	 * of the seed and input */
+
+	uint32_t h = 2166136261u ^ seed;
+
+	while (*str) {
+		h ^= (uint8_t) *str++;
+		h *= 16777619u;
+	}
+
+	return (unsigned) (h >> (32 - ISUPPORT_SLOTS_BITS));
+}
+
+static void
+isupport_slots_init(void)
+{
+	/* Find the first seed hashing each known token to a distinct slot */
+
+	for (isupport_seed = 1; isupport_seed < ISUPPORT_SEEDS_MAX; isupport_seed++) {
+
+		size_t i;
+
+		memset(isupport_slots, 0, sizeof(isupport_slots));
+
+		for (i = 0; i < ARR_LEN(isupport_tokens); i++) {
+
+			unsigned char *slot = &isupport_slots[isupport_hash(isupport_seed, isupport_tokens[i])];
+
+			if (*slot)
+				break;
+
+			*slot = (unsigned char) (i + 1);
+		}
+
+		if (i == ARR_LEN(isupport_tokens))
+			return;
+	}
+
+	fatal("isupport: no perfect hash for tokens");
+}
@@ -0,0 +1,101 @@
+#ifndef RIRC_COMPONENTS_ISUPPORT_H
+#define RIRC_COMPONENTS_ISUPPORT_H
+
+/* Server ISUPPORT (numeric 005) tokens
+ *
+ * Tokens known by the client are stored by index, found from their name
+ * with a perfect hash, and read with typed accessors. Other tokens are
+ * kept by name.
+ *
+ * Values are stored unescaped. A token set without a value has value "",
+ * and an unset token has value NULL.
+ *
+ * On reset, values remain readable until the next token is set, such that
+ * limits from a previous connection apply on registration, before the
+ * server sends numeric 005 */
+
+#include <stddef.h>
+
+#define ISUPPORT_TOKENS \
+	X(AWAYLEN)     \
+	X(BOT)         \
+	X(CALLERID)    \
+	X(CASEMAPPING) \
+	X(CHANLIMIT)   \
+	X(CHANMODES)   \
+	X(CHANNELLEN)  \
+	X(CHANTYPES)   \
+	X(CHATHISTORY) \
+	X(ELIST)       \
+	X(EXCEPTS)     \
+	X(EXTBAN)      \
+	X(HOSTLEN)     \
+	X(INVEX)       \
+	X(KEYLEN)      \
+	X(KICKLEN)     \
+	X(LINELEN)     \
+	X(MAXCHANNELS) \
+	X(MAXLIST)     \
+	X(MAXNICKLEN)  \
+	X(MAXTARGETS)  \
+	X(MODES)       \
+	X(MONITOR)     \
+	X(MSGREFTYPES) \
+	X(NETWORK)     \
+	X(NICKLEN)     \
+	X(PREFIX)      \
+	X(SAFELIST)    \
+	X(SILENCE)     \
+	X(STATUSMSG)   \
+	X(TARGMAX)     \
+	X(TOPICLEN)    \
+	X(USERLEN)     \
+	X(UTF8ONLY)    \
+	X(WATCH)       \
+	X(WHOX)
+
+enum isupport_token
+{
+	#define X(TOKEN) ISUPPORT_##TOKEN,
+	ISUPPORT_TOKENS
+	#undef X
+	ISUPPORT_T_SIZE
+};
+
+struct isupport
+{
+	const char *vals[ISUPPORT_T_SIZE];
+	struct {
+		const char *token;
+		const char *val;
+	} *other;
+	size_t other_n;
+	unsigned stale : 1;
+};
+
+/* Set a token and its value, NULL for none, or remove a '-' prefixed token */
+int isupport_set(struct isupport*, const char*, const char*);
+
+/* Return a token's value by name */
+const char* isupport_get(struct isupport*, const char*);
+
+/* Return the known token by name, or -1 */
+int isupport_token(const char*);
+
+/* Return a known token's value */
+const char* isupport_str(struct isupport*, enum isupport_token);
+
+/* Return a known token's numeric value, or a default if unset or invalid */
+unsigned isupport_num(struct isupport*, enum isupport_token, unsigned);
+
+/* Return the channel limit for a channel type, and its group of types,
+ * 0 if unlimited */
+unsigned isupport_chanlimit(struct isupport*, char, unsigned*);
+
+/* Return the target limit for a command, 0 if unlimited */
+unsigned isupport_targmax(struct isupport*, const char*);
+
+void isupport_reset(struct isupport*);
+void isupport_free(struct isupport*);
+
+#endif
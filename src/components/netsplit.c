@@ -0,0 +1,136 @@
+#include "src/components/netsplit.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int netsplit_cmp(const void*, const void*);
+static size_t netsplit_host(const char*);
+
+/* Casemapping of sorted nicks, for qsort */
+static enum casemapping netsplit_sorting_cm;
+
+int
+netsplit_servers(const char *str)
+{
+	/* Quit messages of users lost in a split are "<server> <server>",
+	 * where servers differ, and are hostnames with at least one '.'.
+	 * Some networks hide server names, e.g. "*.net *.split" */
+
+	const char *str2;
+	size_t len1;
+	size_t len2;
+
+	if (!(len1 = netsplit_host(str)) || str[len1] != ' ')
+		return 0;
+
+	str2 = str + len1 + 1;
+
+	if (!(len2 = netsplit_host(str2)) || str2[len2])
+		return 0;
+
+	return (len1 != len2 || strncmp(str, str2, len1));
+}
+
+void
+netsplit_start(struct netsplit *ns, const char *servers, time_t t)
+{
+	netsplit_free(ns);
+
+	ns->servers = irc_strdup(servers);
+	ns->time = t;
+	ns->time_split = t;
+}
+
+void
+netsplit_add(struct netsplit *ns, const char *nick)
+{
+	if (ns->nicks_n == ns->nicks_size) {
+
+		ns->nicks_size = (ns->nicks_size ? ns->nicks_size * 2 : 64);
+
+		if ((ns->nicks = realloc(ns->nicks, sizeof(*ns->nicks) * ns->nicks_size)) == NULL)
+			fatal("realloc: %s", strerror(errno));
+	}
+
+	ns->nicks[ns->nicks_n++] = irc_strdup(nick);
+	ns->sorted = 0;
+}
+
+void
+netsplit_free(struct netsplit *ns)
+{
+	for (size_t i = 0; i < ns->nicks_n; i++)
+		free(ns->nicks[i]);
+
+	free(ns->nicks);
+	free(ns->servers);
+
+	memset(ns, 0, sizeof(*ns));
+}
+
+int
+netsplit_get(struct netsplit *ns, enum casemapping cm, const char *nick, time_t t)
+{
+	/* Nicks are sorted on first lookup after being added, then searched */
+
+	size_t lo = 0;
+	size_t hi = ns->nicks_n;
+
+	if (!ns->nicks_n || t - ns->time_split > NETSPLIT_REJOIN_MAX)
+		return 0;
+
+	if (!ns->sorted) {
+		netsplit_sorting_cm = cm;
+		qsort(ns->nicks, ns->nicks_n, sizeof(*ns->nicks), netsplit_cmp);
+		ns->sorted = 1;
+	}
+
+	while (lo < hi) {
+
+		size_t mid = lo + (hi - lo) / 2;
+		int cmp = irc_strcmp(cm, ns->nicks[mid], nick);
+
+		if (cmp == 0)
+			return 1;
+
+		/* irc_strcmp orders reverse lexically */
+		if (cmp > 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return 0;
+}
+
+static int
+netsplit_cmp(const void *p1, const void *p2)
+{
+	return -irc_strcmp(netsplit_sorting_cm, *(char *const *)p1, *(char *const *)p2);
+}
+
+static size_t
+netsplit_host(const char *str)
+{
+	/* Return the length of a hostname at str, or 0 if invalid */
+
+	const char *p;
+	unsigned dots = 0;
+
+	for (p = str; *p && *p != ' '; p++) {
+		if (*p == '.') {
+			if (p == str || p[-1] == '.')
+				return 0;
+			dots++;
+		} else if (!isalnum((unsigned char) *p) && *p != '-' && *p != '*') {
+			return 0;
+		}
+	}
+
+	if (!dots || p[-1] == '.')
+		return 0;
+
+	return (size_t)(p - str);
+}
@@ -0,0 +1,54 @@
+#ifndef RIRC_COMPONENTS_NETSPLIT_H
+#define RIRC_COMPONENTS_NETSPLIT_H
+
+/* Netsplit detection
+ *
+ * Without IRCv3 batches, a netsplit is received as a burst of QUITs, each
+ * with the names of the split servers as its message, and the netjoin as
+ * a burst of JOINs by the same users once the servers relink.
+ *
+ * Users quit in the last split are kept, for matching their joins, for up
+ * to NETSPLIT_REJOIN_MAX seconds after the split */
+
+#include "config.h"
+#include "src/utils/utils.h"
+
+#include <stddef.h>
+#include <time.h>
+
+#ifndef NETSPLIT_REJOIN_MAX
+#define NETSPLIT_REJOIN_MAX 3600
+#endif
+
+enum netsplit_state
+{
+	NETSPLIT_NONE,
+	NETSPLIT_QUIT, /* Collecting quits */
+	NETSPLIT_JOIN, /* Collecting joins */
+};
+
+struct netsplit
+{
+	char *servers;  /* "<server> <server>" of the last split */
+	char **nicks;   /* Users quit in the last split */
+	size_t nicks_n;
+	size_t nicks_size;
+	enum netsplit_state state;
+	time_t time;       /* Last quit or join collected */
+	time_t time_split; /* Last split started */
+	unsigned sorted : 1;
+};
+
+/* Return non-zero if a QUIT message names split servers */
+int netsplit_servers(const char*);
+
+/* Start a split, discarding users of the last */
+void netsplit_start(struct netsplit*, const char*, time_t);
+
+void netsplit_add(struct netsplit*, const char*);
+void netsplit_free(struct netsplit*);
+
+/* Return non-zero if a user quit in the last split */
+int netsplit_get(struct netsplit*, enum casemapping, const char*, time_t);
+
+#endif
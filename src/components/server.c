@@ -22,6 +22,7 @@ struct opt
 
 static int parse_005(struct opt*, char**);
 static int server_cmp(const struct server*, const char*, const char*);
+static int server_highlight(struct server*);
 
 #define X(cmd) static int server_set_##cmd(struct server*, char*);
 HANDLED_005
@@ -140,6 +141,9 @@ server_reset(struct server *s)
 {
 	ircv3_caps_reset(&(s->ircv3_caps));
 	ircv3_sasl_reset(&(s->ircv3_sasl));
+	isupport_reset(&(s->isupport));
+	s->chanlist.listing = 0;
+	netsplit_free(&(s->netsplit));
 	memset(&(s->usermodes), 0, sizeof(s->usermodes));
 	memset(&(s->mode_str), 0, sizeof(s->mode_str));
 	s->ping = 0;
@@ -152,6 +156,10 @@ void
 server_free(struct server *s)
 {
 	channel_list_free(&(s->clist));
+	chanlist_free(&(s->chanlist));
+	highlight_free(&(s->highlight));
+	isupport_free(&(s->isupport));
+	netsplit_free(&(s->netsplit));
 
 	free((void *)s->host);
 	free((void *)s->port);
@@ -160,6 +168,7 @@ server_free(struct server *s)
 	free((void *)s->realname);
 	free((void *)s->mode);
 	free((void *)s->nick);
+	free((void *)s->highlights);
 	free((void *)s->nicks.base);
 	free((void *)s->nicks.set);
 	free((void *)s->ircv3_sasl.user);
@@ -215,6 +224,18 @@ server_set_chans(struct server *s, const char *str)
 	return 0;
 }
 
+int
+server_set_highlights(struct server *s, const char *str)
+{
+	/* Set comma separated keywords highlighted along with the nick */
+
+	free((void *)s->highlights);
+
+	s->highlights = irc_strdup(str);
+
+	return server_highlight(s);
+}
+
 int
 server_set_nicks(struct server *s, const char *str)
 {
@@ -298,7 +319,8 @@ server_set_004(struct server *s, char *str)
 void
 server_set_005(struct server *s, char *str)
 {
-	/* Iterate over options parsed from str and set for server s */
+	/* Iterate over options parsed from str and set for server s, storing
+	 * all tokens, and applying those handled by the client */
 
 	struct opt opt;
 
@@ -306,6 +328,16 @@ server_set_005(struct server *s, char *str)
 
 		int (*server_set)(struct server*, char*) = NULL;
 
+		if (isupport_set(&(s->isupport), opt.arg, opt.val)) {
+			server_error(s, "invalid numeric 005 %s", opt.arg);
+			continue;
+		}
+
+		if (*opt.arg == '-') {
+			debug("Unsetting numeric 005 %s", opt.arg + 1);
+			continue;
+		}
+
 		#define X(cmd) \
 		if (!strcmp(opt.arg, #cmd)) \
 			server_set = server_set_##cmd;
@@ -357,6 +389,14 @@ server_cmp(const struct server *s, const char *host, const char *port)
 	return 0;
 }
 
+static int
+server_highlight(struct server *s)
+{
+	/* Recompile highlights, as the nick, keywords or casemapping change */
+
+	return highlight_compile(&(s->highlight), s->casemapping, s->nick, s->highlights);
+}
+
 static int
 parse_005(struct opt *opt, char **str)
 {
@@ -374,28 +414,9 @@ parse_005(struct opt *opt, char **str)
 	 * letpun    =  letter / punct
 	 */
 
-	/* FIXME: (see docs)
-	 *
-	 * '-PARAMETER' is valid and negates a previously set parameter to its default
-	 * 'PARAMETER', 'PARAMTER=' are equivalent
-	 *
-	 * The parameter's value may contain sequences of the form "\xHH", where
-	 * HH is a two-digit hexadecimal number.  Each such sequence is
-	 * considered identical to the equivalent octet after parsing of the
-	 * reply into separate tokens has occurred.
-	 *
-	 * [Example: X=A\x20B defines one token, "X", with the value "A B",
-	 * rather than two tokens "X" and "B".]
-	 * [Note: The literal string "\x" must therefore be encoded as
-	 * "\x5Cx".]
-	 *
-	 * If the server has not advertised a CHARSET parameter, it MUST not use
-	 * such sequences with a value outside those permitted by the above ABNF
-	 * grammar, with the exception of "\x20";  if it has advertised CHARSET,
-	 * then it may in addition send any printable character defined in that
-	 * encoding. Characters in multibyte encodings such as UTF-8 should be
-	 * sent as a series of \x sequences.
-	 */
+	/* '-PARAMETER' is valid and negates a previously set parameter to its
+	 * default, and values may contain sequences of the form "\xHH", which
+	 * are unescaped when stored, see isupport_set */
 
 	char *t, *p = *str;
 
@@ -405,7 +426,7 @@ parse_005(struct opt *opt, char **str)
 	if (!irc_strtrim(&p))
 		return 0;
 
-	if (!isalnum(*p))
+	if (!isalnum(*p) && !(*p == '-' && isalnum(p[1])))
 		return 0;
 
 	opt->arg = p;
@@ -432,17 +453,17 @@ server_set_CASEMAPPING(struct server *s, char *val)
 {
 	if (!strcmp(val, "ascii")) {
 		s->casemapping = CASEMAPPING_ASCII;
-		return 0;
+		return server_highlight(s);
 	}
 
 	if (!strcmp(val, "rfc1459")) {
 		s->casemapping = CASEMAPPING_RFC1459;
-		return 0;
+		return server_highlight(s);
 	}
 
 	if (!strcmp(val, "strict-rfc1459")) {
 		s->casemapping = CASEMAPPING_STRICT_RFC1459;
-		return 0;
+		return server_highlight(s);
 	}
 
 	return -1;
@@ -469,6 +490,8 @@ server_nick_set(struct server *s, const char *nick)
 		free((void *)s->nick);
 
 	s->nick = irc_strdup(nick);
+
+	server_highlight(s);
 }
 
 void
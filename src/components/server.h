@@ -3,11 +3,20 @@
 
 #include "src/components/buffer.h"
 #include "src/components/channel.h"
+#include "src/components/chanlist.h"
 #include "src/components/ircv3.h"
+#include "src/components/isupport.h"
 #include "src/components/mode.h"
+#include "src/components/netsplit.h"
+#include "src/utils/highlight.h"
+#include "src/utils/intern.h"
 
 // TODO: move this to utils
 #define IRC_MESSAGE_LEN 510
+#define IRC_TAGS_LEN    8191
+
+/* Distinct commands counted in handler statistics, including unknown */
+#define SERVER_RECV_COMMANDS 32
 
 struct server
 {
@@ -18,6 +27,7 @@ struct server
 	const char *realname;
 	const char *nick;
 	const char *mode;
+	const char *highlights; /* Comma separated keywords */
 	enum casemapping casemapping;
 	struct {
 		size_t next;
@@ -27,6 +37,11 @@ struct server
 	} nicks;
 	struct channel *channel;
 	struct channel_list clist;
+	struct chanlist chanlist; /* LIST reply */
+	struct netsplit netsplit;
+	struct intern intern; /* Nicks shared by user lists and buffer lines */
+	struct highlight highlight; /* Compiled from nick and highlights */
+	struct isupport isupport;
 	struct ircv3_caps ircv3_caps;
 	struct ircv3_sasl ircv3_sasl;
 	struct mode usermodes;
@@ -43,8 +58,21 @@ struct server
 	struct {
 		size_t i;
 		char cl;
-		char buf[IRC_MESSAGE_LEN + 1]; /* callback message buffer */
+		char buf[IRC_TAGS_LEN + IRC_MESSAGE_LEN + 1]; /* callback message buffer */
+		unsigned long long msgs;       /* messages received */
 	} read;
+	struct {
+		struct {
+			const char *command; /* Handler key, NULL for unknown commands */
+			unsigned long long n;
+			unsigned long long ns;
+		} commands[SERVER_RECV_COMMANDS]; /* In order first received */
+		size_t commands_n;
+		struct {
+			unsigned long long n;
+			unsigned long long ns;
+		} numerics[1000]; /* Indexed by code */
+	} recv_stats; /* Message handler statistics */
 };
 
 struct server_list
@@ -67,6 +95,7 @@ struct server* server_list_del(struct server_list*, struct server*);
 struct server* server_list_get(struct server_list*, const char*, const char*);
 
 int server_set_chans(struct server*, const char*);
+int server_set_highlights(struct server*, const char*);
 int server_set_nicks(struct server*, const char*);
 void server_set_004(struct server*, char*);
 void server_set_005(struct server*, char*);
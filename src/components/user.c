@@ -1,59 +1,315 @@
 #include "src/components/user.h"
 
 #include <errno.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 
-static struct user* user(const char*, struct mode);
-static inline int user_cmp(struct user*, struct user*, void *arg);
-static inline int user_ncmp(struct user*, struct user*, void *arg, size_t);
-static inline void user_free(struct user*);
+struct user_key
+{
+	uint64_t key;
+	struct user *u;
+};
+
+static int user_cmp(enum casemapping, uint64_t, const char*, uint64_t, const char*, size_t);
+static int user_find(struct user_list*, enum casemapping, uint64_t, const char*, size_t, unsigned*, unsigned*);
+static struct user* user(struct user_list*, struct intern*, const char*, struct mode);
+static struct user_block* user_block(struct user_list*, unsigned);
+static void user_append(struct user_list*, struct user*, uint64_t);
+static void user_block_free(struct user_list*, unsigned);
+static void user_insert(struct user_list*, struct user*, uint64_t, unsigned, unsigned);
+static void user_remove(struct user_list*, unsigned, unsigned);
+static void user_sort(struct user_key*, struct user_key*, size_t, enum casemapping);
+static inline void user_free(struct user_list*, struct user*);
+static inline void user_free_nick(struct user*);
+
+static int
+user_cmp(enum casemapping cm, uint64_t key1, const char *nick1, uint64_t key2, const char *nick2, size_t n)
+{
+	/* Compare nicks by key, then in full when their keys are equal,
+	 * comparing n characters if non-zero */
+
+	uint64_t mask = ((n && n < 8) ? ~(UINT64_MAX >> (n * 8)) : UINT64_MAX);
+
+	if ((key1 & mask) != (key2 & mask))
+		return ((key1 & mask) < (key2 & mask) ? 1 : -1);
 
-AVL_GENERATE(user_list, user, ul, user_cmp, user_ncmp)
+	/* Equal keys of at most 7 characters are of equal nicks */
+	if ((n && n <= 8) || (uint8_t)key1 == (uint8_t)(0 - CHAR_MIN))
+		return 0;
 
-static inline int
-user_cmp(struct user *u1, struct user *u2, void *arg)
+	return (n ? irc_strncmp(cm, nick1, nick2, n) : irc_strcmp(cm, nick1, nick2));
+}
+
+static int
+user_find(struct user_list *ul, enum casemapping cm, uint64_t key, const char *nick, size_t n, unsigned *block, unsigned *i)
 {
-	return irc_strcmp(*(enum casemapping*)arg, u1->nick, u2->nick);
+	/* Find the position of the first user ordered at or after nick, comparing
+	 * n characters if non-zero, and return non-zero if the user matches */
+
+	struct user_block *b;
+	unsigned lo = 0;
+	unsigned hi = ul->blocks_n;
+
+	while (lo < hi) {
+
+		unsigned mid = lo + (hi - lo) / 2;
+
+		b = ul->blocks[mid];
+
+		if (user_cmp(cm, b->keys[b->n - 1], b->users[b->n - 1]->nick, key, nick, n) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	*block = lo;
+	*i = 0;
+
+	if (lo == ul->blocks_n)
+		return 0;
+
+	b = ul->blocks[lo];
+
+	lo = 0;
+	hi = b->n - 1;
+
+	while (lo < hi) {
+
+		unsigned mid = lo + (hi - lo) / 2;
+
+		if (user_cmp(cm, b->keys[mid], b->users[mid]->nick, key, nick, n) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	*i = lo;
+
+	return !user_cmp(cm, b->keys[lo], b->users[lo]->nick, key, nick, n);
 }
 
-static inline int
-user_ncmp(struct user *u1, struct user *u2, void *arg, size_t n)
+static inline void
+user_free(struct user_list *ul, struct user *u)
 {
-	return irc_strncmp(*(enum casemapping*)arg, u1->nick, u2->nick, n);
+	/* Release a user to its list for reuse */
+
+	user_free_nick(u);
+
+	u->next = ul->released;
+	ul->released = u;
 }
 
 static inline void
-user_free(struct user *u)
+user_free_nick(struct user *u)
 {
-	free(u);
+	intern_unref(u->nick);
 }
 
 static struct user*
-user(const char *nick, struct mode prfxmodes)
+user(struct user_list *ul, struct intern *t, const char *nick, struct mode prfxmodes)
 {
-	size_t len = strlen(nick);
 	struct user *u;
 
-	if ((u = calloc(1, sizeof(*u) + len + 1)) == NULL)
-		fatal("calloc: %s", strerror(errno));
+	if ((u = ul->released)) {
+		ul->released = u->next;
+	} else {
+
+		if (ul->slabs == NULL || ul->slab_n == ul->slabs->size) {
+
+			struct user_slab *slab;
+			unsigned size = (ul->slabs ? MIN(ul->slabs->size * 2, USER_SLAB_MAX) : USER_SLAB_MIN);
+
+			if ((slab = malloc(sizeof(*slab) + sizeof(*slab->users) * size)) == NULL)
+				fatal("malloc: %s", strerror(errno));
 
-	u->nick = memcpy(u->_, nick, len + 1);
-	u->nick_len = len;
+			slab->next = ul->slabs;
+			slab->size = size;
+
+			ul->slabs = slab;
+			ul->slab_n = 0;
+		}
+
+		u = &(ul->slabs->users[ul->slab_n++]);
+	}
+
+	u->nick_len = strlen(nick);
+	u->nick = intern(t, nick, u->nick_len);
 	u->prfxmodes = prfxmodes;
 
 	return u;
 }
 
+static struct user_block*
+user_block(struct user_list *ul, unsigned b)
+{
+	/* Create an empty block at index b */
+
+	struct user_block *block;
+
+	if (ul->blocks_n == ul->blocks_size) {
+
+		ul->blocks_size = (ul->blocks_size ? ul->blocks_size * 2 : 8);
+
+		if ((ul->blocks = realloc(ul->blocks, sizeof(*ul->blocks) * ul->blocks_size)) == NULL)
+			fatal("realloc: %s", strerror(errno));
+	}
+
+	if ((block = malloc(sizeof(*block))) == NULL)
+		fatal("malloc: %s", strerror(errno));
+
+	block->n = 0;
+
+	memmove(ul->blocks + b + 1, ul->blocks + b, sizeof(*ul->blocks) * (ul->blocks_n - b));
+
+	ul->blocks[b] = block;
+	ul->blocks_n++;
+
+	return block;
+}
+
+static void
+user_block_free(struct user_list *ul, unsigned b)
+{
+	free(ul->blocks[b]);
+
+	memmove(ul->blocks + b, ul->blocks + b + 1, sizeof(*ul->blocks) * (ul->blocks_n - b - 1));
+
+	ul->blocks_n--;
+}
+
+static void
+user_append(struct user_list *ul, struct user *u, uint64_t key)
+{
+	/* Append a user ordered after all others, filling blocks to USER_BLOCK_FILL */
+
+	struct user_block *block;
+
+	if (ul->blocks_n == 0 || ul->blocks[ul->blocks_n - 1]->n == USER_BLOCK_FILL)
+		block = user_block(ul, ul->blocks_n);
+	else
+		block = ul->blocks[ul->blocks_n - 1];
+
+	block->keys[block->n] = key;
+	block->users[block->n] = u;
+	block->n++;
+}
+
+static void
+user_insert(struct user_list *ul, struct user *u, uint64_t key, unsigned b, unsigned i)
+{
+	/* Insert a user at a position found by user_find */
+
+	struct user_block *block;
+
+	if (ul->blocks_n == 0)
+		user_block(ul, 0);
+
+	if (b == ul->blocks_n) {
+		b--;
+		i = ul->blocks[b]->n;
+	}
+
+	block = ul->blocks[b];
+
+	if (block->n == USER_BLOCK_MAX) {
+
+		struct user_block *split = user_block(ul, b + 1);
+
+		split->n = USER_BLOCK_MAX - USER_BLOCK_MAX / 2;
+		block->n = USER_BLOCK_MAX / 2;
+
+		memcpy(split->keys, block->keys + block->n, sizeof(*split->keys) * split->n);
+		memcpy(split->users, block->users + block->n, sizeof(*split->users) * split->n);
+
+		if (i > block->n) {
+			i -= block->n;
+			block = split;
+		}
+	}
+
+	memmove(block->keys + i + 1, block->keys + i, sizeof(*block->keys) * (block->n - i));
+	memmove(block->users + i + 1, block->users + i, sizeof(*block->users) * (block->n - i));
+
+	block->keys[i] = key;
+	block->users[i] = u;
+	block->n++;
+}
+
+static void
+user_remove(struct user_list *ul, unsigned b, unsigned i)
+{
+	/* Remove the user at a position found by user_find, merging the block
+	 * with a neighbour when their users fit in half a block */
+
+	struct user_block *block = ul->blocks[b];
+	unsigned m = ul->blocks_n;
+
+	block->n--;
+
+	memmove(block->keys + i, block->keys + i + 1, sizeof(*block->keys) * (block->n - i));
+	memmove(block->users + i, block->users + i + 1, sizeof(*block->users) * (block->n - i));
+
+	if (b > 0 && ul->blocks[b - 1]->n + block->n <= USER_BLOCK_MAX / 2)
+		m = b - 1;
+	else if (b + 1 < ul->blocks_n && block->n + ul->blocks[b + 1]->n <= USER_BLOCK_MAX / 2)
+		m = b;
+
+	if (m < ul->blocks_n) {
+
+		struct user_block *b1 = ul->blocks[m];
+		struct user_block *b2 = ul->blocks[m + 1];
+
+		memcpy(b1->keys + b1->n, b2->keys, sizeof(*b2->keys) * b2->n);
+		memcpy(b1->users + b1->n, b2->users, sizeof(*b2->users) * b2->n);
+
+		b1->n += b2->n;
+
+		user_block_free(ul, m + 1);
+	} else if (block->n == 0) {
+		user_block_free(ul, b);
+	}
+}
+
+static void
+user_sort(struct user_key *u, struct user_key *tmp, size_t n, enum casemapping cm)
+{
+	/* Stable merge sort of keyed users by nick, with tmp for at least n / 2 */
+
+	size_t i, j, k;
+	size_t mid = n / 2;
+
+	if (n < 2)
+		return;
+
+	user_sort(u, tmp, mid, cm);
+	user_sort(u + mid, tmp, n - mid, cm);
+
+	memcpy(tmp, u, sizeof(*u) * mid);
+
+	for (i = 0, j = mid, k = 0; i < mid; k++) {
+		if (j == n || user_cmp(cm, tmp[i].key, tmp[i].u->nick, u[j].key, u[j].u->nick, 0) <= 0)
+			u[k] = tmp[i++];
+		else
+			u[k] = u[j++];
+	}
+}
+
 enum user_err
-user_list_add(struct user_list *ul, enum casemapping cm, const char *nick, struct mode prfxmodes)
+user_list_add(struct user_list *ul, struct intern *t, enum casemapping cm, const char *nick, struct mode prfxmodes)
 {
 	/* Create user and add to userlist */
 
-	if (user_list_get(ul, cm, nick, 0) != NULL)
+	uint64_t key = irc_strkey(cm, nick, 0);
+	unsigned b;
+	unsigned i;
+
+	user_list_merge(ul, cm, NULL, NULL);
+
+	if (user_find(ul, cm, key, nick, 0, &b, &i))
 		return USER_ERR_DUPLICATE;
 
-	AVL_ADD(user_list, ul, user(nick, prfxmodes), &cm);
+	user_insert(ul, user(ul, t, nick, prfxmodes), key, b, i);
 	ul->count++;
 
 	return USER_ERR_NONE;
@@ -65,41 +321,61 @@ user_list_del(struct user_list *ul, enum casemapping cm, const char *nick)
 	/* Delete user and remove from userlist */
 
 	struct user *u;
+	unsigned b;
+	unsigned i;
+
+	user_list_merge(ul, cm, NULL, NULL);
 
-	if ((u = user_list_get(ul, cm, nick, 0)) == NULL)
+	if (!user_find(ul, cm, irc_strkey(cm, nick, 0), nick, 0, &b, &i))
 		return USER_ERR_NOT_FOUND;
 
-	AVL_DEL(user_list, ul, u, &cm);
+	u = ul->blocks[b]->users[i];
+
+	user_remove(ul, b, i);
 	ul->count--;
 
-	user_free(u);
+	user_free(ul, u);
 
 	return USER_ERR_NONE;
 }
 
 enum user_err
-user_list_rpl(struct user_list *ul, enum casemapping cm, const char *nick_old, const char *nick_new)
+user_list_rpl(struct user_list *ul, struct intern *t, enum casemapping cm, const char *nick_old, const char *nick_new)
 {
 	/* Replace a user by name, maintaining modes */
 
-	struct user *old, *new;
+	const char *nick;
+	struct user *old;
+	struct user *new;
+	uint64_t key;
+	unsigned b;
+	unsigned i;
 
-	old = user_list_get(ul, cm, nick_old, 0);
-	new = user_list_get(ul, cm, nick_new, 0);
+	user_list_merge(ul, cm, NULL, NULL);
 
-	if (old == NULL)
+	if (!user_find(ul, cm, irc_strkey(cm, nick_old, 0), nick_old, 0, &b, &i))
 		return USER_ERR_NOT_FOUND;
 
+	old = ul->blocks[b]->users[i];
+	new = user_list_get(ul, cm, nick_new, 0);
+
 	/* allow nick to change case  */
 	if (new != NULL && irc_strcmp(cm, old->nick, new->nick))
 		return USER_ERR_DUPLICATE;
 
-	new = user(nick_new, old->prfxmodes);
+	user_remove(ul, b, i);
+
+	nick = intern(t, nick_new, strlen(nick_new));
 
-	AVL_DEL(user_list, ul, old, &cm);
-	AVL_ADD(user_list, ul, new, &cm);
+	user_free_nick(old);
 
-	user_free(old);
+	old->nick = nick;
+	old->nick_len = strlen(nick);
+
+	key = irc_strkey(cm, nick, 0);
+
+	user_find(ul, cm, key, nick, 0, &b, &i);
+	user_insert(ul, old, key, b, i);
 
 	return USER_ERR_NONE;
 }
@@ -107,15 +383,201 @@ user_list_rpl(struct user_list *ul, enum casemapping cm, const char *nick_old, c
 struct user*
 user_list_get(struct user_list *ul, enum casemapping cm, const char *nick, size_t prefix_len)
 {
-	struct user u = { .nick = nick };
+	/* Return the user by nick, or the first user in order by nick prefix */
+
+	unsigned b;
+	unsigned i;
+
+	user_list_merge(ul, cm, NULL, NULL);
 
-	return AVL_GET(user_list, ul, &u, &cm, prefix_len);
+	if (!user_find(ul, cm, irc_strkey(cm, nick, prefix_len), nick, prefix_len, &b, &i))
+		return NULL;
+
+	return ul->blocks[b]->users[i];
+}
+
+struct user*
+user_list_next(struct user_list *ul, struct user_iter *it)
+{
+	/* Return the next user in order, or NULL when complete */
+
+	struct user *u;
+
+	if (it->block >= ul->blocks_n || it->i >= ul->blocks[it->block]->n)
+		return NULL;
+
+	u = ul->blocks[it->block]->users[it->i];
+
+	if (it->len && irc_strncmp(it->cm, u->nick, it->prefix, it->len))
+		return NULL;
+
+	if (++it->i == ul->blocks[it->block]->n) {
+		it->block++;
+		it->i = 0;
+	}
+
+	return u;
+}
+
+size_t
+user_list_memory(struct user_list *ul)
+{
+	/* Return the heap memory used by a user list, excluding interned nicks */
+
+	size_t size = sizeof(*ul->staged) * ul->staged_size;
+
+	size += sizeof(*ul->blocks) * ul->blocks_size;
+	size += sizeof(**ul->blocks) * ul->blocks_n;
+
+	for (struct user_slab *slab = ul->slabs; slab; slab = slab->next)
+		size += sizeof(*slab) + sizeof(*slab->users) * slab->size;
+
+	return size;
+}
+
+unsigned
+user_list_merge(struct user_list *ul, enum casemapping cm, void (*dup)(void*, const char*), void *arg)
+{
+	/* Merge staged users into the list, returning the number of duplicates
+	 *
+	 * Staged users are keyed and sorted, then merged in order with the
+	 * list's users, discarding duplicates as they're found, and appended to
+	 * a new set of blocks. Existing users take precedence over staged users,
+	 * and staged users over those staged after them.
+	 *
+	 * Nicks are compared by key, in full only when keys are equal, and each
+	 * staged nick is casemapped once, O(n log n) in the staged users */
+
+	struct user_key *staged;
+	struct user_key *tmp;
+	struct user_key last = {0};
+	struct user_block **blocks = ul->blocks;
+	unsigned blocks_n = ul->blocks_n;
+	unsigned b = 0;
+	unsigned i = 0;
+	unsigned j = 0;
+	unsigned k = 0;
+	unsigned n_staged = ul->staged_n;
+	unsigned n_dups = 0;
+
+	if (n_staged == 0)
+		return 0;
+
+	if ((staged = malloc(sizeof(*staged) * (n_staged + n_staged / 2 + 1))) == NULL)
+		fatal("malloc: %s", strerror(errno));
+
+	tmp = staged + n_staged;
+
+	for (unsigned n = 0; n < n_staged; n++) {
+		staged[n].key = irc_strkey(cm, ul->staged[n]->nick, 0);
+		staged[n].u = ul->staged[n];
+	}
+
+	user_sort(staged, tmp, n_staged, cm);
+
+	ul->blocks = NULL;
+	ul->blocks_n = 0;
+	ul->blocks_size = 0;
+
+	while (b < blocks_n || j < n_staged) {
+
+		struct user_key u;
+
+		if (j == n_staged || (b < blocks_n && user_cmp(cm, blocks[b]->keys[i], blocks[b]->users[i]->nick, staged[j].key, staged[j].u->nick, 0) <= 0)) {
+			u.key = blocks[b]->keys[i];
+			u.u = blocks[b]->users[i];
+			if (++i == blocks[b]->n) {
+				free(blocks[b++]);
+				i = 0;
+			}
+		} else {
+			u = staged[j++];
+		}
+
+		if (last.u && !user_cmp(cm, last.key, last.u->nick, u.key, u.u->nick, 0)) {
+
+			if (dup)
+				(*dup)(arg, u.u->nick);
+
+			user_free(ul, u.u);
+			n_dups++;
+		} else {
+			user_append(ul, u.u, u.key);
+			last = u;
+			k++;
+		}
+	}
+
+	free(staged);
+	free(blocks);
+	free(ul->staged);
+
+	ul->count = k;
+	ul->staged = NULL;
+	ul->staged_n = 0;
+	ul->staged_size = 0;
+
+	return n_dups;
+}
+
+void
+user_list_stage(struct user_list *ul, struct intern *t, const char *nick, struct mode prfxmodes)
+{
+	/* Stage a user to be added in bulk, without lookup */
+
+	if (ul->staged_n == ul->staged_size) {
+
+		ul->staged_size = (ul->staged_size ? ul->staged_size * 2 : 64);
+
+		if ((ul->staged = realloc(ul->staged, sizeof(*ul->staged) * ul->staged_size)) == NULL)
+			fatal("realloc: %s", strerror(errno));
+	}
+
+	ul->staged[ul->staged_n++] = user(ul, t, nick, prfxmodes);
+	ul->count++;
 }
 
 void
 user_list_free(struct user_list *ul)
 {
-	AVL_FOREACH(user_list, ul, user_free);
+	/* Release each user's interned nick, O(n) in the list's users, then
+	 * free the users with their slabs */
+
+	struct user_slab *slab;
+
+	for (unsigned b = 0; b < ul->blocks_n; b++) {
+		for (unsigned i = 0; i < ul->blocks[b]->n; i++)
+			user_free_nick(ul->blocks[b]->users[i]);
+		free(ul->blocks[b]);
+	}
+
+	for (unsigned i = 0; i < ul->staged_n; i++)
+		user_free_nick(ul->staged[i]);
+
+	while ((slab = ul->slabs)) {
+		ul->slabs = slab->next;
+		free(slab);
+	}
+
+	free(ul->blocks);
+	free(ul->staged);
 
 	memset(ul, 0, sizeof(*ul));
 }
+
+void
+user_list_iter(struct user_list *ul, struct user_iter *it, enum casemapping cm, const char *prefix, size_t len)
+{
+	/* Start iterating users in order, from the first user matching prefix */
+
+	user_list_merge(ul, cm, NULL, NULL);
+
+	it->prefix = prefix;
+	it->cm = cm;
+	it->len = len;
+	it->block = 0;
+	it->i = 0;
+
+	if (len && !user_find(ul, cm, irc_strkey(cm, prefix, len), prefix, len, &(it->block), &(it->i)))
+		it->block = ul->blocks_n;
+}
@@ -2,9 +2,13 @@
 #define RIRC_COMPONENTS_USER_H
 
 #include "src/components/mode.h"
-#include "src/utils/tree.h"
+#include "src/utils/intern.h"
 #include "src/utils/utils.h"
 
+/* Users can be staged in bulk, e.g. from RPL_NAMREPLY, and merged into the
+ * list in a single pass once complete. Staged users are counted, and are
+ * merged implicitly before any other list operation */
+
 enum user_err
 {
 	USER_ERR_DUPLICATE = -2,
@@ -12,25 +16,81 @@ enum user_err
 	USER_ERR_NONE
 };
 
+/* Users are allocated from slabs owned by their list, growing from
+ * USER_SLAB_MIN to USER_SLAB_MAX users per slab, and released users are
+ * reused. Nicks are interned, shared with other lists and buffer lines,
+ * so freeing a list visits each user to release its nick */
+#define USER_SLAB_MIN 8
+#define USER_SLAB_MAX 256
+
+/* Users are indexed in order by nick, in blocks of up to USER_BLOCK_MAX.
+ * Lookups are a binary search of the blocks by their last user, then of
+ * the block, comparing keys of each nick's first characters held in the
+ * block, such that nicks are rarely read. Full blocks are split in half,
+ * and sparse blocks are merged with their neighbours. Bulk merged lists
+ * are rebuilt from blocks of USER_BLOCK_FILL users, leaving room for users
+ * to join */
+#define USER_BLOCK_MAX  64
+#define USER_BLOCK_FILL 48
+
 struct user
 {
-	TREE_NODE(user) ul;
-	const char *nick;
+	union {
+		const char *nick;
+		struct user *next; /* Next released user */
+	};
 	size_t nick_len;
 	struct mode prfxmodes;
-	char _[];
+};
+
+struct user_block
+{
+	unsigned n;
+	uint64_t keys[USER_BLOCK_MAX]; /* irc_strkey() of each user's nick */
+	struct user *users[USER_BLOCK_MAX];
+};
+
+struct user_slab
+{
+	struct user_slab *next;
+	unsigned size;
+	struct user users[];
+};
+
+/* Iterates users in order, from the first with a nick prefix of len, or
+ * from the first user when len is 0. Modifying the list ends iteration */
+struct user_iter
+{
+	const char *prefix;
+	enum casemapping cm;
+	size_t len;
+	unsigned block;
+	unsigned i;
 };
 
 struct user_list
 {
-	TREE_HEAD(user);
+	struct user_block **blocks;
+	unsigned blocks_n;
+	unsigned blocks_size;
 	unsigned count;
+	struct user **staged;
+	unsigned staged_n;
+	unsigned staged_size;
+	struct user *released;   /* Released users, linked by next */
+	struct user_slab *slabs; /* Most recent slab first */
+	unsigned slab_n;         /* Users allocated from the most recent slab */
 };
 
-enum user_err user_list_add(struct user_list*, enum casemapping, const char*, struct mode);
+enum user_err user_list_add(struct user_list*, struct intern*, enum casemapping, const char*, struct mode);
 enum user_err user_list_del(struct user_list*, enum casemapping, const char*);
-enum user_err user_list_rpl(struct user_list*, enum casemapping, const char*, const char*);
+enum user_err user_list_rpl(struct user_list*, struct intern*, enum casemapping, const char*, const char*);
 struct user* user_list_get(struct user_list*, enum casemapping, const char*, size_t);
+struct user* user_list_next(struct user_list*, struct user_iter*);
+size_t user_list_memory(struct user_list*);
+unsigned user_list_merge(struct user_list*, enum casemapping, void (*)(void*, const char*), void*);
+void user_list_stage(struct user_list*, struct intern*, const char*, struct mode);
 void user_list_free(struct user_list*);
+void user_list_iter(struct user_list*, struct user_iter*, enum casemapping, const char*, size_t);
 
 #endif
@@ -8,10 +8,14 @@
 #include "src/utils/utils.h"
 
 #include <ctype.h>
+#include <errno.h>
+#include <limits.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 /* Control sequence initiator */
 #define CSI "\x1b["
@@ -24,18 +28,24 @@
 #define BUFFER_PADDING 1
 #endif
 
-#define UTF8_CONT(C) (((unsigned char)(C) & 0xC0) == 0x80)
+#define DRAW_ATTRS_EMPTY { .bg = -1, .fg = -1, .flush = 1 }
 
-#define ATTR_CODE_BOLD      0x02
-#define ATTR_CODE_COLOUR    0x03
-#define ATTR_CODE_ITALIC    0x1D
-#define ATTR_CODE_MONOSPACE 0x11
-#define ATTR_CODE_RESET     0x0F
-#define ATTR_CODE_REVERSE   0x16
-#define ATTR_CODE_STRIKE    0x1E
-#define ATTR_CODE_UNDERLINE 0x1F
+#define DRAW_CELL_BLANK { .glyph = " ", .bg = -1, .fg = -1 }
 
-#define DRAW_ATTRS_EMPTY { .bg = -1, .fg = -1, .flush = 1 }
+#define DRAW_CELL_BOLD      (1 << 0)
+#define DRAW_CELL_ITALIC    (1 << 1)
+#define DRAW_CELL_REVERSE   (1 << 2)
+#define DRAW_CELL_STRIKE    (1 << 3)
+#define DRAW_CELL_UNDERLINE (1 << 4)
+
+/* Right half of a wide glyph drawn in the preceding cell */
+#define DRAW_CELL_TAIL(C) (!(C)->glyph[0])
+
+/* Unknown terminal cursor row or column */
+#define DRAW_CURSOR_UNKNOWN UINT_MAX
+
+/* Append a string literal to the frame output */
+#define DRAW_OUT(S) draw_out((S), sizeof(S) - 1)
 
 /* https://modern.ircdocs.horse/formatting.html#colors
  * https://modern.ircdocs.horse/formatting.html#colors-16-98 */
@@ -85,6 +95,80 @@ struct draw_attrs
 	unsigned flush     : 1;
 };
 
+/* Terminal cell, a single glyph and its attributes */
+struct draw_cell
+{
+	char glyph[8]; /* UTF-8 encoded, NUL padded, including combining code points */
+	short bg;      /* [0, 255], -1: terminal default */
+	short fg;      /* [0, 255], -1: terminal default */
+	unsigned char flags; /* DRAW_CELL_* attributes */
+};
+
+/* In-memory model of the terminal. Components draw into the back buffer
+ * and each frame only the cells differing from the front buffer, i.e. the
+ * cells last written to the terminal, are output. Only rows drawn since
+ * the last frame are compared */
+static struct
+{
+	struct draw_cell *back;
+	struct draw_cell *front;
+	unsigned char *dirty;   /* Rows of the back buffer drawn since the last flush */
+	struct draw_cell *last; /* Last cell drawn, for zero width code points */
+	struct draw_cell pen;   /* Attributes applied to drawn cells */
+	struct draw_cell term;  /* Attributes last set on the terminal */
+	unsigned cols;
+	unsigned rows;
+	unsigned col;        /* Drawing cursor column, from 0 */
+	unsigned row;        /* Drawing cursor row, from 0 */
+	unsigned cursor_col; /* Saved terminal cursor column, from 0 */
+	unsigned cursor_row; /* Saved terminal cursor row, from 0 */
+	unsigned term_col;   /* Terminal cursor column, from 0 */
+	unsigned term_row;   /* Terminal cursor row, from 0 */
+	unsigned scroll_top;  /* Scroll region first row, from 0 */
+	unsigned scroll_bot;  /* Scroll region last row, from 0 */
+	unsigned scroll_rows; /* Rows the back buffer scrolled up within the region */
+	unsigned valid : 1;   /* Front buffer matches the terminal */
+} screen;
+
+/* Buffer state when last drawn */
+static struct
+{
+	struct buffer *b;
+	unsigned head;
+	unsigned pinned : 1; /* Scrollback was at the head line */
+} draw_buffer_last;
+
+/* SGR parameters for setting 256 colours */
+static struct
+{
+	char bg[sizeof("48;5;255")];
+	char fg[sizeof("38;5;255")];
+	unsigned char bg_len;
+	unsigned char fg_len;
+} sgr_colours[256];
+
+/* SGR parameters for setting and resetting cell attributes */
+static const struct
+{
+	unsigned char flag;
+	const char *on;
+	const char *off;
+} sgr_flags[] = {
+	{ DRAW_CELL_BOLD,      "1", "22" },
+	{ DRAW_CELL_ITALIC,    "3", "23" },
+	{ DRAW_CELL_REVERSE,   "7", "27" },
+	{ DRAW_CELL_STRIKE,    "9", "29" },
+	{ DRAW_CELL_UNDERLINE, "4", "24" },
+};
+
+/* Frame output, written to the terminal once per frame */
+static struct
+{
+	char *buf;
+	size_t len;
+	size_t size;
+} frame;
+
 static struct
 {
 	unsigned drawing : 1;
@@ -104,14 +188,17 @@ static struct
 } draw_state;
 
 static struct coords coords(unsigned, unsigned, unsigned, unsigned);
-static unsigned nick_col(char*);
+static unsigned nick_col(const char*);
 static unsigned drawf(struct draw_attrs*, unsigned*, const char*, ...);
 
-static const char* draw_buffer_scrollback_status(struct buffer*, char*, size_t);
+static const char* draw_buffer_scrollback_status(struct buffer*, unsigned, char*, size_t);
 static size_t draw_buffer_wrap(const char*, size_t, size_t);
 static unsigned draw_buffer_line_rows(struct buffer_line*, unsigned);
+static size_t draw_buffer_line_break(const struct buffer_line*, unsigned);
 static void draw_bits(void);
 static void draw_buffer(struct buffer*, struct coords);
+static void draw_buffer_rows(struct buffer*, unsigned);
+static int draw_buffer_line_measured(struct buffer_line*, unsigned);
 static void draw_buffer_line(struct buffer_line*, struct coords, unsigned, unsigned, unsigned, unsigned);
 static void draw_buffer_line_split(struct buffer_line*, unsigned*, unsigned*, unsigned, unsigned);
 static void draw_buffer_scroll_back(void);
@@ -122,25 +209,38 @@ static void draw_separators(void);
 static void draw_status(struct channel*);
 
 static void draw_char(struct draw_attrs*, int);
+static size_t draw_utf8(struct draw_attrs*, const char*, size_t, unsigned*);
 static void draw_clear_full(void);
 static void draw_clear_line(void);
 static void draw_cursor_pos(int, int);
-static void draw_cursor_pos_restore(void);
 static void draw_cursor_pos_save(void);
-static void draw_cursor_hide(void);
-static void draw_cursor_show(void);
-static unsigned draw_parse_irc_colour(const char *code, int *fg, int *bg);
 
-static size_t draw_attr_len(const char *str);
+static int draw_cell_eq(const struct draw_cell*, const struct draw_cell*);
+static int draw_cell_eq_attrs(const struct draw_cell*, const struct draw_cell*);
+static void draw_screen_cursor(unsigned, unsigned);
+static void draw_screen_flush(void);
+static void draw_screen_free(void);
+static void draw_screen_glyph(const char*, size_t, unsigned);
+static void draw_screen_putc(int);
+static void draw_screen_resize(unsigned, unsigned);
+static void draw_screen_scroll(unsigned, unsigned, unsigned);
+static void draw_screen_scroll_region(void);
+static void draw_screen_sgr(const struct draw_cell*);
+static void draw_sgr_init(void);
+static void draw_sgr_param(char*, size_t*, const char*, size_t);
+
+static void draw_out(const char*, size_t);
+static void draw_out_char(char);
+static void draw_out_uint(unsigned);
+static void draw_out_write(void);
+
 static void draw_attrs(struct draw_attrs*, int);
 static void draw_attr_reset(struct draw_attrs*);
+static void draw_attr_run(struct draw_attrs*, const struct buffer_run*, int, int);
 static void draw_attr_set_bg(struct draw_attrs*, int);
 static void draw_attr_set_fg(struct draw_attrs*, int);
-static void draw_attr_toggle_bold(struct draw_attrs*);
-static void draw_attr_toggle_italic(struct draw_attrs*);
-static void draw_attr_toggle_reverse(struct draw_attrs*);
-static void draw_attr_toggle_strike(struct draw_attrs*);
-static void draw_attr_toggle_underline(struct draw_attrs*);
+
+static struct draw_stats frame_stats;
 
 static int actv_colours[ACTIVITY_T_SIZE] = ACTIVITY_COLOURS
 static int nick_colours[] = NICK_COLOURS
@@ -155,7 +255,20 @@ void
 draw_term(void)
 {
 	draw_state.drawing = 0;
-	draw_clear_full();
+	draw_screen_free();
+
+	DRAW_OUT(CSI "0m" CSI "2J");
+	draw_out_write();
+
+	free(frame.buf);
+
+	memset(&frame, 0, sizeof(frame));
+}
+
+const struct draw_stats*
+draw_stats(void)
+{
+	return &frame_stats;
 }
 
 void
@@ -203,26 +316,34 @@ draw(enum draw_bit bit)
 static void
 draw_bits(void)
 {
+	struct timespec t1;
+	struct timespec t2;
+
 	if (!draw_state.drawing)
 		return;
 
+	(void) clock_gettime(CLOCK_MONOTONIC, &t1);
+
 	if (draw_state.bell && BELL_ON_PINGED)
-		putchar('\a');
+		draw_out_char('\a');
 
 	if (!draw_state.bits.all)
-		return;
+		goto write;
 
 	struct channel *c = current_channel();
 
 	unsigned cols = state_cols();
 	unsigned rows = state_rows();
 
-	draw_cursor_hide();
-	draw_cursor_pos_save();
+	if (cols != screen.cols || rows != screen.rows) {
+		draw_screen_resize(cols, rows);
+		draw_state.bits.all = -1;
+	}
 
 	if (cols < COLS_MIN || rows < ROWS_MIN) {
 		draw_clear_full();
 		draw_cursor_pos(1, 1);
+		draw_cursor_pos_save();
 		goto flush;
 	}
 
@@ -253,19 +374,29 @@ draw_bits(void)
 
 flush:
 
-	draw_cursor_pos_restore();
-	draw_cursor_show();
+	draw_screen_flush();
+
+write:
 
-	fflush(stdout);
+	if (frame.len) {
+		frame_stats.frames++;
+		frame_stats.bytes += frame.len;
+	}
+
+	draw_out_write();
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &t2);
+
+	frame_stats.ns += (t2.tv_sec - t1.tv_sec) * 1000000000ULL + t2.tv_nsec - t1.tv_nsec;
 }
 
 static const char*
-draw_buffer_scrollback_status(struct buffer *b, char *buf, size_t n)
+draw_buffer_scrollback_status(struct buffer *b, unsigned cols, char *buf, size_t n)
 {
 	/* Format scrollback status to buffer as unsigned value [0, 100]
 	 *
-	 * Calculated as perentage of lines 'below' the currently drawn buffer
-	 * lines over the total of currently undrawn buffer lines, i.e.:
+	 * Calculated as perentage of rows 'below' the currently drawn buffer
+	 * lines over the total of currently undrawn buffer rows, i.e.:
 	 *
 	 *  tail  +----------+
 	 *        |    n2    |
@@ -278,11 +409,13 @@ draw_buffer_scrollback_status(struct buffer *b, char *buf, size_t n)
 	 *  head  +----------+
 	 */
 
-	if (buffer_line(b, b->scrollback) == buffer_head(b))
+	if (buffer_size(b) == 0 || b->scrollback == b->head - 1)
 		return NULL;
 
-	float n1 = (b->head - b->buffer_i_bot) - 1;
-	float n2 = (b->buffer_i_top - b->tail);
+	draw_buffer_rows(b, cols);
+
+	float n1 = buffer_rows(b, b->buffer_i_bot + 1, b->head);
+	float n2 = buffer_rows(b, b->tail, b->buffer_i_top);
 
 	if (!n1 && !n2)
 		return NULL;
@@ -295,80 +428,122 @@ draw_buffer_scrollback_status(struct buffer *b, char *buf, size_t n)
 static size_t
 draw_buffer_wrap(const char *str, size_t len, size_t cols)
 {
+	/* Return the offset to wrap unformatted text within `cols` columns */
+
 	size_t i = 0;
-	size_t ret;
+	size_t n;
 	size_t w = 0;
+	uint32_t cp;
+	unsigned width;
 
 	if (!cols)
 		return 0;
 
+	/* No code point is wider than its encoding */
 	if (len <= cols)
 		return len;
 
-	while ((ret = draw_attr_len((str + i))))
-		i += ret;
-
-	while (cols && str[i]) {
+	while (cols && i < len && str[i]) {
 
 		if (str[i] == ' ') {
-			while (cols && str[i]) {
-				if ((ret = draw_attr_len((str + i))))
-					i += ret;
-				else if (str[i] == ' ')
-					i++, cols--;
-				else if (str[i] != ' ')
-					break;
-			}
+			while (cols && i < len && str[i] == ' ')
+				i++, cols--;
 		} else {
-			while (cols && str[i]) {
-				if ((ret = draw_attr_len((str + i))))
-					i += ret;
-				else if (str[i] != ' ')
-					i++, cols--;
-				else if (str[i] == ' ')
+			while (i < len && str[i] && str[i] != ' ') {
+
+				n = utf8_decode(str + i, len - i, &cp, &width);
+
+				/* Wide code points are consumed when alone on a row */
+				if (width > cols && i) {
+					cols = 0;
 					break;
+				}
+
+				if (width > cols)
+					width = cols;
+
+				cols -= width;
+				i += n;
 			}
 		}
 
-		if (cols && str[i] && str[i] != ' ')
+		if (cols && i < len && str[i] && str[i] != ' ')
 			w = i;
 	}
 
-	return ((str[i] && w) ? w : i);
+	return ((i < len && str[i] && w) ? w : i);
 }
 
 static unsigned
 draw_buffer_line_rows(struct buffer_line *line, unsigned cols)
 {
-	/* Return the number of times a buffer line will wrap within `cols` columns */
+	/* Return the number of times a buffer line will wrap within `cols` columns,
+	 * caching the offset of each row's break for drawing. Breaks are only
+	 * recomputed when a line is measured on a different width */
 
 	if (cols == 0)
 		fatal("cols is zero");
 
 	/* Empty lines are considered to occupy a row */
-	if (!*line->text)
+	if (!line->text_len)
 		return line->cached.rows = 1;
 
-	if (line->cached.cols != cols) {
+	if (buffer_line_width(line) <= cols) {
+
+		free(line->cached.breaks);
 
+		line->cached.breaks = NULL;
 		line->cached.cols = cols;
-		line->cached.rows = 0;
 
+		return line->cached.rows = 1;
+	}
+
+	/* Breaks of compacted lines are released, and found again when drawn */
+	if (line->cached.cols != cols || (line->cached.rows > 1 && !line->cached.breaks && line->text)) {
+
+		uint16_t breaks[TEXT_LENGTH_MAX];
 		const char *p = line->text;
 		size_t len = line->text_len;
 		size_t ret;
 
+		free(line->cached.breaks);
+
+		line->cached.breaks = NULL;
+		line->cached.cols = cols;
+		line->cached.rows = 0;
+
 		while (len) {
 			ret = draw_buffer_wrap(p, len, cols);
 			len -= ret;
 			p += ret;
-			line->cached.rows++;
+			breaks[line->cached.rows++] = (uint16_t)(p - line->text);
+		}
+
+		if (line->cached.rows > 1) {
+
+			size_t size = sizeof(*breaks) * line->cached.rows;
+
+			if ((line->cached.breaks = malloc(size)) == NULL)
+				fatal("malloc: %s", strerror(errno));
+
+			memcpy(line->cached.breaks, breaks, size);
 		}
 	}
 
 	return line->cached.rows;
 }
 
+static size_t
+draw_buffer_line_break(const struct buffer_line *line, unsigned row)
+{
+	/* Return the offset in a line's text where wrapped `row` ends */
+
+	if (!line->cached.breaks)
+		return line->text_len;
+
+	return line->cached.breaks[row];
+}
+
 static void
 draw_buffer(struct buffer *b, struct coords coords)
 {
@@ -415,6 +590,29 @@ draw_buffer(struct buffer *b, struct coords coords)
 	unsigned row_total = coords.rN - coords.r1 + 1;
 	struct buffer_line *line;
 
+	/* Lines appended while pinned to the head scroll the drawn lines up */
+	if (b == draw_buffer_last.b
+	 && b->scrollback == b->head - 1
+	 && draw_buffer_last.pinned
+	 && (b->head - draw_buffer_last.head) < row_total) {
+
+		unsigned scroll = 0;
+
+		for (buffer_i = draw_buffer_last.head; buffer_i != b->head && scroll < row_total; buffer_i++) {
+			line = buffer_line(b, buffer_i);
+			draw_buffer_line_split(line, NULL, &cols_text, cols_total, b->pad);
+			scroll += draw_buffer_line_rows(line, cols_text);
+		}
+
+		draw_screen_scroll(coords.r1, coords.rN, scroll);
+
+		buffer_i = b->scrollback;
+	}
+
+	draw_buffer_last.b = b;
+	draw_buffer_last.head = b->head;
+	draw_buffer_last.pinned = (b->scrollback == b->head - 1);
+
 	/* empty buffer */
 	if (!(line = buffer_line(b, buffer_i)))
 		goto clear;
@@ -483,6 +681,56 @@ clear:
 	}
 }
 
+static void
+draw_buffer_rows(struct buffer *b, unsigned cols)
+{
+	/* Sum the rows of lines not yet measured on `cols` columns. Rows are
+	 * only summed on demand, e.g. when scrolled back, and all lines are
+	 * measured again after a resize or change of padding */
+
+	struct buffer_line *line;
+	unsigned cols_text;
+	unsigned thawed = b->thawed;
+
+	if (!b->rows.tree || b->rows.cols != cols || b->rows.pad != b->pad)
+		buffer_rows_reset(b, cols);
+
+	if ((b->rows.synced - b->tail) > buffer_size(b))
+		b->rows.synced = b->tail;
+
+	for (; b->rows.synced != b->head; b->rows.synced++) {
+
+		line = buffer_line_peek(b, b->rows.synced);
+
+		draw_buffer_line_split(line, NULL, &cols_text, cols, b->pad);
+
+		/* Cold text is only needed to wrap lines not yet wrapped on `cols_text` */
+		if (!line->text && !draw_buffer_line_measured(line, cols_text))
+			line = buffer_line(b, b->rows.synced);
+
+		buffer_rows_set(b, b->rows.synced, draw_buffer_line_rows(line, cols_text));
+	}
+
+	/* Freeze cold blocks thawed only to be measured */
+	if (b->thawed > thawed)
+		buffer_cold_freeze(b);
+}
+
+static int
+draw_buffer_line_measured(struct buffer_line *line, unsigned cols)
+{
+	/* Return non-zero if the rows a line occupies within `cols` columns
+	 * are known from its cached width and wraps, without its text */
+
+	if (!line->text_len)
+		return 1;
+
+	if (!line->cached.width)
+		return 0;
+
+	return (line->cached.width <= cols || line->cached.cols == cols);
+}
+
 static void
 draw_buffer_line(
 		struct buffer_line *line,
@@ -492,7 +740,6 @@ draw_buffer_line(
 		unsigned skip,
 		unsigned pad)
 {
-	const char *p = line->text;
 	unsigned head_col = coords.c1;
 	unsigned text_bg;
 	unsigned text_col = coords.c1 + cols_head;
@@ -575,84 +822,54 @@ print_text:
 		}
 	}
 
+	const struct buffer_run *run = line->runs;
+	const struct buffer_run *run_end = line->runs + line->runs_len;
 	struct draw_attrs attrs = DRAW_ATTRS_EMPTY;
+	unsigned row = skip;
+	unsigned rows = draw_buffer_line_rows(line, cols_text);
+	size_t i = (row ? draw_buffer_line_break(line, row - 1) : 0);
 
 	draw_attr_set_bg(&attrs, text_bg);
 	draw_attr_set_fg(&attrs, text_fg);
+
+	/* Seek to the run containing the first drawn row */
+	while (run != run_end && i >= (size_t)(run->offset + run->len))
+		run++;
+
+	if (run != run_end && i > run->offset)
+		draw_attr_run(&attrs, run++, text_bg, text_fg);
+
 	draw_attrs(&attrs, 0);
 
-	while (coords.r1 <= coords.rN) {
+	for (; row < rows && coords.r1 <= coords.rN; row++, coords.r1++) {
+
+		size_t end = draw_buffer_line_break(line, row);
 
 		draw_cursor_pos(coords.r1, text_col);
 
-		if (p != line->text) {
+		if (row) {
 			draw_clear_line();
 			draw_attrs(&attrs, 1);
 		}
 
-		if (*p) {
-
-			size_t n = draw_buffer_wrap(p, strlen(p), cols_text);
+		unsigned cols = cols_text;
 
-			while (n) {
+		while (i < end) {
 
-				size_t attr_len;
+			size_t n;
 
-				if ((attr_len = draw_attr_len(p))) {
+			while (run != run_end && i >= run->offset)
+				draw_attr_run(&attrs, run++, text_bg, text_fg);
 
-					int bg = -1;
-					int fg = -1;
+			draw_attrs(&attrs, 0);
 
-					switch (*p) {
-						case ATTR_CODE_BOLD:
-							draw_attr_toggle_bold(&attrs);
-							break;
-						case ATTR_CODE_COLOUR:
-							draw_parse_irc_colour(p, &fg, &bg);
-							if (bg > 0)
-								draw_attr_set_bg(&attrs, bg);
-							if (fg > 0)
-								draw_attr_set_fg(&attrs, fg);
-							if (bg == -1 && fg == -1) {
-								draw_attr_set_bg(&attrs, text_bg);
-								draw_attr_set_fg(&attrs, text_fg);
-							}
-							break;
-						case ATTR_CODE_ITALIC:
-							draw_attr_toggle_italic(&attrs);
-							break;
-						case ATTR_CODE_RESET:
-							draw_attr_reset(&attrs);
-							draw_attr_set_bg(&attrs, text_bg);
-							draw_attr_set_fg(&attrs, text_fg);
-							break;
-						case ATTR_CODE_REVERSE:
-							draw_attr_toggle_reverse(&attrs);
-							break;
-						case ATTR_CODE_STRIKE:
-							draw_attr_toggle_strike(&attrs);
-							break;
-						case ATTR_CODE_UNDERLINE:
-							draw_attr_toggle_underline(&attrs);
-							break;
-						default:
-							break;
-					}
-				} else {
-					draw_attrs(&attrs, 0);
-					if (!skip)
-						draw_char(&attrs, *p);
-				}
+			if (!(n = draw_utf8(&attrs, line->text + i, end - i, &cols)))
+				break;
 
-				n -= (attr_len ? attr_len : 1);
-				p += (attr_len ? attr_len : 1);
-			}
+			i += n;
 		}
 
-		if (skip)
-			skip--;
-		else
-			coords.r1++;
+		i = end;
 	}
 
 	draw_attr_reset(NULL);
@@ -693,35 +910,28 @@ draw_buffer_scroll_back(void)
 
 	struct buffer *b = &(current_channel()->buffer);
 
-	unsigned count = 0;
-	unsigned cols_text = 0;
-	unsigned cols = state_cols();
 	unsigned rows = state_rows() - 4;
-
-	struct buffer_line *line = buffer_line(b, b->scrollback);
+	unsigned rows_top;
+	unsigned rows_bot;
 
 	/* Skip redraw */
-	if (line == buffer_tail(b))
+	if (b->scrollback == b->tail)
 		return;
 
-	/* Find top line */
-	for (;;) {
-
-		draw_buffer_line_split(line, NULL, &cols_text, cols, b->pad);
+	draw_buffer_rows(b, state_cols());
 
-		count += draw_buffer_line_rows(line, cols_text);
-
-		if (line == buffer_tail(b))
-			break;
+	/* Find top line, drawn at least partially */
+	if ((rows_bot = buffer_rows(b, b->tail, b->scrollback + 1)) <= rows) {
+		b->scrollback = b->tail;
+		return;
+	}
 
-		if (count >= rows)
-			break;
+	b->scrollback = buffer_rows_find(b, rows_bot - rows);
 
-		line = buffer_line(b, --b->scrollback);
-	}
+	rows_top = buffer_rows(b, b->tail, b->scrollback);
 
 	/* Top line in view draws in full; scroll forward one additional line */
-	if (count == rows && line != buffer_tail(b))
+	if (rows_bot - rows_top == rows && b->scrollback != b->tail)
 		b->scrollback--;
 }
 
@@ -732,38 +942,25 @@ draw_buffer_scroll_forw(void)
 
 	struct buffer *b = &(current_channel()->buffer);
 
-	unsigned count = 0;
-	unsigned cols_text = 0;
-	unsigned cols = state_cols();
 	unsigned rows = state_rows() - 4;
+	unsigned rows_top;
 
 	if (b->buffer_i_top == b->tail && b->buffer_i_bot != (b->head - 1))
 		b->scrollback = b->buffer_i_bot;
 
-	struct buffer_line *line = buffer_line(b, b->scrollback);
-
 	/* Skip redraw */
-	if (line == buffer_head(b))
+	if (buffer_size(b) == 0 || b->scrollback == b->head - 1)
 		return;
 
-	/* Find top line */
-	for (;;) {
-
-		draw_buffer_line_split(line, NULL, &cols_text, cols, b->pad);
-
-		count += draw_buffer_line_rows(line, cols_text);
-
-		if (line == buffer_head(b))
-			break;
+	draw_buffer_rows(b, state_cols());
 
-		if (count >= rows)
-			break;
+	/* Find bottom line, drawn at least partially */
+	rows_top = buffer_rows(b, b->tail, b->scrollback);
 
-		line = buffer_line(b, ++b->scrollback);
-	}
+	b->scrollback = buffer_rows_find(b, rows_top + rows - 1);
 
 	/* Bottom line in view draws in full; scroll forward one additional line */
-	if (count == rows && line != buffer_head(b))
+	if (buffer_rows(b, b->tail, b->scrollback + 1) == rows_top + rows && b->scrollback != b->head - 1)
 		b->scrollback++;
 }
 
@@ -1041,7 +1238,7 @@ draw_status(struct channel *c)
 	}
 
 	/* -(scrollback) */
-	if ((draw_buffer_scrollback_status(&c->buffer, scrollback, sizeof(scrollback)))) {
+	if ((draw_buffer_scrollback_status(&c->buffer, state_cols(), scrollback, sizeof(scrollback)))) {
 		if (!drawf(&attrs, &cols, STATUS_SEP_HORZ))
 			return;
 		if (!drawf(&attrs, &cols, "(%s%s)", scrollback, "%"))
@@ -1073,7 +1270,7 @@ coords(unsigned c1, unsigned cN, unsigned r1, unsigned rN)
 }
 
 static unsigned
-nick_col(char *nick)
+nick_col(const char *nick)
 {
 	unsigned colour = 0;
 
@@ -1122,30 +1319,32 @@ drawf(struct draw_attrs *attrs, unsigned *cols_p, const char *fmt, ...)
 				case 'd':
 					draw_attrs(attrs, 0);
 					(void) snprintf(buf, sizeof(buf), "%d", va_arg(arg, int));
-					cols -= (unsigned) printf("%.*s", cols, buf);
+					for (const char *str = buf; *str && cols; cols--)
+						draw_char(attrs, *str++);
 					break;
 				case 'u':
 					draw_attrs(attrs, 0);
 					(void) snprintf(buf, sizeof(buf), "%u", va_arg(arg, unsigned));
-					cols -= (unsigned) printf("%.*s", cols, buf);
+					for (const char *str = buf; *str && cols; cols--)
+						draw_char(attrs, *str++);
 					break;
 				case 's':
 					draw_attrs(attrs, 0);
-					for (const char *str = va_arg(arg, const char*); *str && cols; cols--) {
-						do {
-							draw_char(attrs, *str++);
-						} while (UTF8_CONT(*str));
+					for (const char *str = va_arg(arg, const char*); *str && cols; ) {
+						size_t n;
+						if (!(n = draw_utf8(attrs, str, strnlen(str, 4), &cols)))
+							break;
+						str += n;
 					}
 					break;
 				default:
 					fatal("unknown drawf format character '%c'", c);
 			}
 		} else {
+			size_t n;
 			draw_attrs(attrs, 0);
-			cols--;
-			draw_char(attrs, c);
-			while (UTF8_CONT(*fmt))
-				draw_char(attrs, *fmt++);
+			if ((n = draw_utf8(attrs, fmt - 1, strnlen(fmt - 1, 4), &cols)))
+				fmt += n - 1;
 		}
 	}
 
@@ -1157,17 +1356,30 @@ drawf(struct draw_attrs *attrs, unsigned *cols_p, const char *fmt, ...)
 static void
 draw_clear_full(void)
 {
+	struct draw_cell blank = DRAW_CELL_BLANK;
+
 	draw_attrs(&((struct draw_attrs) DRAW_ATTRS_EMPTY), 1);
 
-	printf(CSI "2J");
+	for (unsigned i = 0; i < screen.rows * screen.cols; i++)
+		screen.back[i] = blank;
+
+	memset(screen.dirty, 1, screen.rows);
 }
 
 static void
 draw_clear_line(void)
 {
+	struct draw_cell blank = DRAW_CELL_BLANK;
+
 	draw_attrs(&((struct draw_attrs) DRAW_ATTRS_EMPTY), 1);
 
-	printf(CSI "2K");
+	if (screen.row >= screen.rows)
+		return;
+
+	for (unsigned i = 0; i < screen.cols; i++)
+		screen.back[screen.row * screen.cols + i] = blank;
+
+	screen.dirty[screen.row] = 1;
 }
 
 static void
@@ -1178,206 +1390,639 @@ draw_char(struct draw_attrs *attrs, int c)
 		draw_attr_set_bg(&attrs_cntrl, CNTRL_BG);
 		draw_attr_set_fg(&attrs_cntrl, CNTRL_FG);
 		draw_attrs(&attrs_cntrl, 0);
-		putchar((c | 0x40));
+		draw_screen_putc((c | 0x40));
 		draw_attrs(attrs, 1);
 	} else {
-		putchar(c);
+		draw_screen_putc(c);
 	}
 }
 
-static void
-draw_cursor_pos(int row, int col)
+static size_t
+draw_utf8(struct draw_attrs *attrs, const char *str, size_t len, unsigned *cols)
 {
-	printf(CSI "%d;%dH", row, col);
+	/* Draw the code point at `str` within `cols` columns, returning the number
+	 * of bytes drawn. Code points too wide for the remaining columns aren't
+	 * drawn, and the columns are filled */
+
+	size_t n;
+	uint32_t cp;
+	unsigned width;
+
+	if (!(n = utf8_decode(str, len, &cp, &width)))
+		return 0;
+
+	if (width > *cols) {
+		while (*cols) {
+			draw_char(attrs, ' ');
+			(*cols)--;
+		}
+		return 0;
+	}
+
+	*cols -= width;
+
+	if (cp < 0x80)
+		draw_char(attrs, (int) cp);
+	else if (cp == 0xFFFD && n == 1)
+		draw_screen_glyph("\xef\xbf\xbd", 3, width);
+	else
+		draw_screen_glyph(str, n, width);
+
+	return n;
 }
 
 static void
-draw_cursor_pos_restore(void)
+draw_cursor_pos(int row, int col)
 {
-	printf(CSI "u");
+	screen.row = row - 1;
+	screen.col = col - 1;
+	screen.last = NULL;
 }
 
 static void
 draw_cursor_pos_save(void)
 {
-	printf(CSI "s");
+	screen.cursor_row = screen.row;
+	screen.cursor_col = screen.col;
 }
 
-static void
-draw_cursor_hide(void)
+static int
+draw_cell_eq(const struct draw_cell *c1, const struct draw_cell *c2)
 {
-	printf(CSI "?25l");
+	return !memcmp(c1->glyph, c2->glyph, sizeof(c1->glyph)) && draw_cell_eq_attrs(c1, c2);
 }
 
-static void
-draw_cursor_show(void)
+static int
+draw_cell_eq_attrs(const struct draw_cell *c1, const struct draw_cell *c2)
 {
-	printf(CSI "?25h");
+	return c1->bg == c2->bg && c1->fg == c2->fg && c1->flags == c2->flags;
 }
 
-static unsigned
-draw_parse_irc_colour(const char *code, int *fg, int *bg)
+static void
+draw_screen_cursor(unsigned row, unsigned col)
 {
-	char c;
-	int comma = 0;
-	int digits_bg = 0;
-	int digits_fg = 0;
-	int parsed_fg = 0;
-	int parsed_bg = 0;
+	/* Move the terminal cursor, preferring the shortest sequence */
 
-	if (*code++ != 0x03)
-		return 0;
+	if (screen.term_row == row && screen.term_col == col)
+		return;
 
-	while ((c = *code++)) {
+	if (screen.term_row == row && screen.term_col != DRAW_CURSOR_UNKNOWN && screen.term_col < col) {
 
-		if (isdigit(c)) {
-			if (comma) {
-				if (digits_bg >= 2)
-					break;
-				digits_bg++;
-				parsed_bg *= 10;
-				parsed_bg += (c - '0');
-			} else {
-				if (digits_fg >= 2)
+		unsigned n = col - screen.term_col;
+		struct draw_cell *cells = screen.front + (row * screen.cols) + screen.term_col;
+
+		/* Rewrite a short run of unchanged ASCII cells rather than move over them */
+		if (n < 4) {
+
+			unsigned i;
+
+			for (i = 0; i < n; i++) {
+				if (!draw_cell_eq_attrs(&cells[i], &screen.term) || !cells[i].glyph[0] || cells[i].glyph[1])
 					break;
-				digits_fg++;
-				parsed_fg *= 10;
-				parsed_fg += (c - '0');
 			}
-		} else if (c == ',') {
-			if (comma++)
+
+			if (i == n) {
+				for (i = 0; i < n; i++)
+					draw_out_char(cells[i].glyph[0]);
+
+				screen.term_col = col;
+				return;
+			}
+		}
+
+		DRAW_OUT(CSI);
+		draw_out_uint(n);
+		draw_out_char('C');
+	} else {
+		DRAW_OUT(CSI);
+		draw_out_uint(row + 1);
+		draw_out_char(';');
+		draw_out_uint(col + 1);
+		draw_out_char('H');
+	}
+
+	screen.term_row = row;
+	screen.term_col = col;
+}
+
+static void
+draw_screen_flush(void)
+{
+	/* Write the damaged cells of the back buffer to the terminal,
+	 * as a single synchronized update */
+
+	struct draw_cell blank = DRAW_CELL_BLANK;
+
+	DRAW_OUT(CSI "?2026h" CSI "?25l");
+
+	if (!screen.valid) {
+
+		DRAW_OUT(CSI "0m" CSI "2J");
+
+		for (unsigned i = 0; i < screen.rows * screen.cols; i++)
+			screen.front[i] = blank;
+
+		screen.term = blank;
+		screen.term_row = DRAW_CURSOR_UNKNOWN;
+		screen.term_col = DRAW_CURSOR_UNKNOWN;
+		screen.scroll_rows = 0;
+		screen.valid = 1;
+
+		memset(screen.dirty, 1, screen.rows);
+	}
+
+	if (screen.scroll_rows)
+		draw_screen_scroll_region();
+
+	for (unsigned row = 0; row < screen.rows; row++) {
+
+		struct draw_cell *back = screen.back + (row * screen.cols);
+		struct draw_cell *front = screen.front + (row * screen.cols);
+		unsigned blank_col = screen.cols;
+		unsigned wide = 0;
+		unsigned damaged = 0;
+
+		/* Rows not drawn since the last flush match the terminal */
+		if (!screen.dirty[row])
+			continue;
+
+		screen.dirty[row] = 0;
+
+		/* Trailing blank cells can be cleared to the end of line */
+		while (blank_col && draw_cell_eq(&back[blank_col - 1], &blank))
+			blank_col--;
+
+		/* Rows with wide glyphs are drawn contiguously from the first damaged
+		 * cell, since terminals blank a wide glyph when either half is drawn */
+		for (unsigned col = 0; col < screen.cols && !wide; col++)
+			wide = (DRAW_CELL_TAIL(&back[col]) || DRAW_CELL_TAIL(&front[col]));
+
+		for (unsigned col = 0; col < screen.cols; col++) {
+
+			if (!damaged && draw_cell_eq(&back[col], &front[col]))
+				continue;
+
+			if (DRAW_CELL_TAIL(&back[col]) && col)
+				col--;
+
+			damaged = wide;
+
+			draw_screen_cursor(row, col);
+
+			if (col >= blank_col) {
+				draw_screen_sgr(&blank);
+				DRAW_OUT(CSI "K");
+
+				for (; col < screen.cols; col++)
+					front[col] = blank;
+
 				break;
-		} else {
-			break;
+			}
+
+			draw_screen_sgr(&back[col]);
+
+			draw_out(back[col].glyph, strnlen(back[col].glyph, sizeof(back[col].glyph)));
+
+			front[col] = back[col];
+
+			if (col + 1 < screen.cols && DRAW_CELL_TAIL(&back[col + 1])) {
+				front[col + 1] = back[col + 1];
+				screen.term_col++;
+				col++;
+			}
+
+			/* Column at the edge is unknown */
+			if (col + 1 == screen.cols)
+				screen.term_col = DRAW_CURSOR_UNKNOWN;
+			else
+				screen.term_col++;
+		}
+	}
+
+	draw_screen_cursor(screen.cursor_row, screen.cursor_col);
+
+	DRAW_OUT(CSI "?25h" CSI "?2026l");
+}
+
+static void
+draw_screen_free(void)
+{
+	free(screen.back);
+	free(screen.front);
+	free(screen.dirty);
+
+	memset(&screen, 0, sizeof(screen));
+}
+
+static void
+draw_screen_glyph(const char *str, size_t len, unsigned width)
+{
+	/* Draw a UTF-8 encoded glyph at the drawing cursor. Zero width code
+	 * points are combined with the last drawn glyph, wide glyphs occupy
+	 * the following cell */
+
+	struct draw_cell *cells;
+	struct draw_cell blank = DRAW_CELL_BLANK;
+
+	if (!width) {
+
+		size_t n;
+
+		if (screen.last && (n = strnlen(screen.last->glyph, sizeof(screen.last->glyph))) + len <= sizeof(screen.last->glyph)) {
+			memcpy(screen.last->glyph + n, str, len);
+			screen.dirty[(size_t)(screen.last - screen.back) / screen.cols] = 1;
 		}
+
+		return;
+	}
+
+	if (screen.row >= screen.rows || screen.col + width > screen.cols || len > sizeof(blank.glyph)) {
+		screen.last = NULL;
+		screen.col += width;
+		return;
 	}
 
-	if (fg && !digits_fg && !digits_bg)
-		*fg = -1;
+	cells = screen.back + (screen.row * screen.cols);
+
+	/* Overwriting either half of a wide glyph blanks the other half */
+	if (DRAW_CELL_TAIL(&cells[screen.col]) && screen.col)
+		cells[screen.col - 1] = blank;
 
-	if (bg && !digits_fg && !digits_bg)
-		*bg = -1;
+	if (screen.col + width < screen.cols && DRAW_CELL_TAIL(&cells[screen.col + width]))
+		cells[screen.col + width] = blank;
 
-	if (fg && digits_fg)
-		*fg = irc_to_ansi_colour[parsed_fg];
+	screen.last = &cells[screen.col];
+	screen.dirty[screen.row] = 1;
 
-	if (bg && digits_bg)
-		*bg = irc_to_ansi_colour[parsed_bg];
+	*screen.last = screen.pen;
+
+	memset(screen.last->glyph, 0, sizeof(screen.last->glyph));
+	memcpy(screen.last->glyph, str, len);
+
+	if (width == 2) {
+		cells[screen.col + 1] = screen.pen;
+		memset(cells[screen.col + 1].glyph, 0, sizeof(cells[screen.col + 1].glyph));
+	}
 
-	return (1 + digits_fg + digits_bg + (comma && digits_bg));
+	screen.col += width;
 }
 
-static size_t
-draw_attr_len(const char *str)
+static void
+draw_screen_putc(int c)
 {
-	switch (*str) {
-		case ATTR_CODE_COLOUR:
-			return draw_parse_irc_colour(str, NULL, NULL);
-		case ATTR_CODE_BOLD:
-		case ATTR_CODE_ITALIC:
-		case ATTR_CODE_MONOSPACE:
-		case ATTR_CODE_RESET:
-		case ATTR_CODE_REVERSE:
-		case ATTR_CODE_STRIKE:
-		case ATTR_CODE_UNDERLINE:
-			return 1;
-		default:
-			return 0;
+	/* Draw a single byte glyph at the drawing cursor */
+
+	char glyph = (char) c;
+
+	draw_screen_glyph(&glyph, 1, 1);
+}
+
+static void
+draw_screen_resize(unsigned cols, unsigned rows)
+{
+	/* Reallocate the back and front buffers, the next
+	 * flush clears and redraws the full terminal */
+
+	struct draw_cell blank = DRAW_CELL_BLANK;
+
+	draw_screen_free();
+
+	if ((screen.back = calloc(MAX(cols * rows, 1), sizeof(*screen.back))) == NULL)
+		fatal("calloc: %s", strerror(errno));
+
+	if ((screen.front = calloc(MAX(cols * rows, 1), sizeof(*screen.front))) == NULL)
+		fatal("calloc: %s", strerror(errno));
+
+	if ((screen.dirty = calloc(MAX(rows, 1), sizeof(*screen.dirty))) == NULL)
+		fatal("calloc: %s", strerror(errno));
+
+	for (unsigned i = 0; i < cols * rows; i++)
+		screen.back[i] = blank;
+
+	screen.cols = cols;
+	screen.rows = rows;
+	screen.pen = blank;
+}
+
+static void
+draw_screen_scroll(unsigned r1, unsigned rN, unsigned rows)
+{
+	/* Hint that rows [r1, rN] of the back buffer were scrolled up */
+
+	screen.scroll_top = r1 - 1;
+	screen.scroll_bot = rN - 1;
+	screen.scroll_rows = rows;
+}
+
+static void
+draw_screen_scroll_region(void)
+{
+	/* Scroll the terminal within a region when the back buffer is the front
+	 * buffer scrolled, such that only the rows scrolled into view are drawn */
+
+	struct draw_cell blank = DRAW_CELL_BLANK;
+	unsigned bot = screen.scroll_bot;
+	unsigned top = screen.scroll_top;
+	unsigned rows = screen.scroll_rows;
+	unsigned row;
+
+	screen.scroll_rows = 0;
+
+	if (bot >= screen.rows || top + rows > bot)
+		return;
+
+	for (row = top; row + rows <= bot; row++) {
+
+		struct draw_cell *back = screen.back + (row * screen.cols);
+		struct draw_cell *front = screen.front + ((row + rows) * screen.cols);
+
+		for (unsigned col = 0; col < screen.cols; col++) {
+			if (!draw_cell_eq(&back[col], &front[col]))
+				return;
+		}
+	}
+
+	/* Rows scrolled in are cleared with the current background colour */
+	draw_screen_sgr(&blank);
+
+	DRAW_OUT(CSI);
+	draw_out_uint(top + 1);
+	draw_out_char(';');
+	draw_out_uint(bot + 1);
+	draw_out_char('r');
+
+	DRAW_OUT(CSI);
+	draw_out_uint(bot + 1);
+	DRAW_OUT(";1H");
+
+	for (row = 0; row < rows; row++)
+		draw_out_char('\n');
+
+	DRAW_OUT(CSI "r");
+
+	memmove(
+		screen.front + (top * screen.cols),
+		screen.front + ((top + rows) * screen.cols),
+		sizeof(*screen.front) * screen.cols * (bot - top + 1 - rows));
+
+	for (row = bot + 1 - rows; row <= bot; row++) {
+		for (unsigned col = 0; col < screen.cols; col++)
+			screen.front[(row * screen.cols) + col] = blank;
+		screen.dirty[row] = 1;
 	}
+
+	screen.term_row = DRAW_CURSOR_UNKNOWN;
+	screen.term_col = DRAW_CURSOR_UNKNOWN;
 }
 
 static void
-draw_attrs(struct draw_attrs *draw_attrs, int flush)
+draw_screen_sgr(const struct draw_cell *cell)
 {
-	#define ATTR_BG ";48;5;"
-	#define ATTR_FG ";38;5;"
+	/* Set terminal attributes for drawing a cell. Only attributes differing
+	 * from the terminal's are set, unless resetting all attributes and
+	 * setting the cell's is shorter */
 
-	char bg[sizeof(ATTR_BG) + 4];
-	char fg[sizeof(ATTR_FG) + 4];
+	char delta[sizeof(sgr_flags) / sizeof(sgr_flags[0]) * 3 + 2 * sizeof(sgr_colours[0].bg)];
+	char reset[sizeof(delta) + 1] = "0";
+	size_t delta_len = 0;
+	size_t reset_len = 1;
 
-	if (draw_attrs->flush || flush) {
-		draw_attrs->flush = 0;
+	if (draw_cell_eq_attrs(cell, &screen.term))
+		return;
+
+	if (!sgr_colours[0].bg_len)
+		draw_sgr_init();
+
+	if (cell->bg >= 0)
+		draw_sgr_param(reset, &reset_len, sgr_colours[cell->bg].bg, sgr_colours[cell->bg].bg_len);
+
+	if (cell->fg >= 0)
+		draw_sgr_param(reset, &reset_len, sgr_colours[cell->fg].fg, sgr_colours[cell->fg].fg_len);
 
-		if (draw_attrs->bg >= 0 && draw_attrs->bg <= 255)
-			(void) snprintf(bg, sizeof(bg), ATTR_BG "%d", draw_attrs->bg);
+	if (cell->bg != screen.term.bg) {
+		if (cell->bg < 0)
+			draw_sgr_param(delta, &delta_len, "49", 2);
+		else
+			draw_sgr_param(delta, &delta_len, sgr_colours[cell->bg].bg, sgr_colours[cell->bg].bg_len);
+	}
+
+	if (cell->fg != screen.term.fg) {
+		if (cell->fg < 0)
+			draw_sgr_param(delta, &delta_len, "39", 2);
+		else
+			draw_sgr_param(delta, &delta_len, sgr_colours[cell->fg].fg, sgr_colours[cell->fg].fg_len);
+	}
+
+	for (size_t i = 0; i < sizeof(sgr_flags) / sizeof(sgr_flags[0]); i++) {
+
+		const char *on = sgr_flags[i].on;
+		const char *off = sgr_flags[i].off;
 
-		if (draw_attrs->fg >= 0 && draw_attrs->fg <= 255)
-			(void) snprintf(fg, sizeof(fg), ATTR_FG "%d", draw_attrs->fg);
+		if (cell->flags & sgr_flags[i].flag)
+			draw_sgr_param(reset, &reset_len, on, strlen(on));
 
-		printf(CSI "0%s%s%s%s%s%s%sm",
-			((draw_attrs->bg >= 0 && draw_attrs->bg <= 255) ? bg : ""),
-			((draw_attrs->fg >= 0 && draw_attrs->fg <= 255) ? fg : ""),
-			(draw_attrs->bold      ? ";1" : ""),
-			(draw_attrs->italic    ? ";3" : ""),
-			(draw_attrs->reverse   ? ";7" : ""),
-			(draw_attrs->strike    ? ";9" : ""),
-			(draw_attrs->underline ? ";4" : ""));
+		if ((cell->flags ^ screen.term.flags) & sgr_flags[i].flag) {
+			if (cell->flags & sgr_flags[i].flag)
+				draw_sgr_param(delta, &delta_len, on, strlen(on));
+			else
+				draw_sgr_param(delta, &delta_len, off, strlen(off));
+		}
 	}
+
+	DRAW_OUT(CSI);
+
+	if (delta_len <= reset_len)
+		draw_out(delta, delta_len);
+	else
+		draw_out(reset, reset_len);
+
+	draw_out_char('m');
+
+	screen.term.bg = cell->bg;
+	screen.term.fg = cell->fg;
+	screen.term.flags = cell->flags;
 }
 
 static void
-draw_attr_reset(struct draw_attrs *attrs)
+draw_sgr_init(void)
 {
-	if (attrs) {
-		attrs->bg        = -1;
-		attrs->fg        = -1;
-		attrs->flush     = 0;
-		attrs->bold      = 0;
-		attrs->italic    = 0;
-		attrs->reverse   = 0;
-		attrs->strike    = 0;
-		attrs->underline = 0;
-		attrs->flush     = 1;
-	} else {
-		printf(CSI "0m");
+	/* Precompute the SGR parameters for each 256 colour */
+
+	for (unsigned i = 0; i < 256; i++) {
+
+		char buf[sizeof("255")];
+		char *p = buf + sizeof(buf);
+		size_t len;
+		unsigned n = i;
+
+		do {
+			*--p = '0' + (n % 10);
+		} while ((n /= 10));
+
+		len = (buf + sizeof(buf)) - p;
+
+		memcpy(sgr_colours[i].bg, "48;5;", 5);
+		memcpy(sgr_colours[i].fg, "38;5;", 5);
+		memcpy(sgr_colours[i].bg + 5, p, len);
+		memcpy(sgr_colours[i].fg + 5, p, len);
+
+		sgr_colours[i].bg_len = 5 + len;
+		sgr_colours[i].fg_len = 5 + len;
 	}
 }
 
 static void
-draw_attr_set_bg(struct draw_attrs *attrs, int bg)
+draw_sgr_param(char *buf, size_t *len, const char *param, size_t param_len)
 {
-	attrs->bg = bg;
-	attrs->flush = 1;
+	/* Append a ';' separated SGR parameter */
+
+	if (*len)
+		buf[(*len)++] = ';';
+
+	memcpy(buf + *len, param, param_len);
+
+	*len += param_len;
 }
 
 static void
-draw_attr_set_fg(struct draw_attrs *attrs, int fg)
+draw_out(const char *str, size_t len)
 {
-	attrs->fg = fg;
-	attrs->flush = 1;
+	/* Append bytes to the frame output */
+
+	if (frame.len + len > frame.size) {
+
+		char *buf;
+		size_t size = frame.size ? frame.size : 4096;
+
+		while (size < frame.len + len)
+			size *= 2;
+
+		if ((buf = realloc(frame.buf, size)) == NULL)
+			fatal("realloc: %s", strerror(errno));
+
+		frame.buf = buf;
+		frame.size = size;
+	}
+
+	memcpy(frame.buf + frame.len, str, len);
+	frame.len += len;
 }
 
 static void
-draw_attr_toggle_bold(struct draw_attrs *attrs)
+draw_out_char(char c)
 {
-	attrs->bold = !attrs->bold;
-	attrs->flush = 1;
+	if (frame.len < frame.size)
+		frame.buf[frame.len++] = c;
+	else
+		draw_out(&c, 1);
 }
 
 static void
-draw_attr_toggle_italic(struct draw_attrs *attrs)
+draw_out_uint(unsigned n)
 {
-	attrs->italic = !attrs->italic;
-	attrs->flush = 1;
+	/* Append an unsigned integer in decimal */
+
+	char buf[sizeof("4294967295")];
+	char *p = buf + sizeof(buf);
+
+	do {
+		*--p = '0' + (n % 10);
+	} while ((n /= 10));
+
+	draw_out(p, (buf + sizeof(buf)) - p);
 }
 
 static void
-draw_attr_toggle_reverse(struct draw_attrs *attrs)
+draw_out_write(void)
 {
-	attrs->reverse = !attrs->reverse;
-	attrs->flush = 1;
+	/* Write the frame output to the terminal. On failure the terminal
+	 * no longer matches the front buffer and is redrawn in full */
+
+	size_t n = 0;
+	ssize_t ret;
+
+	while (n < frame.len) {
+
+		if ((ret = write(STDOUT_FILENO, frame.buf + n, frame.len - n)) < 0) {
+
+			if (errno == EINTR)
+				continue;
+
+			screen.valid = 0;
+			break;
+		}
+
+		n += (size_t) ret;
+	}
+
+	frame.len = 0;
+}
+
+static void
+draw_attrs(struct draw_attrs *draw_attrs, int flush)
+{
+	/* Set the attributes of subsequently drawn cells */
+
+	if (draw_attrs->flush || flush) {
+		draw_attrs->flush = 0;
+
+		screen.pen.bg = (draw_attrs->bg >= 0 && draw_attrs->bg <= 255) ? draw_attrs->bg : -1;
+		screen.pen.fg = (draw_attrs->fg >= 0 && draw_attrs->fg <= 255) ? draw_attrs->fg : -1;
+		screen.pen.flags =
+			(draw_attrs->bold      ? DRAW_CELL_BOLD      : 0) |
+			(draw_attrs->italic    ? DRAW_CELL_ITALIC    : 0) |
+			(draw_attrs->reverse   ? DRAW_CELL_REVERSE   : 0) |
+			(draw_attrs->strike    ? DRAW_CELL_STRIKE    : 0) |
+			(draw_attrs->underline ? DRAW_CELL_UNDERLINE : 0);
+	}
 }
 
 static void
-draw_attr_toggle_strike(struct draw_attrs *attrs)
+draw_attr_reset(struct draw_attrs *attrs)
 {
-	attrs->strike = !attrs->strike;
+	if (attrs) {
+		attrs->bg        = -1;
+		attrs->fg        = -1;
+		attrs->flush     = 0;
+		attrs->bold      = 0;
+		attrs->italic    = 0;
+		attrs->reverse   = 0;
+		attrs->strike    = 0;
+		attrs->underline = 0;
+		attrs->flush     = 1;
+	} else {
+		screen.pen.bg = -1;
+		screen.pen.fg = -1;
+		screen.pen.flags = 0;
+	}
+}
+
+static void
+draw_attr_run(struct draw_attrs *attrs, const struct buffer_run *run, int text_bg, int text_fg)
+{
+	/* Set attributes for a buffer line formatting run, default colours
+	 * are the line's text colours */
+
+	attrs->bg        = (run->bg < 0) ? text_bg : irc_to_ansi_colour[run->bg];
+	attrs->fg        = (run->fg < 0) ? text_fg : irc_to_ansi_colour[run->fg];
+	attrs->bold      = !!(run->flags & BUFFER_RUN_BOLD);
+	attrs->italic    = !!(run->flags & BUFFER_RUN_ITALIC);
+	attrs->reverse   = !!(run->flags & BUFFER_RUN_REVERSE);
+	attrs->strike    = !!(run->flags & BUFFER_RUN_STRIKE);
+	attrs->underline = !!(run->flags & BUFFER_RUN_UNDERLINE);
+	attrs->flush     = 1;
+}
+
+static void
+draw_attr_set_bg(struct draw_attrs *attrs, int bg)
+{
+	attrs->bg = bg;
 	attrs->flush = 1;
 }
 
 static void
-draw_attr_toggle_underline(struct draw_attrs *attrs)
+draw_attr_set_fg(struct draw_attrs *attrs, int fg)
 {
-	attrs->underline = !attrs->underline;
+	attrs->fg = fg;
 	attrs->flush = 1;
 }
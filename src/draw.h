@@ -15,9 +15,18 @@ enum draw_bit
 	DRAW_ALL,         /* set all draw bits aside from bell */
 };
 
+struct draw_stats
+{
+	unsigned long long frames; /* Frames written to the terminal */
+	unsigned long long bytes;  /* Bytes written to the terminal */
+	unsigned long long ns;     /* Time spent drawing and writing frames */
+};
+
 void draw_init(void);
 void draw_term(void);
 
 void draw(enum draw_bit);
 
+const struct draw_stats* draw_stats(void);
+
 #endif
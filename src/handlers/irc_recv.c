@@ -13,7 +13,13 @@
 #include <ctype.h>
 #include <errno.h>
 #include <limits.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
+
+#ifndef NETSPLIT_WINDOW
+#define NETSPLIT_WINDOW 5
+#endif
 
 #define failf(S, ...) \
 	do { server_error((S), __VA_ARGS__); \
@@ -31,8 +37,18 @@ static int irc_generic_error(struct server*, struct irc_message*);
 static int irc_generic_ignore(struct server*, struct irc_message*);
 static int irc_generic_info(struct server*, struct irc_message*);
 static int irc_generic_unknown(struct server*, struct irc_message*);
+static int irc_recv_001_join(struct server*);
+static int irc_recv_history(struct server*, struct channel*);
+static void irc_recv_history_mark(struct server*, struct irc_message*, const char*);
+static int irc_recv_history_replay(struct channel*, struct irc_message*, time_t*);
+static void irc_recv_netsplit_flush(struct server*);
+static int irc_recv_netsplit_join(struct server*, struct channel*, const char*, time_t);
+static int irc_recv_netsplit_quit(struct server*, const char*, const char*, time_t);
 static int irc_recv_numeric(struct server*, struct irc_message*);
+static void irc_recv_stat(struct server*, struct irc_message*, const struct recv_handler*, unsigned long long);
+static void irc_recv_366_duplicate(void*, const char*);
 static int irc_recv_threshold_filter(unsigned, unsigned);
+static void irc_recv_urgent(struct channel*);
 static int recv_mode_chanmodes(struct irc_message*, const struct mode_cfg*, struct server*, struct channel*);
 static int recv_mode_usermodes(struct irc_message*, const struct mode_cfg*, struct server*);
 
@@ -59,6 +75,9 @@ static int recv_mode_usermodes(struct irc_message*, const struct mode_cfg*, stru
 	X(317) /* RPL_WHOISIDLE */       \
 	X(319) /* RPL_WHOISCHANNELS */   \
 	X(320) /* RPL_WHOISSPECIAL */    \
+	X(321) /* RPL_LISTSTART */       \
+	X(322) /* RPL_LIST */            \
+	X(323) /* RPL_LISTEND */         \
 	X(324) /* RPL_CHANNELMODEIS */   \
 	X(328) /* RPL_CHANNEL_URL */     \
 	X(329) /* RPL_CREATIONTIME */    \
@@ -157,8 +176,9 @@ static const irc_recv_f irc_numerics[] = {
 	[318] = irc_generic_ignore, /* RPL_ENDOFWHOIS */
 	[319] = irc_recv_319,       /* RPL_WHOISCHANNELS */
 	[320] = irc_recv_320,       /* RPL_WHOISSPECIAL */
-	[322] = irc_generic_info,   /* RPL_LIST */
-	[323] = irc_generic_ignore, /* RPL_LISTEND */
+	[321] = irc_recv_321,       /* RPL_LISTSTART */
+	[322] = irc_recv_322,       /* RPL_LIST */
+	[323] = irc_recv_323,       /* RPL_LISTEND */
 	[324] = irc_recv_324,       /* RPL_CHANNELMODEIS */
 	[325] = irc_generic_info,   /* RPL_UNIQOPIS */
 	[328] = irc_recv_328,       /* RPL_CHANNEL_URL */
@@ -271,18 +291,98 @@ static unsigned threshold_nick    = FILTER_THRESHOLD_NICK;
 static unsigned threshold_part    = FILTER_THRESHOLD_PART;
 static unsigned threshold_quit    = FILTER_THRESHOLD_QUIT;
 
+static unsigned netsplit_window = NETSPLIT_WINDOW;
+
+#define X(cmd) + 1
+#if (1 RECV_HANDLERS) > SERVER_RECV_COMMANDS
+#error SERVER_RECV_COMMANDS must count every handler and unknown commands
+#endif
+#undef X
+
 int
 irc_recv(struct server *s, struct irc_message *m)
 {
-	const struct recv_handler* handler;
+	const struct recv_handler* handler = NULL;
+	struct timespec t1;
+	struct timespec t2;
+	int ret;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	/* Collected netsplit quits and joins are ended once the window lapses,
+	 * and kept through other messages received within it */
+	irc_recv_netsplit(s, time(NULL));
 
 	if (isdigit(*m->command))
-		return irc_recv_numeric(s, m);
+		ret = irc_recv_numeric(s, m);
+	else if ((handler = recv_handler_lookup(m->command, m->len_command)))
+		ret = handler->f(s, m);
+	else
+		ret = irc_generic_unknown(s, m);
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &t2);
 
-	if ((handler = recv_handler_lookup(m->command, m->len_command)))
-		return handler->f(s, m);
+	irc_recv_stat(s, m, handler, (t2.tv_sec - t1.tv_sec) * 1000000000ULL + t2.tv_nsec - t1.tv_nsec);
 
-	return irc_generic_unknown(s, m);
+	return ret;
+}
+
+void
+irc_recv_netsplit(struct server *s, time_t t)
+{
+	if (s->netsplit.state && t - s->netsplit.time > netsplit_window)
+		irc_recv_netsplit_flush(s);
+}
+
+size_t
+irc_recv_stats(struct server *s, struct irc_recv_stat *out, size_t n)
+{
+	size_t i;
+	size_t j = 0;
+
+	for (i = 0; i < s->recv_stats.commands_n && j < n; i++, j++) {
+		snprintf(out[j].command, sizeof(out[j].command), "%s",
+			(s->recv_stats.commands[i].command ? s->recv_stats.commands[i].command : "*"));
+		out[j].n = s->recv_stats.commands[i].n;
+		out[j].ns = s->recv_stats.commands[i].ns;
+	}
+
+	for (i = 0; i < ARR_LEN(s->recv_stats.numerics) && j < n; i++) {
+		if (s->recv_stats.numerics[i].n) {
+			snprintf(out[j].command, sizeof(out[j].command), "%03zu", i);
+			out[j].n = s->recv_stats.numerics[i].n;
+			out[j].ns = s->recv_stats.numerics[i].ns;
+			j++;
+		}
+	}
+
+	return j;
+}
+
+static void
+irc_recv_stat(struct server *s, struct irc_message *m, const struct recv_handler *handler, unsigned long long ns)
+{
+	/* Count a message handled, numerics by code and commands by handler */
+
+	const char *c = m->command;
+	const char *command = (handler ? handler->key : NULL);
+	size_t i;
+
+	if (isdigit(c[0]) && isdigit(c[1]) && isdigit(c[2]) && !c[3]) {
+		i = (size_t)((c[0] - '0') * 100 + (c[1] - '0') * 10 + (c[2] - '0'));
+		s->recv_stats.numerics[i].n++;
+		s->recv_stats.numerics[i].ns += ns;
+		return;
+	}
+
+	for (i = 0; i < s->recv_stats.commands_n && s->recv_stats.commands[i].command != command; i++)
+		continue;
+
+	if (i == s->recv_stats.commands_n)
+		s->recv_stats.commands[s->recv_stats.commands_n++].command = command;
+
+	s->recv_stats.commands[i].n++;
+	s->recv_stats.commands[i].ns += ns;
 }
 
 static int
@@ -369,7 +469,6 @@ irc_recv_001(struct server *s, struct irc_message *m)
 
 	const char *params;
 	const char *trailing;
-	struct channel *c = s->channel;
 
 	s->registered = 1;
 
@@ -381,15 +480,273 @@ irc_recv_001(struct server *s, struct irc_message *m)
 	if (s->mode)
 		sendf(s, "MODE %s +%s", s->nick, s->mode);
 
+	return irc_recv_001_join(s);
+}
+
+static int
+irc_recv_001_join(struct server *s)
+{
+	/* Join the server's channels in as few messages as possible, packed
+	 * into comma separated lists of channels and keys, with keyed channels
+	 * first, up to the message length and the server's TARGMAX for JOIN.
+	 * Channels beyond the server's CHANLIMIT for their type are skipped
+	 *
+	 * JOIN <channel>{,<channel>} [<key>{,<key>}] */
+
+	char chans[IRC_MESSAGE_LEN];
+	char keys[IRC_MESSAGE_LEN] = {0};
+	size_t chans_len = 0;
+	size_t keys_len = 0;
+	unsigned joined[8] = {0};
+	unsigned n = 0;
+	unsigned targmax = isupport_targmax(&(s->isupport), "JOIN");
+
+	for (int keyed = 1; keyed >= 0; keyed--) {
+
+		struct channel *c = s->channel;
+
+		do {
+			int ret_chans;
+			int ret_keys;
+			size_t chan_len;
+			size_t key_len;
+			size_t len;
+			unsigned group;
+			unsigned limit;
+
+			if (c->type != CHANNEL_T_CHANNEL || c->parted || !c->key != !keyed)
+				continue;
+
+			limit = isupport_chanlimit(&(s->isupport), c->name[0], &group);
+
+			if (limit && group < ARR_LEN(joined) && joined[group] == limit) {
+				server_info(s, "Channel limit reached, not joining %s", c->name);
+				continue;
+			}
+
+			chan_len = strlen(c->name);
+			key_len = (keyed ? strlen(c->key) : 0);
+
+			/* Message length with this channel added */
+			len = strlen("JOIN ") + chans_len + !!n + chan_len;
+
+			if (keys_len || key_len)
+				len += strlen(" ") + keys_len + !!keys_len + key_len;
+
+			if (n && (len >= IRC_MESSAGE_LEN || n == targmax)) {
+				sendf(s, "JOIN %s%s%s", chans, (keys_len ? " " : ""), keys);
+				len = strlen("JOIN ") + chan_len + (key_len ? strlen(" ") + key_len : 0);
+				chans_len = 0;
+				keys_len = 0;
+				keys[0] = 0;
+				n = 0;
+			}
+
+			if (len >= IRC_MESSAGE_LEN) {
+				server_error(s, "JOIN: channel too long: %s", c->name);
+				continue;
+			}
+
+			ret_chans = snprintf(chans + chans_len, sizeof(chans) - chans_len, "%s%s", (n ? "," : ""), c->name);
+			ret_keys = (keyed ? snprintf(keys + keys_len, sizeof(keys) - keys_len, "%s%s", (keys_len ? "," : ""), c->key) : 0);
+
+			if (ret_chans < 0 || (size_t) ret_chans >= sizeof(chans) - chans_len
+			 || ret_keys < 0 || (size_t) ret_keys >= sizeof(keys) - keys_len) {
+				chans[chans_len] = 0;
+				keys[keys_len] = 0;
+				server_error(s, "JOIN: channel too long: %s", c->name);
+				continue;
+			}
+
+			chans_len += (size_t) ret_chans;
+			keys_len += (size_t) ret_keys;
+
+			/* Channels count against the limit once added */
+			if (limit && group < ARR_LEN(joined))
+				joined[group]++;
+
+			n++;
+
+		} while ((c = c->next) != s->channel);
+	}
+
+	if (n)
+		sendf(s, "JOIN %s%s%s", chans, (keys_len ? " " : ""), keys);
+
+	return 0;
+}
+
+static int
+irc_recv_history(struct server *s, struct channel *c)
+{
+	/* Request messages missed since the last marked message, on rejoining
+	 * a channel. The reply is received as a chathistory batch */
+
+	unsigned limit;
+
+	if (!s->ircv3_caps.draft_chathistory.set)
+		return 0;
+
+	limit = isupport_num(&(s->isupport), ISUPPORT_CHATHISTORY, 0);
+
+	/* No more than fits in the buffer */
+	if (!limit || limit > BUFFER_LINES_MAX)
+		limit = BUFFER_LINES_MAX;
+
+	if (*c->history.msgid)
+		sendf(s, "CHATHISTORY AFTER %s msgid=%s %u", c->name, c->history.msgid, limit);
+	else if (*c->history.time)
+		sendf(s, "CHATHISTORY AFTER %s timestamp=%s %u", c->name, c->history.time, limit);
+
+	return 0;
+}
+
+static void
+irc_recv_history_mark(struct server *s, struct irc_message *m, const char *target)
+{
+	/* Mark a channel's last received message, by its msgid and server-time */
+
+	char msgid[CHANNEL_HISTORY_LEN];
+	char time[CHANNEL_HISTORY_LEN];
+	struct channel *c;
+
+	if (!m->tags || !(c = channel_list_get(&s->clist, target, s->casemapping)))
+		return;
+
+	if (irc_message_tag(m, "msgid", msgid, sizeof(msgid)) != 1 || strchr(msgid, ' '))
+		*msgid = 0;
+
+	if (irc_message_tag(m, "time", time, sizeof(time)) != 1 || strchr(time, ' '))
+		*time = 0;
+
+	if (!*msgid && !*time)
+		return;
+
+	strcpy(c->history.msgid, msgid);
+	strcpy(c->history.time, time);
+}
+
+static int
+irc_recv_history_replay(struct channel *c, struct irc_message *m, time_t *t)
+{
+	/* Return non-zero if a message is tagged with the channel's open
+	 * history batch, setting t to the time it was sent */
+
+	char batch[CHANNEL_HISTORY_LEN];
+
+	if (!*c->history.batch)
+		return 0;
+
+	if (irc_message_tag(m, "batch", batch, sizeof(batch)) != 1 || strcmp(batch, c->history.batch))
+		return 0;
+
+	if (!irc_message_time(m, t))
+		*t = time(NULL);
+
+	return 1;
+}
+
+static void
+irc_recv_netsplit_flush(struct server *s)
+{
+	/* Write a single line per channel for the collected netsplit quits or
+	 * netjoin joins, merging the joined users in bulk */
+
+	struct channel *c = s->channel;
+	struct netsplit *ns = &(s->netsplit);
+
 	do {
-		if (c->type == CHANNEL_T_CHANNEL && !c->parted)
-			sendf(s, "JOIN %s%s%s",
-				c->name,
-				(!c->key ? "" : " "),
-				(!c->key ? "" : c->key));
+		unsigned n = c->netsplit;
+
+		if (!n)
+			continue;
+
+		c->netsplit = 0;
+
+		if (ns->state == NETSPLIT_JOIN)
+			user_list_merge(&(c->users), s->casemapping, NULL, NULL);
+
+		if (ns->state == NETSPLIT_QUIT && !irc_recv_threshold_filter(threshold_quit, c->users.count))
+			newlinef(c, BUFFER_LINE_QUIT, FROM_QUIT, "netsplit: %u %s (%s)",
+				n, (n == 1 ? "user" : "users"), ns->servers);
+
+		if (ns->state == NETSPLIT_JOIN && !irc_recv_threshold_filter(threshold_join, c->users.count))
+			newlinef(c, BUFFER_LINE_JOIN, FROM_JOIN, "netjoin: %u %s (%s)",
+				n, (n == 1 ? "user" : "users"), ns->servers);
+
 	} while ((c = c->next) != s->channel);
 
-	return 0;
+	ns->state = NETSPLIT_NONE;
+
+	draw(DRAW_STATUS);
+}
+
+static int
+irc_recv_netsplit_join(struct server *s, struct channel *c, const char *nick, time_t t)
+{
+	/* Collect the join of a user quit in the last netsplit, staging them
+	 * to be added to the channel in bulk. Returns non-zero if collected */
+
+	struct netsplit *ns = &(s->netsplit);
+
+	if (!netsplit_window || !netsplit_get(ns, s->casemapping, nick, t))
+		return 0;
+
+	if (ns->state != NETSPLIT_JOIN || t - ns->time > netsplit_window) {
+		if (ns->state)
+			irc_recv_netsplit_flush(s);
+		ns->state = NETSPLIT_JOIN;
+	}
+
+	ns->time = t;
+
+	user_list_stage(&(c->users), &(s->intern), nick, (struct mode){0});
+
+	c->netsplit++;
+
+	return 1;
+}
+
+static int
+irc_recv_netsplit_quit(struct server *s, const char *nick, const char *message, time_t t)
+{
+	/* Collect the quit of a user lost in a netsplit, removing them from
+	 * each channel. Returns non-zero if collected */
+
+	struct channel *c = s->channel;
+	struct netsplit *ns = &(s->netsplit);
+	int quit = 0;
+
+	if (!netsplit_window || !message || !netsplit_servers(message))
+		return 0;
+
+	if (ns->state != NETSPLIT_QUIT || strcmp(ns->servers, message) || t - ns->time > netsplit_window) {
+
+		if (ns->state)
+			irc_recv_netsplit_flush(s);
+
+		/* Quits of the same split resumed are collected with its users */
+		if (!ns->servers || strcmp(ns->servers, message) || t - ns->time_split > NETSPLIT_REJOIN_MAX)
+			netsplit_start(ns, message, t);
+
+		ns->state = NETSPLIT_QUIT;
+	}
+
+	ns->time = t;
+
+	do {
+		if (user_list_del(&(c->users), s->casemapping, nick) == USER_ERR_NOT_FOUND)
+			continue;
+
+		c->netsplit++;
+		quit = 1;
+
+	} while ((c = c->next) != s->channel);
+
+	if (quit)
+		netsplit_add(ns, nick);
+
+	return 1;
 }
 
 static int
@@ -849,6 +1206,79 @@ irc_recv_320(struct server *s, struct irc_message *m)
 	return 0;
 }
 
+static int
+irc_recv_321(struct server *s, struct irc_message *m)
+{
+	/* RPL_LISTSTART
+	 *
+	 * Channel :Users Name */
+
+	UNUSED(m);
+
+	chanlist_reset(&(s->chanlist));
+
+	s->chanlist.listing = 1;
+
+	return 0;
+}
+
+static int
+irc_recv_322(struct server *s, struct irc_message *m)
+{
+	/* RPL_LIST
+	 *
+	 * <channel> <visible users> :<topic>
+	 *
+	 * Entries are collected in the server's channel list rather than
+	 * printed, RPL_LISTSTART is optional */
+
+	char *chan;
+	char *users;
+	char *topic;
+	char *end;
+	unsigned long n;
+
+	if (!irc_message_param(m, &chan))
+		failf(s, "RPL_LIST: channel is null");
+
+	if (!irc_message_param(m, &users))
+		failf(s, "RPL_LIST: users is null");
+
+	if (!irc_message_param(m, &topic))
+		topic = "";
+
+	errno = 0;
+	n = strtoul(users, &end, 10);
+
+	if (*end || errno || !isdigit(*users) || n > UINT_MAX)
+		failf(s, "RPL_LIST: invalid users: '%s'", users);
+
+	if (!s->chanlist.listing) {
+		chanlist_reset(&(s->chanlist));
+		s->chanlist.listing = 1;
+	}
+
+	chanlist_add(&(s->chanlist), chan, (unsigned) n, topic);
+
+	return 0;
+}
+
+static int
+irc_recv_323(struct server *s, struct irc_message *m)
+{
+	/* RPL_LISTEND
+	 *
+	 * :End of /LIST */
+
+	UNUSED(m);
+
+	s->chanlist.listing = 0;
+
+	server_info(s, "LIST: %zu channel(s), :list to view", s->chanlist.entries_len);
+
+	return 0;
+}
+
 static int
 irc_recv_324(struct server *s, struct irc_message *m)
 {
@@ -1133,10 +1563,7 @@ irc_recv_353(struct server *s, struct irc_message *m)
 				continue;
 			}
 
-			if (user_list_add(&(c->users), s->casemapping, nick, prfxmode) == USER_ERR_DUPLICATE) {
-				server_error(s, "RPL_NAMEREPLY: duplicate nick: '%s'", nick);
-				continue;
-			}
+			user_list_stage(&(c->users), &(s->intern), nick, prfxmode);
 		}
 
 		if (c == current_channel())
@@ -1162,12 +1589,24 @@ irc_recv_366(struct server *s, struct irc_message *m)
 	if (!irc_message_param(m, &chan))
 		failf(s, "RPL_NAMEREPLY: channel is null");
 
-	if ((c = channel_list_get(&s->clist, chan, s->casemapping)))
-		c->_366 = 1;
+	if ((c = channel_list_get(&s->clist, chan, s->casemapping)) == NULL)
+		return 0;
+
+	/* Merge the users staged by RPL_NAMEREPLY */
+	if (user_list_merge(&(c->users), s->casemapping, irc_recv_366_duplicate, s) && c == current_channel())
+		draw(DRAW_STATUS);
+
+	c->_366 = 1;
 
 	return 0;
 }
 
+static void
+irc_recv_366_duplicate(void *arg, const char *nick)
+{
+	server_error((struct server *)arg, "RPL_NAMEREPLY: duplicate nick: '%s'", nick);
+}
+
 static int
 irc_recv_378(struct server *s, struct irc_message *m)
 {
@@ -1550,17 +1989,20 @@ recv_join(struct server *s, struct irc_message *m)
 		newlinef(c, BUFFER_LINE_JOIN, FROM_JOIN, "Joined %s", chan);
 		sendf(s, "MODE %s", chan);
 		draw(DRAW_ALL);
-		return 0;
+		return irc_recv_history(s, c);
 	}
 
 	if ((c = channel_list_get(&s->clist, chan, s->casemapping)) == NULL)
 		failf(s, "JOIN: channel '%s' not found", chan);
 
+	if (irc_recv_netsplit_join(s, c, m->from, time(NULL)))
+		return 0;
+
 	/* JOIN increments count, filter first */
 
 	int filter = irc_recv_threshold_filter(threshold_join, c->users.count);
 
-	if (user_list_add(&(c->users), s->casemapping, m->from, (struct mode){0}) == USER_ERR_DUPLICATE)
+	if (user_list_add(&(c->users), &(s->intern), s->casemapping, m->from, (struct mode){0}) == USER_ERR_DUPLICATE)
 		failf(s, "JOIN: user '%s' already on channel '%s'", m->from, chan);
 
 	if (c == current_channel())
@@ -1879,7 +2321,7 @@ recv_nick(struct server *s, struct irc_message *m)
 	do {
 		enum user_err ret;
 
-		if ((ret = user_list_rpl(&(c->users), s->casemapping, m->from, nick)) == USER_ERR_NOT_FOUND)
+		if ((ret = user_list_rpl(&(c->users), &(s->intern), s->casemapping, m->from, nick)) == USER_ERR_NOT_FOUND)
 			continue;
 
 		if (ret == USER_ERR_DUPLICATE)
@@ -1902,7 +2344,9 @@ recv_notice(struct server *s, struct irc_message *m)
 
 	char *message;
 	char *target;
+	enum buffer_line_type type = BUFFER_LINE_CHAT;
 	struct channel *c;
+	time_t t;
 
 	if (!irc_message_param(m, &target))
 		failf(s, "NOTICE: target is null");
@@ -1910,6 +2354,8 @@ recv_notice(struct server *s, struct irc_message *m)
 	if (!irc_message_param(m, &message))
 		failf(s, "NOTICE: message is null");
 
+	irc_recv_history_mark(s, m, target);
+
 	if (IS_CTCP(message))
 		return ctcp_response(s, m->from, target, message);
 
@@ -1917,7 +2363,17 @@ recv_notice(struct server *s, struct irc_message *m)
 		if (!(c = channel_list_get(&(s->clist), m->from, s->casemapping)))
 			c = s->channel;
 
-		newlinef(c, BUFFER_LINE_CHAT, m->from, "%s", message);
+		if (highlight_match(&(s->highlight), message))
+			type = BUFFER_LINE_PINGED;
+
+		if (irc_recv_history_replay(c, m, &t)) {
+			newline_history(c, t, type, m->from, "%s", message);
+		} else {
+			newlinef(c, type, m->from, "%s", message);
+
+			if (type == BUFFER_LINE_PINGED && c != current_channel())
+				irc_recv_urgent(c);
+		}
 
 	} else {
 		server_info(s, "%s", message);
@@ -2013,8 +2469,10 @@ recv_privmsg(struct server *s, struct irc_message *m)
 
 	char *message;
 	char *target;
+	enum buffer_line_type type = BUFFER_LINE_CHAT;
 	int urgent = 0;
 	struct channel *c;
+	time_t t;
 
 	if (!m->from)
 		failf(s, "PRIVMSG: sender's nick is null");
@@ -2025,6 +2483,8 @@ recv_privmsg(struct server *s, struct irc_message *m)
 	if (!irc_message_param(m, &message))
 		failf(s, "PRIVMSG: message is null");
 
+	irc_recv_history_mark(s, m, target);
+
 	if (IS_CTCP(message))
 		return ctcp_request(s, m->from, target, message);
 
@@ -2043,22 +2503,24 @@ recv_privmsg(struct server *s, struct irc_message *m)
 		failf(s, "PRIVMSG: channel '%s' not found", target);
 	}
 
-	if (irc_pinged(s->casemapping, message, s->nick)) {
+	if (highlight_match(&(s->highlight), message)) {
 
 		if (c != current_channel())
 			urgent = 1;
 
-		newlinef(c, BUFFER_LINE_PINGED, m->from, "%s", message);
-	} else {
-		newlinef(c, BUFFER_LINE_CHAT, m->from, "%s", message);
+		type = BUFFER_LINE_PINGED;
 	}
 
-	if (urgent) {
-		c->activity = ACTIVITY_PINGED;
-		draw(DRAW_BELL);
-		draw(DRAW_NAV);
+	if (irc_recv_history_replay(c, m, &t)) {
+		newline_history(c, t, type, m->from, "%s", message);
+		return 0;
 	}
 
+	newlinef(c, type, m->from, "%s", message);
+
+	if (urgent)
+		irc_recv_urgent(c);
+
 	return 0;
 }
 
@@ -2075,6 +2537,9 @@ recv_quit(struct server *s, struct irc_message *m)
 
 	irc_message_param(m, &message);
 
+	if (irc_recv_netsplit_quit(s, m->from, message, time(NULL)))
+		return 0;
+
 	do {
 		/* QUIT decrements count, filter first */
 
@@ -2174,6 +2639,67 @@ recv_ircv3_authenticate(struct server *s, struct irc_message *m)
 	return ret;
 }
 
+static int
+recv_ircv3_batch(struct server *s, struct irc_message *m)
+{
+	/* BATCH +<reference> <type> [<parameters>]
+	 * BATCH -<reference>
+	 *
+	 * Lines of a chathistory batch are added to the channel as they're
+	 * received, and drawn once at the end of the batch. Messages of other
+	 * batch types are handled individually */
+
+	char *ref;
+	char *target;
+	char *type;
+	struct channel *c = s->channel;
+
+	if (!irc_message_param(m, &ref))
+		failf(s, "BATCH: reference is null");
+
+	if ((*ref != '+' && *ref != '-') || !ref[1])
+		failf(s, "BATCH: invalid reference '%s'", ref);
+
+	if (*ref == '-') {
+
+		do {
+			if (strcmp(c->history.batch, ref + 1))
+				continue;
+
+			*c->history.batch = 0;
+
+			if (c == current_channel()) {
+				draw(DRAW_BUFFER);
+				draw(DRAW_STATUS);
+			}
+
+			break;
+
+		} while ((c = c->next) != s->channel);
+
+		return 0;
+	}
+
+	if (!irc_message_param(m, &type))
+		failf(s, "BATCH: type is null");
+
+	if (strcmp(type, "chathistory"))
+		return 0;
+
+	if (!irc_message_param(m, &target))
+		failf(s, "BATCH: target is null");
+
+	if ((c = channel_list_get(&s->clist, target, s->casemapping)) == NULL)
+		failf(s, "BATCH: channel '%s' not found", target);
+
+	if (strlen(ref + 1) >= sizeof(c->history.batch))
+		failf(s, "BATCH: reference too long");
+
+	strcpy(c->history.batch, ref + 1);
+
+	return 0;
+}
+
 static int
 recv_ircv3_account(struct server *s, struct irc_message *m)
 {
@@ -2267,6 +2793,20 @@ recv_ircv3_chghost(struct server *s, struct irc_message *m)
 	return 0;
 }
 
+static int
+recv_ircv3_tagmsg(struct server *s, struct irc_message *m)
+{
+	/* @tags :nick!user@host TAGMSG <target>
+	 *
+	 * Sent with message-tags for client-only tags, e.g. typing
+	 * notifications, which aren't displayed */
+
+	UNUSED(s);
+	UNUSED(m);
+
+	return 0;
+}
+
 static int
 irc_recv_threshold_filter(unsigned filter, unsigned count)
 {
@@ -2281,5 +2821,15 @@ irc_recv_threshold_filter(unsigned filter, unsigned count)
 	return (filter < count);
 }
 
+static void
+irc_recv_urgent(struct channel *c)
+{
+	/* Alert of a highlight or new private message */
+
+	c->activity = ACTIVITY_PINGED;
+	draw(DRAW_BELL);
+	draw(DRAW_NAV);
+}
+
 #undef failf
 #undef sendf
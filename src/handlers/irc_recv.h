@@ -4,6 +4,21 @@
 #include "src/components/server.h"
 #include "src/utils/utils.h"
 
+#include <time.h>
+
+struct irc_recv_stat
+{
+	char command[16];      /* Command or numeric, '*' for unknown commands */
+	unsigned long long n;  /* Messages handled */
+	unsigned long long ns; /* Time spent handling */
+};
+
 int irc_recv(struct server*, struct irc_message*);
 
+/* Write collected netsplit lines once no more are received in time */
+void irc_recv_netsplit(struct server*, time_t);
+
+/* Copy up to n of a server's handler statistics by command, returning the count copied */
+size_t irc_recv_stats(struct server*, struct irc_recv_stat*, size_t);
+
 #endif
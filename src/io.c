@@ -2,6 +2,7 @@
 
 #include "config.h"
 #include "src/rirc.h"
+#include "src/utils/capture.h"
 #include "src/utils/utils.h"
 
 #ifndef NDEBUG
@@ -28,6 +29,7 @@
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <termios.h>
+#include <time.h>
 #include <unistd.h>
 
 /* RFC 2812, section 2.3 */
@@ -90,7 +92,7 @@
 			PT_UL(&(((struct connection *)(C))->mtx)); \
 		} \
 		if (((struct connection *)(C)) && callback) { \
-			PT_LK(&io_cb_mutex); \
+			io_cb_lock(); \
 			(X); \
 			PT_UL(&io_cb_mutex); \
 		} \
@@ -108,6 +110,7 @@
 enum io_err
 {
 	IO_ERR_NONE,
+	IO_ERR_CAPTURE,
 	IO_ERR_CXED,
 	IO_ERR_CXNG,
 	IO_ERR_DXED,
@@ -144,6 +147,10 @@ struct connection
 	mbedtls_x509_crt tls_x509_crt_client;
 	pthread_mutex_t mtx;
 	pthread_t tid;
+	FILE *capture; /* Capture file recording connection events and data */
+	FILE *replay;  /* Capture file replayed in place of the network */
+	uint64_t capture_ns;
+	struct io_stats stats; /* Updated under `mtx` */
 	uint32_t flags;
 	unsigned ping;
 	unsigned rx_sleep;
@@ -154,7 +161,12 @@ static enum io_state io_state_cxed(struct connection*);
 static enum io_state io_state_cxng(struct connection*);
 static enum io_state io_state_ping(struct connection*);
 static enum io_state io_state_rxng(struct connection*);
+static enum io_state io_state_replay(struct connection*);
 static int io_cx_read(struct connection*, uint32_t);
+static int io_replay_dxed(struct connection*);
+static uint64_t io_time_ns(void);
+static void io_cb_lock(void);
+static void io_capture_write(struct connection*, enum capture_event, const char*, size_t);
 static void io_fatal(const char*, int);
 static void io_sig_handle(int);
 static void io_sig_init(void);
@@ -165,6 +177,7 @@ static void* io_thread(void*);
 
 static int io_running;
 static pthread_mutex_t io_cb_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct io_stats io_cb_stats; /* Updated under `io_cb_mutex` */
 static struct termios term;
 static volatile sig_atomic_t flag_sigwinch_cb; /* sigwinch callback */
 
@@ -275,10 +288,14 @@ io_dx(struct connection *cx, int destroy)
 		PT_CF(pthread_kill(cx->tid, SIGUSR1));
 		PT_UL(&io_cb_mutex);
 		PT_CF(pthread_join(cx->tid, NULL));
-		PT_LK(&io_cb_mutex);
+		io_cb_lock();
 	}
 
 	if (destroy) {
+		if (cx->capture)
+			fclose(cx->capture);
+		if (cx->replay)
+			fclose(cx->replay);
 		PT_CF(pthread_mutex_destroy(&(cx->mtx)));
 		free((void*)cx->host);
 		free((void*)cx->port);
@@ -291,6 +308,56 @@ io_dx(struct connection *cx, int destroy)
 	return IO_ERR_NONE;
 }
 
+int
+io_capture(struct connection *cx, const char *path)
+{
+	FILE *f;
+
+	if ((f = fopen(path, "w")) == NULL)
+		return IO_ERR_CAPTURE;
+
+	if (capture_header_write(f)) {
+		fclose(f);
+		return IO_ERR_CAPTURE;
+	}
+
+	PT_LK(&(cx->mtx));
+
+	if (cx->capture)
+		fclose(cx->capture);
+
+	cx->capture = f;
+	cx->capture_ns = io_time_ns();
+
+	PT_UL(&(cx->mtx));
+
+	return IO_ERR_NONE;
+}
+
+int
+io_replay(struct connection *cx, const char *path)
+{
+	FILE *f;
+
+	if (cx->st_cur != IO_ST_DXED)
+		return IO_ERR_CXED;
+
+	if ((f = fopen(path, "r")) == NULL)
+		return IO_ERR_CAPTURE;
+
+	if (capture_header_read(f)) {
+		fclose(f);
+		return IO_ERR_CAPTURE;
+	}
+
+	if (cx->replay)
+		fclose(cx->replay);
+
+	cx->replay = f;
+
+	return IO_ERR_NONE;
+}
+
 int
 io_sendf(struct connection *cx, const char *fmt, ...)
 {
@@ -303,6 +370,10 @@ io_sendf(struct connection *cx, const char *fmt, ...)
 	if (cx->st_cur != IO_ST_CXED && cx->st_cur != IO_ST_PING)
 		return IO_ERR_DXED;
 
+	/* Replayed connections discard data sent */
+	if (cx->replay)
+		return IO_ERR_NONE;
+
 	va_start(ap, fmt);
 	ret = vsnprintf((char*)sendbuf, sizeof(sendbuf) - 2, fmt, ap);
 	va_end(ap);
@@ -345,6 +416,11 @@ io_sendf(struct connection *cx, const char *fmt, ...)
 		}
 	} while ((written += ret) < len);
 
+	PT_LK(&(cx->mtx));
+	cx->stats.send_bytes += len;
+	cx->stats.send_msgs++;
+	PT_UL(&(cx->mtx));
+
 	return IO_ERR_NONE;
 }
 
@@ -368,7 +444,7 @@ io_start(void)
 		ssize_t ret = read(STDIN_FILENO, buf, sizeof(buf));
 
 		if (ret > 0) {
-			PT_LK(&io_cb_mutex);
+			io_cb_lock();
 			io_cb_read_inp(buf, ret);
 			PT_UL(&io_cb_mutex);
 		} else {
@@ -398,16 +474,36 @@ io_tty_winsize(void)
 	if (ioctl(0, TIOCGWINSZ, &tty_ws) < 0)
 		fatal("ioctl: %s", strerror(errno));
 
-	PT_LK(&io_cb_mutex);
+	io_cb_lock();
 	io_cb_sigwinch(tty_ws.ws_col, tty_ws.ws_row);
 	PT_UL(&io_cb_mutex);
 }
 
+void
+io_stats(struct connection *cx, struct io_stats *out)
+{
+	/* Global statistics are updated under the callback mutex, and should
+	 * only be read from callback context */
+
+	if (cx) {
+		PT_LK(&(cx->mtx));
+		*out = cx->stats;
+		PT_UL(&(cx->mtx));
+	} else {
+		memset(out, 0, sizeof(*out));
+	}
+
+	out->cb_locks = io_cb_stats.cb_locks;
+	out->cb_wait_ns = io_cb_stats.cb_wait_ns;
+	out->cb_wait_max = io_cb_stats.cb_wait_max;
+}
+
 const char*
 io_err(int err)
 {
 	switch (err) {
 		case IO_ERR_NONE:      return "success";
+		case IO_ERR_CAPTURE:   return "failed to open capture file";
 		case IO_ERR_CXED:      return "socket connected";
 		case IO_ERR_CXNG:      return "socket connection in progress";
 		case IO_ERR_DXED:      return "socket not connected";
@@ -438,6 +534,10 @@ io_state_rxng(struct connection *cx)
 
 	sleep(cx->rx_sleep);
 
+	PT_LK(&(cx->mtx));
+	cx->stats.reconnects++;
+	PT_UL(&(cx->mtx));
+
 	return IO_ST_CXNG;
 }
 
@@ -456,9 +556,15 @@ io_state_cxng(struct connection *cx)
 static enum io_state
 io_state_cxed(struct connection *cx)
 {
+	/* Reads wait at most IO_PING_REFRESH seconds, after which io_cb_ping
+	 * is called with the unchanged ping, for periodic work while no data
+	 * is received. The ping timeout starts after IO_PING_MIN seconds */
+
+	unsigned idle = 0;
+	unsigned timeout;
 	int ret;
 
-	do {
+	for (;;) {
 		enum io_state st;
 
 		PT_LK(&(cx->mtx));
@@ -468,10 +574,24 @@ io_state_cxed(struct connection *cx)
 		if (st != IO_ST_INVALID)
 			return st;
 
-	} while ((ret = io_cx_read(cx, SEC_IN_MS(IO_PING_MIN))) > 0);
+		timeout = IO_PING_MIN - idle;
 
-	if (ret == MBEDTLS_ERR_SSL_TIMEOUT)
-		return IO_ST_PING;
+		if (IO_PING_REFRESH && timeout > IO_PING_REFRESH)
+			timeout = IO_PING_REFRESH;
+
+		if ((ret = io_cx_read(cx, SEC_IN_MS(timeout))) > 0) {
+			idle = 0;
+			continue;
+		}
+
+		if (ret != MBEDTLS_ERR_SSL_TIMEOUT)
+			break;
+
+		if ((idle += timeout) >= IO_PING_MIN)
+			return IO_ST_PING;
+
+		io_ping(cx, cx->ping);
+	}
 
 	switch (ret) {
 		case MBEDTLS_ERR_SSL_WANT_READ:
@@ -548,6 +668,138 @@ io_state_ping(struct connection *cx)
 	return IO_ST_CXNG;
 }
 
+static enum io_state
+io_state_replay(struct connection *cx)
+{
+	/* Replay the capture's callbacks, then remain idle until io_dx */
+
+	struct capture_record r;
+	uint64_t start = io_time_ns();
+	int ret = 0;
+
+	io_info(cx, "Replaying capture");
+
+	while (!io_replay_dxed(cx) && (ret = capture_read(cx->replay, &r)) > 0) {
+
+		if (cx->flags & IO_REPLAY_REALTIME) {
+
+			uint64_t ns;
+
+			while (!io_replay_dxed(cx) && (ns = io_time_ns() - start) < r.ns) {
+
+				struct timespec ts = {
+					.tv_sec  = (time_t)((r.ns - ns) / 1000000000),
+					.tv_nsec = (long)((r.ns - ns) % 1000000000)
+				};
+
+				/* Interrupted by SIGUSR1 from io_dx */
+				nanosleep(&ts, NULL);
+			}
+
+			if (io_replay_dxed(cx))
+				break;
+		}
+
+		io_capture_write(cx, r.event, r.buf, r.len);
+
+		switch (r.event) {
+			case CAPTURE_CXED:
+				PT_LK(&(cx->mtx));
+				cx->st_cur = IO_ST_CXED;
+				PT_UL(&(cx->mtx));
+				io_cxed(cx);
+				break;
+			case CAPTURE_DXED:
+				PT_LK(&(cx->mtx));
+				cx->st_cur = IO_ST_CXNG;
+				PT_UL(&(cx->mtx));
+				io_dxed(cx);
+				break;
+			case CAPTURE_READ:
+				PT_LK(&(cx->mtx));
+				cx->stats.recv_bytes += r.len;
+				PT_UL(&(cx->mtx));
+				io_cb_lock();
+				io_cb_read_soc(r.buf, r.len, cx->obj);
+				PT_UL(&io_cb_mutex);
+				break;
+		}
+	}
+
+	if (ret < 0)
+		io_error(cx, "Replay failed: malformed capture");
+	else if (ret == 0)
+		io_info(cx, "Replay complete");
+
+	while (!io_replay_dxed(cx)) {
+
+		struct timespec ts = { .tv_sec = 0, .tv_nsec = 100 * 1000 * 1000 };
+
+		nanosleep(&ts, NULL);
+	}
+
+	return IO_ST_DXED;
+}
+
+static int
+io_replay_dxed(struct connection *cx)
+{
+	int dxed;
+
+	PT_LK(&(cx->mtx));
+	dxed = (cx->st_new == IO_ST_DXED);
+	PT_UL(&(cx->mtx));
+
+	return dxed;
+}
+
+static uint64_t
+io_time_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+		fatal("clock_gettime: %s", strerror(errno));
+
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static void
+io_cb_lock(void)
+{
+	/* Lock the callback mutex, counting the time spent waiting */
+
+	uint64_t ns = io_time_ns();
+
+	PT_LK(&io_cb_mutex);
+
+	ns = io_time_ns() - ns;
+
+	io_cb_stats.cb_locks++;
+	io_cb_stats.cb_wait_ns += ns;
+
+	if (io_cb_stats.cb_wait_max < ns)
+		io_cb_stats.cb_wait_max = ns;
+}
+
+static void
+io_capture_write(struct connection *cx, enum capture_event event, const char *buf, size_t len)
+{
+	int ret = 0;
+
+	PT_LK(&(cx->mtx));
+
+	if (cx->capture && (ret = capture_write(cx->capture, event, io_time_ns() - cx->capture_ns, buf, len))) {
+		fclose(cx->capture);
+		cx->capture = NULL;
+	}
+
+	PT_UL(&(cx->mtx));
+
+	if (ret)
+		io_error(cx, "Capture failed: %s", strerror(errno));
+}
+
 static void*
 io_thread(void *arg)
 {
@@ -566,6 +818,15 @@ io_thread(void *arg)
 
 	cx->st_cur = IO_ST_CXNG;
 
+	if (cx->replay) {
+		enum io_state st_new = io_state_replay(cx);
+		PT_LK(&(cx->mtx));
+		cx->st_cur = st_new;
+		cx->st_new = IO_ST_INVALID;
+		PT_UL(&(cx->mtx));
+		return NULL;
+	}
+
 	io_info(cx, "Connecting to %s:%s", cx->host, cx->port);
 
 	do {
@@ -599,10 +860,12 @@ io_thread(void *arg)
 				io_info(cx, "Connecting to %s:%s", cx->host, cx->port);
 				break;
 			case ST_X(IO_ST_CXED, IO_ST_CXNG): /* F1 */
+				io_capture_write(cx, CAPTURE_DXED, NULL, 0);
 				io_dxed(cx);
 				break;
 			case ST_X(IO_ST_PING, IO_ST_CXNG): /* F2 */
 				io_error(cx, "Connection timeout (%u)", cx->ping);
+				io_capture_write(cx, CAPTURE_DXED, NULL, 0);
 				io_dxed(cx);
 				break;
 			case ST_X(IO_ST_RXNG, IO_ST_DXED): /* B1 */
@@ -612,10 +875,15 @@ io_thread(void *arg)
 			case ST_X(IO_ST_CXED, IO_ST_DXED): /* B3 */
 			case ST_X(IO_ST_PING, IO_ST_DXED): /* B4 */
 				io_info(cx, "Connection closed");
+				io_capture_write(cx, CAPTURE_DXED, NULL, 0);
 				io_dxed(cx);
 				break;
 			case ST_X(IO_ST_CXNG, IO_ST_CXED): /* D */
+				PT_LK(&(cx->mtx));
+				cx->stats.connects++;
+				PT_UL(&(cx->mtx));
 				io_info(cx, " .. Connection successful");
+				io_capture_write(cx, CAPTURE_CXED, NULL, 0);
 				io_cxed(cx);
 				cx->rx_sleep = 0;
 				break;
@@ -669,7 +937,11 @@ io_cx_read(struct connection *cx, uint32_t timeout)
 	}
 
 	if (ret > 0) {
-		PT_LK(&io_cb_mutex);
+		io_capture_write(cx, CAPTURE_READ, (char *)buf, (size_t)ret);
+		PT_LK(&(cx->mtx));
+		cx->stats.recv_bytes += (unsigned long long)ret;
+		PT_UL(&(cx->mtx));
+		io_cb_lock();
 		io_cb_read_soc((char *)buf, (size_t)ret,  cx->obj);
 		PT_UL(&io_cb_mutex);
 	}
@@ -862,6 +1134,7 @@ io_tls_establish(struct connection *cx)
 {
 	const unsigned char pers[] = "rirc-drbg-seed";
 	int ret;
+	uint64_t handshake_ns;
 
 	io_info(cx, " .. Establishing TLS connection");
 
@@ -1013,12 +1286,21 @@ io_tls_establish(struct connection *cx)
 		mbedtls_net_recv,
 		NULL);
 
+	handshake_ns = io_time_ns();
+
 	while ((ret = mbedtls_ssl_handshake(&(cx->tls_ctx)))) {
 		if (ret != MBEDTLS_ERR_SSL_WANT_READ
 		 && ret != MBEDTLS_ERR_SSL_WANT_WRITE)
 			break;
 	}
 
+	if (ret == 0) {
+		PT_LK(&(cx->mtx));
+		cx->stats.handshakes++;
+		cx->stats.handshake_ns += io_time_ns() - handshake_ns;
+		PT_UL(&(cx->mtx));
+	}
+
 	if (ret && cx->flags & IO_TLS_VRFY_DISABLED) {
 		io_error(cx, " .. %s ", io_tls_err(ret));
 		goto err;
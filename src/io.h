@@ -55,12 +55,25 @@
  *   (H) on ping timeout update: io_cb_ping
  *   (I) on ping normal:         io_cb_ping
  *
+ * Connected sockets also call io_cb_ping with an unchanged ping after
+ * each IO_PING_REFRESH seconds without data, for periodic work
+ *
  * Successful reads on stdin and connected sockets result in data callbacks:
  *   from stdin:  io_cb_read_inp
  *   from socket: io_cb_read_soc
  *
  * SIGWINCH results in a non signal-handler context callback io_cb_singwinch
  *
+ * Connection events and data received can be recorded to a capture file
+ * with io_capture. A connection given a capture file with io_replay doesn't
+ * use the network, io_cx instead replays the capture's callbacks either as
+ * fast as possible, or at the original pace with IO_REPLAY_REALTIME, and
+ * data sent is discarded
+ *
+ * Counters of traffic and connection events are kept per connection, and
+ * the time spent waiting to acquire the callback mutex is kept globally.
+ * Both are read with io_stats
+ *
  * Failed connection attempts enter a retry cycle with exponential
  * backoff time given by:
  *   t(n) = t(n - 1) * factor
@@ -82,9 +95,24 @@
 #define IO_TLS_VRFY_DISABLED (1 << 6)
 #define IO_TLS_VRFY_OPTIONAL (1 << 7)
 #define IO_TLS_VRFY_REQUIRED (1 << 8)
+#define IO_REPLAY_REALTIME   (1 << 9)
 
 struct connection;
 
+struct io_stats
+{
+	unsigned long long recv_bytes;   /* Bytes received */
+	unsigned long long send_bytes;   /* Bytes sent */
+	unsigned long long send_msgs;    /* Messages sent */
+	unsigned long long connects;     /* Connections established */
+	unsigned long long reconnects;   /* Reconnection attempts */
+	unsigned long long handshakes;   /* TLS handshakes completed */
+	unsigned long long handshake_ns; /* Time spent in completed TLS handshakes */
+	unsigned long long cb_locks;     /* Callback mutex acquisitions, global */
+	unsigned long long cb_wait_ns;   /* Time spent waiting on the callback mutex, global */
+	unsigned long long cb_wait_max;  /* Longest wait on the callback mutex, global */
+};
+
 struct connection* connection(
 	const void*, /* callback object */
 	const char*, /* host */
@@ -98,9 +126,16 @@ struct connection* connection(
 int io_cx(struct connection*);
 int io_dx(struct connection*, int);
 
+/* Record to, or replay from, a capture file */
+int io_capture(struct connection*, const char*);
+int io_replay(struct connection*, const char*);
+
 /* Formatted write to connection */
 int io_sendf(struct connection*, const char*, ...);
 
+/* Copy connection statistics, or only global statistics for NULL */
+void io_stats(struct connection*, struct io_stats*);
+
 /* IO error string */
 const char* io_err(int);
 
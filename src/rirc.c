@@ -44,6 +44,12 @@ const char *default_nicks = DEFAULT_NICKS;
 const char *default_nicks;
 #endif
 
+#ifdef DEFAULT_HIGHLIGHTS
+const char *default_highlights = DEFAULT_HIGHLIGHTS;
+#else
+const char *default_highlights;
+#endif
+
 #ifdef DEFAULT_USERNAME
 const char *default_username = DEFAULT_USERNAME;
 #else
@@ -81,6 +87,7 @@ static const char *const rirc_help =
 "\n  -m, --mode=MODE           Set IRC user modes"
 "\n  -n, --nicks=NICKS         Set comma separated list of nicks to use"
 "\n  -c, --chans=CHANNELS      Set comma separated list of channels to join"
+"\n      --highlights=WORDS    Set comma separated list of words to highlight"
 "\n      --tls-cert=PATH       Set TLS client certificate file path"
 "\n      --tls-ca-file=PATH    Set TLS peer certificate file path"
 "\n      --tls-ca-path=PATH    Set TLS peer certificate directory path"
@@ -91,6 +98,9 @@ static const char *const rirc_help =
 "\n      --sasl-pass=PASS      Authenticate with SASL password"
 "\n      --ipv4                Use IPv4 addresses only"
 "\n      --ipv6                Use IPv6 addresses only"
+"\n      --capture=PATH        Record connection traffic to capture file"
+"\n      --replay=PATH         Replay capture file in place of connecting"
+"\n      --replay-realtime     Replay capture at its original pace"
 "\n";
 
 static const char *const rirc_version =
@@ -112,6 +122,7 @@ rirc_opt_str(char c)
 		case 'm': return "-m/--mode";
 		case 'n': return "-n/--nicks";
 		case 'c': return "-c/--chans";
+		case 'H': return "--highlights";
 		case '0': return "--tls-cert";
 		case '1': return "--tls-ca-file";
 		case '2': return "--tls-ca-path";
@@ -122,6 +133,9 @@ rirc_opt_str(char c)
 		case '7': return "--sasl-pass";
 		case '8': return "--ipv4";
 		case '9': return "--ipv6";
+		case 'C': return "--capture";
+		case 'R': return "--replay";
+		case 'T': return "--replay-realtime";
 		default:
 			fatal("unknown option flag '%c'", c);
 	}
@@ -158,13 +172,17 @@ rirc_parse_args(int argc, char **argv)
 		const char *mode;
 		const char *nicks;
 		const char *chans;
+		const char *highlights;
 		const char *tls_ca_file;
 		const char *tls_ca_path;
 		const char *tls_cert;
 		const char *sasl;
 		const char *sasl_user;
 		const char *sasl_pass;
+		const char *capture;
+		const char *replay;
 		int ipv;
+		int realtime;
 		int tls;
 		int tls_vrfy;
 		struct server *s;
@@ -179,6 +197,7 @@ rirc_parse_args(int argc, char **argv)
 		{"mode",        required_argument, 0, 'm'},
 		{"nicks",       required_argument, 0, 'n'},
 		{"chans",       required_argument, 0, 'c'},
+		{"highlights",  required_argument, 0, 'H'},
 		{"help",        no_argument,       0, 'h'},
 		{"version",     no_argument,       0, 'v'},
 		{"tls-cert",    required_argument, 0, '0'},
@@ -191,6 +210,9 @@ rirc_parse_args(int argc, char **argv)
 		{"sasl-pass",   required_argument, 0, '7'},
 		{"ipv4",        no_argument,       0, '8'},
 		{"ipv6",        no_argument,       0, '9'},
+		{"capture",     required_argument, 0, 'C'},
+		{"replay",      required_argument, 0, 'R'},
+		{"replay-realtime", no_argument,   0, 'T'},
 		{0, 0, 0, 0}
 	};
 
@@ -220,13 +242,17 @@ rirc_parse_args(int argc, char **argv)
 				cli_servers[n_servers - 1].mode        = NULL;
 				cli_servers[n_servers - 1].nicks       = default_nicks;
 				cli_servers[n_servers - 1].chans       = NULL;
+				cli_servers[n_servers - 1].highlights  = default_highlights;
 				cli_servers[n_servers - 1].tls_ca_file = NULL;
 				cli_servers[n_servers - 1].tls_ca_path = NULL;
 				cli_servers[n_servers - 1].tls_cert    = NULL;
 				cli_servers[n_servers - 1].sasl        = NULL;
 				cli_servers[n_servers - 1].sasl_user   = NULL;
 				cli_servers[n_servers - 1].sasl_pass   = NULL;
+				cli_servers[n_servers - 1].capture     = NULL;
+				cli_servers[n_servers - 1].replay      = NULL;
 				cli_servers[n_servers - 1].ipv         = IO_IPV_UNSPEC;
+				cli_servers[n_servers - 1].realtime    = 0;
 				cli_servers[n_servers - 1].tls         = IO_TLS_ENABLED;
 				cli_servers[n_servers - 1].tls_vrfy    = IO_TLS_VRFY_REQUIRED;
 				break;
@@ -276,6 +302,11 @@ rirc_parse_args(int argc, char **argv)
 				cli_servers[n_servers - 1].chans = optarg;
 				break;
 
+			case 'H': /* Set comma separated list of words to highlight */
+				CHECK_SERVER_OPTARG(opt_c, 1);
+				cli_servers[n_servers - 1].highlights = optarg;
+				break;
+
 			case '0': /* Set TLS client certificate file path */
 				CHECK_SERVER_OPTARG(opt_c, 1);
 				cli_servers[n_servers - 1].tls_cert = optarg;
@@ -346,6 +377,21 @@ rirc_parse_args(int argc, char **argv)
 				cli_servers[n_servers -1].ipv = IO_IPV_6;
 				break;
 
+			case 'C': /* Record connection traffic to capture file */
+				CHECK_SERVER_OPTARG(opt_c, 1);
+				cli_servers[n_servers - 1].capture = optarg;
+				break;
+
+			case 'R': /* Replay capture file in place of connecting */
+				CHECK_SERVER_OPTARG(opt_c, 1);
+				cli_servers[n_servers - 1].replay = optarg;
+				break;
+
+			case 'T': /* Replay capture at its original pace */
+				CHECK_SERVER_OPTARG(opt_c, 0);
+				cli_servers[n_servers - 1].realtime = IO_REPLAY_REALTIME;
+				break;
+
 			#undef CHECK_SERVER_OPTARG
 
 			case 'h':
@@ -398,7 +444,18 @@ rirc_parse_args(int argc, char **argv)
 			cli_servers[i].tls_cert,
 			(cli_servers[i].ipv |
 			 cli_servers[i].tls |
-			 cli_servers[i].tls_vrfy));
+			 cli_servers[i].tls_vrfy |
+			 cli_servers[i].realtime));
+
+		if (cli_servers[i].capture && io_capture(cli_servers[i].s->connection, cli_servers[i].capture)) {
+			arg_error("invalid %s: '%s'", rirc_opt_str('C'), cli_servers[i].capture);
+			return -1;
+		}
+
+		if (cli_servers[i].replay && io_replay(cli_servers[i].s->connection, cli_servers[i].replay)) {
+			arg_error("invalid %s: '%s'", rirc_opt_str('R'), cli_servers[i].replay);
+			return -1;
+		}
 
 		if (server_list_add(state_server_list(), cli_servers[i].s)) {
 			arg_error("duplicate server: %s:%s", cli_servers[i].host, cli_servers[i].port);
@@ -415,6 +472,11 @@ rirc_parse_args(int argc, char **argv)
 			return -1;
 		}
 
+		if (cli_servers[i].highlights && server_set_highlights(cli_servers[i].s, cli_servers[i].highlights)) {
+			arg_error("invalid %s: '%s'", rirc_opt_str('H'), cli_servers[i].highlights);
+			return -1;
+		}
+
 		if (cli_servers[i].sasl) {
 			server_set_sasl(
 				cli_servers[i].s,
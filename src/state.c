@@ -10,12 +10,26 @@
 #include "src/utils/utils.h"
 
 #include <ctype.h>
+#include <errno.h>
+#include <limits.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
 
+#ifndef CHANNEL_IDLE_COMPACT
+#define CHANNEL_IDLE_COMPACT 600
+#endif
+
+#ifndef STATS_FILE
+#define STATS_FILE ""
+#endif
+
+#ifndef STATS_INTERVAL
+#define STATS_INTERVAL 60
+#endif
+
 /* See: https://vt100.net/docs/vt100-ug/chapter3.html */
 #define CTRL(k) ((k) & 0x1f)
 
@@ -24,14 +38,16 @@
 	X(close) \
 	X(connect) \
 	X(disconnect) \
-	X(quit)
+	X(list) \
+	X(quit) \
+	X(stats)
 
 #define X(CMD) \
 static void command_##CMD(struct channel*, char*);
 COMMAND_HANDLERS
 #undef X
 
-static void newlinev(struct channel*, enum buffer_line_type, const char*, const char*, va_list);
+static void newlinev(struct channel*, time_t, int, enum buffer_line_type, const char*, const char*, va_list);
 
 static int state_input_linef(struct channel*);
 static int state_input_ctrlch(const char*, size_t);
@@ -48,6 +64,15 @@ static uint16_t state_complete_user(char*, uint16_t, uint16_t, int);
 
 static void state_channel_clear(int);
 static void state_channel_close(int);
+static void state_channel_compact(time_t);
+
+static void state_list_page(struct channel*, struct chanlist*);
+static void state_list_request(struct server*);
+
+static int state_stats_cmp(const void*, const void*);
+static void state_stats(struct channel*, FILE*);
+static void state_stats_dump(time_t);
+static void state_stats_line(struct channel*, FILE*, const char*, ...);
 
 static void channel_move_prev(void);
 static void channel_move_next(void);
@@ -65,6 +90,7 @@ static struct
 	struct channel *current_channel; /* the current channel being drawn */
 	struct channel *default_channel; /* the default rirc channel at startup */
 	struct server_list servers;
+	time_t compact_next; /* Earliest idle deadline of a channel not yet compacted */
 } state;
 
 static unsigned state_tty_cols;
@@ -132,6 +158,7 @@ state_term(void)
 
 	state.current_channel = NULL;
 	state.default_channel = NULL;
+	state.compact_next = 0;
 
 	action_handler = NULL;
 	action_buff[0] = 0;
@@ -168,12 +195,22 @@ newlinef(struct channel *c, enum buffer_line_type type, const char *from, const
 	va_list ap;
 
 	va_start(ap, fmt);
-	newlinev(c, type, from, fmt, ap);
+	newlinev(c, time(NULL), 0, type, from, fmt, ap);
+	va_end(ap);
+}
+
+void
+newline_history(struct channel *c, time_t t, enum buffer_line_type type, const char *from, const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	newlinev(c, t, 1, type, from, fmt, ap);
 	va_end(ap);
 }
 
 static void
-newlinev(struct channel *c, enum buffer_line_type type, const char *from, const char *fmt, va_list ap)
+newlinev(struct channel *c, time_t t, int history, enum buffer_line_type type, const char *from, const char *fmt, va_list ap)
 {
 	char buf[TEXT_LENGTH_MAX];
 	char prefix = 0;
@@ -182,6 +219,7 @@ newlinev(struct channel *c, enum buffer_line_type type, const char *from, const
 	int len;
 	size_t from_len;
 	size_t text_len;
+	struct intern *strings = (c->server ? &(c->server->intern) : NULL);
 
 	if ((len = vsnprintf(buf, sizeof(buf), fmt, ap)) < 0) {
 		text_str = "newlinef error: vsprintf failure";
@@ -215,7 +253,7 @@ newlinev(struct channel *c, enum buffer_line_type type, const char *from, const
 	struct tm tm_new;
 
 	time_t t_old = c->buffer.time_last;
-	time_t t_new = time(NULL);
+	time_t t_new = t;
 
 	if ((c->type == CHANNEL_T_CHANNEL
 	  || c->type == CHANNEL_T_PRIVMSG
@@ -230,7 +268,9 @@ newlinev(struct channel *c, enum buffer_line_type type, const char *from, const
 		if (strftime(buf_date, sizeof(buf_date), "-- %e %b %Y --", &tm_new))
 			buffer_newline(
 				&(c->buffer),
+				strings,
 				BUFFER_LINE_OTHER,
+				t_new,
 				FROM_INFO,
 				buf_date,
 				strlen(FROM_INFO),
@@ -242,19 +282,22 @@ newlinev(struct channel *c, enum buffer_line_type type, const char *from, const
 
 	buffer_newline(
 		&(c->buffer),
+		strings,
 		type,
+		t_new,
 		from_str,
 		text_str,
 		from_len,
 		text_len,
 		prefix);
 
-	if (c == current_channel()) {
-		draw(DRAW_BUFFER);
-		draw(DRAW_STATUS);
-	} else {
+	if (c != current_channel()) {
 		c->activity = MAX(c->activity, ACTIVITY_ACTIVE);
 		draw(DRAW_NAV);
+	} else if (!history) {
+		/* Replayed history is drawn at the end of its batch */
+		draw(DRAW_BUFFER);
+		draw(DRAW_STATUS);
 	}
 }
 
@@ -346,7 +389,8 @@ state_channel_clear(int action_confirm)
 	if (action_confirm) {
 		action(action_clear, "Clear buffer '%s'?   [y/n]", c->name);
 	} else {
-		memset(&(c->buffer), 0, sizeof(c->buffer));
+		buffer_free(&(c->buffer));
+		buffer(&(c->buffer));
 		draw(DRAW_BUFFER);
 	}
 }
@@ -526,11 +570,57 @@ channel_set_current(struct channel *c)
 {
 	/* Set the state to an arbitrary channel */
 
+	time_t t = time(NULL);
+
+	if (state.current_channel)
+		state.current_channel->time_viewed = t;
+
 	state.current_channel = c;
+	state.current_channel->time_viewed = t;
+
+	state_channel_compact(t);
 
 	draw(DRAW_ALL);
 }
 
+static void
+state_channel_compact(time_t t)
+{
+	/* Compact storage of channels idle and out of view. Channels are only
+	 * scanned once the earliest idle deadline found by the last scan passes */
+
+	struct channel *c;
+	struct server *s;
+	time_t deadline;
+
+	if (CHANNEL_IDLE_COMPACT <= 0 || t < state.compact_next)
+		return;
+
+	state.compact_next = t + CHANNEL_IDLE_COMPACT;
+
+	if ((s = state.servers.head) == NULL)
+		return;
+
+	do {
+		if ((c = s->clist.head) == NULL)
+			continue;
+
+		do {
+			if (c == current_channel())
+				continue;
+
+			deadline = MAX(c->time_viewed, c->buffer.time_last) + CHANNEL_IDLE_COMPACT;
+
+			if (deadline > t)
+				state.compact_next = MIN(state.compact_next, deadline);
+			else
+				channel_compact(c);
+
+		} while ((c = c->next) != s->clist.head);
+
+	} while ((s = s->next) != state.servers.head);
+}
+
 static uint16_t
 state_complete_list(char *str, uint16_t len, uint16_t max, const char **list)
 {
@@ -841,6 +931,80 @@ command_disconnect(struct channel *c, char *args)
 		action(action_error, "disconnect: %s", io_err(err));
 }
 
+static void
+command_list(struct channel *c, char *args)
+{
+	/* :list [-r] [-n] [>users] [<users] [match]
+	 *
+	 * Show the next page of the server's LIST reply, or with arguments,
+	 * filter and sort it by user count, or by name with -n, and show its
+	 * first page. With -r, request the list from the server again */
+
+	char *arg;
+	int filtered = 0;
+	int refresh = 0;
+	struct chanlist_filter filter = {0};
+	struct server *s;
+
+	if (!(s = c->server)) {
+		action(action_error, "list: This is not a server");
+		return;
+	}
+
+	while ((arg = irc_strsep(&args))) {
+
+		filtered = 1;
+
+		if (!strcmp(arg, "-r")) {
+			refresh = 1;
+		} else if (!strcmp(arg, "-n")) {
+			filter.sort = CHANLIST_SORT_NAME;
+		} else if (*arg == '<' || *arg == '>') {
+
+			char *end;
+			unsigned long n;
+
+			errno = 0;
+			n = strtoul(arg + 1, &end, 10);
+
+			if (!isdigit(arg[1]) || *end || errno || n > UINT_MAX) {
+				action(action_error, "list: Invalid users '%s'", arg);
+				return;
+			}
+
+			if (*arg == '>')
+				filter.users_min = (unsigned) n;
+			else
+				filter.users_max = (unsigned) n;
+
+		} else if (*arg == '-') {
+			action(action_error, "list: Unknown arg '%s'", arg);
+			return;
+		} else if (*filter.match) {
+			action(action_error, "list: Unexpected arg '%s'", arg);
+			return;
+		} else if (strlen(arg) >= sizeof(filter.match)) {
+			action(action_error, "list: Match too long");
+			return;
+		} else {
+			strcpy(filter.match, arg);
+		}
+	}
+
+	if (filtered)
+		s->chanlist.filter = filter;
+
+	if (refresh) {
+		state_list_request(s);
+		return;
+	}
+
+	if (filtered || s->chanlist.stale)
+		chanlist_view(&(s->chanlist), s->casemapping);
+
+	state_list_page(c, &(s->chanlist));
+}
+
 static void
 command_quit(struct channel *c, char *args)
 {
@@ -856,6 +1020,250 @@ command_quit(struct channel *c, char *args)
 	io_stop();
 }
 
+static void
+command_stats(struct channel *c, char *args)
+{
+	char *arg;
+
+	if ((arg = irc_strsep(&args))) {
+		action(action_error, "stats: Unknown arg '%s'", arg);
+		return;
+	}
+
+	state_stats(c, NULL);
+}
+
+static void
+state_list_page(struct channel *c, struct chanlist *cl)
+{
+	/* Print the view's next page, sized to the buffer's rows */
+
+	const struct chanlist_entry *e;
+	size_t first;
+	size_t pages;
+	size_t rows = (state_rows() > 6 ? state_rows() - 5 : 1);
+	int width = 0;
+
+	if (!cl->view_len) {
+		newlinef(c, 0, FROM_INFO, "LIST: no channels%s", (cl->listing ? " received yet" : ""));
+		return;
+	}
+
+	pages = (cl->view_len + rows - 1) / rows;
+
+	if (cl->page >= pages)
+		cl->page = 0;
+
+	first = cl->page * rows;
+
+	for (size_t i = first; (i - first) < rows && (e = chanlist_view_entry(cl, i)); i++) {
+
+		int len = (int) strlen(chanlist_name(cl, e));
+
+		if (width < len)
+			width = len;
+	}
+
+	newlinef(c, 0, FROM_INFO, "LIST: page %zu of %zu, %zu of %zu channel(s)",
+		cl->page + 1, pages, cl->view_len, cl->entries_len);
+
+	for (size_t i = first; (i - first) < rows && (e = chanlist_view_entry(cl, i)); i++) {
+		newlinef(c, 0, FROM_INFO, "%-*s %6u  %s",
+			width,
+			chanlist_name(cl, e),
+			e->users,
+			chanlist_topic(cl, e));
+	}
+
+	cl->page++;
+}
+
+static void
+state_list_request(struct server *s)
+{
+	/* Request the server's LIST, sending the filter's conditions where
+	 * supported by the server's ELIST, others are filtered locally */
+
+	char conds[IRC_MESSAGE_LEN] = {0};
+	const char *elist = isupport_str(&(s->isupport), ISUPPORT_ELIST);
+	const struct chanlist_filter *f = &(s->chanlist.filter);
+	int ret;
+	size_t len = 0;
+
+	if (!s->registered) {
+		action(action_error, "list: Not registered with server");
+		return;
+	}
+
+	if (elist && strpbrk(elist, "Uu")) {
+		if (f->users_min)
+			len += (size_t) snprintf(conds + len, sizeof(conds) - len, ",>%u", f->users_min);
+		if (f->users_max)
+			len += (size_t) snprintf(conds + len, sizeof(conds) - len, ",<%u", f->users_max);
+	}
+
+	if (elist && strpbrk(elist, "Mm") && *f->match)
+		len += (size_t) snprintf(conds + len, sizeof(conds) - len, ",*%s*", f->match);
+
+	if ((ret = io_sendf(s->connection, "LIST%s%s", (len ? " " : ""), (len ? conds + 1 : ""))))
+		server_error(s, "sendf fail: %s", io_err(ret));
+
+	chanlist_reset(&(s->chanlist));
+
+	s->chanlist.listing = 1;
+}
+
+static void
+state_stats(struct channel *c, FILE *f)
+{
+	/* Report runtime statistics, to a channel or file */
+
+	struct irc_recv_stat recv[64];
+	struct io_stats io;
+	struct channel *ch;
+	struct server *s;
+	const struct buffer_stats *bs = buffer_stats();
+	const struct draw_stats *ds = draw_stats();
+	size_t n;
+
+	io_stats(NULL, &io);
+
+	state_stats_line(c, f, "io: %llu callback locks, %llu us waiting, %llu us longest",
+		io.cb_locks,
+		io.cb_wait_ns / 1000,
+		io.cb_wait_max / 1000);
+
+	state_stats_line(c, f, "draw: %llu frames, %llu bytes/frame, %llu us/frame",
+		ds->frames,
+		(ds->frames ? ds->bytes / ds->frames : 0),
+		(ds->frames ? ds->ns / ds->frames / 1000 : 0));
+
+	state_stats_line(c, f, "buffer: %llu cold bytes packed to %llu, %llu thaws, %llu us thawing",
+		bs->cold_bytes_raw,
+		bs->cold_bytes_packed,
+		bs->thaw_count,
+		bs->thaw_ns / 1000);
+
+	state_stats_line(c, f, "buffer %s: %u lines, %zu bytes",
+		state.default_channel->name,
+		buffer_size(&(state.default_channel->buffer)),
+		buffer_memory(&(state.default_channel->buffer)));
+
+	if ((s = state.servers.head) == NULL)
+		return;
+
+	do {
+		io_stats(s->connection, &io);
+
+		state_stats_line(c, f, "server %s: recv %llu bytes, %llu msgs, sent %llu bytes, %llu msgs",
+			s->host,
+			io.recv_bytes,
+			s->read.msgs,
+			io.send_bytes,
+			io.send_msgs);
+
+		state_stats_line(c, f, "server %s: %llu connects, %llu reconnects, %llu TLS handshakes, %llu us/handshake",
+			s->host,
+			io.connects,
+			io.reconnects,
+			io.handshakes,
+			(io.handshakes ? io.handshake_ns / io.handshakes / 1000 : 0));
+
+		state_stats_line(c, f, "server %s: %zu interned nicks, %zu bytes",
+			s->host,
+			s->intern.count,
+			intern_memory(&(s->intern)));
+
+		state_stats_line(c, f, "server %s: %zu listed channels, %zu bytes",
+			s->host,
+			s->chanlist.entries_len,
+			chanlist_memory(&(s->chanlist)));
+
+		n = irc_recv_stats(s, recv, ARR_LEN(recv));
+
+		qsort(recv, n, sizeof(*recv), state_stats_cmp);
+
+		for (size_t i = 0; i < n; i++) {
+			state_stats_line(c, f, "server %s: recv %s: %llu msgs, %llu ns/msg, %llu us total",
+				s->host,
+				recv[i].command,
+				recv[i].n,
+				recv[i].ns / recv[i].n,
+				recv[i].ns / 1000);
+		}
+
+		if ((ch = s->clist.head) == NULL)
+			continue;
+
+		do {
+			state_stats_line(c, f, "buffer %s: %u lines, %zu bytes, %u users, %zu bytes",
+				ch->name,
+				buffer_size(&(ch->buffer)),
+				buffer_memory(&(ch->buffer)),
+				ch->users.count,
+				user_list_memory(&(ch->users)));
+		} while ((ch = ch->next) != s->clist.head);
+
+	} while ((s = s->next) != state.servers.head);
+}
+
+static void
+state_stats_dump(time_t t)
+{
+	/* Append statistics to STATS_FILE, at most every STATS_INTERVAL seconds */
+
+	static time_t t_last;
+
+	char buf[64];
+	struct tm tm;
+	FILE *f;
+
+	if (!*STATS_FILE || (t - t_last) < STATS_INTERVAL)
+		return;
+
+	t_last = t;
+
+	if ((f = fopen(STATS_FILE, "a")) == NULL) {
+		newlinef(state.default_channel, 0, FROM_ERROR, "stats: %s: %s", STATS_FILE, strerror(errno));
+		return;
+	}
+
+	if (localtime_r(&t, &tm) && strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm))
+		fprintf(f, "-- %s --\n", buf);
+
+	state_stats(NULL, f);
+
+	if (fclose(f))
+		newlinef(state.default_channel, 0, FROM_ERROR, "stats: %s: %s", STATS_FILE, strerror(errno));
+}
+
+static void
+state_stats_line(struct channel *c, FILE *f, const char *fmt, ...)
+{
+	char buf[TEXT_LENGTH_MAX + 1];
+	va_list ap;
+
+	va_start(ap, fmt);
+	(void) vsnprintf(buf, sizeof(buf), fmt, ap);
+	va_end(ap);
+
+	if (f)
+		fprintf(f, "%s\n", buf);
+	else
+		newlinef(c, 0, FROM_INFO, "%s", buf);
+}
+
+static int
+state_stats_cmp(const void *a, const void *b)
+{
+	/* Order handler statistics by total time, descending */
+
+	unsigned long long ns_a = ((const struct irc_recv_stat *)a)->ns;
+	unsigned long long ns_b = ((const struct irc_recv_stat *)b)->ns;
+
+	return (ns_a < ns_b) - (ns_a > ns_b);
+}
+
 static int
 state_input_ctrlch(const char *c, size_t len)
 {
@@ -1046,13 +1454,15 @@ io_cb_read_soc(char *buf, size_t len, const void *cb_obj)
 
 			struct irc_message m;
 
+			s->read.msgs++;
+
 			if (irc_message_parse(&m, s->read.buf) != 0)
 				newlinef(c, 0, FROM_ERROR, "failed to parse message");
 			else
 				irc_recv(s, &m);
 
 			ci = 0;
-		} else if (ci < IRC_MESSAGE_LEN && cc && cc != '\n' && cc != '\r') {
+		} else if (ci < sizeof(s->read.buf) - 1 && cc && cc != '\n' && cc != '\r') {
 			s->read.buf[ci++] = cc;
 		}
 	}
@@ -1060,6 +1470,10 @@ io_cb_read_soc(char *buf, size_t len, const void *cb_obj)
 	s->read.cl = buf[n - 1];
 	s->read.i = ci;
 
+	irc_recv_netsplit(s, time(NULL));
+
+	state_stats_dump(time(NULL));
+
 	draw(DRAW_FLUSH);
 }
 
@@ -1115,12 +1529,20 @@ io_cb_ping(const void *cb_obj, unsigned ping)
 	int ret;
 	struct server *s = (struct server *)cb_obj;
 
+	if (ping == IO_PING_MIN) {
+		if ((ret = io_sendf(s->connection, "PING :%s", s->host)))
+			server_error(s, "sendf fail: %s", io_err(ret));
+	} else if (ping != s->ping) {
+		draw(DRAW_STATUS);
+	}
+
 	s->ping = ping;
 
-	if (ping != IO_PING_MIN)
-		draw(DRAW_STATUS);
-	else if ((ret = io_sendf(s->connection, "PING :%s", s->host)))
-		server_error(s, "sendf fail: %s", io_err(ret));
+	/* Called periodically while connected, collected netsplits are
+	 * written within IO_PING_REFRESH seconds of their window lapsing */
+	irc_recv_netsplit(s, time(NULL));
+
+	state_stats_dump(time(NULL));
 
 	draw(DRAW_FLUSH);
 }
@@ -1141,7 +1563,7 @@ io_cb_info(const void *cb_obj, const char *fmt, ...)
 	va_list ap;
 	va_start(ap, fmt);
 
-	newlinev(((struct server *)cb_obj)->channel, 0, FROM_INFO, fmt, ap);
+	newlinev(((struct server *)cb_obj)->channel, time(NULL), 0, 0, FROM_INFO, fmt, ap);
 
 	va_end(ap);
 
@@ -1154,7 +1576,7 @@ io_cb_error(const void *cb_obj, const char *fmt, ...)
 	va_list ap;
 	va_start(ap, fmt);
 
-	newlinev(((struct server *)cb_obj)->channel, 0, FROM_ERROR, fmt, ap);
+	newlinev(((struct server *)cb_obj)->channel, time(NULL), 0, 0, FROM_ERROR, fmt, ap);
 
 	va_end(ap);
 
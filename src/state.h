@@ -35,4 +35,7 @@ struct server_list* state_server_list(void);
 void channel_set_current(struct channel*);
 void newlinef(struct channel*, enum buffer_line_type, const char*, const char*, ...);
 
+/* Add a line of replayed history sent at time t, drawn at the end of its batch */
+void newline_history(struct channel*, time_t, enum buffer_line_type, const char*, const char*, ...);
+
 #endif
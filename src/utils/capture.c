@@ -0,0 +1,91 @@
+#include "src/utils/capture.h"
+
+#include <inttypes.h>
+#include <string.h>
+
+#define CAPTURE_HEADER "rirc-capture"
+
+int
+capture_header_read(FILE *f)
+{
+	unsigned version;
+
+	if (fscanf(f, CAPTURE_HEADER " %u", &version) != 1 || fgetc(f) != '\n')
+		return -1;
+
+	if (version != CAPTURE_VERSION)
+		return -1;
+
+	return 0;
+}
+
+int
+capture_header_write(FILE *f)
+{
+	if (fprintf(f, CAPTURE_HEADER " %u\n", CAPTURE_VERSION) < 0)
+		return -1;
+
+	return (fflush(f) ? -1 : 0);
+}
+
+int
+capture_read(FILE *f, struct capture_record *r)
+{
+	int c;
+	uint64_t ns;
+	size_t len;
+
+	if ((c = fgetc(f)) == EOF)
+		return 0;
+
+	switch (c) {
+		case CAPTURE_CXED:
+		case CAPTURE_DXED:
+		case CAPTURE_READ:
+			break;
+		default:
+			return -1;
+	}
+
+	if (fscanf(f, " %" SCNu64 " %zu", &ns, &len) != 2 || fgetc(f) != '\n')
+		return -1;
+
+	if (len > sizeof(r->buf) || (c != CAPTURE_READ && len))
+		return -1;
+
+	if (fread(r->buf, 1, len, f) != len || fgetc(f) != '\n')
+		return -1;
+
+	r->event = (enum capture_event) c;
+	r->ns = ns;
+	r->len = len;
+
+	return 1;
+}
+
+int
+capture_write(FILE *f, enum capture_event event, uint64_t ns, const char *buf, size_t len)
+{
+	/* Records are flushed as written, such that a capture is complete up to
+	 * the most recent event when rirc exits abnormally */
+
+	while (len > CAPTURE_READ_LEN) {
+
+		if (capture_write(f, event, ns, buf, CAPTURE_READ_LEN))
+			return -1;
+
+		buf += CAPTURE_READ_LEN;
+		len -= CAPTURE_READ_LEN;
+	}
+
+	if (fprintf(f, "%c %" PRIu64 " %zu\n", (char) event, ns, len) < 0)
+		return -1;
+
+	if (len && fwrite(buf, 1, len, f) != len)
+		return -1;
+
+	if (fputc('\n', f) == EOF)
+		return -1;
+
+	return (fflush(f) ? -1 : 0);
+}
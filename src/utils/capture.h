@@ -0,0 +1,51 @@
+#ifndef RIRC_UTILS_CAPTURE_H
+#define RIRC_UTILS_CAPTURE_H
+
+/* Capture files of connection traffic, for deterministic replay
+ *
+ * A capture begins with a header line, followed by timestamped records
+ * of each connection event and each chunk of data received:
+ *
+ *   rirc-capture <version>\n
+ *   <event> <ns> <len>\n<data>\n
+ *
+ * Where:
+ *   - event: 'C' connected, 'D' disconnected, 'R' data read
+ *   - ns:    nanoseconds since the capture began
+ *   - len:   length of data, 0 for connection events
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define CAPTURE_VERSION 1
+
+/* Largest chunk of data in a single record */
+#define CAPTURE_READ_LEN 4096
+
+enum capture_event
+{
+	CAPTURE_CXED = 'C',
+	CAPTURE_DXED = 'D',
+	CAPTURE_READ = 'R',
+};
+
+struct capture_record
+{
+	enum capture_event event;
+	uint64_t ns;
+	size_t len;
+	char buf[CAPTURE_READ_LEN];
+};
+
+/* Read or write the capture header, returning non-zero on error */
+int capture_header_read(FILE*);
+int capture_header_write(FILE*);
+
+/* Read the next record, returning 1 on success, 0 at end of file, -1 on error */
+int capture_read(FILE*, struct capture_record*);
+
+/* Write a record, returning non-zero on error */
+int capture_write(FILE*, enum capture_event, uint64_t, const char*, size_t);
+
+#endif
@@ -0,0 +1,163 @@
+#include "src/utils/highlight.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* highlight_pattern(const char*, size_t*);
+
+static const char*
+highlight_pattern(const char *str, size_t *len)
+{
+	/* Return the next non-empty pattern of a comma separated list */
+
+	if (str == NULL)
+		return NULL;
+
+	while (*str == ',')
+		str++;
+
+	if (*str == 0)
+		return NULL;
+
+	*len = strcspn(str, ",");
+
+	return str;
+}
+
+int
+highlight_compile(struct highlight *h, enum casemapping cm, const char *nick, const char *keywords)
+{
+	const char *lists[] = { nick, keywords };
+	const char *p;
+	size_t len;
+	size_t n_states = 1;
+	uint16_t *fail;
+	uint16_t *queue;
+	uint8_t folded[256] = {0};
+	unsigned head = 0;
+	unsigned tail = 0;
+	unsigned nc = 1;
+
+	highlight_free(h);
+
+	/* Assign a class to each casemapped byte in the patterns */
+	for (size_t i = 0; i < ARR_LEN(lists); i++) {
+		for (p = lists[i]; (p = highlight_pattern(p, &len)); p += len) {
+
+			for (size_t j = 0; j < len; j++) {
+
+				uint8_t f = (uint8_t) irc_toupper(cm, p[j]);
+
+				if (!folded[f])
+					folded[f] = nc++;
+			}
+
+			n_states += len;
+		}
+	}
+
+	if (n_states > HIGHLIGHT_STATES_MAX)
+		return -1;
+
+	for (unsigned c = 0; c < ARR_LEN(h->classes); c++)
+		h->classes[c] = folded[(uint8_t) irc_toupper(cm, (char) c)];
+
+	if ((h->delta = calloc(n_states * (nc + 2), sizeof(*h->delta))) == NULL)
+		fatal("calloc: %s", strerror(errno));
+
+	if ((fail = malloc(sizeof(*fail) * n_states * 2)) == NULL)
+		fatal("malloc: %s", strerror(errno));
+
+	h->out = h->delta + n_states * nc;
+	h->link = h->out + n_states;
+	h->n_classes = nc;
+	h->n_states = 1;
+
+	/* Build the trie of patterns from the root state 0 */
+	for (size_t i = 0; i < ARR_LEN(lists); i++) {
+		for (p = lists[i]; (p = highlight_pattern(p, &len)); p += len) {
+
+			unsigned s = 0;
+
+			for (size_t j = 0; j < len; j++) {
+
+				uint16_t *t = &(h->delta[s * nc + h->classes[(uint8_t) p[j]]]);
+
+				if (*t == 0)
+					*t = h->n_states++;
+
+				s = *t;
+			}
+
+			h->out[s] = len;
+		}
+	}
+
+	/* Complete each state's transitions breadth first, from the state of
+	 * its longest proper suffix in the trie, and link it to the state of
+	 * its longest suffix matching a pattern */
+	queue = fail + n_states;
+
+	for (unsigned c = 0; c < nc; c++) {
+		if (h->delta[c]) {
+			fail[h->delta[c]] = 0;
+			queue[tail++] = h->delta[c];
+		}
+	}
+
+	while (head < tail) {
+
+		unsigned s = queue[head++];
+
+		h->link[s] = (h->out[fail[s]] ? fail[s] : h->link[fail[s]]);
+
+		for (unsigned c = 0; c < nc; c++) {
+
+			uint16_t *t = &(h->delta[s * nc + c]);
+
+			if (*t) {
+				fail[*t] = h->delta[fail[s] * nc + c];
+				queue[tail++] = *t;
+			} else {
+				*t = h->delta[fail[s] * nc + c];
+			}
+		}
+	}
+
+	free(fail);
+
+	return 0;
+}
+
+int
+highlight_match(struct highlight *h, const char *mesg)
+{
+	unsigned s = 0;
+
+	if (h->delta == NULL)
+		return 0;
+
+	for (const char *p = mesg; *p; p++) {
+
+		s = h->delta[s * h->n_classes + h->classes[(uint8_t) *p]];
+
+		for (unsigned m = (h->out[s] ? s : h->link[s]); m; m = h->link[m]) {
+
+			const char *start = p - h->out[m] + 1;
+
+			if ((start == mesg || !irc_isnickchar(start[-1], 0)) && !irc_isnickchar(p[1], 0))
+				return 1;
+		}
+	}
+
+	return 0;
+}
+
+void
+highlight_free(struct highlight *h)
+{
+	free(h->delta);
+
+	memset(h, 0, sizeof(*h));
+}
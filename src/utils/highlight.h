@@ -0,0 +1,39 @@
+#ifndef RIRC_UTILS_HIGHLIGHT_H
+#define RIRC_UTILS_HIGHLIGHT_H
+
+/* Highlight matching
+ *
+ * The user's nick and a comma separated list of keywords are compiled
+ * under a casemapping into a single Aho-Corasick automaton, such that a
+ * message is matched against all patterns in one pass over its bytes.
+ *
+ * Bytes are mapped to classes of the casemapped bytes in the patterns,
+ * with all other bytes in one class, keeping the transition table small.
+ * Patterns only match as whole words, i.e. not preceded or followed by
+ * a nick character */
+
+#include "src/utils/utils.h"
+
+#include <stdint.h>
+
+#define HIGHLIGHT_STATES_MAX UINT16_MAX
+
+struct highlight
+{
+	uint16_t *delta; /* Transitions of each state, by class */
+	uint16_t *out;   /* Length of the pattern matched in each state */
+	uint16_t *link;  /* State matching the next shorter pattern */
+	uint8_t classes[256];
+	unsigned n_classes;
+	unsigned n_states;
+};
+
+/* Compile the patterns, replacing any previous, NULL for none */
+int highlight_compile(struct highlight*, enum casemapping, const char*, const char*);
+
+/* Return non-zero if a message matches any pattern */
+int highlight_match(struct highlight*, const char*);
+
+void highlight_free(struct highlight*);
+
+#endif
@@ -0,0 +1,153 @@
+#include "src/utils/intern.h"
+
+#include "src/utils/utils.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INTERN_SIZE_MIN 64
+
+struct intern_str
+{
+	struct intern_str *next;
+	struct intern *table;
+	uint32_t hash;
+	unsigned refs;
+	size_t len;
+	char str[];
+};
+
+#define INTERN_STR(S) \
+	((struct intern_str *)((char *)(S) - offsetof(struct intern_str, str)))
+
+static uint32_t intern_hash(const char*, size_t);
+static void intern_grow(struct intern*);
+
+const char*
+intern(struct intern *t, const char *str, size_t len)
+{
+	struct intern_str *s;
+	uint32_t hash = intern_hash(str, len);
+
+	if (t->size) {
+		for (s = t->buckets[hash & (t->size - 1)]; s; s = s->next) {
+			if (s->hash == hash && s->len == len && !memcmp(s->str, str, len)) {
+				s->refs++;
+				return s->str;
+			}
+		}
+	}
+
+	if (t->count == t->size)
+		intern_grow(t);
+
+	if ((s = malloc(sizeof(*s) + len + 1)) == NULL)
+		fatal("malloc: %s", strerror(errno));
+
+	memcpy(s->str, str, len);
+
+	s->str[len] = 0;
+	s->hash = hash;
+	s->len = len;
+	s->refs = 1;
+	s->table = t;
+	s->next = t->buckets[hash & (t->size - 1)];
+
+	t->buckets[hash & (t->size - 1)] = s;
+	t->count++;
+
+	return s->str;
+}
+
+const char*
+intern_ref(const char *str)
+{
+	INTERN_STR(str)->refs++;
+
+	return str;
+}
+
+void
+intern_unref(const char *str)
+{
+	struct intern *t;
+	struct intern_str **p;
+	struct intern_str *s;
+
+	if (str == NULL)
+		return;
+
+	if (--(s = INTERN_STR(str))->refs)
+		return;
+
+	t = s->table;
+
+	for (p = &(t->buckets[s->hash & (t->size - 1)]); *p != s; p = &((*p)->next))
+		continue;
+
+	*p = s->next;
+
+	free(s);
+
+	if (--t->count == 0) {
+		free(t->buckets);
+		t->buckets = NULL;
+		t->size = 0;
+	}
+}
+
+size_t
+intern_memory(struct intern *t)
+{
+	size_t size = sizeof(*t->buckets) * t->size;
+
+	for (size_t i = 0; i < t->size; i++) {
+		for (struct intern_str *s = t->buckets[i]; s; s = s->next)
+			size += sizeof(*s) + s->len + 1;
+	}
+
+	return size;
+}
+
+static uint32_t
+intern_hash(const char *str, size_t len)
+{
+	/* FNV-1a */
+
+	uint32_t hash = 2166136261u;
+
+	while (len--) {
+		hash ^= (unsigned char) *str++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static void
+intern_grow(struct intern *t)
+{
+	/* Double the table's buckets, rehashing each string */
+
+	struct intern_str **buckets;
+	struct intern_str *s;
+	size_t size = (t->size ? t->size * 2 : INTERN_SIZE_MIN);
+
+	if ((buckets = calloc(size, sizeof(*buckets))) == NULL)
+		fatal("calloc: %s", strerror(errno));
+
+	for (size_t i = 0; i < t->size; i++) {
+		while ((s = t->buckets[i])) {
+			t->buckets[i] = s->next;
+			s->next = buckets[s->hash & (size - 1)];
+			buckets[s->hash & (size - 1)] = s;
+		}
+	}
+
+	free(t->buckets);
+
+	t->buckets = buckets;
+	t->size = size;
+}
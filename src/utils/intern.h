@@ -0,0 +1,34 @@
+#ifndef RIRC_UTILS_INTERN_H
+#define RIRC_UTILS_INTERN_H
+
+/* Interned strings
+ *
+ * Equal strings interned in a table share a single reference counted
+ * allocation, e.g. a nick held by many channels' user lists and buffer
+ * lines. Interned strings are immutable, and each refers back to its
+ * table such that it can be released without it.
+ *
+ * A table's memory is freed with its last string */
+
+#include <stddef.h>
+
+struct intern
+{
+	struct intern_str **buckets;
+	size_t count;
+	size_t size;
+};
+
+/* Return the interned copy of a string, with a new reference */
+const char* intern(struct intern*, const char*, size_t);
+
+/* Add a reference to an interned string */
+const char* intern_ref(const char*);
+
+/* Release a reference to an interned string, NULL is ignored */
+void intern_unref(const char*);
+
+/* Return the heap memory used by a table and its strings */
+size_t intern_memory(struct intern*);
+
+#endif
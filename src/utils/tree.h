@@ -14,6 +14,8 @@
 #define AVL_DEL(name, x, y, z)    name##_AVL_DEL(x, y, z)
 #define AVL_GET(name, x, y, z, n) name##_AVL_GET(x, y, z, n)
 #define AVL_FOREACH(name, x, y)   name##_AVL_FOREACH(x, y)
+#define AVL_ARRAY(name, x, y)     name##_AVL_ARRAY(x, y)
+#define AVL_BUILD(name, x, y, z)  name##_AVL_BUILD(x, y, z)
 
 #define TREE_HEAD(type) \
     struct type *tree_root
@@ -32,6 +34,8 @@
     static struct type* name##_AVL_DEL(struct name*, struct type*, void*);        \
     static struct type* name##_AVL_ADD_REC(struct type*, struct type*, void*);    \
     static struct type* name##_AVL_DEL_REC(struct type**, struct type*, void*);   \
+    static struct type* name##_AVL_BUILD_REC(struct type**, size_t);              \
+    static struct type** name##_AVL_ARRAY_REC(struct type*, struct type**);       \
                                                                                   \
 static inline void                                                                \
 name##_AVL_INIT(struct type *elm)                                                 \
@@ -112,6 +116,54 @@ name##_AVL_FOREACH(struct name *head, void (*f)(struct type*))
     name##_AVL_FOREACH_REC(TREE_ROOT(head), f);                                   \
 }                                                                                 \
                                                                                   \
+static struct type**                                                              \
+name##_AVL_ARRAY_REC(struct type *elm, struct type **arr)                         \
+{                                                                                 \
+    if (elm) {                                                                    \
+        arr = name##_AVL_ARRAY_REC(TREE_LEFT(elm, field), arr);                   \
+        *arr++ = elm;                                                             \
+        arr = name##_AVL_ARRAY_REC(TREE_RIGHT(elm, field), arr);                  \
+    }                                                                             \
+                                                                                  \
+    return arr;                                                                   \
+}                                                                                 \
+                                                                                  \
+static inline size_t                                                              \
+name##_AVL_ARRAY(struct name *head, struct type **arr)                            \
+{                                                                                 \
+    /* Write the tree's elements to arr in order, returning the count */          \
+                                                                                  \
+    return (size_t)(name##_AVL_ARRAY_REC(TREE_ROOT(head), arr) - arr);            \
+}                                                                                 \
+                                                                                  \
+static struct type*                                                               \
+name##_AVL_BUILD_REC(struct type **arr, size_t n)                                 \
+{                                                                                 \
+    struct type *elm;                                                             \
+    size_t mid = n / 2;                                                           \
+                                                                                  \
+    if (n == 0)                                                                   \
+        return NULL;                                                              \
+                                                                                  \
+    elm = arr[mid];                                                               \
+                                                                                  \
+    TREE_LEFT(elm, field) = name##_AVL_BUILD_REC(arr, mid);                       \
+    TREE_RIGHT(elm, field) = name##_AVL_BUILD_REC(arr + mid + 1, n - mid - 1);    \
+                                                                                  \
+    name##_AVL_SET_HEIGHT(elm);                                                   \
+                                                                                  \
+    return elm;                                                                   \
+}                                                                                 \
+                                                                                  \
+static inline void                                                                \
+name##_AVL_BUILD(struct name *head, struct type **arr, size_t n)                  \
+{                                                                                 \
+    /* Replace the tree with the n sorted, unique elements of arr, halving        \
+     * at each level such that the result is balanced in a single pass */         \
+                                                                                  \
+    TREE_ROOT(head) = name##_AVL_BUILD_REC(arr, n);                               \
+}                                                                                 \
+                                                                                  \
 static struct type*                                                               \
 name##_AVL_GET(struct name *head, struct type *elm, void *arg, size_t n)          \
 {                                                                                 \
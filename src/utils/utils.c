@@ -1,6 +1,8 @@
 #include "src/utils/utils.h"
+#include "src/utils/utf8_width.h"
 
 #include <errno.h>
+#include <limits.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -8,8 +10,6 @@
 #include <strings.h>
 
 static inline int irc_ischanchar(char, int);
-static inline int irc_isnickchar(char, int);
-static inline int irc_toupper(enum casemapping, int);
 
 int
 irc_isnick(const char *str)
@@ -39,26 +39,6 @@ irc_ischan(const char *str)
 	return 1;
 }
 
-int
-irc_pinged(enum casemapping cm, const char *mesg, const char *nick)
-{
-	size_t len = strlen(nick);
-
-	while (*mesg) {
-
-		while (*mesg && *mesg != *nick && !irc_isnickchar(*mesg, 1))
-			mesg++;
-
-		if (!irc_strncmp(cm, mesg, nick, len) && !irc_isnickchar(*(mesg + len), 0))
-			return 1;
-
-		while (*mesg && *mesg != ' ')
-			mesg++;
-	}
-
-	return 0;
-}
-
 int
 irc_strcmp(enum casemapping cm, const char *s1, const char *s2)
 {
@@ -107,6 +87,29 @@ irc_strncmp(enum casemapping cm, const char *s1, const char *s2, size_t n)
 	return 0;
 }
 
+uint64_t
+irc_strkey(enum casemapping cm, const char *str, size_t n)
+{
+	/* Return the first 8 characters of str, or up to n, casemapped as an
+	 * integer key. Strings with unequal keys compare by irc_strcmp as the
+	 * inverse of their keys, strings with equal keys must be compared */
+
+	int c = 0;
+	uint64_t key = 0;
+
+	for (size_t i = 0; i < 8; i++) {
+
+		if ((!n || i < n) && *str)
+			c = irc_toupper(cm, *str++);
+		else
+			c = 0;
+
+		key = (key << 8) | (uint8_t)(c - CHAR_MIN);
+	}
+
+	return key;
+}
+
 // TODO: reverse return order
 // 0 success, -1 error
 int
@@ -148,9 +151,9 @@ irc_message_param(struct irc_message *m, char **param)
 int
 irc_message_parse(struct irc_message *m, char *buf)
 {
-	/* RFC 2812, section 2.3.1
+	/* RFC 2812, section 2.3.1, with IRCv3 message tags
 	 *
-	 * message    =   [ ":" prefix SPACE ] command [ params ] crlf
+	 * message    =   [ "@" tags SPACE ] [ ":" prefix SPACE ] command [ params ] crlf
 	 * prefix     =   servername / ( nickname [ [ "!" user ] "@" host ] )
 	 * command    =   1*letter / 3digit
 	 * params     =   *14( SPACE middle ) [ SPACE ":" trailing ]
@@ -170,6 +173,24 @@ irc_message_parse(struct irc_message *m, char *buf)
 	if (!irc_strtrim(&buf))
 		return -1;
 
+	if (*buf == '@') {
+
+		/* Tags:
+		 *  = @key[=value]{;key[=value]}
+		 */
+
+		m->tags = ++buf;
+
+		while (*buf && *buf != ' ')
+			buf++;
+
+		if (*buf == ' ')
+			*buf++ = 0;
+
+		if (!irc_strtrim(&buf))
+			return -1;
+	}
+
 	if (*buf == ':') {
 
 		/* Prefix:
@@ -285,6 +306,104 @@ irc_message_split(struct irc_message *m, const char **params, const char **trail
 	return 0;
 }
 
+int
+irc_message_tag(struct irc_message *m, const char *key, char *val, size_t len)
+{
+	/* Copy the unescaped value of a message tag to val, truncating to len
+	 *
+	 * Returns 1 if the tag is present, 0 otherwise, -1 if truncated */
+
+	const char *p = m->tags;
+	size_t key_len = strlen(key);
+	size_t i = 0;
+
+	if (!p || !len)
+		return 0;
+
+	while (*p) {
+
+		if (!strncmp(p, key, key_len) && (p[key_len] == '=' || p[key_len] == ';' || !p[key_len]))
+			break;
+
+		while (*p && *p != ';')
+			p++;
+
+		if (*p == ';')
+			p++;
+	}
+
+	if (!*p)
+		return 0;
+
+	p += key_len;
+
+	if (*p == '=')
+		p++;
+
+	for (; *p && *p != ';'; p++) {
+
+		char c = *p;
+
+		if (c == '\\') {
+			switch (*++p) {
+				case ':': c = ';';  break;
+				case 's': c = ' ';  break;
+				case 'r': c = '\r'; break;
+				case 'n': c = '\n'; break;
+				case ';':
+				case 0:
+					/* Trailing backslash is dropped */
+					p--;
+					continue;
+				default:
+					c = *p;
+			}
+		}
+
+		if (i == len - 1) {
+			val[i] = 0;
+			return -1;
+		}
+
+		val[i++] = c;
+	}
+
+	val[i] = 0;
+
+	return 1;
+}
+
+int
+irc_message_time(struct irc_message *m, time_t *t)
+{
+	/* Parse a message's server-time tag, "YYYY-MM-DDThh:mm:ss.sssZ", UTC
+	 *
+	 * Returns 1 if parsed, 0 otherwise */
+
+	char time[32];
+	unsigned y, mo, d, h, mi, sec;
+	unsigned long days;
+
+	if (irc_message_tag(m, "time", time, sizeof(time)) != 1)
+		return 0;
+
+	if (sscanf(time, "%4u-%2u-%2uT%2u:%2u:%2u", &y, &mo, &d, &h, &mi, &sec) != 6)
+		return 0;
+
+	if (y < 1970 || mo < 1 || mo > 12 || d < 1 || d > 31 || h > 23 || mi > 59 || sec > 60)
+		return 0;
+
+	/* Days since the epoch, counting years from March */
+	y -= (mo <= 2);
+	days = 365UL * y + y / 4 - y / 100 + y / 400;
+	days += (153 * (mo > 2 ? mo - 3 : mo + 9) + 2) / 5 + d - 1;
+	days -= 719468;
+
+	*t = (time_t)(days * 86400 + h * 3600 + mi * 60 + sec);
+
+	return 1;
+}
+
 char*
 irc_strdup(const char *str)
 {
@@ -337,6 +456,87 @@ irc_strtrim(char **str)
 	return *p ? p : NULL;
 }
 
+size_t
+utf8_decode(const char *str, size_t len, uint32_t *cp, unsigned *width)
+{
+	/* Decode the UTF-8 code point at `str` and its display width in a single
+	 * pass, returning the number of bytes consumed. Malformed sequences
+	 * consume a single byte and decode as U+FFFD */
+
+	const unsigned char *s = (const unsigned char *)str;
+	uint32_t c;
+	uint32_t min;
+	size_t n;
+
+	if (!len)
+		return 0;
+
+	if (s[0] < 0x80) {
+		*cp = s[0];
+		*width = 1;
+		return 1;
+	}
+
+	if ((s[0] & 0xE0) == 0xC0) {
+		c = s[0] & 0x1F;
+		min = 0x80;
+		n = 2;
+	} else if ((s[0] & 0xF0) == 0xE0) {
+		c = s[0] & 0x0F;
+		min = 0x800;
+		n = 3;
+	} else if ((s[0] & 0xF8) == 0xF0) {
+		c = s[0] & 0x07;
+		min = 0x10000;
+		n = 4;
+	} else {
+		goto malformed;
+	}
+
+	if (n > len)
+		goto malformed;
+
+	for (size_t i = 1; i < n; i++) {
+		if ((s[i] & 0xC0) != 0x80)
+			goto malformed;
+		c = (c << 6) | (s[i] & 0x3F);
+	}
+
+	if (c < min || c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF))
+		goto malformed;
+
+	*cp = c;
+	*width = utf8_width(c);
+
+	return n;
+
+malformed:
+
+	*cp = 0xFFFD;
+	*width = 1;
+
+	return 1;
+}
+
+unsigned
+utf8_width(uint32_t cp)
+{
+	/* Return the display width of a code point, 0, 1 or 2 columns */
+
+	unsigned block;
+
+	if (cp < 0x300)
+		return 1;
+
+	if (cp >= (sizeof(utf8_width_stage1) * UTF8_WIDTH_BLOCK))
+		return 1;
+
+	block = utf8_width_stage1[cp / UTF8_WIDTH_BLOCK];
+	cp %= UTF8_WIDTH_BLOCK;
+
+	return (utf8_width_stage2[block][cp / 4] >> ((cp % 4) * 2)) & 0x3;
+}
+
 static inline int
 irc_ischanchar(char c, int first)
 {
@@ -367,7 +567,7 @@ irc_ischanchar(char c, int first)
 	}
 }
 
-static inline int
+int
 irc_isnickchar(char c, int first)
 {
 	/* RFC 2812, section 2.3.1
@@ -381,7 +581,7 @@ irc_isnickchar(char c, int first)
 	return ((c >= 0x41 && c <= 0x7D) || (!first && ((c >= 0x30 && c <= 0x39) || c == '-')));
 }
 
-static inline int
+int
 irc_toupper(enum casemapping cm, int c)
 {
 	/* RFC 2812, section 2.2
@@ -1,8 +1,10 @@
 #ifndef RIRC_UTILS_UTILS_H
 #define RIRC_UTILS_UTILS_H
 
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 
 #define ARR_LEN(A) (sizeof((A)) / sizeof((A)[0]))
 
@@ -60,6 +62,7 @@ struct irc_message
 	const char *command;
 	const char *from;
 	const char *host;
+	const char *tags;
 	size_t len_command;
 	size_t len_from;
 	size_t len_host;
@@ -69,15 +72,22 @@ struct irc_message
 
 int irc_ischan(const char*);
 int irc_isnick(const char*);
-int irc_pinged(enum casemapping, const char*, const char*);
+int irc_isnickchar(char, int);
 int irc_strcmp(enum casemapping, const char*, const char*);
 int irc_strncmp(enum casemapping, const char*, const char*, size_t);
+uint64_t irc_strkey(enum casemapping, const char*, size_t);
 char* irc_strdup(const char*);
 char* irc_strsep(char**);
 char* irc_strtrim(char**);
+int irc_toupper(enum casemapping, int);
 
 int irc_message_param(struct irc_message*, char**);
 int irc_message_parse(struct irc_message*, char*);
 int irc_message_split(struct irc_message*, const char**, const char**);
+int irc_message_tag(struct irc_message*, const char*, char*, size_t);
+int irc_message_time(struct irc_message*, time_t*);
+
+size_t utf8_decode(const char*, size_t, uint32_t*, unsigned*);
+unsigned utf8_width(uint32_t);
 
 #endif
@@ -2,6 +2,7 @@
 
 #include "test/test.h"
 #include "src/components/buffer.c"
+#include "src/utils/intern.c"
 #include "src/utils/utils.c"
 
 static struct buffer *b;
@@ -17,12 +18,18 @@ t__fmt_int(int i)
 	return buff;
 }
 
+static size_t
+t__parse_irc_colour(const char *str, int *fg, int *bg)
+{
+	return buffer_parse_irc_colour(str, strlen(str), fg, bg);
+}
+
 static void
 t__buffer_newline(struct buffer *buffer, const char *t)
 {
 	/* Abstract newline with default values */
 
-	buffer_newline(buffer, BUFFER_LINE_OTHER, "", t, 0, strlen(t), 0);
+	buffer_newline(buffer, NULL, BUFFER_LINE_OTHER, 0, "", t, 0, strlen(t), 0);
 }
 
 static void
@@ -92,6 +99,11 @@ test_buffer_line(void)
 	assert_ptr_null(buffer_line(b, b->tail));
 	assert_ptr_null(buffer_line(b, b->scrollback));
 
+	/* Line storage is allocated on first write */
+	assert_ptr_null(b->buffer_lines);
+	t__buffer_newline(b, "");
+	assert_ptr_not_null(b->buffer_lines);
+
 	/* For any buffer line retrieval, these conditions should always hold */
 	#define CHECK_BUFFER(B) \
 	    assert_fatal(buffer_line((B), (B)->tail - 1)); \
@@ -253,7 +265,7 @@ test_buffer_newline_prefix(void)
 	text_str = "abc";
 	text_len = strlen(text_str);
 
-	buffer_newline(b, BUFFER_LINE_OTHER, from_str, text_str, from_len, text_len, 0);
+	buffer_newline(b, NULL, BUFFER_LINE_OTHER, 0, from_str, text_str, from_len, text_len, 0);
 
 	line = buffer_head(b);
 
@@ -261,7 +273,7 @@ test_buffer_newline_prefix(void)
 	assert_strcmp(line->from, "testing");
 	assert_ueq(line->from_len, strlen("testing"));
 
-	buffer_newline(b, BUFFER_LINE_OTHER, from_str, text_str, from_len, text_len, '@');
+	buffer_newline(b, NULL, BUFFER_LINE_OTHER, 0, from_str, text_str, from_len, text_len, '@');
 
 	line = buffer_head(b);
 
@@ -269,6 +281,12 @@ test_buffer_newline_prefix(void)
 	assert_strcmp(line->from, "@testing");
 	assert_ueq(line->from_len, strlen("@testing"));
 
+	/* Test `from` is interned, and shared between lines */
+	buffer_newline(b, NULL, BUFFER_LINE_OTHER, 0, from_str, text_str, from_len, text_len, 0);
+
+	assert_ptr_eq(buffer_head(b)->from, buffer_line(b, b->head - 3)->from);
+	assert_true(buffer_head(b)->from != buffer_line(b, b->head - 2)->from);
+
 	/* Test truncating `from` */
 
 	/* If, FROM_LENGTH_MAX = 100, then:
@@ -288,20 +306,497 @@ test_buffer_newline_prefix(void)
 	from_str = _from;
 	from_len = FROM_LENGTH_MAX;
 
-	buffer_newline(b, BUFFER_LINE_OTHER, from_str, text_str, from_len, text_len, 0);
+	buffer_newline(b, NULL, BUFFER_LINE_OTHER, 0, from_str, text_str, from_len, text_len, 0);
 
 	line = buffer_head(b);
 	assert_ueq(line->from_len, FROM_LENGTH_MAX);
 	assert_eq(line->from[FROM_LENGTH_MAX - 1], 'c');
 
 
-	buffer_newline(b, BUFFER_LINE_OTHER, from_str, text_str, from_len, text_len, '@');
+	buffer_newline(b, NULL, BUFFER_LINE_OTHER, 0, from_str, text_str, from_len, text_len, '@');
 
 	line = buffer_head(b);
 	assert_ueq(line->from_len, FROM_LENGTH_MAX);
 	assert_eq(line->from[FROM_LENGTH_MAX - 1], 'b');
 }
 
+static void
+test_buffer_newline_format(void)
+{
+	/* Test formatting codes are parsed to runs and stripped from text */
+
+	struct buffer_line *line;
+
+	/* Unformatted */
+	t__buffer_newline(b, "abc");
+
+	line = buffer_head(b);
+	assert_strcmp(line->text, "abc");
+	assert_ptr_null(line->runs);
+	assert_ueq(line->runs_len, 0);
+
+	/* Formatting codes with no formatted text */
+	t__buffer_newline(b, "\x02\x02" "a" "\x03" "4" "\x03");
+
+	line = buffer_head(b);
+	assert_strcmp(line->text, "a");
+	assert_ueq(line->text_len, 1);
+	assert_ptr_null(line->runs);
+
+	/* Toggles, colours and reset, adjacent equal runs are merged */
+	t__buffer_newline(b, "a\x02" "bc\x1D" "d\x03" "4,5e\x0F" "f\x02\x02" "g\x03" ",99h\x03" "i");
+
+	line = buffer_head(b);
+	assert_strcmp(line->text, "abcdefghi");
+	assert_ueq(line->text_len, 9);
+	assert_ueq(line->runs_len, 5);
+
+	assert_ueq(line->runs[0].offset, 0);
+	assert_ueq(line->runs[0].len, 1);
+	assert_eq(line->runs[0].fg, -1);
+	assert_eq(line->runs[0].bg, -1);
+	assert_ueq(line->runs[0].flags, 0);
+
+	assert_ueq(line->runs[1].offset, 1);
+	assert_ueq(line->runs[1].len, 2);
+	assert_ueq(line->runs[1].flags, BUFFER_RUN_BOLD);
+
+	assert_ueq(line->runs[2].offset, 3);
+	assert_ueq(line->runs[2].len, 1);
+	assert_ueq(line->runs[2].flags, BUFFER_RUN_BOLD | BUFFER_RUN_ITALIC);
+
+	assert_ueq(line->runs[3].offset, 4);
+	assert_ueq(line->runs[3].len, 1);
+	assert_eq(line->runs[3].fg, 4);
+	assert_eq(line->runs[3].bg, 5);
+	assert_ueq(line->runs[3].flags, BUFFER_RUN_BOLD | BUFFER_RUN_ITALIC);
+
+	assert_ueq(line->runs[4].offset, 5);
+	assert_ueq(line->runs[4].len, 4);
+	assert_eq(line->runs[4].fg, -1);
+	assert_eq(line->runs[4].bg, -1);
+	assert_ueq(line->runs[4].flags, 0);
+
+	/* Colour 99 is the default colour */
+	t__buffer_newline(b, "\x03" "4,5a\x03" "99b");
+
+	line = buffer_head(b);
+	assert_strcmp(line->text, "ab");
+	assert_ueq(line->runs_len, 2);
+	assert_eq(line->runs[0].fg, 4);
+	assert_eq(line->runs[0].bg, 5);
+	assert_eq(line->runs[1].fg, -1);
+	assert_eq(line->runs[1].bg, 5);
+
+	/* Control characters other than formatting codes are kept */
+	t__buffer_newline(b, "\x01" "a\x1F" "b");
+
+	line = buffer_head(b);
+	assert_strcmp(line->text, "\x01" "ab");
+	assert_ueq(line->runs_len, 2);
+	assert_ueq(line->runs[1].flags, BUFFER_RUN_UNDERLINE);
+}
+
+static void
+test_buffer_irc_colour(void)
+{
+	int fg;
+	int bg;
+
+	fg = -2;
+	bg = -2;
+	assert_eq(t__parse_irc_colour("xxx", &fg, &bg), 0);
+	assert_eq(fg, -2);
+	assert_eq(bg, -2);
+
+	fg = -2;
+	bg = -2;
+	assert_eq(t__parse_irc_colour("\x03", &fg, &bg), 1);
+	assert_eq(fg, -1);
+	assert_eq(bg, -1);
+
+	fg = -2;
+	bg = -2;
+	assert_eq(t__parse_irc_colour("\x03xxx", &fg, &bg), 1);
+	assert_eq(fg, -1);
+	assert_eq(bg, -1);
+
+	fg = -2;
+	bg = -2;
+	assert_eq(t__parse_irc_colour("\x03,", &fg, &bg), 1);
+	assert_eq(fg, -1);
+	assert_eq(bg, -1);
+
+	fg = -2;
+	bg = -2;
+	assert_eq(t__parse_irc_colour("\x03,1", &fg, &bg), 3);
+	assert_eq(fg, -2);
+	assert_eq(bg, 1);
+
+	fg = -2;
+	bg = -2;
+	assert_eq(t__parse_irc_colour("\x03,11", &fg, &bg), 4);
+	assert_eq(fg, -2);
+	assert_eq(bg, 11);
+
+	fg = -2;
+	bg = -2;
+	assert_eq(t__parse_irc_colour("\x03" "2", &fg, &bg), 2);
+	assert_eq(fg, 2);
+	assert_eq(bg, -2);
+
+	fg = -2;
+	bg = -2;
+	assert_eq(t__parse_irc_colour("\x03" "3,", &fg, &bg), 2);
+	assert_eq(fg, 3);
+	assert_eq(bg, -2);
+
+	fg = -2;
+	bg = -2;
+	assert_eq(t__parse_irc_colour("\x03" "4,5", &fg, &bg), 4);
+	assert_eq(fg, 4);
+	assert_eq(bg, 5);
+
+	fg = -2;
+	bg = -2;
+	assert_eq(t__parse_irc_colour("\x03" "6,77", &fg, &bg), 5);
+	assert_eq(fg, 6);
+	assert_eq(bg, 77);
+
+	fg = -2;
+	bg = -2;
+	assert_eq(t__parse_irc_colour("\x03" "11", &fg, &bg), 3);
+	assert_eq(fg, 11);
+	assert_eq(bg, -2);
+
+	fg = -2;
+	bg = -2;
+	assert_eq(t__parse_irc_colour("\x03" "22,", &fg, &bg), 3);
+	assert_eq(fg, 22);
+	assert_eq(bg, -2);
+
+	fg = -2;
+	bg = -2;
+	assert_eq(t__parse_irc_colour("\x03" "33,4", &fg, &bg), 5);
+	assert_eq(fg, 33);
+	assert_eq(bg, 4);
+
+	fg = -2;
+	bg = -2;
+	assert_eq(t__parse_irc_colour("\x03" "55,66", &fg, &bg), 6);
+	assert_eq(fg, 55);
+	assert_eq(bg, 66);
+
+	fg = -2;
+	bg = -2;
+	assert_eq(t__parse_irc_colour("\x03" "111", &fg, &bg), 3);
+	assert_eq(fg, 11);
+	assert_eq(bg, -2);
+
+	fg = -2;
+	bg = -2;
+	assert_eq(t__parse_irc_colour("\x03" "222,", &fg, &bg), 3);
+	assert_eq(fg, 22);
+	assert_eq(bg, -2);
+
+	fg = -2;
+	bg = -2;
+	assert_eq(t__parse_irc_colour("\x03" "333,4,", &fg, &bg), 3);
+	assert_eq(fg, 33);
+	assert_eq(bg, -2);
+
+	fg = -2;
+	bg = -2;
+	assert_eq(t__parse_irc_colour("\x03" "1,222", &fg, &bg), 5);
+	assert_eq(fg, 1);
+	assert_eq(bg, 22);
+
+	fg = -2;
+	bg = -2;
+	assert_eq(t__parse_irc_colour("\x03" "22,333", &fg, &bg), 6);
+	assert_eq(fg, 22);
+	assert_eq(bg, 33);
+
+	fg = -2;
+	bg = -2;
+	assert_eq(t__parse_irc_colour("\x03" "11,22", &fg, NULL), 6);
+	assert_eq(fg, 11);
+	assert_eq(bg, -2);
+
+	fg = -2;
+	bg = -2;
+	assert_eq(t__parse_irc_colour("\x03" "11,22", NULL, &bg), 6);
+	assert_eq(fg, -2);
+	assert_eq(bg, 22);
+
+	assert_eq(t__parse_irc_colour("\x03", NULL, NULL), 1);
+	assert_eq(t__parse_irc_colour("\x03" "11", NULL, NULL), 3);
+	assert_eq(t__parse_irc_colour("\x03" ",22", NULL, NULL), 4);
+	assert_eq(t__parse_irc_colour("\x03" "11,22", NULL, NULL), 6);
+
+	/* Test parsing is bounded by length */
+	fg = -2;
+	bg = -2;
+	assert_eq(buffer_parse_irc_colour("\x03" "11,22", 4, &fg, &bg), 3);
+	assert_eq(fg, 11);
+	assert_eq(bg, -2);
+
+	assert_eq(buffer_parse_irc_colour("\x03" "11,22", 0, &fg, &bg), 0);
+}
+
+static void
+test_buffer_cold(void)
+{
+	/* Test lines falling out of the hot region are packed into cold
+	 * blocks, thawed on access and frozen again at the buffer head */
+
+	int i;
+	struct buffer_line *line;
+
+	for (i = 0; i < BUFFER_LINES_HOT + BUFFER_BLOCK_LINES - 1; i++)
+		t__buffer_newline(b, t__fmt_int(i));
+
+	assert_ptr_null(b->buffer_lines[0].block);
+	assert_ptr_not_null(b->buffer_lines[0].text);
+
+	t__buffer_newline(b, t__fmt_int(i++));
+
+	for (int j = 0; j < BUFFER_BLOCK_LINES; j++) {
+		assert_ptr_not_null(b->buffer_lines[j].block);
+		assert_ptr_null(b->buffer_lines[j].text);
+	}
+
+	assert_ptr_null(b->buffer_lines[BUFFER_BLOCK_LINES].block);
+	assert_ueq(b->thawed, 0);
+
+	/* Thaw on access while scrolled back */
+	b->scrollback = b->tail;
+
+	line = buffer_line(b, b->tail + 1);
+
+	assert_strcmp(line->text, t__fmt_int(1));
+	assert_strcmp(b->buffer_lines[0].text, t__fmt_int(0));
+	assert_strcmp(b->buffer_lines[BUFFER_BLOCK_LINES - 1].text, t__fmt_int(BUFFER_BLOCK_LINES - 1));
+	assert_ueq(b->thawed, 1);
+
+	/* Remains thawed while scrolled back */
+	t__buffer_newline(b, t__fmt_int(i++));
+
+	assert_ueq(b->thawed, 1);
+	assert_strcmp(line->text, t__fmt_int(1));
+
+	/* Frozen at the buffer head */
+	b->scrollback = b->head - 1;
+
+	t__buffer_newline(b, t__fmt_int(i++));
+
+	assert_ueq(b->thawed, 0);
+	assert_ptr_null(line->text);
+	assert_strcmp(buffer_line(b, b->tail + 2)->text, t__fmt_int(2));
+
+	/* Lines evicted from the tail release the block */
+	while (i < BUFFER_LINES_MAX + BUFFER_BLOCK_LINES)
+		t__buffer_newline(b, t__fmt_int(i++));
+
+	assert_strcmp(buffer_tail(b)->text, t__fmt_int(BUFFER_BLOCK_LINES));
+	assert_strcmp(buffer_head(b)->text, t__fmt_int(BUFFER_LINES_MAX + BUFFER_BLOCK_LINES - 1));
+
+	for (i = 0; i < BUFFER_LINES_MAX; i++)
+		assert_strcmp(buffer_line(b, b->tail + i)->text, t__fmt_int(BUFFER_BLOCK_LINES + i));
+
+	assert_true(buffer_stats()->cold_bytes_packed > 0);
+	assert_true(buffer_stats()->thaw_count > 0);
+}
+
+static void
+test_buffer_grow(void)
+{
+	/* Test line storage grows by powers of 2 and preserves lines */
+
+	int i;
+
+	assert_ptr_null(b->buffer_lines);
+	assert_ueq(b->buffer_lines_max, 0);
+
+	t__buffer_newline(b, t__fmt_int(0));
+
+	assert_ueq(b->buffer_lines_max, BUFFER_BLOCK_LINES);
+
+	for (i = 1; i < BUFFER_BLOCK_LINES + 1; i++)
+		t__buffer_newline(b, t__fmt_int(i));
+
+	assert_ueq(b->buffer_lines_max, BUFFER_BLOCK_LINES * 2);
+
+	for (; i < BUFFER_LINES_MAX * 2; i++)
+		t__buffer_newline(b, t__fmt_int(i));
+
+	assert_ueq(b->buffer_lines_max, BUFFER_LINES_MAX);
+	assert_strcmp(buffer_tail(b)->text, t__fmt_int(BUFFER_LINES_MAX));
+	assert_strcmp(buffer_head(b)->text, t__fmt_int(BUFFER_LINES_MAX * 2 - 1));
+
+	/* Test growing from an offset tail, across index overflow */
+	buffer_free(b);
+	buffer(b);
+
+	b->head = b->tail = b->scrollback = UINT_MAX - BUFFER_BLOCK_LINES;
+
+	for (i = 0; i < BUFFER_BLOCK_LINES * 3; i++)
+		t__buffer_newline(b, t__fmt_int(i));
+
+	assert_ueq(b->buffer_lines_max, BUFFER_BLOCK_LINES * 4);
+
+	for (i = 0; i < BUFFER_BLOCK_LINES * 3; i++)
+		assert_strcmp(buffer_line(b, b->tail + i)->text, t__fmt_int(i));
+}
+
+static void
+test_buffer_compact(void)
+{
+	/* Test compacting packs all full blocks, including hot lines */
+
+	int i;
+
+	for (i = 0; i < BUFFER_BLOCK_LINES * 2 + 1; i++)
+		t__buffer_newline(b, t__fmt_int(i));
+
+	buffer_compact(b);
+
+	assert_ptr_not_null(b->buffer_lines[0].block);
+	assert_ptr_not_null(b->buffer_lines[BUFFER_BLOCK_LINES].block);
+	assert_ptr_null(b->buffer_lines[BUFFER_BLOCK_LINES * 2].block);
+	assert_ptr_null(b->buffer_lines[BUFFER_BLOCK_LINES].text);
+
+	/* Hot lines thaw on view and aren't frozen again at the buffer head */
+	assert_strcmp(buffer_line(b, b->tail + BUFFER_BLOCK_LINES)->text, t__fmt_int(BUFFER_BLOCK_LINES));
+	assert_ueq(b->thawed, 1);
+
+	t__buffer_newline(b, t__fmt_int(i++));
+
+	assert_ueq(b->thawed, 1);
+	assert_strcmp(b->buffer_lines[BUFFER_BLOCK_LINES].text, t__fmt_int(BUFFER_BLOCK_LINES));
+
+	/* Compacting again freezes thawed blocks, releasing summed rows and packed lines' breaks */
+	buffer_rows_reset(b, 80);
+	b->buffer_lines[0].cached.rows = 2;
+	b->buffer_lines[BUFFER_BLOCK_LINES * 2].cached.rows = 2;
+
+	if (!(b->buffer_lines[0].cached.breaks = calloc(2, sizeof(uint16_t))))
+		abort();
+
+	if (!(b->buffer_lines[BUFFER_BLOCK_LINES * 2].cached.breaks = calloc(2, sizeof(uint16_t))))
+		abort();
+
+	buffer_compact(b);
+
+	assert_ueq(b->thawed, 0);
+	assert_ptr_null(b->buffer_lines[BUFFER_BLOCK_LINES].text);
+	assert_ptr_null(b->buffer_lines[0].cached.breaks);
+	assert_ptr_not_null(b->buffer_lines[BUFFER_BLOCK_LINES * 2].cached.breaks);
+	assert_ptr_null(b->rows.tree);
+
+	for (i = 0; i < BUFFER_BLOCK_LINES * 2 + 2; i++)
+		assert_strcmp(buffer_line(b, b->tail + i)->text, t__fmt_int(i));
+}
+
+static void
+test_buffer_rows(void)
+{
+	/* Test summing and searching line rows, across slot and index wrapping */
+
+	unsigned i;
+	unsigned j;
+	unsigned rows;
+
+	assert_ueq(buffer_rows(b, 0, 1), 0);
+	assert_ueq(buffer_rows_find(b, 0), UINT_MAX);
+
+	b->head = b->tail = b->scrollback = UINT_MAX - 10;
+
+	for (i = 0; i < BUFFER_LINES_MAX + 100; i++)
+		t__buffer_newline(b, t__fmt_int(i));
+
+	buffer_rows_reset(b, 80);
+
+	assert_ueq(b->rows.synced, b->tail);
+	assert_ueq(buffer_rows(b, b->tail, b->head), 0);
+
+	/* Line `i` occupies (i % 3) + 1 rows */
+	for (i = b->tail; i != b->head; i++)
+		buffer_rows_set(b, i, ((i - b->tail) % 3) + 1);
+
+	assert_ueq(buffer_rows(b, b->tail, b->head), 2 * BUFFER_LINES_MAX - 1);
+	assert_ueq(buffer_rows(b, b->tail, b->tail + 3), 6);
+	assert_ueq(buffer_rows(b, b->head - 1, b->head), 1);
+
+	for (i = 0, rows = 0; i < BUFFER_LINES_MAX; i++) {
+		for (j = 0; j < (i % 3) + 1; j++, rows++) {
+			if (buffer_rows_find(b, rows) != b->tail + i)
+				break;
+		}
+		if (j != (i % 3) + 1)
+			break;
+	}
+
+	assert_ueq(i, BUFFER_LINES_MAX);
+
+	/* Test out of range rows find the head line */
+	assert_ueq(buffer_rows_find(b, rows), b->head - 1);
+
+	/* Test updating a line's rows */
+	buffer_rows_set(b, b->tail, 10);
+
+	assert_ueq(buffer_rows(b, b->tail, b->head), 2 * BUFFER_LINES_MAX + 8);
+	assert_ueq(buffer_rows_find(b, 9), b->tail);
+	assert_ueq(buffer_rows_find(b, 10), b->tail + 1);
+}
+
+static void
+test_buffer_lz(void)
+{
+	/* Test LZ round trips of incompressible, repetitive and mixed input */
+
+	unsigned char src[4096] = {0};
+	unsigned char dst[BUFFER_LZ_BOUND(sizeof(src))];
+	unsigned char out[sizeof(src)];
+	size_t len;
+	size_t n;
+
+	/* Empty input */
+	assert_ueq(buffer_lz_pack(src, 0, dst), 0);
+	assert_ueq(buffer_lz_unpack(dst, 0, out, sizeof(out)), 0);
+
+	/* Incompressible input within bound */
+	for (n = 0; n < sizeof(src); n++)
+		src[n] = (n * 2654435761U) >> 13;
+
+	len = buffer_lz_pack(src, sizeof(src), dst);
+	assert_true(len <= BUFFER_LZ_BOUND(sizeof(src)));
+	assert_ueq(buffer_lz_unpack(dst, len, out, sizeof(out)), sizeof(src));
+	assert_true(!memcmp(src, out, sizeof(src)));
+
+	/* Repetitive input, overlapping matches */
+	memset(src, 'a', sizeof(src));
+
+	len = buffer_lz_pack(src, sizeof(src), dst);
+	assert_true(len < sizeof(src) / 16);
+	assert_ueq(buffer_lz_unpack(dst, len, out, sizeof(out)), sizeof(src));
+	assert_true(!memcmp(src, out, sizeof(src)));
+
+	/* Mixed text */
+	for (n = 0; n < sizeof(src); n++)
+		src[n] = "<nick> hello world, testing "[(n * 7 / 3) % 28] + (n % 97 == 0);
+
+	len = buffer_lz_pack(src, sizeof(src), dst);
+	assert_true(len < sizeof(src));
+	assert_ueq(buffer_lz_unpack(dst, len, out, sizeof(out)), sizeof(src));
+	assert_true(!memcmp(src, out, sizeof(src)));
+
+	/* Output exceeding max, malformed input */
+	assert_ueq(buffer_lz_unpack(dst, len, out, sizeof(out) - 1), 0);
+	assert_ueq(buffer_lz_unpack((unsigned char *)"\x80\x00\x01", 3, out, sizeof(out)), 0);
+	assert_ueq(buffer_lz_unpack((unsigned char *)"\x05" "ab", 3, out, sizeof(out)), 0);
+}
+
 static int
 test_init(void)
 {
@@ -315,6 +810,7 @@ test_init(void)
 static int
 test_term(void)
 {
+	buffer_free(b);
 	free(b);
 
 	return 0;
@@ -332,6 +828,13 @@ main(void)
 		TESTCASE(test_buffer_index_overflow),
 		TESTCASE(test_buffer_newline),
 		TESTCASE(test_buffer_newline_prefix),
+		TESTCASE(test_buffer_newline_format),
+		TESTCASE(test_buffer_irc_colour),
+		TESTCASE(test_buffer_cold),
+		TESTCASE(test_buffer_grow),
+		TESTCASE(test_buffer_compact),
+		TESTCASE(test_buffer_rows),
+		TESTCASE(test_buffer_lz),
 	};
 
 	return run_tests(test_init, test_term, tests);
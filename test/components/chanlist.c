@@ -0,0 +1,137 @@
+#include "test/test.h"
+
+#include "src/components/chanlist.c"
+#include "src/utils/utils.c"
+
+static void
+test_chanlist(void)
+{
+	/* Test entries are stored, reset and freed */
+
+	char topic[1024];
+	struct chanlist cl = {0};
+	const struct chanlist_entry *e;
+
+	assert_eq(chanlist_memory(&cl), 0);
+
+	chanlist_add(&cl, "#a", 1, "topic a");
+	chanlist_add(&cl, "#b", 2, "");
+
+	assert_ueq(cl.entries_len, 2);
+	assert_ueq(cl.strs_len, sizeof("#a") + sizeof("topic a") + sizeof("#b") + sizeof(""));
+	assert_true(cl.stale);
+
+	assert_strcmp(chanlist_name(&cl, &(cl.entries[0])), "#a");
+	assert_strcmp(chanlist_topic(&cl, &(cl.entries[0])), "topic a");
+	assert_strcmp(chanlist_name(&cl, &(cl.entries[1])), "#b");
+	assert_strcmp(chanlist_topic(&cl, &(cl.entries[1])), "");
+
+	/* Test string table growth */
+	memset(topic, 'x', sizeof(topic) - 1);
+	topic[sizeof(topic) - 1] = 0;
+
+	for (unsigned i = 0; i < 1000; i++)
+		chanlist_add(&cl, "#c", i, topic);
+
+	assert_ueq(cl.entries_len, 1002);
+	assert_strcmp(chanlist_topic(&cl, &(cl.entries[1001])), topic);
+	assert_gt(chanlist_memory(&cl), 1000 * sizeof(topic));
+
+	chanlist_view(&cl, CASEMAPPING_RFC1459);
+
+	assert_ueq(cl.view_len, 1002);
+	assert_false(cl.stale);
+
+	chanlist_reset(&cl);
+
+	assert_ueq(cl.entries_len, 0);
+	assert_ueq(cl.view_len, 0);
+	assert_ptr_null(chanlist_view_entry(&cl, 0));
+
+	chanlist_add(&cl, "#d", 4, "topic d");
+
+	chanlist_view(&cl, CASEMAPPING_RFC1459);
+
+	assert_ptr_not_null((e = chanlist_view_entry(&cl, 0)));
+	assert_strcmp(chanlist_name(&cl, e), "#d");
+	assert_ptr_null(chanlist_view_entry(&cl, 1));
+
+	chanlist_free(&cl);
+
+	assert_ptr_null(cl.strs);
+	assert_ptr_null(cl.entries);
+	assert_ptr_null(cl.view);
+	assert_eq(chanlist_memory(&cl), 0);
+}
+
+static void
+test_chanlist_view(void)
+{
+	/* Test the view is filtered and sorted */
+
+	struct chanlist cl = {0};
+
+#define CHECK_VIEW(N, ...) \
+	do { \
+		const char *names[] = { __VA_ARGS__ }; \
+		assert_ueq(cl.view_len, (N)); \
+		for (size_t i = 0; i < (N); i++) \
+			assert_strcmp(chanlist_name(&cl, chanlist_view_entry(&cl, i)), names[i]); \
+	} while (0)
+
+	chanlist_add(&cl, "#rirc", 10, "");
+	chanlist_add(&cl, "#c", 100, "");
+	chanlist_add(&cl, "#IRC", 10, "");
+	chanlist_add(&cl, "#a", 1, "");
+	chanlist_add(&cl, "#irc[x]", 50, "");
+
+	chanlist_view(&cl, CASEMAPPING_RFC1459);
+	CHECK_VIEW(5, "#c", "#irc[x]", "#IRC", "#rirc", "#a");
+
+	cl.filter.sort = CHANLIST_SORT_NAME;
+	chanlist_view(&cl, CASEMAPPING_RFC1459);
+	CHECK_VIEW(5, "#a", "#c", "#IRC", "#irc[x]", "#rirc");
+
+	/* Test user counts are exclusive */
+	cl.filter.users_min = 1;
+	cl.filter.users_max = 100;
+	chanlist_view(&cl, CASEMAPPING_RFC1459);
+	CHECK_VIEW(3, "#IRC", "#irc[x]", "#rirc");
+
+	cl.filter.users_min = 10;
+	cl.filter.users_max = 0;
+	chanlist_view(&cl, CASEMAPPING_RFC1459);
+	CHECK_VIEW(2, "#c", "#irc[x]");
+
+	/* Test matching names under casemapping */
+	cl.filter.users_min = 0;
+	strcpy(cl.filter.match, "irc");
+	chanlist_view(&cl, CASEMAPPING_RFC1459);
+	CHECK_VIEW(3, "#IRC", "#irc[x]", "#rirc");
+
+	strcpy(cl.filter.match, "IRC{X}");
+	chanlist_view(&cl, CASEMAPPING_RFC1459);
+	CHECK_VIEW(1, "#irc[x]");
+
+	chanlist_view(&cl, CASEMAPPING_ASCII);
+	assert_ueq(cl.view_len, 0);
+
+	strcpy(cl.filter.match, "#irc[x]x");
+	chanlist_view(&cl, CASEMAPPING_RFC1459);
+	assert_ueq(cl.view_len, 0);
+
+#undef CHECK_VIEW
+
+	chanlist_free(&cl);
+}
+
+int
+main(void)
+{
+	struct testcase tests[] = {
+		TESTCASE(test_chanlist),
+		TESTCASE(test_chanlist_view),
+	};
+
+	return run_tests(NULL, NULL, tests);
+}
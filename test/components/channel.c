@@ -5,6 +5,7 @@
 #include "src/components/input.c"
 #include "src/components/mode.c"
 #include "src/components/user.c"
+#include "src/utils/intern.c"
 #include "src/utils/utils.c"
 
 static void
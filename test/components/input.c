@@ -567,6 +567,40 @@ test_input_text_size(void)
 	input_free(&inp);
 }
 
+static void
+test_input_release(void)
+{
+	struct input inp;
+
+	input_init(&inp);
+
+	/* Test the edit area is allocated on first edit */
+	assert_ptr_null(inp.buf);
+	assert_eq(input_cursor_back(&inp), 0);
+	assert_eq(input_cursor_forw(&inp), 0);
+	CHECK_INPUT_WRITE(&inp, "");
+	assert_ptr_null(inp.buf);
+
+	assert_eq(input_insert(&inp, "abc", 3), 1);
+	assert_ptr_not_null(inp.buf);
+
+	/* Test the edit area isn't released while non-empty */
+	input_release(&inp);
+	assert_ptr_not_null(inp.buf);
+	CHECK_INPUT_WRITE(&inp, "abc");
+
+	assert_eq(input_hist_push(&inp), 1);
+	input_release(&inp);
+	assert_ptr_null(inp.buf);
+
+	/* Test history is retained and reallocates the edit area */
+	assert_eq(input_hist_back(&inp), 1);
+	assert_ptr_not_null(inp.buf);
+	CHECK_INPUT_WRITE(&inp, "abc");
+
+	input_free(&inp);
+}
+
 int
 main(void)
 {
@@ -580,7 +614,8 @@ main(void)
 		TESTCASE(test_input_frame),
 		TESTCASE(test_input_write),
 		TESTCASE(test_input_complete),
-		TESTCASE(test_input_text_size)
+		TESTCASE(test_input_text_size),
+		TESTCASE(test_input_release)
 	};
 
 	return run_tests(NULL, NULL, tests);
@@ -0,0 +1,188 @@
+#include "test/test.h"
+
+#include "src/components/isupport.c"
+#include "src/utils/utils.c"
+
+static void
+test_isupport_token(void)
+{
+	/* Test known tokens are found by name */
+
+	#define X(TOKEN) \
+	assert_eq(isupport_token(#TOKEN), ISUPPORT_##TOKEN);
+	ISUPPORT_TOKENS
+	#undef X
+
+	assert_eq(isupport_token(""), -1);
+	assert_eq(isupport_token("nicklen"), -1);
+	assert_eq(isupport_token("NICKLE"), -1);
+	assert_eq(isupport_token("NICKLENX"), -1);
+	assert_eq(isupport_token("XYZ"), -1);
+}
+
+static void
+test_isupport_set(void)
+{
+	/* Test setting, replacing and removing tokens */
+
+	struct isupport is = {0};
+
+	assert_eq(isupport_set(&is, "NICKLEN", "9"), 0);
+	assert_eq(isupport_set(&is, "WHOX", NULL), 0);
+	assert_eq(isupport_set(&is, "ABC", "1"), 0);
+	assert_eq(isupport_set(&is, "XYZ", NULL), 0);
+
+	assert_strcmp(isupport_get(&is, "NICKLEN"), "9");
+	assert_strcmp(isupport_get(&is, "WHOX"), "");
+	assert_strcmp(isupport_get(&is, "ABC"), "1");
+	assert_strcmp(isupport_get(&is, "XYZ"), "");
+	assert_ptr_null(isupport_get(&is, "MONITOR"));
+	assert_ptr_null(isupport_get(&is, "DEF"));
+
+	assert_eq(isupport_set(&is, "NICKLEN", "30"), 0);
+	assert_eq(isupport_set(&is, "ABC", "2"), 0);
+	assert_strcmp(isupport_get(&is, "NICKLEN"), "30");
+	assert_strcmp(isupport_get(&is, "ABC"), "2");
+	assert_ueq(is.other_n, 2);
+
+	/* Test removing tokens */
+	assert_eq(isupport_set(&is, "-NICKLEN", NULL), 0);
+	assert_eq(isupport_set(&is, "-ABC", NULL), 0);
+	assert_eq(isupport_set(&is, "-DEF", NULL), 0);
+	assert_ptr_null(isupport_get(&is, "NICKLEN"));
+	assert_ptr_null(isupport_get(&is, "ABC"));
+	assert_strcmp(isupport_get(&is, "XYZ"), "");
+	assert_ueq(is.other_n, 1);
+
+	/* Test invalid tokens */
+	assert_eq(isupport_set(&is, "", NULL), -1);
+	assert_eq(isupport_set(&is, "-", NULL), -1);
+	assert_eq(isupport_set(&is, "-WHOX", "1"), -1);
+	assert_strcmp(isupport_get(&is, "WHOX"), "");
+
+	/* Test escaped values */
+	assert_eq(isupport_set(&is, "NETWORK", "a\\x20b\\x3Dc\\x5c\\xZZ\\x2"), 0);
+	assert_strcmp(isupport_get(&is, "NETWORK"), "a b=c\\\\xZZ\\x2");
+
+	/* Test reset tokens are cleared when next set */
+	isupport_reset(&is);
+
+	assert_strcmp(isupport_get(&is, "WHOX"), "");
+	assert_eq(isupport_set(&is, "MONITOR", "100"), 0);
+	assert_ptr_null(isupport_get(&is, "WHOX"));
+	assert_ptr_null(isupport_get(&is, "XYZ"));
+	assert_strcmp(isupport_get(&is, "MONITOR"), "100");
+
+	isupport_free(&is);
+
+	assert_ptr_null(isupport_get(&is, "MONITOR"));
+	assert_ptr_null(is.other);
+	assert_ueq(is.other_n, 0);
+}
+
+static void
+test_isupport_num(void)
+{
+	/* Test numeric values, and defaults */
+
+	struct isupport is = {0};
+
+	assert_eq(isupport_num(&is, ISUPPORT_NICKLEN, 9), 9);
+
+	#define CHECK_NUM(V, R) \
+	assert_eq(isupport_set(&is, "NICKLEN", (V)), 0); \
+	assert_ueq(isupport_num(&is, ISUPPORT_NICKLEN, 9), (R));
+
+	CHECK_NUM(NULL, 9);
+	CHECK_NUM("0", 0);
+	CHECK_NUM("30", 30);
+	CHECK_NUM("4294967295", UINT_MAX);
+	CHECK_NUM("4294967296", 9);
+	CHECK_NUM("-1", 9);
+	CHECK_NUM(" 1", 9);
+	CHECK_NUM("1x", 9);
+
+	#undef CHECK_NUM
+
+	isupport_free(&is);
+}
+
+static void
+test_isupport_chanlimit(void)
+{
+	/* Test channel limits by channel type */
+
+	struct isupport is = {0};
+	unsigned group;
+
+	assert_eq(isupport_chanlimit(&is, '#', &group), 0);
+
+	assert_eq(isupport_set(&is, "MAXCHANNELS", "10"), 0);
+	assert_eq(isupport_chanlimit(&is, '#', &group), 10);
+	assert_eq(group, 0);
+	assert_eq(isupport_chanlimit(&is, '&', &group), 10);
+	assert_eq(group, 0);
+
+	assert_eq(isupport_set(&is, "CHANLIMIT", "#&:50,+:,!:3"), 0);
+	assert_eq(isupport_chanlimit(&is, '#', &group), 50);
+	assert_eq(group, 0);
+	assert_eq(isupport_chanlimit(&is, '&', &group), 50);
+	assert_eq(group, 0);
+	assert_eq(isupport_chanlimit(&is, '+', &group), 0);
+	assert_eq(group, 1);
+	assert_eq(isupport_chanlimit(&is, '!', &group), 3);
+	assert_eq(group, 2);
+	assert_eq(isupport_chanlimit(&is, '~', &group), 0);
+	assert_eq(isupport_chanlimit(&is, ':', &group), 0);
+
+	/* Test limits are parsed up to an invalid entry */
+	assert_eq(isupport_set(&is, "CHANLIMIT", "#:5,&:x,+:1"), 0);
+	assert_eq(isupport_chanlimit(&is, '#', &group), 5);
+	assert_eq(isupport_chanlimit(&is, '&', &group), 0);
+	assert_eq(isupport_chanlimit(&is, '+', &group), 0);
+
+	assert_eq(isupport_set(&is, "CHANLIMIT", ":5,#5"), 0);
+	assert_eq(isupport_chanlimit(&is, '#', &group), 0);
+
+	isupport_free(&is);
+}
+
+static void
+test_isupport_targmax(void)
+{
+	/* Test target limits by command */
+
+	struct isupport is = {0};
+
+	assert_eq(isupport_targmax(&is, "PRIVMSG"), 0);
+	assert_eq(isupport_targmax(&is, "JOIN"), 0);
+
+	assert_eq(isupport_set(&is, "MAXTARGETS", "4"), 0);
+	assert_eq(isupport_targmax(&is, "PRIVMSG"), 4);
+	assert_eq(isupport_targmax(&is, "notice"), 4);
+	assert_eq(isupport_targmax(&is, "JOIN"), 0);
+
+	assert_eq(isupport_set(&is, "TARGMAX", "PRIVMSG:3,NOTICE:,join:2,JOINX:1,NAMES:1"), 0);
+	assert_eq(isupport_targmax(&is, "PRIVMSG"), 3);
+	assert_eq(isupport_targmax(&is, "NOTICE"), 0);
+	assert_eq(isupport_targmax(&is, "JOIN"), 2);
+	assert_eq(isupport_targmax(&is, "JOI"), 0);
+	assert_eq(isupport_targmax(&is, "NAMES"), 1);
+	assert_eq(isupport_targmax(&is, "KICK"), 0);
+
+	isupport_free(&is);
+}
+
+int
+main(void)
+{
+	struct testcase tests[] = {
+		TESTCASE(test_isupport_token),
+		TESTCASE(test_isupport_set),
+		TESTCASE(test_isupport_num),
+		TESTCASE(test_isupport_chanlimit),
+		TESTCASE(test_isupport_targmax),
+	};
+
+	return run_tests(NULL, NULL, tests);
+}
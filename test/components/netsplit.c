@@ -0,0 +1,103 @@
+#include "test/test.h"
+
+#include "src/components/netsplit.c"
+#include "src/utils/utils.c"
+
+static void
+test_netsplit_servers(void)
+{
+	/* Test quit messages naming split servers */
+
+	assert_true(netsplit_servers("irc.a.net irc.b.net"));
+	assert_true(netsplit_servers("a.b c.d"));
+	assert_true(netsplit_servers("*.net *.split"));
+	assert_true(netsplit_servers("irc-1.a.net irc-2.a.net"));
+
+	assert_false(netsplit_servers(""));
+	assert_false(netsplit_servers(" "));
+	assert_false(netsplit_servers("irc.a.net"));
+	assert_false(netsplit_servers("irc.a.net "));
+	assert_false(netsplit_servers(" irc.a.net irc.b.net"));
+	assert_false(netsplit_servers("irc.a.net  irc.b.net"));
+	assert_false(netsplit_servers("irc.a.net irc.b.net "));
+	assert_false(netsplit_servers("irc.a.net irc.a.net"));
+	assert_false(netsplit_servers("irc.a.net irc.b.net irc.c.net"));
+	assert_false(netsplit_servers("irca ircb"));
+	assert_false(netsplit_servers("irc.a.net ircb"));
+	assert_false(netsplit_servers(".a.net irc.b.net"));
+	assert_false(netsplit_servers("irc.a. irc.b.net"));
+	assert_false(netsplit_servers("irc..a irc.b.net"));
+	assert_false(netsplit_servers("Quit: see you.later bye"));
+	assert_false(netsplit_servers("http://a.b c.d"));
+	assert_false(netsplit_servers("a.b c.d:"));
+}
+
+static void
+test_netsplit(void)
+{
+	/* Test users quit in a split are found for rejoining */
+
+	struct netsplit ns = {0};
+
+	assert_false(netsplit_get(&ns, CASEMAPPING_RFC1459, "nick", 0));
+
+	netsplit_start(&ns, "a.b c.d", 100);
+
+	assert_strcmp(ns.servers, "a.b c.d");
+	assert_eq(ns.time_split, 100);
+
+	netsplit_add(&ns, "nick-b");
+	netsplit_add(&ns, "nick[a]");
+	netsplit_add(&ns, "nick-c");
+
+	assert_true(netsplit_get(&ns, CASEMAPPING_RFC1459, "nick-b", 100));
+	assert_true(netsplit_get(&ns, CASEMAPPING_RFC1459, "NICK{A}", 100));
+	assert_true(netsplit_get(&ns, CASEMAPPING_RFC1459, "nick-c", 100));
+	assert_false(netsplit_get(&ns, CASEMAPPING_RFC1459, "nick", 100));
+	assert_false(netsplit_get(&ns, CASEMAPPING_RFC1459, "nick-d", 100));
+	assert_false(netsplit_get(&ns, CASEMAPPING_RFC1459, "nick-a", 100));
+
+	/* Test nicks added after lookup are sorted again */
+	for (unsigned i = 0; i < 100; i++) {
+		char nick[16];
+		snprintf(nick, sizeof(nick), "n%u", (i * 37) % 100);
+		netsplit_add(&ns, nick);
+	}
+
+	assert_ueq(ns.nicks_n, 103);
+
+	for (unsigned i = 0; i < 100; i++) {
+		char nick[16];
+		snprintf(nick, sizeof(nick), "N%u", i);
+		assert_true(netsplit_get(&ns, CASEMAPPING_RFC1459, nick, 100));
+	}
+
+	assert_true(netsplit_get(&ns, CASEMAPPING_RFC1459, "nick-b", 100));
+
+	/* Test users are kept up to NETSPLIT_REJOIN_MAX */
+	assert_true(netsplit_get(&ns, CASEMAPPING_RFC1459, "nick-b", 100 + NETSPLIT_REJOIN_MAX));
+	assert_false(netsplit_get(&ns, CASEMAPPING_RFC1459, "nick-b", 100 + NETSPLIT_REJOIN_MAX + 1));
+
+	/* Test starting a split discards users of the last */
+	netsplit_start(&ns, "e.f g.h", 200);
+
+	assert_strcmp(ns.servers, "e.f g.h");
+	assert_ueq(ns.nicks_n, 0);
+	assert_false(netsplit_get(&ns, CASEMAPPING_RFC1459, "nick-b", 200));
+
+	netsplit_free(&ns);
+
+	assert_ptr_null(ns.servers);
+	assert_ptr_null(ns.nicks);
+}
+
+int
+main(void)
+{
+	struct testcase tests[] = {
+		TESTCASE(test_netsplit_servers),
+		TESTCASE(test_netsplit),
+	};
+
+	return run_tests(NULL, NULL, tests);
+}
@@ -1,11 +1,16 @@
 #include "test/test.h"
 #include "src/components/buffer.c"
 #include "src/components/channel.c"
+#include "src/components/chanlist.c"
 #include "src/components/input.c"
 #include "src/components/ircv3.c"
+#include "src/components/isupport.c"
 #include "src/components/mode.c"
+#include "src/components/netsplit.c"
 #include "src/components/server.c"
 #include "src/components/user.c"
+#include "src/utils/highlight.c"
+#include "src/utils/intern.c"
 #include "src/utils/utils.c"
 
 void
@@ -278,8 +283,14 @@ test_parse_005(void)
 	CHECK(1, "TESTING3", NULL);
 	CHECK(0, NULL,       NULL);
 
-	char opts10[] = "000 1=t 2=t! 3= 4=  5=t,t, 6= 7=7 8===D 9=9 10=10 11= 12 13 ";
+	char opts10[] = "-TESTING1 -TESTING2=x - -";
 	ptr = opts10;
+	CHECK(1, "-TESTING1", NULL);
+	CHECK(1, "-TESTING2", "x");
+	CHECK(0, NULL,        NULL);
+
+	char opts11[] = "000 1=t 2=t! 3= 4=  5=t,t, 6= 7=7 8===D 9=9 10=10 11= 12 13 ";
+	ptr = opts11;
 
 	CHECK(1, "000", NULL);
 	CHECK(1, "1",   "t");
@@ -300,6 +311,45 @@ test_parse_005(void)
 #undef CHECK
 }
 
+static void
+test_server_set_005(void)
+{
+	/* Test numeric 005 tokens are stored, applied and removed */
+
+	struct server *s = server("host", "port", NULL, "user", "real", NULL);
+
+	char opts1[] = "CASEMAPPING=ascii NICKLEN=16 WHOX NETWORK=a\\x20b XYZ=1";
+	server_set_005(s, opts1);
+
+	assert_eq(s->casemapping, CASEMAPPING_ASCII);
+	assert_strcmp(isupport_str(&(s->isupport), ISUPPORT_CASEMAPPING), "ascii");
+	assert_eq(isupport_num(&(s->isupport), ISUPPORT_NICKLEN, 9), 16);
+	assert_strcmp(isupport_str(&(s->isupport), ISUPPORT_WHOX), "");
+	assert_strcmp(isupport_str(&(s->isupport), ISUPPORT_NETWORK), "a b");
+	assert_strcmp(isupport_get(&(s->isupport), "XYZ"), "1");
+
+	char opts2[] = "-NICKLEN -WHOX -XYZ -XYZ";
+	server_set_005(s, opts2);
+
+	assert_eq(isupport_num(&(s->isupport), ISUPPORT_NICKLEN, 9), 9);
+	assert_ptr_null(isupport_str(&(s->isupport), ISUPPORT_WHOX));
+	assert_ptr_null(isupport_get(&(s->isupport), "XYZ"));
+	assert_strcmp(isupport_str(&(s->isupport), ISUPPORT_NETWORK), "a b");
+
+	/* Test tokens are kept after reset until the next numeric 005 */
+	server_reset(s);
+
+	assert_strcmp(isupport_str(&(s->isupport), ISUPPORT_NETWORK), "a b");
+
+	char opts3[] = "NICKLEN=30";
+	server_set_005(s, opts3);
+
+	assert_ptr_null(isupport_str(&(s->isupport), ISUPPORT_NETWORK));
+	assert_eq(isupport_num(&(s->isupport), ISUPPORT_NICKLEN, 9), 30);
+
+	server_free(s);
+}
+
 int
 main(void)
 {
@@ -308,7 +358,8 @@ main(void)
 		TESTCASE(test_server_set_chans),
 		TESTCASE(test_server_set_nicks),
 		TESTCASE(test_server_set_sasl),
-		TESTCASE(test_parse_005)
+		TESTCASE(test_parse_005),
+		TESTCASE(test_server_set_005)
 	};
 
 	return run_tests(NULL, NULL, tests);
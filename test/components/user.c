@@ -1,7 +1,10 @@
 #include "test/test.h"
 #include "src/components/user.c"
+#include "src/utils/intern.c"
 #include "src/utils/utils.c"
 
+static struct intern strings;
+
 static void
 test_user_list(void)
 {
@@ -13,15 +16,15 @@ test_user_list(void)
 	memset(&ulist, 0, sizeof(ulist));
 
 	/* Test adding users to list */
-	assert_eq(user_list_add(&ulist, CASEMAPPING_RFC1459, "aaa", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&ulist, CASEMAPPING_RFC1459, "bbb", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&ulist, CASEMAPPING_RFC1459, "ccc", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&ulist, &strings, CASEMAPPING_RFC1459, "aaa", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&ulist, &strings, CASEMAPPING_RFC1459, "bbb", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&ulist, &strings, CASEMAPPING_RFC1459, "ccc", (struct mode){0}), USER_ERR_NONE);
 
 	if (ulist.count != 3)
 		test_abort("Failed to add users to list");
 
 	/* Test adding duplicates */
-	assert_eq(user_list_add(&ulist, CASEMAPPING_RFC1459, "aaa", (struct mode){0}), USER_ERR_DUPLICATE);
+	assert_eq(user_list_add(&ulist, &strings, CASEMAPPING_RFC1459, "aaa", (struct mode){0}), USER_ERR_DUPLICATE);
 
 	/* Test retrieving by name, failure */
 	assert_ptr_null(user_list_get(&ulist, CASEMAPPING_RFC1459, "a", 0));
@@ -59,15 +62,15 @@ test_user_list(void)
 	assert_strcmp(u3->nick, "ccc");
 
 	/* Test replacing user in list, failure */
-	assert_eq(user_list_rpl(&ulist, CASEMAPPING_RFC1459, "zzz", "yyy"), USER_ERR_NOT_FOUND);
-	assert_eq(user_list_rpl(&ulist, CASEMAPPING_RFC1459, "bbb", "ccc"), USER_ERR_DUPLICATE);
+	assert_eq(user_list_rpl(&ulist, &strings, CASEMAPPING_RFC1459, "zzz", "yyy"), USER_ERR_NOT_FOUND);
+	assert_eq(user_list_rpl(&ulist, &strings, CASEMAPPING_RFC1459, "bbb", "ccc"), USER_ERR_DUPLICATE);
 
 	/* Test replacing user in list, success */
 	u3->prfxmodes.lower = 0x123;
 	u3->prfxmodes.upper = 0x456;
 	u3->prfxmodes.prefix = '*';
 
-	assert_eq(user_list_rpl(&ulist, CASEMAPPING_RFC1459, "ccc", "ddd"), USER_ERR_NONE);
+	assert_eq(user_list_rpl(&ulist, &strings, CASEMAPPING_RFC1459, "ccc", "ddd"), USER_ERR_NONE);
 
 	if ((u4 = user_list_get(&ulist, CASEMAPPING_RFC1459, "ddd", 0)) == NULL)
 		test_abort("Failed to retrieve u4");
@@ -89,6 +92,8 @@ test_user_list(void)
 	assert_eq(user_list_del(&ulist, CASEMAPPING_RFC1459, "ddd"), USER_ERR_NONE);
 
 	assert_eq(ulist.count, 0);
+
+	user_list_free(&ulist);
 }
 
 static void
@@ -101,11 +106,11 @@ test_user_list_casemapping(void)
 
 	memset(&ulist, 0, sizeof(ulist));
 
-	assert_eq(user_list_add(&ulist, CASEMAPPING_RFC1459, "aaa", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&ulist, CASEMAPPING_RFC1459, "AaA", (struct mode){0}), USER_ERR_DUPLICATE);
-	assert_eq(user_list_add(&ulist, CASEMAPPING_RFC1459, "{}^", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&ulist, CASEMAPPING_RFC1459, "[}~", (struct mode){0}), USER_ERR_DUPLICATE);
-	assert_eq(user_list_add(&ulist, CASEMAPPING_RFC1459, "zzz", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&ulist, &strings, CASEMAPPING_RFC1459, "aaa", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&ulist, &strings, CASEMAPPING_RFC1459, "AaA", (struct mode){0}), USER_ERR_DUPLICATE);
+	assert_eq(user_list_add(&ulist, &strings, CASEMAPPING_RFC1459, "{}^", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&ulist, &strings, CASEMAPPING_RFC1459, "[}~", (struct mode){0}), USER_ERR_DUPLICATE);
+	assert_eq(user_list_add(&ulist, &strings, CASEMAPPING_RFC1459, "zzz", (struct mode){0}), USER_ERR_NONE);
 
 	assert_eq(ulist.count, 3);
 
@@ -115,14 +120,14 @@ test_user_list_casemapping(void)
 	assert_ptr_eq(user_list_get(&ulist, CASEMAPPING_RFC1459, "aAa", 3), u);
 	assert_ptr_eq(user_list_get(&ulist, CASEMAPPING_RFC1459, "A",   1), u);
 
-	assert_eq(user_list_rpl(&ulist, CASEMAPPING_RFC1459, "AaA", "bbb"), USER_ERR_NONE);
+	assert_eq(user_list_rpl(&ulist, &strings, CASEMAPPING_RFC1459, "AaA", "bbb"), USER_ERR_NONE);
 	assert_eq(user_list_del(&ulist, CASEMAPPING_RFC1459, "aaa"),        USER_ERR_NOT_FOUND);
 	assert_eq(user_list_del(&ulist, CASEMAPPING_RFC1459, "BBB"),        USER_ERR_NONE);
 
 	assert_eq(ulist.count, 2);
 
-	assert_eq(user_list_rpl(&ulist, CASEMAPPING_RFC1459, "{}^", "[}~"), USER_ERR_NONE);
-	assert_eq(user_list_rpl(&ulist, CASEMAPPING_RFC1459, "zzz", "ZzZ"), USER_ERR_NONE);
+	assert_eq(user_list_rpl(&ulist, &strings, CASEMAPPING_RFC1459, "{}^", "[}~"), USER_ERR_NONE);
+	assert_eq(user_list_rpl(&ulist, &strings, CASEMAPPING_RFC1459, "zzz", "ZzZ"), USER_ERR_NONE);
 
 	assert_eq(ulist.count, 2);
 
@@ -150,27 +155,328 @@ test_user_list_free(void)
 	};
 
 	for (p = users; *p; p++) {
-		if (user_list_add(&ulist, CASEMAPPING_RFC1459, *p, (struct mode){0}) != USER_ERR_NONE)
+		if (user_list_add(&ulist, &strings, CASEMAPPING_RFC1459, *p, (struct mode){0}) != USER_ERR_NONE)
 			test_failf("Failed to add user to list: %s", *p);
 	}
 
+	/* 26 users, in slabs of 8, 16, 32, indexed in one block */
+	assert_ueq(user_list_memory(&ulist),
+		(8 + 16 + 32) * sizeof(struct user) + 3 * sizeof(struct user_slab) +
+		8 * sizeof(struct user_block*) + sizeof(struct user_block));
+
 	user_list_free(&ulist);
 
+	assert_ueq(user_list_memory(&ulist), 0);
+
 	for (p = users; *p; p++) {
-		if (user_list_add(&ulist, CASEMAPPING_RFC1459, *p, (struct mode){0}) != USER_ERR_NONE)
+		if (user_list_add(&ulist, &strings, CASEMAPPING_RFC1459, *p, (struct mode){0}) != USER_ERR_NONE)
 			test_failf("Failed to remove user from list: %s", *p);
 	}
 
 	user_list_free(&ulist);
 }
 
+static void
+test_user_list_merge(void)
+{
+	/* Test staged users are merged in bulk, discarding duplicates */
+
+	struct user_list ulist;
+	struct user *u;
+	char nick[16];
+
+	memset(&ulist, 0, sizeof(ulist));
+
+	assert_eq(user_list_merge(&ulist, CASEMAPPING_RFC1459, NULL, NULL), 0);
+
+	assert_eq(user_list_add(&ulist, &strings, CASEMAPPING_RFC1459, "aaa", (struct mode){0}), USER_ERR_NONE);
+
+	user_list_stage(&ulist, &strings, "ccc", (struct mode){ .prefix = '@' });
+	user_list_stage(&ulist, &strings, "bbb", (struct mode){0});
+	user_list_stage(&ulist, &strings, "AAA", (struct mode){0});
+	user_list_stage(&ulist, &strings, "CCC", (struct mode){0});
+
+	assert_eq(ulist.count, 5);
+	assert_eq(ulist.staged_n, 4);
+
+	assert_eq(user_list_merge(&ulist, CASEMAPPING_RFC1459, NULL, NULL), 2);
+
+	assert_eq(ulist.count, 3);
+	assert_eq(ulist.staged_n, 0);
+	assert_ptr_null(ulist.staged);
+
+	/* Existing users take precedence, then the first staged */
+	assert_ptr_not_null((u = user_list_get(&ulist, CASEMAPPING_RFC1459, "aaa", 0)));
+	assert_strcmp(u->nick, "aaa");
+	assert_ptr_not_null((u = user_list_get(&ulist, CASEMAPPING_RFC1459, "ccc", 0)));
+	assert_strcmp(u->nick, "ccc");
+	assert_eq(u->prfxmodes.prefix, '@');
+
+	/* Staged users are merged implicitly by other operations */
+	user_list_stage(&ulist, &strings, "ddd", (struct mode){0});
+
+	assert_eq(user_list_del(&ulist, CASEMAPPING_RFC1459, "ddd"), USER_ERR_NONE);
+	assert_eq(ulist.count, 3);
+
+	/* Large merges are ordered, in filled blocks */
+	for (int i = 0; i < 1000; i++) {
+		snprintf(nick, sizeof(nick), "n%d", (i * 7919) % 1000);
+		user_list_stage(&ulist, &strings, nick, (struct mode){0});
+	}
+
+	assert_eq(user_list_merge(&ulist, CASEMAPPING_RFC1459, NULL, NULL), 0);
+	assert_eq(ulist.count, 1003);
+	assert_eq(ulist.blocks_n, (1003 + USER_BLOCK_FILL - 1) / USER_BLOCK_FILL);
+	assert_eq(ulist.blocks[0]->n, USER_BLOCK_FILL);
+
+	for (int i = 0; i < 1000; i++) {
+		snprintf(nick, sizeof(nick), "n%d", i);
+		if (!user_list_get(&ulist, CASEMAPPING_RFC1459, nick, 0))
+			test_failf("Failed to retrieve user: %s", nick);
+	}
+
+	/* Nicks with equal keys are compared in full */
+	user_list_stage(&ulist, &strings, "longnick2", (struct mode){0});
+	user_list_stage(&ulist, &strings, "LONGNICK1", (struct mode){0});
+	user_list_stage(&ulist, &strings, "longnick1", (struct mode){0});
+	user_list_stage(&ulist, &strings, "longnick", (struct mode){0});
+
+	assert_eq(user_list_merge(&ulist, CASEMAPPING_RFC1459, NULL, NULL), 1);
+	assert_eq(ulist.count, 1006);
+	assert_ptr_not_null((u = user_list_get(&ulist, CASEMAPPING_RFC1459, "longnick1", 0)));
+	assert_strcmp(u->nick, "LONGNICK1");
+	assert_ptr_not_null((u = user_list_get(&ulist, CASEMAPPING_RFC1459, "longnick", 0)));
+	assert_strcmp(u->nick, "longnick");
+	assert_ptr_not_null((u = user_list_get(&ulist, CASEMAPPING_RFC1459, "longnick2", 0)));
+	assert_strcmp(u->nick, "longnick2");
+
+	/* Staged users are freed with the list */
+	user_list_stage(&ulist, &strings, "eee", (struct mode){0});
+
+	user_list_free(&ulist);
+
+	assert_eq(ulist.count, 0);
+	assert_ptr_null(ulist.staged);
+}
+
+static void
+test_user_list_iter(void)
+{
+	/* Test iterating users in order, and by prefix */
+
+	struct user *u;
+	struct user_iter it;
+	struct user_list ulist;
+
+	memset(&ulist, 0, sizeof(ulist));
+
+	user_list_iter(&ulist, &it, CASEMAPPING_RFC1459, NULL, 0);
+	assert_ptr_null(user_list_next(&ulist, &it));
+
+	assert_eq(user_list_add(&ulist, &strings, CASEMAPPING_RFC1459, "ab",  (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&ulist, &strings, CASEMAPPING_RFC1459, "b",   (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&ulist, &strings, CASEMAPPING_RFC1459, "abc", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&ulist, &strings, CASEMAPPING_RFC1459, "a",   (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&ulist, &strings, CASEMAPPING_RFC1459, "AC",  (struct mode){0}), USER_ERR_NONE);
+
+	/* Test all users, ordered by casemapped nick */
+	user_list_iter(&ulist, &it, CASEMAPPING_RFC1459, NULL, 0);
+	assert_ptr_not_null((u = user_list_next(&ulist, &it)));
+	assert_strcmp(u->nick, "b");
+	assert_ptr_not_null((u = user_list_next(&ulist, &it)));
+	assert_strcmp(u->nick, "AC");
+	assert_ptr_not_null((u = user_list_next(&ulist, &it)));
+	assert_strcmp(u->nick, "abc");
+	assert_ptr_not_null((u = user_list_next(&ulist, &it)));
+	assert_strcmp(u->nick, "ab");
+	assert_ptr_not_null((u = user_list_next(&ulist, &it)));
+	assert_strcmp(u->nick, "a");
+	assert_ptr_null(user_list_next(&ulist, &it));
+
+	/* Test users by prefix */
+	user_list_iter(&ulist, &it, CASEMAPPING_RFC1459, "Ab", 2);
+	assert_ptr_not_null((u = user_list_next(&ulist, &it)));
+	assert_strcmp(u->nick, "abc");
+	assert_ptr_not_null((u = user_list_next(&ulist, &it)));
+	assert_strcmp(u->nick, "ab");
+	assert_ptr_null(user_list_next(&ulist, &it));
+
+	user_list_iter(&ulist, &it, CASEMAPPING_RFC1459, "abcd", 4);
+	assert_ptr_null(user_list_next(&ulist, &it));
+
+	user_list_iter(&ulist, &it, CASEMAPPING_RFC1459, "c", 1);
+	assert_ptr_null(user_list_next(&ulist, &it));
+
+	/* Test nicks beyond the length of their keys */
+	assert_eq(user_list_add(&ulist, &strings, CASEMAPPING_RFC1459, "abcdefgh1", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&ulist, &strings, CASEMAPPING_RFC1459, "abcdefgh",  (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&ulist, &strings, CASEMAPPING_RFC1459, "ABCDEFGH2", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&ulist, &strings, CASEMAPPING_RFC1459, "abcdefgh2", (struct mode){0}), USER_ERR_DUPLICATE);
+
+	assert_ptr_not_null((u = user_list_get(&ulist, CASEMAPPING_RFC1459, "abcdefgh", 0)));
+	assert_strcmp(u->nick, "abcdefgh");
+	assert_ptr_not_null((u = user_list_get(&ulist, CASEMAPPING_RFC1459, "abcdefgh1", 0)));
+	assert_strcmp(u->nick, "abcdefgh1");
+	assert_ptr_null(user_list_get(&ulist, CASEMAPPING_RFC1459, "abcdefgh3", 0));
+
+	user_list_iter(&ulist, &it, CASEMAPPING_RFC1459, "abcdefgh", 8);
+	assert_ptr_not_null((u = user_list_next(&ulist, &it)));
+	assert_strcmp(u->nick, "ABCDEFGH2");
+	assert_ptr_not_null((u = user_list_next(&ulist, &it)));
+	assert_strcmp(u->nick, "abcdefgh1");
+	assert_ptr_not_null((u = user_list_next(&ulist, &it)));
+	assert_strcmp(u->nick, "abcdefgh");
+	assert_ptr_null(user_list_next(&ulist, &it));
+
+	user_list_free(&ulist);
+}
+
+static void
+test_user_list_blocks(void)
+{
+	/* Test blocks are split and merged, and remain ordered */
+
+	char nick[16];
+	struct user *u;
+	struct user *prev;
+	struct user_iter it;
+	struct user_list ulist;
+	unsigned n;
+
+	memset(&ulist, 0, sizeof(ulist));
+
+	for (int i = 0; i < 1000; i++) {
+		snprintf(nick, sizeof(nick), "n%d", (i * 7919) % 1000);
+		if (user_list_add(&ulist, &strings, CASEMAPPING_RFC1459, nick, (struct mode){0}) != USER_ERR_NONE)
+			test_failf("Failed to add user: %s", nick);
+	}
+
+	assert_gt(ulist.blocks_n, 1000 / USER_BLOCK_MAX);
+
+	/* Delete all but every tenth user */
+	for (int i = 0; i < 1000; i++) {
+		snprintf(nick, sizeof(nick), "n%d", (i * 7919) % 1000);
+		if ((i * 7919) % 10 && user_list_del(&ulist, CASEMAPPING_RFC1459, nick) != USER_ERR_NONE)
+			test_failf("Failed to delete user: %s", nick);
+	}
+
+	assert_eq(ulist.count, 100);
+	assert_lt(ulist.blocks_n, 100 / (USER_BLOCK_MAX / 4));
+
+	n = 0;
+	prev = NULL;
+
+	for (user_list_iter(&ulist, &it, CASEMAPPING_RFC1459, NULL, 0); (u = user_list_next(&ulist, &it)); prev = u) {
+		if (prev && irc_strcmp(CASEMAPPING_RFC1459, prev->nick, u->nick) >= 0)
+			test_failf("Users out of order: %s, %s", prev->nick, u->nick);
+		n++;
+	}
+
+	assert_eq(n, 100);
+
+	for (int i = 0; i < 1000; i += 10) {
+		snprintf(nick, sizeof(nick), "n%d", i);
+		if (user_list_del(&ulist, CASEMAPPING_RFC1459, nick) != USER_ERR_NONE)
+			test_failf("Failed to delete user: %s", nick);
+	}
+
+	assert_eq(ulist.count, 0);
+	assert_eq(ulist.blocks_n, 0);
+
+	user_list_free(&ulist);
+}
+
+static void
+test_user_list_slab(void)
+{
+	/* Test users are allocated from slabs and reused */
+
+	struct user_list ulist;
+	struct user *u1;
+	struct user *u2;
+
+	memset(&ulist, 0, sizeof(ulist));
+
+	assert_eq(user_list_add(&ulist, &strings, CASEMAPPING_RFC1459, "aaa", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&ulist, &strings, CASEMAPPING_RFC1459, "bbb", (struct mode){0}), USER_ERR_NONE);
+
+	assert_ptr_not_null((u1 = user_list_get(&ulist, CASEMAPPING_RFC1459, "aaa", 0)));
+	assert_ptr_not_null((u2 = user_list_get(&ulist, CASEMAPPING_RFC1459, "bbb", 0)));
+
+	assert_ptr_eq(u1, &(ulist.slabs->users[0]));
+	assert_ptr_eq(u2, &(ulist.slabs->users[1]));
+
+	/* Renamed users are updated in place */
+	assert_eq(user_list_rpl(&ulist, &strings, CASEMAPPING_RFC1459, "aaa", "ccc"), USER_ERR_NONE);
+	assert_ptr_eq(user_list_get(&ulist, CASEMAPPING_RFC1459, "ccc", 0), u1);
+
+	/* Deleted users are reused */
+	assert_eq(user_list_del(&ulist, CASEMAPPING_RFC1459, "ccc"), USER_ERR_NONE);
+	assert_eq(user_list_add(&ulist, &strings, CASEMAPPING_RFC1459, "ddd", (struct mode){0}), USER_ERR_NONE);
+	assert_ptr_eq(user_list_get(&ulist, CASEMAPPING_RFC1459, "ddd", 0), u1);
+	assert_eq(ulist.slab_n, 2);
+
+	user_list_free(&ulist);
+
+	assert_ptr_null(ulist.slabs);
+	assert_ptr_null(ulist.released);
+}
+
+static void
+test_user_list_intern(void)
+{
+	/* Test nicks are shared between lists, and released */
+
+	struct user_list ulist1;
+	struct user_list ulist2;
+	struct user *u1;
+	struct user *u2;
+
+	memset(&ulist1, 0, sizeof(ulist1));
+	memset(&ulist2, 0, sizeof(ulist2));
+
+	assert_eq(user_list_add(&ulist1, &strings, CASEMAPPING_RFC1459, "aaa", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&ulist2, &strings, CASEMAPPING_RFC1459, "aaa", (struct mode){0}), USER_ERR_NONE);
+	user_list_stage(&ulist2, &strings, "bbb", (struct mode){0});
+
+	assert_ptr_not_null((u1 = user_list_get(&ulist1, CASEMAPPING_RFC1459, "aaa", 0)));
+	assert_ptr_not_null((u2 = user_list_get(&ulist2, CASEMAPPING_RFC1459, "aaa", 0)));
+
+	assert_ptr_eq(u1->nick, u2->nick);
+	assert_ueq(strings.count, 2);
+
+	/* Renaming in each list shares the new nick, and releases the old */
+	assert_eq(user_list_rpl(&ulist1, &strings, CASEMAPPING_RFC1459, "aaa", "AAA"), USER_ERR_NONE);
+	assert_ueq(strings.count, 3);
+	assert_eq(user_list_rpl(&ulist2, &strings, CASEMAPPING_RFC1459, "aaa", "AAA"), USER_ERR_NONE);
+	assert_ueq(strings.count, 2);
+
+	assert_ptr_eq(u1->nick, u2->nick);
+	assert_strcmp(u1->nick, "AAA");
+	assert_ueq(u1->nick_len, 3);
+
+	user_list_free(&ulist1);
+
+	assert_ueq(strings.count, 2);
+
+	user_list_free(&ulist2);
+
+	assert_ueq(strings.count, 0);
+	assert_ptr_null(strings.buckets);
+}
+
 int
 main(void)
 {
 	struct testcase tests[] = {
 		TESTCASE(test_user_list),
 		TESTCASE(test_user_list_casemapping),
-		TESTCASE(test_user_list_free)
+		TESTCASE(test_user_list_free),
+		TESTCASE(test_user_list_merge),
+		TESTCASE(test_user_list_iter),
+		TESTCASE(test_user_list_blocks),
+		TESTCASE(test_user_list_slab),
+		TESTCASE(test_user_list_intern)
 	};
 
 	return run_tests(NULL, NULL, tests);
@@ -4,13 +4,18 @@
 
 #include "src/components/buffer.c"
 #include "src/components/channel.c"
+#include "src/components/chanlist.c"
 #include "src/components/input.c"
 #include "src/components/ircv3.c"
+#include "src/components/isupport.c"
 #include "src/components/mode.c"
+#include "src/components/netsplit.c"
 #include "src/components/server.c"
 #include "src/components/user.c"
 #include "src/draw.c"
 #include "src/state.c"
+#include "src/utils/highlight.c"
+#include "src/utils/intern.c"
 #include "src/utils/utils.c"
 
 #include "test/handlers/irc_recv.mock.c"
@@ -23,7 +28,7 @@ t__buffer_newline(struct buffer *b, const char *t)
 {
 	/* Abstract newline with default values */
 
-	buffer_newline(b, BUFFER_LINE_OTHER, "", t, 0, strlen(t), 0);
+	buffer_newline(b, NULL, BUFFER_LINE_OTHER, 0, "", t, 0, strlen(t), 0);
 }
 
 static void
@@ -65,9 +70,25 @@ test_draw_buffer_line_rows(void)
 	 * */
 	assert_eq(draw_buffer_line_rows(buffer_head(b), 4), 3);
 
+	/* Test row breaks are cached for the measured width */
+	assert_ueq(draw_buffer_line_break(buffer_head(b), 0), 3);
+	assert_ueq(draw_buffer_line_break(buffer_head(b), 1), 6);
+	assert_ueq(draw_buffer_line_break(buffer_head(b), 2), 8);
+
 	/* Greater columns than length should always return one row */
 	assert_eq(draw_buffer_line_rows(buffer_head(b), buffer_head(b)->text_len + 1), 1);
+	assert_ptr_null(buffer_head(b)->cached.breaks);
+	assert_ueq(draw_buffer_line_break(buffer_head(b), 0), 8);
+
+	/* Test rows are measured in display width */
+	t__buffer_newline(b, "\xe4\xb8\xad\xe6\x96\x87 e\xcc\x81");
 
+	assert_eq(draw_buffer_line_rows(buffer_head(b), 6), 1);
+	assert_ueq(buffer_head(b)->cached.width, 6);
+	assert_eq(draw_buffer_line_rows(buffer_head(b), 5), 2);
+	assert_eq(draw_buffer_line_rows(buffer_head(b), 3), 3);
+
+	buffer_free(b);
 	free(b);
 }
 
@@ -81,63 +102,261 @@ test_draw_buffer_scrollback_status(void)
 
 	buffer(b);
 
-	b->head = 100;
-	b->tail = 0;
+	for (unsigned i = 0; i < 100; i++)
+		t__buffer_newline(b, "a");
+
 	assert_ueq(buffer_size(b), 100);
 
+	b->scrollback = b->tail;
+
 	/* test scrollback head in view */
 	b->buffer_i_bot = (b->head - 1);
-	assert_strcmp((draw_buffer_scrollback_status(b, buf, sizeof(buf))), NULL);
+	assert_strcmp((draw_buffer_scrollback_status(b, 80, buf, sizeof(buf))), NULL);
 
 	/* test scrollback tail in view */
 	b->buffer_i_bot = b->tail;
 	b->buffer_i_top = b->tail;
-	assert_strcmp((draw_buffer_scrollback_status(b, buf, sizeof(buf))), "100");
+	assert_strcmp((draw_buffer_scrollback_status(b, 80, buf, sizeof(buf))), "100");
 
 	/* test scrollback at half */
 	b->buffer_i_bot = (b->head / 2);
 	b->buffer_i_top = (b->head / 2) - 2;
-	assert_strcmp((draw_buffer_scrollback_status(b, buf, sizeof(buf))), "50");
+	assert_strcmp((draw_buffer_scrollback_status(b, 80, buf, sizeof(buf))), "50");
+
+	/* test percentage is calculated over rows, not lines */
+	t__buffer_newline(b, "aaaa bbbb cccc dddd");
+	assert_strcmp((draw_buffer_scrollback_status(b, 80, buf, sizeof(buf))), "51");
+	assert_strcmp((draw_buffer_scrollback_status(b, 20, buf, sizeof(buf))), "52");
+
+	buffer_free(b);
+	buffer(b);
 
 	/* test buffer index wrapping */
-	b->head = 999;
-	b->tail = UINT_MAX - 1000;
-	assert_ueq(buffer_size(b), 2000);
+	b->head = UINT_MAX - 9;
+	b->tail = UINT_MAX - 9;
+
+	for (unsigned i = 0; i < 20; i++)
+		t__buffer_newline(b, "a");
+
+	assert_ueq(b->head, 10);
+	assert_ueq(buffer_size(b), 20);
 
 	/* test scrollback head in view */
 	b->scrollback = (b->head - 1);
-	assert_strcmp((draw_buffer_scrollback_status(b, buf, sizeof(buf))), NULL);
+	assert_strcmp((draw_buffer_scrollback_status(b, 80, buf, sizeof(buf))), NULL);
 
 	/* test scrollback tail in view */
 	b->buffer_i_bot = b->tail;
 	b->buffer_i_top = b->tail;
 	b->scrollback = (b->head - 2);
-	assert_strcmp((draw_buffer_scrollback_status(b, buf, sizeof(buf))), "100");
+	assert_strcmp((draw_buffer_scrollback_status(b, 80, buf, sizeof(buf))), "100");
 
 	/* test scrollback at half */
-	b->buffer_i_bot = UINT_MAX;
-	b->buffer_i_top = UINT_MAX - 2;
-	assert_strcmp((draw_buffer_scrollback_status(b, buf, sizeof(buf))), "50");
-
-	b->head++;
-	b->tail++;
-	b->buffer_i_bot++;
-	b->buffer_i_top++;
-	assert_ueq(b->buffer_i_bot, 0);
-	assert_ueq(b->buffer_i_top, UINT_MAX - 1);
-	assert_strcmp((draw_buffer_scrollback_status(b, buf, sizeof(buf))), "50");
-
-	b->head++;
-	b->tail++;
-	b->buffer_i_bot++;
-	b->buffer_i_top++;
-	assert_ueq(b->buffer_i_bot, 1);
-	assert_ueq(b->buffer_i_top, UINT_MAX);
-	assert_strcmp((draw_buffer_scrollback_status(b, buf, sizeof(buf))), "50");
+	b->buffer_i_bot = 0;
+	b->buffer_i_top = UINT_MAX;
+	assert_strcmp((draw_buffer_scrollback_status(b, 80, buf, sizeof(buf))), "50");
+
+	b->buffer_i_bot = 1;
+	b->buffer_i_top = UINT_MAX - 1;
+	assert_strcmp((draw_buffer_scrollback_status(b, 80, buf, sizeof(buf))), "50");
+
+	buffer_free(b);
+	free(b);
+}
+
+static void
+test_draw_buffer_rows(void)
+{
+	/* Test summing buffer rows measures cold lines without thawing them */
+
+	unsigned long long thaw_count;
+	unsigned n = BUFFER_LINES_HOT + BUFFER_BLOCK_LINES;
+	unsigned rows;
+	struct buffer *b = malloc(sizeof(*b));
+
+	buffer(b);
+
+	for (unsigned i = 0; i < n; i++)
+		t__buffer_newline(b, "aaaa bbbb cccc dddd");
+
+	assert_ptr_null(buffer_line_peek(b, b->tail)->text);
+	assert_ueq(b->thawed, 0);
+
+	rows = draw_buffer_line_rows(buffer_head(b), 10);
+
+	assert_gt(rows, 1);
+
+	/* test lines not wrapping aren't thawed */
+	thaw_count = buffer_stats()->thaw_count;
+
+	draw_buffer_rows(b, 80);
 
+	assert_ueq(buffer_rows(b, b->tail, b->head), n);
+	assert_ueq(buffer_stats()->thaw_count, thaw_count);
+	assert_ueq(b->thawed, 0);
+
+	/* test wrapping lines are thawed to be wrapped once, and frozen again */
+	buffer_rows_reset(b, 0);
+
+	draw_buffer_rows(b, 20);
+
+	assert_ueq(buffer_rows(b, b->tail, b->head), n * rows);
+	assert_ueq(buffer_stats()->thaw_count, thaw_count + 1);
+	assert_ueq(b->thawed, 0);
+
+	buffer_rows_reset(b, 0);
+
+	draw_buffer_rows(b, 20);
+
+	assert_ueq(buffer_rows(b, b->tail, b->head), n * rows);
+	assert_ueq(buffer_stats()->thaw_count, thaw_count + 1);
+	assert_ueq(b->thawed, 0);
+
+	buffer_free(b);
 	free(b);
 }
 
+static void
+test_draw_screen(void)
+{
+	/* Test drawing cells into the screen back buffer */
+
+	struct draw_attrs attrs = DRAW_ATTRS_EMPTY;
+	struct draw_cell *cells;
+	unsigned cols = 4;
+
+	draw_screen_resize(10, 3);
+
+	assert_ueq(screen.cols, 10);
+	assert_ueq(screen.rows, 3);
+	assert_strcmp(screen.back[29].glyph, " ");
+
+	cells = screen.back + 10;
+
+	draw_cursor_pos(2, 3);
+	draw_cursor_pos_save();
+
+	drawf(&attrs, &cols, "%b%fa\x01%a\xc3\xa9" "bcd", 1, 2);
+
+	assert_ueq(cols, 0);
+
+	/* Test rows drawn are marked for the next flush */
+	assert_false(screen.dirty[0]);
+	assert_true(screen.dirty[1]);
+	assert_false(screen.dirty[2]);
+
+	assert_strcmp(cells[2].glyph, "a");
+	assert_eq(cells[2].bg, 1);
+	assert_eq(cells[2].fg, 2);
+	assert_strcmp(cells[3].glyph, "A");
+	assert_eq(cells[3].bg, CNTRL_BG);
+	assert_eq(cells[3].fg, CNTRL_FG);
+	assert_strcmp(cells[4].glyph, "\xc3\xa9");
+	assert_eq(cells[4].bg, -1);
+	assert_eq(cells[4].fg, -1);
+	assert_strcmp(cells[5].glyph, "b");
+	assert_strcmp(cells[6].glyph, " ");
+
+	/* Test drawing is clipped to the screen */
+	draw_cursor_pos(3, 10);
+	draw_char(&attrs, 'x');
+	draw_char(&attrs, 'y');
+
+	assert_strcmp(screen.back[29].glyph, "x");
+
+	/* Test clearing a line */
+	draw_cursor_pos(2, 1);
+	draw_clear_line();
+
+	assert_strcmp(cells[2].glyph, " ");
+	assert_eq(cells[2].bg, -1);
+	assert_strcmp(cells[4].glyph, " ");
+	assert_ueq(screen.cursor_row, 1);
+	assert_ueq(screen.cursor_col, 2);
+
+	draw_screen_free();
+}
+
+static void
+test_draw_screen_wide(void)
+{
+	/* Test drawing wide and combining glyphs */
+
+	struct draw_attrs attrs = DRAW_ATTRS_EMPTY;
+	unsigned cols;
+
+	draw_screen_resize(6, 1);
+
+	screen.term = (struct draw_cell) DRAW_CELL_BLANK;
+	screen.valid = 1;
+
+	for (unsigned i = 0; i < 6; i++)
+		screen.front[i] = screen.back[i];
+
+	/* Test wide glyphs occupy two cells, combining code points are appended */
+	cols = 6;
+	draw_cursor_pos(1, 1);
+	drawf(&attrs, &cols, "\xe4\xb8\xad" "ae\xcc\x81");
+
+	assert_ueq(cols, 2);
+	assert_strcmp(screen.back[0].glyph, "\xe4\xb8\xad");
+	assert_strcmp(screen.back[1].glyph, "");
+	assert_strcmp(screen.back[2].glyph, "a");
+	assert_strcmp(screen.back[3].glyph, "e\xcc\x81");
+
+	draw_screen_flush();
+
+	assert_strcmp(screen.front[0].glyph, "\xe4\xb8\xad");
+	assert_strcmp(screen.front[1].glyph, "");
+
+	/* Test rows with wide glyphs are redrawn from the first damaged cell */
+	frame.len = 0;
+	draw_cursor_pos(1, 4);
+	draw_char(&attrs, 'x');
+	draw_screen_flush();
+
+	assert_true(frame.len > 14 && !memcmp(frame.buf + 14, CSI "3Cx" CSI "K", 7));
+
+	/* Test overwriting half a wide glyph blanks the other half */
+	frame.len = 0;
+	draw_cursor_pos(1, 2);
+	draw_char(&attrs, 'y');
+
+	assert_strcmp(screen.back[0].glyph, " ");
+	assert_strcmp(screen.back[1].glyph, "y");
+
+	draw_screen_flush();
+
+	assert_true(frame.len > 14 && !memcmp(frame.buf + 14, " yax" CSI "K", 7));
+
+	assert_strcmp(screen.front[0].glyph, " ");
+	assert_strcmp(screen.front[1].glyph, "y");
+
+	/* Test rows not drawn since the last flush aren't compared */
+	screen.front[2].glyph[0] = 'z';
+
+	draw_screen_flush();
+
+	assert_false(screen.dirty[0]);
+	assert_strcmp(screen.front[2].glyph, "z");
+
+	screen.front[2].glyph[0] = 'a';
+
+	/* Test wide glyphs don't draw beyond the available columns */
+	cols = 1;
+	draw_cursor_pos(1, 6);
+	drawf(&attrs, &cols, "\xe4\xb8\xad");
+
+	assert_ueq(cols, 0);
+	assert_strcmp(screen.back[5].glyph, " ");
+
+	free(frame.buf);
+
+	memset(&frame, 0, sizeof(frame));
+
+	draw_screen_free();
+}
+
 static void
 test_draw_buffer_wrap(void)
 {
@@ -214,185 +433,108 @@ test_draw_buffer_wrap(void)
 	CHECK_WRAP("a bb  ", 6, "");
 	CHECK_WRAP("a bb  ", 7, "");
 
-	#define ATTRS_ALL "\x02\x03""11,22\x1D\x11\x0F\x16\x1E\x1F"
-
-	/* test all attrs, test empty string */
-	assert_ueq(draw_buffer_wrap(ATTRS_ALL "", 0, 0), 0);
-	assert_ueq(draw_buffer_wrap("" ATTRS_ALL, 0, 1), 0);
-	assert_ueq(draw_buffer_wrap(ATTRS_ALL "", 0, 2), 0);
-
-	/* test all attrs, test zero cols */
-	assert_ueq(draw_buffer_wrap(ATTRS_ALL "",      0, 0), 0);
-	assert_ueq(draw_buffer_wrap("a" ATTRS_ALL,     1, 0), 0);
-	assert_ueq(draw_buffer_wrap("a" ATTRS_ALL "b", 2, 0), 0);
-
-	/* test all attrs, test all print */
-	CHECK_WRAP(ATTRS_ALL "abcde", 1, "bcde");
-	CHECK_WRAP(ATTRS_ALL "abcde", 2, "cde");
-	CHECK_WRAP(ATTRS_ALL "abcde", 3, "de");
-	CHECK_WRAP(ATTRS_ALL "abcde", 4, "e");
-	CHECK_WRAP(ATTRS_ALL "abcde", 5, "");
-	CHECK_WRAP(ATTRS_ALL "abcde", 6, "");
-
-	/* test all attrs, test all space */
-	CHECK_WRAP(ATTRS_ALL "     ", 1, "    ");
-	CHECK_WRAP(ATTRS_ALL "     ", 2, "   ");
-	CHECK_WRAP(ATTRS_ALL "     ", 3, "  ");
-	CHECK_WRAP(ATTRS_ALL "     ", 4, " ");
-	CHECK_WRAP(ATTRS_ALL "     ", 5, "");
-	CHECK_WRAP(ATTRS_ALL "     ", 6, "");
-
-	/* test all attrs, test all combinations for 'a bb  ccc' */
-	CHECK_WRAP(            ATTRS_ALL "a bb  ccc", 1,  " bb  ccc");
-	CHECK_WRAP("a"         ATTRS_ALL " bb  ccc",  2,  "bb  ccc");
-	CHECK_WRAP("a "        ATTRS_ALL "bb  ccc",   3,  "bb  ccc");
-	CHECK_WRAP("a b"       ATTRS_ALL "b  ccc",    4,  "b" ATTRS_ALL "b  ccc");
-	CHECK_WRAP("a bb"      ATTRS_ALL "  ccc",     5,  "bb" ATTRS_ALL "  ccc");
-	CHECK_WRAP("a bb "     ATTRS_ALL " ccc",      6,  "bb " ATTRS_ALL " ccc");
-	CHECK_WRAP("a bb  "    ATTRS_ALL "ccc",       7,  "ccc");
-	CHECK_WRAP("a bb  c"   ATTRS_ALL "cc",        8,  "c" ATTRS_ALL "cc");
-	CHECK_WRAP("a bb  cc"  ATTRS_ALL "c",         9,  "");
-	CHECK_WRAP("a bb  ccc" ATTRS_ALL,             10, "");
+	/* test wide and combining code points */
+	CHECK_WRAP("\xe4\xb8\xad\xe6\x96\x87 ab", 1, "\xe6\x96\x87 ab");
+	CHECK_WRAP("\xe4\xb8\xad\xe6\x96\x87 ab", 3, "\xe6\x96\x87 ab");
+	CHECK_WRAP("\xe4\xb8\xad\xe6\x96\x87 ab", 4, " ab");
+	CHECK_WRAP("\xe4\xb8\xad\xe6\x96\x87 ab", 5, "ab");
+	CHECK_WRAP("\xe4\xb8\xad\xe6\x96\x87 ab", 6, "ab");
+	CHECK_WRAP("\xe4\xb8\xad\xe6\x96\x87 ab", 7, "");
+
+	CHECK_WRAP("e\xcc\x81" "e\xcc\x81", 1, "e\xcc\x81");
+	CHECK_WRAP("e\xcc\x81" "e\xcc\x81", 2, "");
 
 	#undef CHECK_WRAP
 }
 
 static void
-test_draw_irc_colour(void)
+test_draw_screen_sgr(void)
 {
-	int fg;
-	int bg;
-
-	fg = -2;
-	bg = -2;
-	assert_eq(draw_parse_irc_colour("xxx", &fg, &bg), 0);
-	assert_eq(fg, -2);
-	assert_eq(bg, -2);
-
-	fg = -2;
-	bg = -2;
-	assert_eq(draw_parse_irc_colour("\x03", &fg, &bg), 1);
-	assert_eq(fg, -1);
-	assert_eq(bg, -1);
-
-	fg = -2;
-	bg = -2;
-	assert_eq(draw_parse_irc_colour("\x03xxx", &fg, &bg), 1);
-	assert_eq(fg, -1);
-	assert_eq(bg, -1);
-
-	fg = -2;
-	bg = -2;
-	assert_eq(draw_parse_irc_colour("\x03,", &fg, &bg), 1);
-	assert_eq(fg, -1);
-	assert_eq(bg, -1);
-
-	fg = -2;
-	bg = -2;
-	assert_eq(draw_parse_irc_colour("\x03,1", &fg, &bg), 3);
-	assert_eq(fg, -2);
-	assert_eq(bg, irc_to_ansi_colour[1]);
-
-	fg = -2;
-	bg = -2;
-	assert_eq(draw_parse_irc_colour("\x03,11", &fg, &bg), 4);
-	assert_eq(fg, -2);
-	assert_eq(bg, irc_to_ansi_colour[11]);
-
-	fg = -2;
-	bg = -2;
-	assert_eq(draw_parse_irc_colour("\x03" "2", &fg, &bg), 2);
-	assert_eq(fg, irc_to_ansi_colour[2]);
-	assert_eq(bg, -2);
-
-	fg = -2;
-	bg = -2;
-	assert_eq(draw_parse_irc_colour("\x03" "3,", &fg, &bg), 2);
-	assert_eq(fg, irc_to_ansi_colour[3]);
-	assert_eq(bg, -2);
-
-	fg = -2;
-	bg = -2;
-	assert_eq(draw_parse_irc_colour("\x03" "4,5", &fg, &bg), 4);
-	assert_eq(fg, irc_to_ansi_colour[4]);
-	assert_eq(bg, irc_to_ansi_colour[5]);
-
-	fg = -2;
-	bg = -2;
-	assert_eq(draw_parse_irc_colour("\x03" "6,77", &fg, &bg), 5);
-	assert_eq(fg, irc_to_ansi_colour[6]);
-	assert_eq(bg, irc_to_ansi_colour[77]);
-
-	fg = -2;
-	bg = -2;
-	assert_eq(draw_parse_irc_colour("\x03" "11", &fg, &bg), 3);
-	assert_eq(fg, irc_to_ansi_colour[11]);
-	assert_eq(bg, -2);
-
-	fg = -2;
-	bg = -2;
-	assert_eq(draw_parse_irc_colour("\x03" "22,", &fg, &bg), 3);
-	assert_eq(fg, irc_to_ansi_colour[22]);
-	assert_eq(bg, -2);
-
-	fg = -2;
-	bg = -2;
-	assert_eq(draw_parse_irc_colour("\x03" "33,4", &fg, &bg), 5);
-	assert_eq(fg, irc_to_ansi_colour[33]);
-	assert_eq(bg, irc_to_ansi_colour[4]);
-
-	fg = -2;
-	bg = -2;
-	assert_eq(draw_parse_irc_colour("\x03" "55,66", &fg, &bg), 6);
-	assert_eq(fg, irc_to_ansi_colour[55]);
-	assert_eq(bg, irc_to_ansi_colour[66]);
-
-	fg = -2;
-	bg = -2;
-	assert_eq(draw_parse_irc_colour("\x03" "111", &fg, &bg), 3);
-	assert_eq(fg, irc_to_ansi_colour[11]);
-	assert_eq(bg, -2);
-
-	fg = -2;
-	bg = -2;
-	assert_eq(draw_parse_irc_colour("\x03" "222,", &fg, &bg), 3);
-	assert_eq(fg, irc_to_ansi_colour[22]);
-	assert_eq(bg, -2);
-
-	fg = -2;
-	bg = -2;
-	assert_eq(draw_parse_irc_colour("\x03" "333,4,", &fg, &bg), 3);
-	assert_eq(fg, irc_to_ansi_colour[33]);
-	assert_eq(bg, -2);
-
-	fg = -2;
-	bg = -2;
-	assert_eq(draw_parse_irc_colour("\x03" "1,222", &fg, &bg), 5);
-	assert_eq(fg, irc_to_ansi_colour[1]);
-	assert_eq(bg, irc_to_ansi_colour[22]);
-
-	fg = -2;
-	bg = -2;
-	assert_eq(draw_parse_irc_colour("\x03" "22,333", &fg, &bg), 6);
-	assert_eq(fg, irc_to_ansi_colour[22]);
-	assert_eq(bg, irc_to_ansi_colour[33]);
-
-	fg = -2;
-	bg = -2;
-	assert_eq(draw_parse_irc_colour("\x03" "11,22", &fg, NULL), 6);
-	assert_eq(fg, irc_to_ansi_colour[11]);
-	assert_eq(bg, -2);
-
-	fg = -2;
-	bg = -2;
-	assert_eq(draw_parse_irc_colour("\x03" "11,22", NULL, &bg), 6);
-	assert_eq(fg, -2);
-	assert_eq(bg, irc_to_ansi_colour[22]);
-
-	assert_eq(draw_parse_irc_colour("\x03",         NULL, NULL), 1);
-	assert_eq(draw_parse_irc_colour("\x03" "11",    NULL, NULL), 3);
-	assert_eq(draw_parse_irc_colour("\x03" ",22",   NULL, NULL), 4);
-	assert_eq(draw_parse_irc_colour("\x03" "11,22", NULL, NULL), 6);
+	/* Test only changed attributes are set on the terminal */
+
+	#define CHECK_SGR(BG, FG, FLAGS, S) \
+	do { \
+		frame.len = 0; \
+		draw_screen_sgr(&((struct draw_cell) { .bg = (BG), .fg = (FG), .flags = (FLAGS) })); \
+		assert_ueq(frame.len, strlen(S)); \
+		assert_true(!frame.len || !memcmp(frame.buf, (S), frame.len)); \
+	} while (0)
+
+	screen.term = (struct draw_cell) DRAW_CELL_BLANK;
+
+	/* Unchanged attributes */
+	CHECK_SGR(-1, -1, 0, "");
+
+	/* Set colours and attributes */
+	CHECK_SGR(1, 255, 0, CSI "48;5;1;38;5;255m");
+	CHECK_SGR(1, 255, DRAW_CELL_BOLD, CSI "1m");
+	CHECK_SGR(1, 7, DRAW_CELL_BOLD | DRAW_CELL_UNDERLINE, CSI "38;5;7;4m");
+
+	/* Unset colours and attributes */
+	CHECK_SGR(1, -1, DRAW_CELL_UNDERLINE, CSI "39;22m");
+	CHECK_SGR(-1, -1, DRAW_CELL_UNDERLINE, CSI "49m");
+
+	/* Reset when shorter */
+	CHECK_SGR(-1, -1, DRAW_CELL_BOLD | DRAW_CELL_ITALIC | DRAW_CELL_REVERSE, CSI "0;1;3;7m");
+	CHECK_SGR(-1, -1, 0, CSI "0m");
+	CHECK_SGR(10, 20, DRAW_CELL_STRIKE | DRAW_CELL_ITALIC, CSI "48;5;10;38;5;20;3;9m");
+	CHECK_SGR(-1, 20, DRAW_CELL_STRIKE, CSI "49;23m");
+
+	#undef CHECK_SGR
+
+	free(frame.buf);
+
+	memset(&frame, 0, sizeof(frame));
+}
+
+static void
+test_draw_screen_scroll(void)
+{
+	/* Test scrolling the terminal when the back buffer scrolled */
+
+	const char *expected = CSI "2;4r" CSI "4;1H\n\n" CSI "r";
+
+	draw_screen_resize(2, 5);
+
+	screen.term = (struct draw_cell) DRAW_CELL_BLANK;
+	screen.valid = 1;
+
+	for (unsigned i = 0; i < 10; i++) {
+		screen.back[i].glyph[0] = 'a' + (i / 2);
+		screen.front[i] = screen.back[i];
+	}
+
+	/* Test region scrolled with unchanged rows outside it */
+	screen.back[2].glyph[0] = 'd';
+	screen.back[3].glyph[0] = 'd';
+	screen.back[4].glyph[0] = 'x';
+
+	/* Test scrolling is skipped when rows don't match */
+	draw_screen_scroll(2, 4, 1);
+	draw_screen_scroll_region();
+
+	assert_ueq(frame.len, 0);
+	assert_ueq(screen.scroll_rows, 0);
+
+	draw_screen_scroll(2, 4, 2);
+	draw_screen_scroll_region();
+
+	assert_ueq(frame.len, strlen(expected));
+	assert_true(!memcmp(frame.buf, expected, frame.len));
+
+	assert_strcmp(screen.front[0].glyph, "a");
+	assert_strcmp(screen.front[2].glyph, "d");
+	assert_strcmp(screen.front[3].glyph, "d");
+	assert_strcmp(screen.front[4].glyph, " ");
+	assert_strcmp(screen.front[7].glyph, " ");
+	assert_strcmp(screen.front[8].glyph, "e");
+	assert_ueq(screen.term_row, DRAW_CURSOR_UNKNOWN);
+
+	free(frame.buf);
+
+	memset(&frame, 0, sizeof(frame));
+
+	draw_screen_free();
 }
 
 int
@@ -401,8 +543,12 @@ main(void)
 	struct testcase tests[] = {
 		TESTCASE(test_draw_buffer_line_rows),
 		TESTCASE(test_draw_buffer_scrollback_status),
+		TESTCASE(test_draw_buffer_rows),
 		TESTCASE(test_draw_buffer_wrap),
-		TESTCASE(test_draw_irc_colour),
+		TESTCASE(test_draw_screen),
+		TESTCASE(test_draw_screen_sgr),
+		TESTCASE(test_draw_screen_wide),
+		TESTCASE(test_draw_screen_scroll),
 	};
 
 	return run_tests(NULL, NULL, tests);
@@ -2,15 +2,20 @@
 
 #include "src/components/buffer.c"
 #include "src/components/channel.c"
+#include "src/components/chanlist.c"
 #include "src/components/channel.h"
 #include "src/components/input.c"
 #include "src/components/ircv3.c"
+#include "src/components/isupport.c"
 #include "src/components/mode.c"
+#include "src/components/netsplit.c"
 #include "src/components/server.c"
 #include "src/components/user.c"
 #include "src/handlers/irc_ctcp.c"
 #include "src/handlers/irc_recv.c"
 #include "src/handlers/ircv3.c"
+#include "src/utils/highlight.c"
+#include "src/utils/intern.c"
 #include "src/utils/utils.c"
 
 #include "test/draw.mock.c"
@@ -217,8 +222,8 @@ test_recv_join(void)
 
 	threshold_join = 0;
 
-	assert_eq(user_list_add(&(c1->users), CASEMAPPING_RFC1459, "nick1", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c2->users), CASEMAPPING_RFC1459, "nick1", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c1->users), &(s->intern), CASEMAPPING_RFC1459, "nick1", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c2->users), &(s->intern), CASEMAPPING_RFC1459, "nick1", (struct mode){0}), USER_ERR_NONE);
 
 	CHECK_RECV("JOIN #c1", 1, 1, 0);
 	assert_strcmp(mock_chan[0], "host");
@@ -267,6 +272,32 @@ test_recv_join(void)
 	assert_strcmp(mock_send[0], "MODE #new");
 	assert_ptr_not_null(channel_list_get(&s->clist, "#new", s->casemapping));
 
+	/* test IRCv3 chathistory requested on rejoin */
+	CHECK_RECV(":me!user@host JOIN #c3", 0, 1, 1);
+
+	s->ircv3_caps.draft_chathistory.set = 1;
+
+	CHECK_RECV(":me!user@host JOIN #c3", 0, 1, 1);
+
+	strcpy(c3->history.time, "2020-01-01T00:00:00.000Z");
+
+	CHECK_RECV(":me!user@host JOIN #c3", 0, 1, 2);
+	assert_strcmp(mock_send[0], "MODE #c3");
+	assert_strcmp(mock_send[1], "CHATHISTORY AFTER #c3 timestamp=2020-01-01T00:00:00.000Z 1024");
+
+	strcpy(c3->history.msgid, "abc");
+	assert_eq(isupport_set(&(s->isupport), "CHATHISTORY", "100"), 0);
+
+	CHECK_RECV(":me!user@host JOIN #c3", 0, 1, 2);
+	assert_strcmp(mock_send[1], "CHATHISTORY AFTER #c3 msgid=abc 100");
+
+	assert_eq(isupport_set(&(s->isupport), "CHATHISTORY", "2000"), 0);
+
+	CHECK_RECV(":me!user@host JOIN #c3", 0, 1, 2);
+	assert_strcmp(mock_send[1], "CHATHISTORY AFTER #c3 msgid=abc 1024");
+
+	s->ircv3_caps.draft_chathistory.set = 0;
+
 	/* test threshold_join */
 	c_filter = c2;
 
@@ -327,9 +358,9 @@ test_recv_kick(void)
 {
 	/* :nick!user@host KICK <channel> <user> [:message] */
 
-	assert_eq(user_list_add(&(c1->users), CASEMAPPING_RFC1459, "nick1", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c1->users), CASEMAPPING_RFC1459, "nick2", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c1->users), CASEMAPPING_RFC1459, "nick3", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c1->users), &(s->intern), CASEMAPPING_RFC1459, "nick1", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c1->users), &(s->intern), CASEMAPPING_RFC1459, "nick2", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c1->users), &(s->intern), CASEMAPPING_RFC1459, "nick3", (struct mode){0}), USER_ERR_NONE);
 
 	CHECK_RECV("KICK #c1", 1, 1, 0);
 	assert_strcmp(mock_chan[0], "host");
@@ -406,10 +437,10 @@ test_recv_nick(void)
 
 	threshold_nick = 0;
 
-	assert_eq(user_list_add(&(c1->users), CASEMAPPING_RFC1459, "nick1", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c1->users), CASEMAPPING_RFC1459, "nick2", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c3->users), CASEMAPPING_RFC1459, "nick1", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c3->users), CASEMAPPING_RFC1459, "nick2", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c1->users), &(s->intern), CASEMAPPING_RFC1459, "nick1", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c1->users), &(s->intern), CASEMAPPING_RFC1459, "nick2", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c3->users), &(s->intern), CASEMAPPING_RFC1459, "nick1", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c3->users), &(s->intern), CASEMAPPING_RFC1459, "nick2", (struct mode){0}), USER_ERR_NONE);
 
 	CHECK_RECV("NICK new_nick", 1, 1, 0);
 	assert_strcmp(mock_chan[0], "host");
@@ -445,7 +476,7 @@ test_recv_nick(void)
 	assert_strcmp(mock_line[0], "Your nick is now 'new_me'");
 
 	/* user can change own nick case */
-	assert_eq(user_list_add(&(c1->users), CASEMAPPING_RFC1459, "abc{}|^", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c1->users), &(s->intern), CASEMAPPING_RFC1459, "abc{}|^", (struct mode){0}), USER_ERR_NONE);
 
 	CHECK_RECV(":abc{}|^!user@host NICK AbC{]|~", 0, 1, 0);
 	assert_strcmp(mock_chan[0], "#c1");
@@ -456,15 +487,15 @@ test_recv_nick(void)
 	/* test threshold_nick */
 	c_filter = c2;
 
-	assert_eq(user_list_add(&(c_filter->users), CASEMAPPING_RFC1459, "nick-filter-1", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c_filter->users), CASEMAPPING_RFC1459, "nick-filter-2", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c_filter->users), CASEMAPPING_RFC1459, "nick-filter-3", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c_filter->users), CASEMAPPING_RFC1459, "nick-filter-4", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c_filter->users), CASEMAPPING_RFC1459, "nick-filter-5", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c_filter->users), CASEMAPPING_RFC1459, "nick-filter-6", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c_filter->users), CASEMAPPING_RFC1459, "nick-filter-7", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c_filter->users), CASEMAPPING_RFC1459, "nick-filter-8", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c_filter->users), CASEMAPPING_RFC1459, "nick-filter-9", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c_filter->users), &(s->intern), CASEMAPPING_RFC1459, "nick-filter-1", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c_filter->users), &(s->intern), CASEMAPPING_RFC1459, "nick-filter-2", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c_filter->users), &(s->intern), CASEMAPPING_RFC1459, "nick-filter-3", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c_filter->users), &(s->intern), CASEMAPPING_RFC1459, "nick-filter-4", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c_filter->users), &(s->intern), CASEMAPPING_RFC1459, "nick-filter-5", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c_filter->users), &(s->intern), CASEMAPPING_RFC1459, "nick-filter-6", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c_filter->users), &(s->intern), CASEMAPPING_RFC1459, "nick-filter-7", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c_filter->users), &(s->intern), CASEMAPPING_RFC1459, "nick-filter-8", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c_filter->users), &(s->intern), CASEMAPPING_RFC1459, "nick-filter-9", (struct mode){0}), USER_ERR_NONE);
 
 	/* test threshold_nick is set */
 	threshold_nick = 100;
@@ -521,7 +552,42 @@ test_recv_nick(void)
 static void
 test_recv_notice(void)
 {
-	/* TODO */
+	/* [:nick[!user@host]] NOTICE <target> <:message> */
+
+	CHECK_RECV("NOTICE", 1, 1, 0);
+	assert_strcmp(mock_line[0], "NOTICE: target is null");
+
+	CHECK_RECV("NOTICE me", 1, 1, 0);
+	assert_strcmp(mock_line[0], "NOTICE: message is null");
+
+	/* test notices from the server */
+	CHECK_RECV("NOTICE me :xxx", 0, 1, 0);
+	assert_strcmp(mock_chan[0], "host");
+	assert_strcmp(mock_line[0], "xxx");
+
+	/* test notices from users with a private buffer */
+	p1->activity = ACTIVITY_DEFAULT;
+
+	CHECK_RECV(":p1!user@host NOTICE me :xxx", 0, 1, 0);
+	assert_strcmp(mock_chan[0], "p1");
+	assert_strcmp(mock_line[0], "xxx");
+	assert_eq(p1->activity, ACTIVITY_DEFAULT);
+
+	/* test highlighted notices are urgent */
+	CHECK_RECV(":p1!user@host NOTICE me :xxx me xxx", 0, 1, 0);
+	assert_strcmp(mock_chan[0], "p1");
+	assert_eq(p1->activity, ACTIVITY_PINGED);
+
+	/* test notices from users without a private buffer */
+	s->channel->activity = ACTIVITY_DEFAULT;
+
+	CHECK_RECV(":nick!user@host NOTICE #c1 :xxx", 0, 1, 0);
+	assert_strcmp(mock_chan[0], "host");
+	assert_eq(s->channel->activity, ACTIVITY_DEFAULT);
+
+	CHECK_RECV(":nick!user@host NOTICE #c1 :xxx me xxx", 0, 1, 0);
+	assert_strcmp(mock_chan[0], "host");
+	assert_eq(s->channel->activity, ACTIVITY_PINGED);
 }
 
 static void
@@ -569,9 +635,9 @@ test_recv_part(void)
 
 	threshold_part = 0;
 
-	assert_eq(user_list_add(&(c1->users), CASEMAPPING_RFC1459, "nick1", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c1->users), CASEMAPPING_RFC1459, "nick2", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c1->users), CASEMAPPING_RFC1459, "nick3", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c1->users), &(s->intern), CASEMAPPING_RFC1459, "nick1", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c1->users), &(s->intern), CASEMAPPING_RFC1459, "nick2", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c1->users), &(s->intern), CASEMAPPING_RFC1459, "nick3", (struct mode){0}), USER_ERR_NONE);
 
 	CHECK_RECV("PART #c1 :part message", 1, 1, 0);
 	assert_strcmp(mock_chan[0], "host");
@@ -626,15 +692,15 @@ test_recv_part(void)
 	/* test threshold_part */
 	c_filter = c2;
 
-	assert_eq(user_list_add(&(c_filter->users), CASEMAPPING_RFC1459, "nick-filter-1", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c_filter->users), CASEMAPPING_RFC1459, "nick-filter-2", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c_filter->users), CASEMAPPING_RFC1459, "nick-filter-3", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c_filter->users), CASEMAPPING_RFC1459, "nick-filter-4", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c_filter->users), CASEMAPPING_RFC1459, "nick-filter-5", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c_filter->users), CASEMAPPING_RFC1459, "nick-filter-6", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c_filter->users), CASEMAPPING_RFC1459, "nick-filter-7", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c_filter->users), CASEMAPPING_RFC1459, "nick-filter-8", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c_filter->users), CASEMAPPING_RFC1459, "nick-filter-9", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c_filter->users), &(s->intern), CASEMAPPING_RFC1459, "nick-filter-1", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c_filter->users), &(s->intern), CASEMAPPING_RFC1459, "nick-filter-2", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c_filter->users), &(s->intern), CASEMAPPING_RFC1459, "nick-filter-3", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c_filter->users), &(s->intern), CASEMAPPING_RFC1459, "nick-filter-4", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c_filter->users), &(s->intern), CASEMAPPING_RFC1459, "nick-filter-5", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c_filter->users), &(s->intern), CASEMAPPING_RFC1459, "nick-filter-6", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c_filter->users), &(s->intern), CASEMAPPING_RFC1459, "nick-filter-7", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c_filter->users), &(s->intern), CASEMAPPING_RFC1459, "nick-filter-8", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c_filter->users), &(s->intern), CASEMAPPING_RFC1459, "nick-filter-9", (struct mode){0}), USER_ERR_NONE);
 
 	/* test threshold_part is set */
 	threshold_part = 100;
@@ -714,7 +780,71 @@ test_recv_pong(void)
 static void
 test_recv_privmsg(void)
 {
-	/* TODO */
+	/* :nick!user@host PRIVMSG <target> :<message> */
+
+	/* test highlighted by nick */
+	c1->activity = ACTIVITY_DEFAULT;
+	CHECK_RECV(":nick!user@host PRIVMSG #c1 :xxx mexxx", 0, 1, 0);
+	assert_strcmp(mock_chan[0], "#c1");
+	assert_strcmp(mock_line[0], "xxx mexxx");
+	assert_eq(c1->activity, ACTIVITY_DEFAULT);
+
+	CHECK_RECV(":nick!user@host PRIVMSG #c1 :xxx ME: xxx", 0, 1, 0);
+	assert_eq(c1->activity, ACTIVITY_PINGED);
+
+	/* test highlighted by keywords */
+	assert_eq(server_set_highlights(s, "rirc,foo bar"), 0);
+
+	c1->activity = ACTIVITY_DEFAULT;
+	CHECK_RECV(":nick!user@host PRIVMSG #c1 :xxx foo baz", 0, 1, 0);
+	assert_eq(c1->activity, ACTIVITY_DEFAULT);
+
+	CHECK_RECV(":nick!user@host PRIVMSG #c1 :xxx Foo Bar!", 0, 1, 0);
+	assert_eq(c1->activity, ACTIVITY_PINGED);
+
+	c1->activity = ACTIVITY_DEFAULT;
+	CHECK_RECV(":nick!user@host PRIVMSG #c1 :rirc", 0, 1, 0);
+	assert_eq(c1->activity, ACTIVITY_PINGED);
+
+	/* test highlights follow nick changes */
+	CHECK_RECV(":me!user@host NICK new_me", 0, 1, 0);
+
+	c1->activity = ACTIVITY_DEFAULT;
+	CHECK_RECV(":nick!user@host PRIVMSG #c1 :xxx me xxx", 0, 1, 0);
+	assert_eq(c1->activity, ACTIVITY_DEFAULT);
+
+	CHECK_RECV(":nick!user@host PRIVMSG #c1 :xxx new_me xxx", 0, 1, 0);
+	assert_eq(c1->activity, ACTIVITY_PINGED);
+
+	server_nick_set(s, "me");
+
+	assert_eq(server_set_highlights(s, ""), 0);
+
+	c1->activity = ACTIVITY_DEFAULT;
+	CHECK_RECV(":nick!user@host PRIVMSG #c1 :rirc", 0, 1, 0);
+	assert_eq(c1->activity, ACTIVITY_DEFAULT);
+
+	/* test IRCv3 msgid and server-time marked per channel */
+	CHECK_RECV("@time=2020-01-01T00:00:00.000Z;msgid=a1 :nick!user@host PRIVMSG #c1 :x", 0, 1, 0);
+	assert_strcmp(c1->history.time, "2020-01-01T00:00:00.000Z");
+	assert_strcmp(c1->history.msgid, "a1");
+
+	CHECK_RECV("@msgid=a2 :nick!user@host PRIVMSG #c1 :x", 0, 1, 0);
+	assert_strcmp(c1->history.time, "");
+	assert_strcmp(c1->history.msgid, "a2");
+
+	CHECK_RECV("@time=2020-01-01T00:00:01.000Z :nick!user@host NOTICE #c1 :x", 0, 1, 0);
+	assert_strcmp(c1->history.time, "2020-01-01T00:00:01.000Z");
+	assert_strcmp(c1->history.msgid, "");
+
+	CHECK_RECV("@msgid=a\\sb;+x=y :nick!user@host PRIVMSG #c1 :x", 0, 1, 0);
+	assert_strcmp(c1->history.time, "2020-01-01T00:00:01.000Z");
+	assert_strcmp(c1->history.msgid, "");
+
+	CHECK_RECV("@msgid=a3 :nick!user@host PRIVMSG me :x", 0, 1, 0);
+	assert_strcmp(c1->history.msgid, "");
+	assert_strcmp(c2->history.msgid, "");
+	assert_strcmp(c3->history.msgid, "");
 }
 
 static void
@@ -726,13 +856,13 @@ test_recv_quit(void)
 
 	threshold_quit = 0;
 
-	assert_eq(user_list_add(&(c1->users), CASEMAPPING_RFC1459, "nick1", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c1->users), CASEMAPPING_RFC1459, "nick2", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c1->users), CASEMAPPING_RFC1459, "nick3", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c1->users), CASEMAPPING_RFC1459, "nick4", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c1->users), &(s->intern), CASEMAPPING_RFC1459, "nick1", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c1->users), &(s->intern), CASEMAPPING_RFC1459, "nick2", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c1->users), &(s->intern), CASEMAPPING_RFC1459, "nick3", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c1->users), &(s->intern), CASEMAPPING_RFC1459, "nick4", (struct mode){0}), USER_ERR_NONE);
 
-	assert_eq(user_list_add(&(c3->users), CASEMAPPING_RFC1459, "nick1", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c3->users), CASEMAPPING_RFC1459, "nick2", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c3->users), &(s->intern), CASEMAPPING_RFC1459, "nick1", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c3->users), &(s->intern), CASEMAPPING_RFC1459, "nick2", (struct mode){0}), USER_ERR_NONE);
 
 	CHECK_RECV("QUIT message", 1, 1, 0);
 	assert_strcmp(mock_chan[0], "host");
@@ -764,15 +894,15 @@ test_recv_quit(void)
 	/* test threshold_quit */
 	c_filter = c2;
 
-	assert_eq(user_list_add(&(c_filter->users), CASEMAPPING_RFC1459, "nick-filter-1", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c_filter->users), CASEMAPPING_RFC1459, "nick-filter-2", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c_filter->users), CASEMAPPING_RFC1459, "nick-filter-3", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c_filter->users), CASEMAPPING_RFC1459, "nick-filter-4", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c_filter->users), CASEMAPPING_RFC1459, "nick-filter-5", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c_filter->users), CASEMAPPING_RFC1459, "nick-filter-6", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c_filter->users), CASEMAPPING_RFC1459, "nick-filter-7", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c_filter->users), CASEMAPPING_RFC1459, "nick-filter-8", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c_filter->users), CASEMAPPING_RFC1459, "nick-filter-9", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c_filter->users), &(s->intern), CASEMAPPING_RFC1459, "nick-filter-1", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c_filter->users), &(s->intern), CASEMAPPING_RFC1459, "nick-filter-2", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c_filter->users), &(s->intern), CASEMAPPING_RFC1459, "nick-filter-3", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c_filter->users), &(s->intern), CASEMAPPING_RFC1459, "nick-filter-4", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c_filter->users), &(s->intern), CASEMAPPING_RFC1459, "nick-filter-5", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c_filter->users), &(s->intern), CASEMAPPING_RFC1459, "nick-filter-6", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c_filter->users), &(s->intern), CASEMAPPING_RFC1459, "nick-filter-7", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c_filter->users), &(s->intern), CASEMAPPING_RFC1459, "nick-filter-8", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c_filter->users), &(s->intern), CASEMAPPING_RFC1459, "nick-filter-9", (struct mode){0}), USER_ERR_NONE);
 
 	/* test threshold_quit is set */
 	threshold_quit = 100;
@@ -826,6 +956,140 @@ test_recv_quit(void)
 	CHECK_RECV(":nick-filter-9!user@host QUIT", 0, 0, 0);
 }
 
+static void
+test_recv_netsplit(void)
+{
+	/* Netsplit QUITs and netjoin JOINs are collected into a single line
+	 * per channel */
+
+	unsigned threshold_join_prev = threshold_join;
+	unsigned threshold_quit_prev = threshold_quit;
+
+	netsplit_window = 5;
+	threshold_join = 0;
+	threshold_quit = 0;
+
+	assert_eq(user_list_add(&(c1->users), &(s->intern), CASEMAPPING_RFC1459, "nick1", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c1->users), &(s->intern), CASEMAPPING_RFC1459, "nick2", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c1->users), &(s->intern), CASEMAPPING_RFC1459, "nick3", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c1->users), &(s->intern), CASEMAPPING_RFC1459, "nick4", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c2->users), &(s->intern), CASEMAPPING_RFC1459, "nick5", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c3->users), &(s->intern), CASEMAPPING_RFC1459, "nick1", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c3->users), &(s->intern), CASEMAPPING_RFC1459, "nick2", (struct mode){0}), USER_ERR_NONE);
+
+	/* test quits collected through other messages */
+	CHECK_RECV(":nick1!user@host QUIT :irc.a.net irc.b.net", 0, 0, 0);
+	CHECK_RECV("PING :x", 0, 0, 1);
+	assert_strcmp(mock_send[0], "PONG x");
+	CHECK_RECV(":nick2!user@host QUIT :irc.a.net irc.b.net", 0, 0, 0);
+	CHECK_RECV(":nick9!user@host QUIT :irc.a.net irc.b.net", 0, 0, 0);
+	assert_ptr_null(user_list_get(&(c1->users), s->casemapping, "nick1", 0));
+	assert_ptr_null(user_list_get(&(c3->users), s->casemapping, "nick2", 0));
+	assert_eq(c1->users.count, 2);
+	assert_eq(c3->users.count, 0);
+
+	/* test quits collected until the window lapses */
+	mock_reset_state();
+	irc_recv_netsplit(s, s->netsplit.time + 5);
+	assert_eq(mock_line_n, 0);
+
+	irc_recv_netsplit(s, s->netsplit.time + 6);
+	assert_eq(mock_line_n, 2);
+	assert_strcmp(mock_chan[0], "#c1");
+	assert_strcmp(mock_line[0], "netsplit: 2 users (irc.a.net irc.b.net)");
+	assert_strcmp(mock_chan[1], "#c3");
+	assert_strcmp(mock_line[1], "netsplit: 2 users (irc.a.net irc.b.net)");
+
+	mock_reset_state();
+	irc_recv_netsplit(s, s->netsplit.time + 6);
+	assert_eq(mock_line_n, 0);
+
+	/* test joins of split users collected through other messages */
+	CHECK_RECV(":nick1!user@host JOIN #c1", 0, 0, 0);
+	CHECK_RECV(":nick7!user@host JOIN #c1", 0, 1, 0);
+	assert_strcmp(mock_chan[0], "#c1");
+	assert_strcmp(mock_line[0], "nick7!user@host has joined");
+	CHECK_RECV(":NICK2!user@host JOIN #c1", 0, 0, 0);
+	CHECK_RECV(":nick2!user@host JOIN #c3", 0, 0, 0);
+	CHECK_RECV(":nick1!user@host MODE #c1 +v nick2", 0, 1, 0);
+	assert_eq(c1->users.count, 5);
+	assert_eq(c3->users.count, 1);
+
+	mock_reset_state();
+	irc_recv_netsplit(s, s->netsplit.time + 6);
+	assert_eq(mock_line_n, 2);
+	assert_strcmp(mock_chan[0], "#c1");
+	assert_strcmp(mock_line[0], "netjoin: 2 users (irc.a.net irc.b.net)");
+	assert_strcmp(mock_chan[1], "#c3");
+	assert_strcmp(mock_line[1], "netjoin: 1 user (irc.a.net irc.b.net)");
+	assert_ptr_not_null(user_list_get(&(c1->users), s->casemapping, "nick1", 0));
+	assert_ptr_not_null(user_list_get(&(c1->users), s->casemapping, "nick2", 0));
+	assert_ptr_not_null(user_list_get(&(c3->users), s->casemapping, "nick2", 0));
+	assert_eq(c1->users.count, 5);
+
+	/* test quits collected until another split */
+	CHECK_RECV(":nick3!user@host QUIT :irc.c.net irc.d.net", 0, 0, 0);
+	CHECK_RECV(":nick7!user@host QUIT :irc.e.net irc.f.net", 0, 1, 0);
+	assert_strcmp(mock_chan[0], "#c1");
+	assert_strcmp(mock_line[0], "netsplit: 1 user (irc.c.net irc.d.net)");
+
+	/* test quits collected through other quits */
+	CHECK_RECV(":nick1!user@host QUIT :irc.e.net irc.f.net", 0, 0, 0);
+	CHECK_RECV(":nick2!user@host QUIT :quit message", 0, 2, 0);
+	assert_strcmp(mock_chan[0], "#c1");
+	assert_strcmp(mock_line[0], "nick2!user@host has quit (quit message)");
+	assert_strcmp(mock_chan[1], "#c3");
+	assert_strcmp(mock_line[1], "nick2!user@host has quit (quit message)");
+
+	mock_reset_state();
+	irc_recv_netsplit(s, s->netsplit.time + 6);
+	assert_eq(mock_line_n, 1);
+	assert_strcmp(mock_chan[0], "#c1");
+	assert_strcmp(mock_line[0], "netsplit: 2 users (irc.e.net irc.f.net)");
+
+	/* test users of earlier splits aren't collected as joining */
+	CHECK_RECV(":nick3!user@host JOIN #c1", 0, 1, 0);
+	assert_strcmp(mock_line[0], "nick3!user@host has joined");
+
+	/* test quits of a split resumed after the window lapses are collected
+	 * with its users, for their joins */
+	assert_eq(user_list_add(&(c2->users), &(s->intern), CASEMAPPING_RFC1459, "nick8", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c2->users), &(s->intern), CASEMAPPING_RFC1459, "nick9", (struct mode){0}), USER_ERR_NONE);
+
+	CHECK_RECV(":nick8!user@host QUIT :irc.g.net irc.h.net", 0, 0, 0);
+
+	mock_reset_state();
+	irc_recv_netsplit(s, s->netsplit.time + 6);
+	assert_eq(mock_line_n, 1);
+	assert_strcmp(mock_line[0], "netsplit: 1 user (irc.g.net irc.h.net)");
+
+	CHECK_RECV("PING :x", 0, 0, 1);
+	CHECK_RECV(":nick9!user@host QUIT :irc.g.net irc.h.net", 0, 0, 0);
+	CHECK_RECV(":nick8!user@host JOIN #c2", 0, 1, 0);
+	assert_strcmp(mock_line[0], "netsplit: 1 user (irc.g.net irc.h.net)");
+	CHECK_RECV(":nick9!user@host JOIN #c2", 0, 0, 0);
+
+	mock_reset_state();
+	irc_recv_netsplit(s, s->netsplit.time + 6);
+	assert_eq(mock_line_n, 1);
+	assert_strcmp(mock_chan[0], "#c2");
+	assert_strcmp(mock_line[0], "netjoin: 2 users (irc.g.net irc.h.net)");
+
+	/* test never collected */
+	netsplit_window = 0;
+
+	CHECK_RECV(":nick1!user@host JOIN #c3", 0, 1, 0);
+	assert_strcmp(mock_line[0], "nick1!user@host has joined");
+
+	CHECK_RECV(":nick5!user@host QUIT :irc.a.net irc.b.net", 0, 1, 0);
+	assert_strcmp(mock_chan[0], "#c2");
+	assert_strcmp(mock_line[0], "nick5!user@host has quit (irc.a.net irc.b.net)");
+
+	netsplit_window = NETSPLIT_WINDOW;
+	threshold_join = threshold_join_prev;
+	threshold_quit = threshold_quit_prev;
+}
+
 static void
 test_recv_topic(void)
 {
@@ -908,9 +1172,9 @@ test_recv_ircv3_account(void)
 
 	threshold_account = 0;
 
-	assert_eq(user_list_add(&(c1->users), CASEMAPPING_RFC1459, "nick1", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c1->users), CASEMAPPING_RFC1459, "nick2", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c3->users), CASEMAPPING_RFC1459, "nick1", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c1->users), &(s->intern), CASEMAPPING_RFC1459, "nick1", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c1->users), &(s->intern), CASEMAPPING_RFC1459, "nick2", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c3->users), &(s->intern), CASEMAPPING_RFC1459, "nick1", (struct mode){0}), USER_ERR_NONE);
 
 	CHECK_RECV("ACCOUNT *", 1, 1, 0);
 	assert_strcmp(mock_chan[0], "host");
@@ -939,7 +1203,7 @@ test_recv_ircv3_account(void)
 	/* test threshold_account */
 	c_filter = c2;
 
-	assert_eq(user_list_add(&(c_filter->users), CASEMAPPING_RFC1459, "nick-filter", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c_filter->users), &(s->intern), CASEMAPPING_RFC1459, "nick-filter", (struct mode){0}), USER_ERR_NONE);
 
 	/* test threshold_account is set */
 	threshold_account = 100;
@@ -1002,9 +1266,9 @@ test_recv_ircv3_away(void)
 
 	threshold_away = 0;
 
-	assert_eq(user_list_add(&(c1->users), CASEMAPPING_RFC1459, "nick1", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c1->users), CASEMAPPING_RFC1459, "nick2", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c3->users), CASEMAPPING_RFC1459, "nick1", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c1->users), &(s->intern), CASEMAPPING_RFC1459, "nick1", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c1->users), &(s->intern), CASEMAPPING_RFC1459, "nick2", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c3->users), &(s->intern), CASEMAPPING_RFC1459, "nick1", (struct mode){0}), USER_ERR_NONE);
 
 	CHECK_RECV("AWAY *", 1, 1, 0);
 	assert_strcmp(mock_chan[0], "host");
@@ -1030,7 +1294,7 @@ test_recv_ircv3_away(void)
 	/* test threshold_away */
 	c_filter = c2;
 
-	assert_eq(user_list_add(&(c_filter->users), CASEMAPPING_RFC1459, "nick-filter", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c_filter->users), &(s->intern), CASEMAPPING_RFC1459, "nick-filter", (struct mode){0}), USER_ERR_NONE);
 
 	/* test threshold_away is set */
 	threshold_away = 100;
@@ -1093,9 +1357,9 @@ test_recv_ircv3_chghost(void)
 
 	threshold_chghost = 0;
 
-	assert_eq(user_list_add(&(c1->users), CASEMAPPING_RFC1459, "nick1", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c1->users), CASEMAPPING_RFC1459, "nick2", (struct mode){0}), USER_ERR_NONE);
-	assert_eq(user_list_add(&(c3->users), CASEMAPPING_RFC1459, "nick1", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c1->users), &(s->intern), CASEMAPPING_RFC1459, "nick1", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c1->users), &(s->intern), CASEMAPPING_RFC1459, "nick2", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c3->users), &(s->intern), CASEMAPPING_RFC1459, "nick1", (struct mode){0}), USER_ERR_NONE);
 
 	CHECK_RECV("CHGHOST new_user new_host", 1, 1, 0);
 	assert_strcmp(mock_chan[0], "host");
@@ -1119,7 +1383,7 @@ test_recv_ircv3_chghost(void)
 	/* test threshold_chghost */
 	c_filter = c2;
 
-	assert_eq(user_list_add(&(c_filter->users), CASEMAPPING_RFC1459, "nick-filter", (struct mode){0}), USER_ERR_NONE);
+	assert_eq(user_list_add(&(c_filter->users), &(s->intern), CASEMAPPING_RFC1459, "nick-filter", (struct mode){0}), USER_ERR_NONE);
 
 	/* test threshold_chghost is set */
 	threshold_chghost = 100;
@@ -1186,12 +1450,10 @@ test_irc_recv_001(void)
 
 	assert_eq(s->registered, 0);
 
-	CHECK_RECV("001 me", 0, 1, 3);
+	CHECK_RECV("001 me", 0, 1, 1);
 	assert_strcmp(mock_chan[0], "host");
 	assert_strcmp(mock_line[0], "You are known as me");
-	assert_strcmp(mock_send[0], "JOIN #c1");
-	assert_strcmp(mock_send[1], "JOIN #c2");
-	assert_strcmp(mock_send[2], "JOIN #c3");
+	assert_strcmp(mock_send[0], "JOIN #c1,#c2,#c3");
 
 	assert_eq(s->registered, 1);
 
@@ -1199,28 +1461,47 @@ test_irc_recv_001(void)
 	mock_reset_io();
 	mock_reset_state();
 
-	CHECK_RECV("001 me :welcome message", 0, 2, 3);
+	CHECK_RECV("001 me :welcome message", 0, 2, 1);
 	assert_strcmp(mock_chan[0], "host");
 	assert_strcmp(mock_line[0], "welcome message");
 	assert_strcmp(mock_line[1], "You are known as me");
-	assert_strcmp(mock_send[0], "JOIN #c1");
-	assert_strcmp(mock_send[1], "JOIN #c2");
-	assert_strcmp(mock_send[2], "JOIN #c3");
+	assert_strcmp(mock_send[0], "JOIN #c1,#c2,#c3");
 
-	/* test channel keys */
+	/* test channel keys, keyed channels first */
 	mock_reset_io();
 	mock_reset_state();
 
 	channel_key_add(c1, "foo");
 	channel_key_add(c3, "bar");
 
-	CHECK_RECV("001 me :welcome message", 0, 2, 3);
+	CHECK_RECV("001 me :welcome message", 0, 2, 1);
 	assert_strcmp(mock_chan[0], "host");
 	assert_strcmp(mock_line[0], "welcome message");
 	assert_strcmp(mock_line[1], "You are known as me");
+	assert_strcmp(mock_send[0], "JOIN #c1,#c3,#c2 foo,bar");
+
+	/* test TARGMAX */
+	mock_reset_io();
+	mock_reset_state();
+
+	channel_key_add(c2, "baz");
+
+	assert_eq(isupport_set(&(s->isupport), "TARGMAX", "PRIVMSG:4,JOIN:2"), 0);
+
+	CHECK_RECV("001 me", 0, 1, 2);
+	assert_strcmp(mock_send[0], "JOIN #c1,#c2 foo,baz");
+	assert_strcmp(mock_send[1], "JOIN #c3 bar");
+
+	channel_key_del(c2);
+
+	assert_eq(isupport_set(&(s->isupport), "TARGMAX", "JOIN:1"), 0);
+
+	CHECK_RECV("001 me", 0, 1, 3);
 	assert_strcmp(mock_send[0], "JOIN #c1 foo");
-	assert_strcmp(mock_send[1], "JOIN #c2");
-	assert_strcmp(mock_send[2], "JOIN #c3 bar");
+	assert_strcmp(mock_send[1], "JOIN #c3 bar");
+	assert_strcmp(mock_send[2], "JOIN #c2");
+
+	assert_eq(isupport_set(&(s->isupport), "-TARGMAX", NULL), 0);
 
 	channel_key_del(c1);
 	channel_key_del(c3);
@@ -1231,13 +1512,11 @@ test_irc_recv_001(void)
 
 	s->mode = strdup("abc");
 
-	CHECK_RECV("001 me", 0, 1, 4);
+	CHECK_RECV("001 me", 0, 1, 2);
 	assert_strcmp(mock_chan[0], "host");
 	assert_strcmp(mock_line[0], "You are known as me");
 	assert_strcmp(mock_send[0], "MODE me +abc");
-	assert_strcmp(mock_send[1], "JOIN #c1");
-	assert_strcmp(mock_send[2], "JOIN #c2");
-	assert_strcmp(mock_send[3], "JOIN #c3");
+	assert_strcmp(mock_send[1], "JOIN #c1,#c2,#c3");
 
 	/* test parted channels aren't auto joined */
 	mock_reset_io();
@@ -1245,12 +1524,71 @@ test_irc_recv_001(void)
 
 	c2->parted = 1;
 
-	CHECK_RECV("001 me", 0, 1, 3);
+	CHECK_RECV("001 me", 0, 1, 2);
 	assert_strcmp(mock_chan[0], "host");
 	assert_strcmp(mock_line[0], "You are known as me");
 	assert_strcmp(mock_send[0], "MODE me +abc");
-	assert_strcmp(mock_send[1], "JOIN #c1");
-	assert_strcmp(mock_send[2], "JOIN #c3");
+	assert_strcmp(mock_send[1], "JOIN #c1,#c3");
+
+	c2->parted = 0;
+
+	free((void *)s->mode);
+	s->mode = NULL;
+
+	/* test CHANLIMIT */
+	mock_reset_io();
+	mock_reset_state();
+
+	assert_eq(isupport_set(&(s->isupport), "CHANLIMIT", "&:1,#:2"), 0);
+
+	CHECK_RECV("001 me", 0, 2, 1);
+	assert_strcmp(mock_line[1], "Channel limit reached, not joining #c3");
+	assert_strcmp(mock_send[0], "JOIN #c1,#c2");
+
+	/* test channels rejected as too long don't count against the limit */
+	mock_reset_io();
+	mock_reset_state();
+
+	char key[IRC_MESSAGE_LEN];
+
+	memset(key, 'k', sizeof(key) - 1);
+	key[sizeof(key) - 1] = 0;
+
+	channel_key_add(c1, key);
+
+	CHECK_RECV("001 me", 0, 2, 1);
+	assert_strcmp(mock_line[1], "JOIN: channel too long: #c1");
+	assert_strcmp(mock_send[0], "JOIN #c2,#c3");
+
+	channel_key_del(c1);
+
+	assert_eq(isupport_set(&(s->isupport), "-CHANLIMIT", NULL), 0);
+
+	/* test packing channels up to the message length */
+	mock_reset_io();
+	mock_reset_state();
+
+	struct channel *chans[100];
+	char name[16];
+
+	for (int i = 0; i < 100; i++) {
+		snprintf(name, sizeof(name), "#x%03d", i);
+		chans[i] = channel(name, CHANNEL_T_CHANNEL);
+		channel_list_add(&(s->clist), chans[i]);
+	}
+
+	channel_key_add(chans[50], "key");
+
+	CHECK_RECV("001 me", 0, 1, 2);
+	assert_strncmp(mock_send[0], "JOIN #x050,#c1,#c2,#c3,#x000,#x001,", 35);
+	assert_ueq(strlen(mock_send[0]), 506);
+	assert_strcmp(mock_send[0] + 496, ",#x080 key");
+	assert_strcmp(mock_send[1], "JOIN #x081,#x082,#x083,#x084,#x085,#x086,#x087,#x088,#x089,#x090,#x091,#x092,#x093,#x094,#x095,#x096,#x097,#x098,#x099");
+
+	for (int i = 0; i < 100; i++) {
+		channel_list_del(&(s->clist), chans[i]);
+		channel_free(chans[i]);
+	}
 }
 
 static void
@@ -1453,6 +1791,77 @@ test_irc_recv_320(void)
 	/* TODO */
 }
 
+static void
+test_irc_recv_321(void)
+{
+	/* RPL_LISTSTART
+	 *
+	 * Channel :Users Name */
+
+	chanlist_add(&(s->chanlist), "#x", 1, "");
+
+	CHECK_RECV("321 me Channel :Users Name", 0, 0, 0);
+	assert_eq(s->chanlist.entries_len, 0);
+	assert_true(s->chanlist.listing);
+
+	CHECK_RECV("323 me :End of /LIST", 0, 1, 0);
+	assert_false(s->chanlist.listing);
+}
+
+static void
+test_irc_recv_322(void)
+{
+	/* RPL_LIST
+	 *
+	 * <channel> <visible users> :<topic> */
+
+	CHECK_RECV("322 me", 1, 1, 0);
+	assert_strcmp(mock_line[0], "RPL_LIST: channel is null");
+
+	CHECK_RECV("322 me #x", 1, 1, 0);
+	assert_strcmp(mock_line[0], "RPL_LIST: users is null");
+
+	CHECK_RECV("322 me #x 1x", 1, 1, 0);
+	assert_strcmp(mock_line[0], "RPL_LIST: invalid users: '1x'");
+
+	CHECK_RECV("322 me #x -1", 1, 1, 0);
+	assert_strcmp(mock_line[0], "RPL_LIST: invalid users: '-1'");
+
+	/* Test entries are collected without printing, and without RPL_LISTSTART */
+	chanlist_add(&(s->chanlist), "#x", 1, "");
+
+	CHECK_RECV("322 me #a 10 :topic a", 0, 0, 0);
+	CHECK_RECV("322 me #b 20", 0, 0, 0);
+
+	assert_eq(s->chanlist.entries_len, 2);
+	assert_strcmp(chanlist_name(&(s->chanlist), &(s->chanlist.entries[0])), "#a");
+	assert_strcmp(chanlist_topic(&(s->chanlist), &(s->chanlist.entries[0])), "topic a");
+	assert_eq(s->chanlist.entries[0].users, 10);
+	assert_strcmp(chanlist_name(&(s->chanlist), &(s->chanlist.entries[1])), "#b");
+	assert_strcmp(chanlist_topic(&(s->chanlist), &(s->chanlist.entries[1])), "");
+	assert_eq(s->chanlist.entries[1].users, 20);
+}
+
+static void
+test_irc_recv_323(void)
+{
+	/* RPL_LISTEND
+	 *
+	 * :End of /LIST */
+
+	CHECK_RECV("322 me #a 10 :topic a", 0, 0, 0);
+	CHECK_RECV("322 me #b 20", 0, 0, 0);
+	CHECK_RECV("323 me :End of /LIST", 0, 1, 0);
+	assert_strcmp(mock_chan[0], "host");
+	assert_strcmp(mock_line[0], "LIST: 2 channel(s), :list to view");
+	assert_false(s->chanlist.listing);
+
+	/* Test the next list replaces entries */
+	CHECK_RECV("322 me #c 30 :topic c", 0, 0, 0);
+	CHECK_RECV("323 me :End of /LIST", 0, 1, 0);
+	assert_strcmp(mock_line[0], "LIST: 1 channel(s), :list to view");
+}
+
 static void
 test_irc_recv_324(void)
 {
@@ -1595,11 +2004,37 @@ test_irc_recv_353(void)
 	assert_strcmp(mock_line[1], "RPL_NAMEREPLY: invalid nick: '@+'");
 	channel_reset(c1);
 
-	/* test initial user list populating, duplicate nick */
-	CHECK_RECV("353 me = #c1 :n1 n1 n1", 0, 2, 0);
+	/* test initial user list populating, duplicate nick, detected at RPL_ENDOFNAMES */
+	CHECK_RECV("353 me = #c1 :n1 n1", 0, 0, 0);
+	CHECK_RECV("353 me = #c1 :n2 n1", 0, 0, 0);
+	assert_eq(c1->users.count, 4);
+	CHECK_RECV("366 me #c1", 0, 2, 0);
 	assert_strcmp(mock_chan[0], "host");
 	assert_strcmp(mock_line[0], "RPL_NAMEREPLY: duplicate nick: 'n1'");
 	assert_strcmp(mock_line[1], "RPL_NAMEREPLY: duplicate nick: 'n1'");
+	assert_eq(c1->users.count, 2);
+	assert_true(c1->_366);
+	channel_reset(c1);
+
+	/* test initial user list populating, staged users merged with existing */
+	CHECK_RECV(":n3!u@h JOIN #c1", 0, 0, 0);
+	CHECK_RECV("353 me = #c1 :n1 @n2", 0, 0, 0);
+	CHECK_RECV(":n4!u@h JOIN #c1", 0, 0, 0);
+	CHECK_RECV("353 me = #c1 :n3 +n4 n5", 0, 0, 0);
+	CHECK_RECV("366 me #c1", 0, 2, 0);
+	assert_strcmp(mock_line[0], "RPL_NAMEREPLY: duplicate nick: 'n4'");
+	assert_strcmp(mock_line[1], "RPL_NAMEREPLY: duplicate nick: 'n3'");
+	assert_eq(c1->users.count, 5);
+
+	if (!(u1 = user_list_get(&(c1->users), CASEMAPPING_RFC1459, "n2", 0))
+	 || !(u2 = user_list_get(&(c1->users), CASEMAPPING_RFC1459, "n4", 0))
+	 || !(u3 = user_list_get(&(c1->users), CASEMAPPING_RFC1459, "n5", 0)))
+		test_abort("Failed to retrieve users");
+
+	assert_eq(u1->prfxmodes.lower, (mode_bit('o')));
+	assert_eq(u2->prfxmodes.lower, 0);
+	assert_eq(u3->prfxmodes.lower, 0);
+
 	channel_reset(c1);
 
 	/* test initial user list populating, single nick */
@@ -1862,6 +2297,165 @@ test_irc_recv_718(void)
 	/* TODO */
 }
 
+static unsigned long long
+test_recv_stats_n(struct server *sv, const char *command)
+{
+	struct irc_recv_stat out[64];
+	size_t n = irc_recv_stats(sv, out, ARR_LEN(out));
+
+	for (size_t i = 0; i < n; i++) {
+		if (!strcmp(out[i].command, command))
+			return out[i].n;
+	}
+
+	return 0;
+}
+
+static void
+test_recv_stats(void)
+{
+	/* Test messages are counted by command, numeric, or as unknown */
+
+	struct irc_recv_stat out[64];
+	struct server *s2;
+	unsigned long long n_pong = test_recv_stats_n(s, "PONG");
+	unsigned long long n_unknown = test_recv_stats_n(s, "*");
+	unsigned long long n_numeric = test_recv_stats_n(s, "372");
+
+	CHECK_RECV("PONG s1", 0, 0, 0);
+	CHECK_RECV("PONG s1", 0, 0, 0);
+	CHECK_RECV(":irc.server 372 me :motd", 0, 1, 0);
+	CHECK_RECV("UNHANDLED", 0, 1, 0);
+
+	assert_ueq(test_recv_stats_n(s, "PONG"), n_pong + 2);
+	assert_ueq(test_recv_stats_n(s, "372"), n_numeric + 1);
+	assert_ueq(test_recv_stats_n(s, "*"), n_unknown + 1);
+
+	/* Statistics are kept per server */
+	s2 = server("h2", "p2", NULL, "u2", "r2", NULL);
+
+	assert_ueq(irc_recv_stats(s2, out, ARR_LEN(out)), 0);
+
+	server_free(s2);
+}
+
+static void
+test_recv_ircv3_batch(void)
+{
+	/* BATCH +<reference> <type> [<parameters>]
+	 * BATCH -<reference> */
+
+	CHECK_RECV("BATCH", 1, 1, 0);
+	assert_strcmp(mock_chan[0], "host");
+	assert_strcmp(mock_line[0], "BATCH: reference is null");
+
+	CHECK_RECV("BATCH ref", 1, 1, 0);
+	assert_strcmp(mock_line[0], "BATCH: invalid reference 'ref'");
+
+	CHECK_RECV("BATCH +", 1, 1, 0);
+	assert_strcmp(mock_line[0], "BATCH: invalid reference '+'");
+
+	CHECK_RECV("BATCH +ref", 1, 1, 0);
+	assert_strcmp(mock_line[0], "BATCH: type is null");
+
+	CHECK_RECV("BATCH +ref chathistory", 1, 1, 0);
+	assert_strcmp(mock_line[0], "BATCH: target is null");
+
+	CHECK_RECV("BATCH +ref chathistory #notfound", 1, 1, 0);
+	assert_strcmp(mock_line[0], "BATCH: channel '#notfound' not found");
+
+	CHECK_RECV("BATCH +"
+		"xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx"
+		" chathistory #c1", 1, 1, 0);
+	assert_strcmp(mock_line[0], "BATCH: reference too long");
+
+	/* test other batch types are ignored */
+	CHECK_RECV("BATCH +ref netsplit irc.a irc.b", 0, 0, 0);
+	assert_strcmp(c1->history.batch, "");
+
+	CHECK_RECV("BATCH -ref", 0, 0, 0);
+
+	/* test chathistory batch */
+	CHECK_RECV("BATCH +ref1 chathistory #c1", 0, 0, 0);
+	CHECK_RECV("BATCH +ref2 chathistory P1", 0, 0, 0);
+	assert_strcmp(c1->history.batch, "ref1");
+	assert_strcmp(p1->history.batch, "ref2");
+
+	CHECK_RECV("@batch=ref1;time=2020-01-01T00:00:00.000Z;msgid=b1 :nick!user@host PRIVMSG #c1 :x", 0, 1, 0);
+	assert_strcmp(mock_chan[0], "#c1");
+	assert_strcmp(c1->history.msgid, "b1");
+
+	/* test replayed lines are added at their server-time */
+	assert_eq(mock_time[0], 1577836800);
+
+	/* test replayed highlights aren't urgent */
+	c1->activity = ACTIVITY_DEFAULT;
+	p1->activity = ACTIVITY_DEFAULT;
+
+	CHECK_RECV("@batch=ref1;time=2020-01-01T00:00:01.000Z :nick!user@host PRIVMSG #c1 :me", 0, 1, 0);
+	assert_eq(mock_time[0], 1577836801);
+	assert_eq(c1->activity, ACTIVITY_DEFAULT);
+
+	CHECK_RECV("@batch=ref2;time=2020-01-01T00:00:02.000Z :p1!user@host PRIVMSG me :x", 0, 1, 0);
+	assert_strcmp(mock_chan[0], "p1");
+	assert_eq(mock_time[0], 1577836802);
+	assert_eq(p1->activity, ACTIVITY_DEFAULT);
+
+	CHECK_RECV("@batch=ref2;time=2020-01-01T00:00:03.000Z :p1!user@host NOTICE me :x", 0, 1, 0);
+	assert_strcmp(mock_chan[0], "p1");
+	assert_eq(mock_time[0], 1577836803);
+
+	/* test live messages received during a batch aren't replayed */
+	CHECK_RECV("@time=2020-01-01T00:00:04.000Z :nick!user@host PRIVMSG #c1 :me", 0, 1, 0);
+	assert_gt(mock_time[0], 1577836804);
+	assert_eq(c1->activity, ACTIVITY_PINGED);
+
+	c1->activity = ACTIVITY_DEFAULT;
+
+	CHECK_RECV("@batch=ref2;time=2020-01-01T00:00:04.000Z :nick!user@host PRIVMSG #c1 :me", 0, 1, 0);
+	assert_gt(mock_time[0], 1577836804);
+	assert_eq(c1->activity, ACTIVITY_PINGED);
+
+	CHECK_RECV("@batch=ref1;time=2020-01-01T00:00:05.000Z :nick!user@host PRIVMSG #c1 :x", 0, 1, 0);
+	assert_eq(mock_time[0], 1577836805);
+
+	p1->activity = ACTIVITY_DEFAULT;
+
+	CHECK_RECV(":p1!user@host NOTICE me :me", 0, 1, 0);
+	assert_gt(mock_time[0], 1577836804);
+	assert_eq(p1->activity, ACTIVITY_PINGED);
+
+	CHECK_RECV("BATCH -ref1", 0, 0, 0);
+	assert_strcmp(c1->history.batch, "");
+	assert_strcmp(p1->history.batch, "ref2");
+
+	/* test lines after the batch are added at the time received */
+	CHECK_RECV("@time=2020-01-01T00:00:04.000Z;msgid=b2 :nick!user@host PRIVMSG #c1 :me", 0, 1, 0);
+	assert_gt(mock_time[0], 1577836804);
+	assert_eq(c1->activity, ACTIVITY_PINGED);
+
+	CHECK_RECV("BATCH -ref2", 0, 0, 0);
+	assert_strcmp(p1->history.batch, "");
+
+	/* test disconnecting ends open batches */
+	CHECK_RECV("BATCH +ref3 chathistory #c1", 0, 0, 0);
+	assert_strcmp(c1->history.batch, "ref3");
+
+	channel_reset(c1);
+
+	assert_strcmp(c1->history.batch, "");
+	assert_strcmp(c1->history.msgid, "b2");
+}
+
+static void
+test_recv_ircv3_tagmsg(void)
+{
+	/* @tags :nick!user@host TAGMSG <target> */
+
+	CHECK_RECV("@+typing=active :nick!user@host TAGMSG #c1", 0, 0, 0);
+	CHECK_RECV("@+typing=done :nick!user@host TAGMSG me", 0, 0, 0);
+}
+
 static int
 test_init(void)
 {
@@ -1923,12 +2517,16 @@ main(void)
 		TESTCASE(test_recv_pong),
 		TESTCASE(test_recv_privmsg),
 		TESTCASE(test_recv_quit),
+		TESTCASE(test_recv_netsplit),
 		TESTCASE(test_recv_topic),
 		TESTCASE(test_recv_wallops),
 		TESTCASE(test_recv_ircv3_cap),
 		TESTCASE(test_recv_ircv3_account),
 		TESTCASE(test_recv_ircv3_away),
 		TESTCASE(test_recv_ircv3_chghost),
+		TESTCASE(test_recv_ircv3_batch),
+		TESTCASE(test_recv_ircv3_tagmsg),
+		TESTCASE(test_recv_stats),
 		#define X(numeric) \
 		TESTCASE(test_irc_recv_##numeric),
 		IRC_RECV_NUMERICS
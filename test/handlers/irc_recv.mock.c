@@ -5,3 +5,19 @@ irc_recv(struct server *s, struct irc_message *m)
 	UNUSED(m);
 	return 0;
 }
+
+void
+irc_recv_netsplit(struct server *s, time_t t)
+{
+	UNUSED(s);
+	UNUSED(t);
+}
+
+size_t
+irc_recv_stats(struct server *s, struct irc_recv_stat *out, size_t n)
+{
+	UNUSED(s);
+	UNUSED(out);
+	UNUSED(n);
+	return 0;
+}
@@ -2,12 +2,17 @@
 
 #include "src/components/buffer.c"
 #include "src/components/channel.c"
+#include "src/components/chanlist.c"
 #include "src/components/input.c"
 #include "src/components/ircv3.c"
+#include "src/components/isupport.c"
 #include "src/components/mode.c"
+#include "src/components/netsplit.c"
 #include "src/components/server.c"
 #include "src/components/user.c"
 #include "src/handlers/irc_send.c"
+#include "src/utils/highlight.c"
+#include "src/utils/intern.c"
 #include "src/utils/utils.c"
 
 #include "test/io.mock.c"
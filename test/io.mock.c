@@ -56,6 +56,22 @@ connection(
 	return NULL;
 }
 
+int
+io_capture(struct connection *c, const char *path)
+{
+	UNUSED(c);
+	UNUSED(path);
+	return 0;
+}
+
+int
+io_replay(struct connection *c, const char *path)
+{
+	UNUSED(c);
+	UNUSED(path);
+	return 0;
+}
+
 int
 io_cx(struct connection *c)
 {
@@ -90,6 +106,13 @@ io_err(int err)
 	return (cxed ? "cxed" : "dxed");
 }
 
+void
+io_stats(struct connection *c, struct io_stats *out)
+{
+	UNUSED(c);
+	memset(out, 0, sizeof(*out));
+}
+
 unsigned io_tty_cols(void) { return 0; }
 unsigned io_tty_rows(void) { return 0; }
 void io_init(void) { ; }
@@ -2,13 +2,18 @@
 
 #include "src/components/buffer.c"
 #include "src/components/channel.c"
+#include "src/components/chanlist.c"
 #include "src/components/input.c"
 #include "src/components/ircv3.c"
+#include "src/components/isupport.c"
 #include "src/components/mode.c"
+#include "src/components/netsplit.c"
 #include "src/components/server.c"
 #include "src/components/user.c"
 #include "src/handlers/irc_send.c"
 #include "src/state.c"
+#include "src/utils/highlight.c"
+#include "src/utils/intern.c"
 #include "src/utils/utils.c"
 
 #include "test/draw.mock.c"
@@ -436,6 +441,125 @@ test_command_disconnect(void)
 	assert_ptr_null(CURRENT_LINE);
 }
 
+static void
+test_command_list(void)
+{
+	struct server *s;
+
+#define LIST_LINE(N) \
+	buffer_line(&(s->channel->buffer), s->channel->buffer.head - (N))->text
+
+	mock_reset_io();
+
+	INP_COMMAND(":list");
+
+	assert_strcmp(action_message(), "list: This is not a server");
+
+	/* clear error */
+	INP_C(0x0A);
+
+	if (!(s = server("host", "port", NULL, "user", "real", NULL)))
+		test_abort("Failed test setup");
+
+	if (server_list_add(state_server_list(), s))
+		test_abort("Failed to add server");
+
+	channel_set_current(s->channel);
+
+	INP_COMMAND(":list");
+
+	assert_strcmp(CURRENT_LINE, "LIST: no channels");
+
+	/* Test pages sized to the buffer's rows */
+	state_tty_rows = 8;
+
+	chanlist_add(&(s->chanlist), "#aa", 10, "topic a");
+	chanlist_add(&(s->chanlist), "#b", 50, "");
+	chanlist_add(&(s->chanlist), "#c", 5, "topic c");
+	chanlist_add(&(s->chanlist), "#D", 50, "topic d");
+	chanlist_add(&(s->chanlist), "#e", 1, "topic e");
+
+	INP_COMMAND(":list");
+
+	assert_strcmp(LIST_LINE(4), "LIST: page 1 of 2, 5 of 5 channel(s)");
+	assert_strcmp(LIST_LINE(3), "#b      50  ");
+	assert_strcmp(LIST_LINE(2), "#D      50  topic d");
+	assert_strcmp(LIST_LINE(1), "#aa     10  topic a");
+
+	INP_COMMAND(":list");
+
+	assert_strcmp(LIST_LINE(3), "LIST: page 2 of 2, 5 of 5 channel(s)");
+	assert_strcmp(LIST_LINE(2), "#c      5  topic c");
+	assert_strcmp(LIST_LINE(1), "#e      1  topic e");
+
+	INP_COMMAND(":list");
+
+	assert_strcmp(LIST_LINE(4), "LIST: page 1 of 2, 5 of 5 channel(s)");
+
+	/* Test filtering and sorting */
+	INP_COMMAND(":list -n >1 <50");
+
+	assert_strcmp(LIST_LINE(3), "LIST: page 1 of 1, 2 of 5 channel(s)");
+	assert_strcmp(LIST_LINE(2), "#aa     10  topic a");
+	assert_strcmp(LIST_LINE(1), "#c       5  topic c");
+
+	INP_COMMAND(":list -n d");
+
+	assert_strcmp(LIST_LINE(2), "LIST: page 1 of 1, 1 of 5 channel(s)");
+	assert_strcmp(LIST_LINE(1), "#D     50  topic d");
+
+	INP_COMMAND(":list -x");
+
+	assert_strcmp(action_message(), "list: Unknown arg '-x'");
+
+	/* clear error */
+	INP_C(0x0A);
+
+	INP_COMMAND(":list >x");
+
+	assert_strcmp(action_message(), "list: Invalid users '>x'");
+
+	/* clear error */
+	INP_C(0x0A);
+
+	INP_COMMAND(":list a b");
+
+	assert_strcmp(action_message(), "list: Unexpected arg 'b'");
+
+	/* clear error */
+	INP_C(0x0A);
+
+	/* Test requesting the list, with conditions supported by ELIST */
+	INP_COMMAND(":list -r");
+
+	assert_strcmp(action_message(), "list: Not registered with server");
+
+	/* clear error */
+	INP_C(0x0A);
+
+	s->registered = 1;
+
+	INP_COMMAND(":list -r >4 abc");
+
+	assert_strcmp(mock_send[0], "LIST");
+	assert_eq(s->chanlist.entries_len, 0);
+	assert_eq(s->chanlist.filter.users_min, 4);
+
+	assert_eq(isupport_set(&(s->isupport), "ELIST", "MNU"), 0);
+
+	INP_COMMAND(":list -r >4 <100 abc");
+
+	assert_strcmp(mock_send[1], "LIST >4,<100,*abc*");
+
+	INP_COMMAND(":list");
+
+	assert_strcmp(CURRENT_LINE, "LIST: no channels received yet");
+
+	state_tty_rows = 0;
+
+#undef LIST_LINE
+}
+
 static void
 test_command_quit(void)
 {
@@ -452,6 +576,38 @@ test_command_quit(void)
 	assert_ptr_null(action_message());
 }
 
+static void
+test_command_stats(void)
+{
+	struct server *s;
+
+	INP_COMMAND(":stats with args");
+
+	assert_strcmp(action_message(), "stats: Unknown arg 'with'");
+
+	/* clear error */
+	INP_C(0x0A);
+
+	INP_COMMAND(":stats");
+
+	assert_strncmp(CURRENT_LINE, "buffer rirc: ", 13);
+
+	if (!(s = server("host", "port", NULL, "user", "real", NULL)))
+		test_abort("Failed test setup");
+
+	if (server_list_add(state_server_list(), s))
+		test_abort("Failed to add server");
+
+	channel_set_current(s->channel);
+
+	io_cb_read_soc(":nick!user@host PRIVMSG host :message\r\n", 39, s);
+
+	INP_COMMAND(":stats");
+
+	assert_strncmp(CURRENT_LINE, "buffer host: ", 13);
+	assert_eq(s->read.msgs, 1);
+}
+
 static void
 test_state(void)
 {
@@ -499,11 +655,68 @@ test_state(void)
 	assert_ptr_eq(server_list_add(state_server_list(), s3), NULL);
 }
 
+static void
+test_state_channel_compact(void)
+{
+	/* Test channels idle and out of view are compacted when switching */
+
+	struct channel *c1 = channel("#c1", CHANNEL_T_CHANNEL);
+	struct channel *c2 = channel("#c2", CHANNEL_T_CHANNEL);
+	struct server *s = server("h1", "p1", NULL, "u1", "r1", NULL);
+	time_t t;
+
+	c1->server = s;
+	c2->server = s;
+	channel_list_add(&(s->clist), c1);
+	channel_list_add(&(s->clist), c2);
+	assert_ptr_eq(server_list_add(state_server_list(), s), NULL);
+
+	for (int i = 0; i < 64; i++) {
+		newlinef(c1, 0, "", "%d", i);
+		newlinef(c2, 0, "", "%d", i);
+	}
+
+	channel_set_current(c1);
+	assert_eq(input_insert(&(c1->input), "a", 1), 1);
+	assert_eq(input_delete_back(&(c1->input)), 1);
+
+	/* Not yet idle */
+	channel_set_current(c2);
+	assert_ptr_not_null(c1->input.buf);
+	assert_ptr_null(c1->buffer.buffer_lines[0].block);
+
+	t = c1->time_viewed;
+
+	/* Not yet idle, before the deadline */
+	state_channel_compact(t + CHANNEL_IDLE_COMPACT - 1);
+	assert_ptr_not_null(c1->input.buf);
+	assert_ptr_null(c1->buffer.buffer_lines[0].block);
+
+	/* Idle, not viewed */
+	state_channel_compact(t + CHANNEL_IDLE_COMPACT);
+	assert_ptr_null(c1->input.buf);
+	assert_ptr_not_null(c1->buffer.buffer_lines[0].block);
+
+	/* Channels aren't scanned again before the earliest idle deadline */
+	assert_true(state.compact_next == t + CHANNEL_IDLE_COMPACT * 2);
+	c1->time_viewed -= CHANNEL_IDLE_COMPACT * 2;
+	c1->buffer.time_last -= CHANNEL_IDLE_COMPACT * 2;
+	assert_eq(input_insert(&(c1->input), "a", 1), 1);
+	assert_eq(input_delete_back(&(c1->input)), 1);
+	state_channel_compact(t + CHANNEL_IDLE_COMPACT * 2 - 1);
+	assert_ptr_not_null(c1->input.buf);
+
+	/* Current channel is never compacted */
+	state_channel_compact(t + CHANNEL_IDLE_COMPACT * 2);
+	assert_ptr_null(c2->buffer.buffer_lines[0].block);
+}
+
 static int
 test_init(void)
 {
 	state_init();
 
+	buffer_free(&(current_channel()->buffer));
 	buffer(&(current_channel()->buffer));
 
 	return 0;
@@ -526,8 +739,11 @@ main(void)
 		TESTCASE(test_command_close),
 		TESTCASE(test_command_connect),
 		TESTCASE(test_command_disconnect),
+		TESTCASE(test_command_list),
 		TESTCASE(test_command_quit),
+		TESTCASE(test_command_stats),
 		TESTCASE(test_state),
+		TESTCASE(test_state_channel_compact),
 	};
 
 	return run_tests(test_init, test_term, tests);
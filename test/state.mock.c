@@ -6,6 +6,7 @@
 
 static char mock_chan[MOCK_LINE_N][MOCK_CHAN_LEN];
 static char mock_line[MOCK_LINE_N][MOCK_LINE_LEN];
+static time_t mock_time[MOCK_LINE_N];
 static unsigned mock_line_i;
 static unsigned mock_line_n;
 
@@ -16,22 +17,18 @@ mock_reset_state(void)
 	mock_line_n = 0;
 	memset(mock_chan, 0, MOCK_LINE_N * MOCK_CHAN_LEN);
 	memset(mock_line, 0, MOCK_LINE_N * MOCK_LINE_LEN);
+	memset(mock_time, 0, sizeof(mock_time));
 }
 
-void
-newlinef(struct channel *c, enum buffer_line_type t, const char *f, const char *fmt, ...)
+static void
+mock_newlinev(struct channel *c, time_t t, const char *fmt, va_list ap)
 {
-	va_list ap;
 	int r1;
 	int r2;
 
-	UNUSED(f);
-	UNUSED(t);
-
-	va_start(ap, fmt);
 	r1 = snprintf(mock_chan[mock_line_i], sizeof(mock_chan[mock_line_i]), "%s", c->name);
 	r2 = vsnprintf(mock_line[mock_line_i], sizeof(mock_line[mock_line_i]), fmt, ap);
-	va_end(ap);
+	mock_time[mock_line_i] = t;
 
 	mock_line_n++;
 
@@ -42,6 +39,32 @@ newlinef(struct channel *c, enum buffer_line_type t, const char *f, const char *
 	assert_gt(r2, 0);
 }
 
+void
+newlinef(struct channel *c, enum buffer_line_type t, const char *f, const char *fmt, ...)
+{
+	va_list ap;
+
+	UNUSED(f);
+	UNUSED(t);
+
+	va_start(ap, fmt);
+	mock_newlinev(c, time(NULL), fmt, ap);
+	va_end(ap);
+}
+
+void
+newline_history(struct channel *c, time_t time, enum buffer_line_type t, const char *f, const char *fmt, ...)
+{
+	va_list ap;
+
+	UNUSED(f);
+	UNUSED(t);
+
+	va_start(ap, fmt);
+	mock_newlinev(c, time, fmt, ap);
+	va_end(ap);
+}
+
 void
 newline(struct channel *c, enum buffer_line_type t, const char *f, const char *fmt)
 {
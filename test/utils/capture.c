@@ -0,0 +1,115 @@
+#include "test/test.h"
+
+#include "src/utils/capture.c"
+
+static void
+test_capture(void)
+{
+	/* Test writing and reading back a capture */
+
+	FILE *f;
+	char buf[CAPTURE_READ_LEN + 10];
+	struct capture_record r;
+
+	if ((f = tmpfile()) == NULL)
+		test_abort("tmpfile");
+
+	memset(buf, 'x', sizeof(buf));
+	buf[0] = '\n';
+	buf[1] = 0;
+
+	assert_eq(capture_header_write(f), 0);
+	assert_eq(capture_write(f, CAPTURE_CXED, 10, NULL, 0), 0);
+	assert_eq(capture_write(f, CAPTURE_READ, 20, "abc\r\n", 5), 0);
+	assert_eq(capture_write(f, CAPTURE_READ, 30, buf, sizeof(buf)), 0);
+	assert_eq(capture_write(f, CAPTURE_DXED, 40, NULL, 0), 0);
+
+	rewind(f);
+
+	assert_eq(capture_header_read(f), 0);
+
+	assert_eq(capture_read(f, &r), 1);
+	assert_eq(r.event, CAPTURE_CXED);
+	assert_ueq(r.ns, 10);
+	assert_ueq(r.len, 0);
+
+	assert_eq(capture_read(f, &r), 1);
+	assert_eq(r.event, CAPTURE_READ);
+	assert_ueq(r.ns, 20);
+	assert_ueq(r.len, 5);
+	assert_true(!memcmp(r.buf, "abc\r\n", 5));
+
+	/* Test data longer than a record is split, and binary safe */
+	assert_eq(capture_read(f, &r), 1);
+	assert_eq(r.event, CAPTURE_READ);
+	assert_ueq(r.ns, 30);
+	assert_ueq(r.len, CAPTURE_READ_LEN);
+	assert_true(!memcmp(r.buf, buf, CAPTURE_READ_LEN));
+
+	assert_eq(capture_read(f, &r), 1);
+	assert_ueq(r.len, 10);
+	assert_true(!memcmp(r.buf, buf + CAPTURE_READ_LEN, 10));
+
+	assert_eq(capture_read(f, &r), 1);
+	assert_eq(r.event, CAPTURE_DXED);
+	assert_ueq(r.ns, 40);
+
+	assert_eq(capture_read(f, &r), 0);
+
+	fclose(f);
+}
+
+static void
+test_capture_malformed(void)
+{
+	/* Test malformed captures are rejected */
+
+	#define CHECK_HEADER(S, RET) \
+	do { \
+		char str[] = S; \
+		FILE *f; \
+		if ((f = fmemopen(str, sizeof(str) - 1, "r")) == NULL) \
+			test_abort("fmemopen"); \
+		assert_eq(capture_header_read(f), (RET)); \
+		fclose(f); \
+	} while (0)
+
+	#define CHECK_READ(S, RET) \
+	do { \
+		char str[] = S; \
+		FILE *f; \
+		struct capture_record r; \
+		if ((f = fmemopen(str, sizeof(str) - 1, "r")) == NULL) \
+			test_abort("fmemopen"); \
+		assert_eq(capture_read(f, &r), (RET)); \
+		fclose(f); \
+	} while (0)
+
+	CHECK_HEADER("rirc-capture 1\n", 0);
+	CHECK_HEADER("rirc-capture 2\n", -1);
+	CHECK_HEADER("rirc-capture\n",   -1);
+	CHECK_HEADER("capture 1\n",      -1);
+
+	CHECK_READ("R 1 3\nabc\n", 1);
+	CHECK_READ("",             0);
+	CHECK_READ("X 1 0\n\n",   -1);
+	CHECK_READ("R 1\n",       -1);
+	CHECK_READ("R 1 4\nabc\n", -1);
+	CHECK_READ("R 1 3\nabc",  -1);
+	CHECK_READ("C 1 3\nabc\n", -1);
+	CHECK_READ("R 1 4097\n",  -1);
+
+	#undef CHECK_HEADER
+	#undef CHECK_READ
+}
+
+int
+main(void)
+{
+	struct testcase tests[] = {
+		TESTCASE(test_capture),
+		TESTCASE(test_capture_malformed),
+	};
+
+	return run_tests(NULL, NULL, tests);
+}
@@ -0,0 +1,190 @@
+#include "test/test.h"
+
+#include "src/utils/highlight.c"
+#include "src/utils/utils.c"
+
+static void
+test_highlight_nick(void)
+{
+	/* Test detecting user's nick in message */
+
+	struct highlight h = {0};
+
+#define CHECK_HIGHLIGHT(M, R) \
+	assert_eq(highlight_match(&h, (M)), (R));
+
+	assert_eq(highlight_compile(&h, CASEMAPPING_RFC1459, "nick", NULL), 0);
+
+	CHECK_HIGHLIGHT("nick", 1);
+	CHECK_HIGHLIGHT("nick ", 1);
+	CHECK_HIGHLIGHT("nick:", 1);
+	CHECK_HIGHLIGHT("nick: ", 1);
+	CHECK_HIGHLIGHT(" nick", 1);
+	CHECK_HIGHLIGHT(" nick ", 1);
+	CHECK_HIGHLIGHT(" nick:", 1);
+	CHECK_HIGHLIGHT(" nick: ", 1);
+	CHECK_HIGHLIGHT("xxx 'nick'! ", 1);
+	CHECK_HIGHLIGHT("xxx @nick?! xxx", 1);
+	CHECK_HIGHLIGHT("xxx @NICK?! xxx", 1);
+	CHECK_HIGHLIGHT("nnick nick", 1);
+	CHECK_HIGHLIGHT("nicknick nick", 1);
+
+	CHECK_HIGHLIGHT("", 0);
+	CHECK_HIGHLIGHT(" ", 0);
+	CHECK_HIGHLIGHT("xxx", 0);
+	CHECK_HIGHLIGHT("nic", 0);
+	CHECK_HIGHLIGHT("xnick", 0);
+	CHECK_HIGHLIGHT("xnick:", 0);
+	CHECK_HIGHLIGHT("xnick: ", 0);
+	CHECK_HIGHLIGHT(" xnick", 0);
+	CHECK_HIGHLIGHT(" xnick:", 0);
+	CHECK_HIGHLIGHT("nickx", 0);
+	CHECK_HIGHLIGHT("nick-", 0);
+	CHECK_HIGHLIGHT("nicknick", 0);
+
+	/* Test server assigns a non standard nick */
+	assert_eq(highlight_compile(&h, CASEMAPPING_RFC1459, "000nick", NULL), 0);
+
+	CHECK_HIGHLIGHT("000nick", 1);
+	CHECK_HIGHLIGHT("000nick ", 1);
+	CHECK_HIGHLIGHT("000nick:", 1);
+	CHECK_HIGHLIGHT("000nick: ", 1);
+	CHECK_HIGHLIGHT(" 000nick", 1);
+	CHECK_HIGHLIGHT(" 000nick ", 1);
+	CHECK_HIGHLIGHT(" 000nick:", 1);
+	CHECK_HIGHLIGHT(" 000nick: ", 1);
+	CHECK_HIGHLIGHT("xxx '000nick'! ", 1);
+	CHECK_HIGHLIGHT("xxx @000nick?! xxx", 1);
+	CHECK_HIGHLIGHT("xxx @000NICK?! xxx", 1);
+
+	CHECK_HIGHLIGHT("nick", 0);
+	CHECK_HIGHLIGHT("x000nick", 0);
+	CHECK_HIGHLIGHT("x000nick:", 0);
+	CHECK_HIGHLIGHT("x000nick: ", 0);
+	CHECK_HIGHLIGHT(" x000nick", 0);
+	CHECK_HIGHLIGHT(" x000nick:", 0);
+
+	highlight_free(&h);
+
+	/* Test no patterns */
+	CHECK_HIGHLIGHT("nick", 0);
+
+	assert_eq(highlight_compile(&h, CASEMAPPING_RFC1459, NULL, NULL), 0);
+
+	CHECK_HIGHLIGHT("nick", 0);
+
+	highlight_free(&h);
+
+#undef CHECK_HIGHLIGHT
+}
+
+static void
+test_highlight_keywords(void)
+{
+	/* Test detecting keywords, and overlapping patterns */
+
+	struct highlight h = {0};
+
+#define CHECK_HIGHLIGHT(M, R) \
+	assert_eq(highlight_match(&h, (M)), (R));
+
+	assert_eq(highlight_compile(&h, CASEMAPPING_RFC1459, "nick", ",rirc,,ick,c++,nick nack,"), 0);
+
+	CHECK_HIGHLIGHT("nick", 1);
+	CHECK_HIGHLIGHT("xxx rirc xxx", 1);
+	CHECK_HIGHLIGHT("xxx RIRC", 1);
+	CHECK_HIGHLIGHT("ick", 1);
+	CHECK_HIGHLIGHT("xxx c++ xxx", 1);
+	CHECK_HIGHLIGHT("nick nack", 1);
+	CHECK_HIGHLIGHT("NICK NACK!", 1);
+
+	/* Shorter patterns matching within longer patterns */
+	CHECK_HIGHLIGHT("xnick", 0);
+	CHECK_HIGHLIGHT("xnick ick", 1);
+	CHECK_HIGHLIGHT("nick nac", 1);
+	CHECK_HIGHLIGHT("xnick nack", 0);
+
+	CHECK_HIGHLIGHT("", 0);
+	CHECK_HIGHLIGHT(",", 0);
+	CHECK_HIGHLIGHT("rircs", 0);
+	CHECK_HIGHLIGHT("c+", 0);
+	CHECK_HIGHLIGHT("xc++", 0);
+
+	/* Test keywords without a nick */
+	assert_eq(highlight_compile(&h, CASEMAPPING_RFC1459, NULL, "rirc"), 0);
+
+	CHECK_HIGHLIGHT("nick", 0);
+	CHECK_HIGHLIGHT("rirc", 1);
+
+	highlight_free(&h);
+
+#undef CHECK_HIGHLIGHT
+}
+
+static void
+test_highlight_casemapping(void)
+{
+	/* Test patterns are matched under casemapping */
+
+	struct highlight h = {0};
+
+	assert_eq(highlight_compile(&h, CASEMAPPING_RFC1459, "n{i}c|k^", NULL), 0);
+	assert_eq(highlight_match(&h, "xxx N[I]C\\K~ xxx"), 1);
+	assert_eq(highlight_match(&h, "xxx n{i}c|k^ xxx"), 1);
+
+	assert_eq(highlight_compile(&h, CASEMAPPING_STRICT_RFC1459, "n{i}c|k^", NULL), 0);
+	assert_eq(highlight_match(&h, "xxx N[I]C\\K~ xxx"), 0);
+	assert_eq(highlight_match(&h, "xxx N[I]C\\K^ xxx"), 1);
+
+	assert_eq(highlight_compile(&h, CASEMAPPING_ASCII, "n{i}c|k^", NULL), 0);
+	assert_eq(highlight_match(&h, "xxx N[I]C\\K^ xxx"), 0);
+	assert_eq(highlight_match(&h, "xxx N{I}C|K^ xxx"), 1);
+
+	highlight_free(&h);
+}
+
+static void
+test_highlight_states(void)
+{
+	/* Test states are shared by common prefixes, and limited */
+
+	char *keywords;
+	size_t len = HIGHLIGHT_STATES_MAX;
+	struct highlight h = {0};
+
+	assert_eq(highlight_compile(&h, CASEMAPPING_RFC1459, "abc", "abd,ABE,ab"), 0);
+	assert_eq(h.n_states, 6);
+	assert_eq(h.n_classes, 6);
+
+	if ((keywords = malloc(len + 1)) == NULL)
+		test_abort("malloc");
+
+	memset(keywords, 'a', len);
+	keywords[len] = 0;
+
+	assert_eq(highlight_compile(&h, CASEMAPPING_RFC1459, NULL, keywords), -1);
+	assert_ptr_null(h.delta);
+	assert_eq(highlight_match(&h, "abc"), 0);
+
+	keywords[len - 1] = 0;
+
+	assert_eq(highlight_compile(&h, CASEMAPPING_RFC1459, NULL, keywords), 0);
+	assert_eq(highlight_match(&h, keywords), 1);
+
+	free(keywords);
+
+	highlight_free(&h);
+}
+
+int
+main(void)
+{
+	struct testcase tests[] = {
+		TESTCASE(test_highlight_nick),
+		TESTCASE(test_highlight_keywords),
+		TESTCASE(test_highlight_casemapping),
+		TESTCASE(test_highlight_states),
+	};
+
+	return run_tests(NULL, NULL, tests);
+}
@@ -0,0 +1,90 @@
+#include "test/test.h"
+
+#include "src/utils/intern.c"
+
+static void
+test_intern(void)
+{
+	/* Test equal strings are shared, and freed with their last reference */
+
+	struct intern t = {0};
+	const char *s1;
+	const char *s2;
+	const char *s3;
+
+	assert_ptr_not_null((s1 = intern(&t, "abc", 3)));
+	assert_ptr_not_null((s2 = intern(&t, "abcdef", 3)));
+	assert_ptr_not_null((s3 = intern(&t, "ABC", 3)));
+
+	assert_ptr_eq(s1, s2);
+	assert_true(s1 != s3);
+	assert_strcmp(s1, "abc");
+	assert_strcmp(s3, "ABC");
+	assert_ueq(t.count, 2);
+
+	/* Test zero length strings */
+	intern_unref(intern(&t, "", 0));
+	assert_ueq(t.count, 2);
+
+	assert_ptr_eq(intern_ref(s3), s3);
+
+	intern_unref(s1);
+	intern_unref(s3);
+	assert_ueq(t.count, 2);
+
+	intern_unref(s2);
+	assert_ueq(t.count, 1);
+
+	intern_unref(s3);
+	intern_unref(NULL);
+
+	assert_ueq(t.count, 0);
+	assert_ueq(t.size, 0);
+	assert_ptr_null(t.buckets);
+	assert_ueq(intern_memory(&t), 0);
+}
+
+static void
+test_intern_grow(void)
+{
+	/* Test strings are retained as the table grows */
+
+	char buf[16];
+	const char *strs[1000];
+	struct intern t = {0};
+
+	for (int i = 0; i < 1000; i++) {
+		snprintf(buf, sizeof(buf), "str%d", i);
+		strs[i] = intern(&t, buf, strlen(buf));
+	}
+
+	assert_ueq(t.count, 1000);
+	assert_ueq(t.size, 1024);
+	assert_gt(intern_memory(&t), 1000 * sizeof(struct intern_str));
+
+	for (int i = 0; i < 1000; i++) {
+		snprintf(buf, sizeof(buf), "str%d", i);
+		if (intern(&t, buf, strlen(buf)) != strs[i])
+			test_failf("Failed to retrieve string: %s", buf);
+		intern_unref(strs[i]);
+	}
+
+	assert_ueq(t.count, 1000);
+
+	for (int i = 0; i < 1000; i++)
+		intern_unref(strs[i]);
+
+	assert_ueq(t.count, 0);
+	assert_ptr_null(t.buckets);
+}
+
+int
+main(void)
+{
+	struct testcase tests[] = {
+		TESTCASE(test_intern),
+		TESTCASE(test_intern_grow),
+	};
+
+	return run_tests(NULL, NULL, tests);
+}
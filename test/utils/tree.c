@@ -669,6 +669,66 @@ test_avl_foreach(void)
 	assert_ptr_null(t350.node.tree_right);
 }
 
+static void
+test_avl_build(void)
+{
+	/* Test AVL_BUILD and AVL_ARRAY
+	 *
+	 * Build from 50, 100, 150, 200, 250, 300:
+	 *
+	 *          _ 200 _
+	 *         /       \
+	 *      100         300
+	 *     /   \       /
+	 *   50     150 250
+	 */
+
+	struct test_tree tl = {0};
+	struct test_node *arr[7];
+
+	struct test_node
+		t050 = { .val = 50 },
+		t100 = { .val = 100 },
+		t150 = { .val = 150 },
+		t200 = { .val = 200 },
+		t250 = { .val = 250 },
+		t300 = { .val = 300 },
+		t350 = { .val = 350 };
+
+	struct test_node *nodes[] = { &t050, &t100, &t150, &t200, &t250, &t300 };
+
+	test_tree_AVL_BUILD(&tl, nodes, 0);
+
+	assert_ptr_null(TREE_ROOT(&tl));
+	assert_eq((int) test_tree_AVL_ARRAY(&tl, arr), 0);
+
+	test_tree_AVL_BUILD(&tl, nodes, 6);
+
+	assert_ptr_eq(TREE_ROOT(&tl), &t200);
+	assert_ptr_eq(t200.node.tree_left,  &t100);
+	assert_ptr_eq(t200.node.tree_right, &t300);
+	assert_ptr_eq(t100.node.tree_left,  &t050);
+	assert_ptr_eq(t100.node.tree_right, &t150);
+	assert_ptr_eq(t300.node.tree_left,  &t250);
+	assert_ptr_null(t300.node.tree_right);
+
+	assert_eq(t200.node.height, 3);
+	assert_eq(t300.node.height, 2);
+	assert_eq(t250.node.height, 1);
+
+	/* Built tree can be modified */
+	assert_ptr_eq(test_tree_AVL_ADD(&tl, &t350, 0), &t350);
+	assert_ptr_eq(test_tree_AVL_DEL(&tl, &t100, 0), &t100);
+
+	assert_eq((int) test_tree_AVL_ARRAY(&tl, arr), 6);
+	assert_ptr_eq(arr[0], &t050);
+	assert_ptr_eq(arr[1], &t150);
+	assert_ptr_eq(arr[2], &t200);
+	assert_ptr_eq(arr[3], &t250);
+	assert_ptr_eq(arr[4], &t300);
+	assert_ptr_eq(arr[5], &t350);
+}
+
 int
 main(void)
 {
@@ -680,7 +740,8 @@ main(void)
 		TESTCASE(test_avl_del),
 		TESTCASE(test_avl_get_n),
 		TESTCASE(test_avl_rotations),
-		TESTCASE(test_avl_foreach)
+		TESTCASE(test_avl_foreach),
+		TESTCASE(test_avl_build)
 	};
 
 	return run_tests(NULL, NULL, tests);
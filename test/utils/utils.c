@@ -184,9 +184,96 @@ test_irc_message_parse(void)
 	char mesg9[] = ": CMD arg1 arg2 arg3";
 	CHECK_IRC_MESSAGE_PARSE(mesg9, -1);
 
+	/* Test message tags */
+	char mesg10[] = "@time=2020-01-01T00:00:00.000Z;msgid=abc :nick!user@host CMD arg";
+
+	CHECK_IRC_MESSAGE_PARSE(mesg10, 0);
+	assert_strcmp(m.tags,    "time=2020-01-01T00:00:00.000Z;msgid=abc");
+	assert_strcmp(m.command, "CMD");
+	assert_strcmp(m.from,    "nick");
+	assert_strcmp(m.host,    "user@host");
+	assert_strcmp(m.params,  "arg");
+
+	/* Test message tags, no prefix */
+	char mesg11[] = "@a  CMD";
+
+	CHECK_IRC_MESSAGE_PARSE(mesg11, 0);
+	assert_strcmp(m.tags,    "a");
+	assert_strcmp(m.command, "CMD");
+	assert_strcmp(m.from,    NULL);
+
+	/* Error: tags only */
+	char mesg12[] = "@a=b ";
+	CHECK_IRC_MESSAGE_PARSE(mesg12, -1);
+
 #undef CHECK_IRC_MESSAGE_PARSE
 }
 
+static void
+test_irc_message_tag(void)
+{
+	char val[8];
+	struct irc_message m;
+
+#define CHECK_IRC_MESSAGE_TAG(K, R, V) \
+	assert_eq(irc_message_tag(&m, (K), val, sizeof(val)), (R)); \
+	if ((R)) assert_strcmp(val, (V));
+
+	char mesg1[] = "CMD";
+	assert_eq(irc_message_parse(&m, mesg1), 0);
+
+	CHECK_IRC_MESSAGE_TAG("a", 0, NULL);
+
+	char mesg2[] = "@a=1;ab=2;b;c=;+d=x\\:y\\sz;e=\\\\\\;f=\\ab\\;g=12345678 CMD";
+	assert_eq(irc_message_parse(&m, mesg2), 0);
+
+	CHECK_IRC_MESSAGE_TAG("a",  1, "1");
+	CHECK_IRC_MESSAGE_TAG("ab", 1, "2");
+	CHECK_IRC_MESSAGE_TAG("b",  1, "");
+	CHECK_IRC_MESSAGE_TAG("c",  1, "");
+	CHECK_IRC_MESSAGE_TAG("d",  0, NULL);
+	CHECK_IRC_MESSAGE_TAG("+d", 1, "x;y z");
+	CHECK_IRC_MESSAGE_TAG("e",  1, "\\");
+	CHECK_IRC_MESSAGE_TAG("f",  1, "ab");
+	CHECK_IRC_MESSAGE_TAG("x",  0, NULL);
+
+	/* Test truncated values */
+	CHECK_IRC_MESSAGE_TAG("g", -1, "1234567");
+
+#undef CHECK_IRC_MESSAGE_TAG
+}
+
+static void
+test_irc_message_time(void)
+{
+	struct irc_message m;
+	time_t t;
+
+#define CHECK_IRC_MESSAGE_TIME(M, R, T) \
+	do { \
+		char mesg[] = M; \
+		t = -1; \
+		assert_eq(irc_message_parse(&m, mesg), 0); \
+		assert_eq(irc_message_time(&m, &t), (R)); \
+		assert_eq(t, (T)); \
+	} while (0)
+
+	CHECK_IRC_MESSAGE_TIME("@time=1970-01-01T00:00:00.000Z CMD", 1, 0);
+	CHECK_IRC_MESSAGE_TIME("@time=2000-02-29T12:34:56.789Z CMD", 1, 951827696);
+	CHECK_IRC_MESSAGE_TIME("@a=b;time=2024-12-31T23:59:59.000Z CMD", 1, 1735689599);
+
+	/* Test absent or invalid times */
+	CHECK_IRC_MESSAGE_TIME("CMD", 0, -1);
+	CHECK_IRC_MESSAGE_TIME("@a=b CMD", 0, -1);
+	CHECK_IRC_MESSAGE_TIME("@time= CMD", 0, -1);
+	CHECK_IRC_MESSAGE_TIME("@time=2020-01-01 CMD", 0, -1);
+	CHECK_IRC_MESSAGE_TIME("@time=1969-12-31T23:59:59.000Z CMD", 0, -1);
+	CHECK_IRC_MESSAGE_TIME("@time=2020-13-01T00:00:00.000Z CMD", 0, -1);
+	CHECK_IRC_MESSAGE_TIME("@time=2020-01-01T24:00:00.000Z CMD", 0, -1);
+
+#undef CHECK_IRC_MESSAGE_TIME
+}
+
 static void
 test_irc_message_split(void)
 {
@@ -362,63 +449,6 @@ test_irc_message_split(void)
 #undef CHECK_IRC_MESSAGE_SPLIT
 }
 
-static void
-test_irc_pinged(void)
-{
-	/* Test detecting user's nick in message */
-
-	const char *nick;
-
-#define CHECK_IRC_PINGED(M, R) \
-	assert_eq(irc_pinged(CASEMAPPING_RFC1459, (M), nick), (R));
-
-	nick = "nick";
-
-	CHECK_IRC_PINGED("nick", 1);
-	CHECK_IRC_PINGED("nick ", 1);
-	CHECK_IRC_PINGED("nick:", 1);
-	CHECK_IRC_PINGED("nick: ", 1);
-	CHECK_IRC_PINGED(" nick", 1);
-	CHECK_IRC_PINGED(" nick ", 1);
-	CHECK_IRC_PINGED(" nick:", 1);
-	CHECK_IRC_PINGED(" nick: ", 1);
-	CHECK_IRC_PINGED("xxx 'nick'! ", 1);
-	CHECK_IRC_PINGED("xxx @nick?! xxx", 1);
-	CHECK_IRC_PINGED("xxx @NICK?! xxx", 1);
-
-	CHECK_IRC_PINGED("", 0);
-	CHECK_IRC_PINGED(" ", 0);
-	CHECK_IRC_PINGED("xxx", 0);
-	CHECK_IRC_PINGED("xnick", 0);
-	CHECK_IRC_PINGED("xnick:", 0);
-	CHECK_IRC_PINGED("xnick: ", 0);
-	CHECK_IRC_PINGED(" xnick", 0);
-	CHECK_IRC_PINGED(" xnick:", 0);
-
-	/* Test server assigns a non standard nick */
-	nick = "000nick";
-
-	CHECK_IRC_PINGED("000nick", 1);
-	CHECK_IRC_PINGED("000nick ", 1);
-	CHECK_IRC_PINGED("000nick:", 1);
-	CHECK_IRC_PINGED("000nick: ", 1);
-	CHECK_IRC_PINGED(" 000nick", 1);
-	CHECK_IRC_PINGED(" 000nick ", 1);
-	CHECK_IRC_PINGED(" 000nick:", 1);
-	CHECK_IRC_PINGED(" 000nick: ", 1);
-	CHECK_IRC_PINGED("xxx '000nick'! ", 1);
-	CHECK_IRC_PINGED("xxx @000nick?! xxx", 1);
-	CHECK_IRC_PINGED("xxx @000NICK?! xxx", 1);
-
-	CHECK_IRC_PINGED("x000nick", 0);
-	CHECK_IRC_PINGED("x000nick:", 0);
-	CHECK_IRC_PINGED("x000nick: ", 0);
-	CHECK_IRC_PINGED(" x000nick", 0);
-	CHECK_IRC_PINGED(" x000nick:", 0);
-
-#undef CHECK_IRC_PINGED
-}
-
 static void
 test_irc_strcmp(void)
 {
@@ -466,6 +496,24 @@ test_irc_strncmp(void)
 	assert_gt(irc_strncmp(CASEMAPPING_RFC1459, "abcA", "abcZ", 4), 0);
 }
 
+static void
+test_irc_strkey(void)
+{
+	/* Test keys order inversely to irc_strcmp, and are casemapped */
+	assert_true(irc_strkey(CASEMAPPING_RFC1459, "0", 0) < irc_strkey(CASEMAPPING_RFC1459, "a", 0));
+	assert_true(irc_strkey(CASEMAPPING_RFC1459, "a", 0) < irc_strkey(CASEMAPPING_RFC1459, "{", 0));
+	assert_true(irc_strkey(CASEMAPPING_RFC1459, "ab", 0) > irc_strkey(CASEMAPPING_RFC1459, "a", 0));
+	assert_eq((irc_strkey(CASEMAPPING_RFC1459, "a\xe9", 0) < irc_strkey(CASEMAPPING_RFC1459, "a", 0)),
+	          (irc_strcmp(CASEMAPPING_RFC1459, "a\xe9", "a") > 0));
+	assert_true(irc_strkey(CASEMAPPING_RFC1459, "abc[]\\~", 0) == irc_strkey(CASEMAPPING_RFC1459, "ABC{}|^", 0));
+	assert_true(irc_strkey(CASEMAPPING_ASCII, "abc[]\\~", 0) != irc_strkey(CASEMAPPING_ASCII, "ABC{}|^", 0));
+
+	/* Test keys of the first 8 characters, or n */
+	assert_true(irc_strkey(CASEMAPPING_RFC1459, "abcdefghX", 0) == irc_strkey(CASEMAPPING_RFC1459, "abcdefghY", 0));
+	assert_true(irc_strkey(CASEMAPPING_RFC1459, "abcX", 3) == irc_strkey(CASEMAPPING_RFC1459, "abcY", 3));
+	assert_true(irc_strkey(CASEMAPPING_RFC1459, "abcX", 4) != irc_strkey(CASEMAPPING_RFC1459, "abcY", 4));
+}
+
 static void
 test_irc_toupper(void)
 {
@@ -541,6 +589,65 @@ test_irc_strtrim(void)
 	assert_strcmp(mesg4, "");
 }
 
+static void
+test_utf8_decode(void)
+{
+	/* Test decoding UTF-8 code points and their display width */
+
+	#define CHECK_DECODE(S, N, CP, W) \
+	do { \
+		uint32_t c; \
+		unsigned w; \
+		assert_ueq(utf8_decode((S), strlen((S)), &c, &w), (N)); \
+		assert_ueq(c, (CP)); \
+		assert_ueq(w, (W)); \
+	} while (0)
+
+	uint32_t cp;
+	unsigned width;
+
+	assert_ueq(utf8_decode("", 0, &cp, &width), 0);
+
+	CHECK_DECODE("a",                1, 0x61,    1);
+	CHECK_DECODE("\xc3\xa9",         2, 0xE9,    1);
+	CHECK_DECODE("\xcc\x81",         2, 0x301,   0);
+	CHECK_DECODE("\xe4\xb8\xad",     3, 0x4E2D,  2);
+	CHECK_DECODE("\xef\xbc\xa1",     3, 0xFF21,  2);
+	CHECK_DECODE("\xe2\x80\x8b",     3, 0x200B,  0);
+	CHECK_DECODE("\xf0\x9f\x98\x80", 4, 0x1F600, 2);
+
+	/* Test malformed sequences decode a single byte */
+	CHECK_DECODE("\x80",             1, 0xFFFD,  1);
+	CHECK_DECODE("\xc3",             1, 0xFFFD,  1);
+	CHECK_DECODE("\xc3" "a",          1, 0xFFFD,  1);
+	CHECK_DECODE("\xc0\xaf",         1, 0xFFFD,  1);
+	CHECK_DECODE("\xed\xa0\x80",     1, 0xFFFD,  1);
+	CHECK_DECODE("\xf4\x90\x80\x80", 1, 0xFFFD,  1);
+
+	/* Test truncated length */
+	assert_ueq(utf8_decode("\xe4\xb8\xad", 2, &cp, &width), 1);
+	assert_ueq(cp, 0xFFFD);
+
+	#undef CHECK_DECODE
+}
+
+static void
+test_utf8_width(void)
+{
+	/* Test display width of code points */
+
+	assert_ueq(utf8_width(0x41), 1);
+	assert_ueq(utf8_width(0xAD), 1);
+	assert_ueq(utf8_width(0x300), 0);
+	assert_ueq(utf8_width(0x1160), 0);
+	assert_ueq(utf8_width(0x1100), 2);
+	assert_ueq(utf8_width(0x3000), 2);
+	assert_ueq(utf8_width(0xAC00), 2);
+	assert_ueq(utf8_width(0x20000), 2);
+	assert_ueq(utf8_width(0x10FFFF), 1);
+	assert_ueq(utf8_width(0x110000), 1);
+}
+
 int
 main(void)
 {
@@ -550,12 +657,16 @@ main(void)
 		TESTCASE(test_irc_message_param),
 		TESTCASE(test_irc_message_parse),
 		TESTCASE(test_irc_message_split),
-		TESTCASE(test_irc_pinged),
+		TESTCASE(test_irc_message_tag),
+		TESTCASE(test_irc_message_time),
 		TESTCASE(test_irc_strcmp),
 		TESTCASE(test_irc_strncmp),
+		TESTCASE(test_irc_strkey),
 		TESTCASE(test_irc_strsep),
 		TESTCASE(test_irc_strtrim),
-		TESTCASE(test_irc_toupper)
+		TESTCASE(test_irc_toupper),
+		TESTCASE(test_utf8_decode),
+		TESTCASE(test_utf8_width)
 	};
 
 	return run_tests(NULL, NULL, tests);